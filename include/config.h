@@ -48,6 +48,8 @@
     PZEM B RX   -> GPIO12
     GSM TX      -> GPIO16
     GSM RX      -> GPIO17
+    GSM DTR     -> GPIO32
+    GSM RI      -> GPIO33
     LCD/RTC SDA -> GPIO21
     LCD/RTC SCL -> GPIO22
     BUZZER      -> GPIO18
@@ -85,13 +87,22 @@
 #define GSM_RX_PIN 17
 #define GSM_RESET_PIN 5     // Optional reset pin
 #define GSM_PWR_PIN 4       // Optional power control pin
+#define GSM_DTR_PIN 32      // High lets the modem slow-clock sleep, low wakes it
+#define GSM_RI_PIN 33       // Pulled low by the modem on incoming SMS/call
 
 // UART Configuration
-#define GSM_UART_BAUDRATE      9600
+#define GSM_UART_BAUDRATE      9600     // Probe and fallback rate; the modem autobauds to it
+#define GSM_UART_FAST_BAUDRATE 115200   // Switched to with AT+IPR after the first probe; 0 stays at the probe rate
 #define GSM_UART_CONFIG        SERIAL_8N1
+#define MODEM_SILENT_LIMIT     3        // Unanswered commands in a row before the rates are probed again
 
 //#define UART_BUFFER_SIZE       256      // UART receive buffer size
 
+// Bring-up runs in the background from setup(); see GSMModule::serviceBringUp()
+#define MODEM_BOOT_TIMEOUT 10000          // Modem answers AT ~3 s after power-on
+#define MODEM_REGISTRATION_TIMEOUT 60000  // Give up waiting for the network after 1 minute
+#define MODEM_BRINGUP_RETRY 60000         // Then start over after another minute
+
 // Network Configuration
 #define GSM_APN "internet"  // Change to your carrier's APN
 #define GSM_USERNAME ""     // Usually empty for most carriers
@@ -106,25 +117,84 @@ static const char* const SMS_RECIPIENTS[] = {
 #define SMS_RECIPIENT_COUNT (sizeof(SMS_RECIPIENTS) / sizeof(SMS_RECIPIENTS[0]))
 
 // SMS Rate Limiting
-#define SMS_MIN_INTERVAL 30000    // 30 seconds between SMS
+#define SMS_MIN_INTERVAL 10000    // 10 seconds between outgoing SMS
 #define SMS_RETRY_COUNT 3         // Number of SMS retry attempts
 #define SMS_TIMEOUT 30000         // SMS send timeout (30 seconds)
+#define SMS_COALESCE_WINDOW 600000 // Repeats of the same alert within 10 minutes go out as one SMS
+
+// Delivery reports: +CMGS only means the SMS centre took the message. With
+// reports on, each message asks for a +CDS once the phone has it; alerts
+// that were not delivered are sent again to that recipient only.
+#define SMS_DELIVERY_REPORTS true
+#define SMS_DELIVERY_TIMEOUT 900000    // No report within 15 minutes: logged as unconfirmed
+#define SMS_REDELIVERY_COUNT 2         // Further sends after a temporary-failure report
 
 // ===================================
 // CLOUD/API CONFIGURATION
 // ===================================
-#define THINGSPEAK_API_KEY "F4SQUSOSHFE7K3I7&field1=0"
+#define THINGSPEAK_API_KEY "F4SQUSOSHFE7K3I7"
 #define THINGSPEAK_CHANNEL_ID "3035836"
 
 // HTTP Configuration
 #define HTTP_TIMEOUT 30000        // HTTP request timeout (30 seconds)
 #define HTTP_RETRY_COUNT 3        // Number of HTTP retry attempts
 #define HTTP_USER_AGENT "ESP32-EnergyMonitor/1.0"
+// Response bodies up to this size are read back (AT+HTTPREAD) for server
+// directives: {"upload_interval":<s>} and {"retry_after":<s>}
+#define HTTP_RESPONSE_MAX 256
+
+// GPRS reconnect policy: exponential backoff with jitter, then a breaker
+#define GPRS_RETRY_BASE_DELAY 10000    // First retry after 5-10 seconds
+#define GPRS_RETRY_MAX_DELAY 300000    // Backoff never exceeds 5 minutes
+#define GPRS_BREAKER_THRESHOLD 5       // Failed attempts in a row before the breaker opens
+#define GPRS_BREAKER_OPEN_TIME 1800000 // Cool-down while open (30 minutes)
+
+// MQTT over the modem's TCP stack: one long-lived connection instead of an
+// HTTP request per upload for the billing backend. HTTP stays the fallback
+// while the broker is unreachable.
+#define ENABLE_MQTT false
+#define MQTT_BROKER_HOST "broker.example.com"
+#define MQTT_BROKER_PORT 1883
+#define MQTT_USERNAME ""
+#define MQTT_PASSWORD ""
+#define MQTT_KEEPALIVE 300             // Seconds; uploads every 5 minutes keep it alive on their own
+#define MQTT_ACK_TIMEOUT 15000         // Wait for CONNACK/PUBACK
+#define MQTT_MAX_PAYLOAD 8192          // Telemetry publishes are built in RAM (~45 readings as JSON)
+#define MQTT_TOPIC_ROOT "energy-monitor/" DEVICE_ID
+#define MQTT_TELEMETRY_TOPIC MQTT_TOPIC_ROOT "/telemetry"
+#define MQTT_COMMAND_TOPIC MQTT_TOPIC_ROOT "/cmd"   // Same commands as SMS
+#define MQTT_REPLY_TOPIC MQTT_TOPIC_ROOT "/reply"
+#define MQTT_MODEM_TOPIC MQTT_TOPIC_ROOT "/modem"
 
 // Cloud Services URLs
 #define THINGSPEAK_UPDATE_URL "https://api.thingspeak.com/update"
+#define THINGSPEAK_BULK_URL "https://api.thingspeak.com/channels/" THINGSPEAK_CHANNEL_ID "/bulk_update.json"
+#define UPLOAD_MAX_BODY 32768            // Largest POST body (~175 readings as JSON); streamed from the queue, not held in RAM
+#define UPLOAD_STREAM_WINDOW 512         // Encoder window between the queue and the modem UART
 #define BACKUP_CLOUD_URL "https://your-backup-service.com/api/data"
 
+// Upload backends. Each reads the offline queue through its own cursor and
+// backs off on its own, so a slow or dead one never holds back the others;
+// a reading leaves the queue once every backend has it.
+#define ENABLE_THINGSPEAK_UPLOAD true
+#define ENABLE_BILLING_UPLOAD true
+#define BILLING_UPLOAD_URL "https://billing.example.com/api/readings"
+#define BILLING_FAILOVER_URL BACKUP_CLOUD_URL   // Used after UPLOAD_FAILOVER_AFTER failures in a row
+#define BILLING_API_KEY ""                      // write_api_key in JSON batches
+#define UPLOAD_FAILOVER_AFTER 2
+#define UPLOAD_RETRY_BASE_DELAY 30000      // Per-backend backoff after a failed upload
+#define UPLOAD_RETRY_MAX_DELAY 900000
+#define UPLOAD_BREAKER_THRESHOLD 6
+#define UPLOAD_BREAKER_OPEN_TIME 3600000
+
+// Per-command OK/ERROR/timeout counts and latency histograms (see
+// printDetailedStatus) go to the billing backend after an upload window,
+// at most this often: MODEM_STATS_URL, or MQTT_MODEM_TOPIC with ENABLE_MQTT
+#define ENABLE_MODEM_STATS_REPORT true
+#define MODEM_STATS_URL "https://billing.example.com/api/modem-stats"
+#define MODEM_STATS_INTERVAL 3600000
+#define MODEM_STATS_MAX_BODY 3072       // Built in RAM; ~24 command classes
+
 // ===================================
 // SENSOR CONFIGURATION (PZEM-004T)
 // ===================================
@@ -168,8 +238,18 @@ static const char* const SMS_RECIPIENTS[] = {
 // TIMING INTERVALS
 // ===================================
 #define DATA_LOG_INTERVAL 300000       // Log to cloud every 5 minutes
-#define SMS_CHECK_INTERVAL 60000       // Check for SMS every 1 minute
 #define API_UPDATE_INTERVAL 600000     // API updates every 10 minutes
+#define UPLOAD_INTERVAL DATA_LOG_INTERVAL   // Upload windows, phased per DEVICE_ID (see UploadScheduler.h)
+#define UPLOAD_JITTER 60000            // Each window moves by up to +/-30 seconds
+#define UPLOAD_INTERVAL_MIN 60000      // Bounds on an interval set by the server
+#define UPLOAD_INTERVAL_MAX 21600000
+#define UPLOAD_HOLD_MAX 86400000       // Longest pause a server can ask one backend for
+// Each window samples AT+CSQ first. At or below UPLOAD_POOR_SIGNAL (0-5) it
+// is put off by UPLOAD_DEFER_RETRY unless the oldest reading is older than
+// UPLOAD_MAX_STALENESS or the queue is 3/4 full; batches shrink as the signal weakens.
+#define UPLOAD_POOR_SIGNAL 2
+#define UPLOAD_DEFER_RETRY 120000
+#define UPLOAD_MAX_STALENESS 3600000
 #define DAILY_RESET_INTERVAL 86400000  // Reset daily counters (24 hours)
 #define SYSTEM_HEALTH_CHECK 300000     // System health check every 5 minutes
 
@@ -187,6 +267,12 @@ static const char* const SMS_RECIPIENTS[] = {
 #define LCD_COLS 16
 #define LCD_ROWS 4
 
+// Wall clock: network time (AT+CCLK) disciplines the DS3231, which carries it over reboots
+#define ENABLE_RTC true
+#define CLOCK_SYNC_INTERVAL 3600000    // Re-read network time hourly
+#define CLOCK_SYNC_RETRY 60000         // Pace of retries after a failed network-time read
+#define RTC_TRIM_SPAN 604800           // Seconds the RTC runs before its rate error is trimmed (1 s a week = 1.7 ppm)
+
 // Display Update Intervals
 #define DISPLAY_PAGE_DURATION 2000       // Update LCD every 2 seconds
 #define LCD_ALERT_BLINK_INTERVAL 500   // Alert blink rate
@@ -224,6 +310,25 @@ static const char* const SMS_RECIPIENTS[] = {
 #define WATCHDOG_TIMEOUT 30000       // 30 second watchdog timeout
 #define STACK_SIZE_GSM 8192          // Stack size for GSM task
 #define STACK_SIZE_SENSORS 4096      // Stack size for sensor task
+#define STACK_SIZE_UI 4096           // Stack size for LCD and alert task
+
+// FreeRTOS tasks: metering on the application core, the modem on the
+// protocol core (no Wi-Fi/BT stack runs there), LCD and LEDs lowest
+#define TASK_CORE_SENSORS 1
+#define TASK_CORE_GSM 0
+#define TASK_CORE_UI 1
+#define TASK_PRIORITY_SENSORS 3
+#define TASK_PRIORITY_GSM 2
+#define TASK_PRIORITY_UI 1
+#define GSM_TASK_PERIOD 10           // ms between modem service passes
+#define UI_TASK_PERIOD 50            // ms between LCD/LED passes
+
+// Bounded queues between the tasks; a full queue drops the new item and counts it
+#define ALERT_QUEUE_LENGTH 4         // SMS alerts raised by the sensor task
+#define UI_EVENT_QUEUE_LENGTH 8      // LCD messages and LED/buzzer changes
+// Readings on their way to the upload queue, in a lock-free ring that drops
+// the oldest when full (power of two)
+#define TELEMETRY_RING_SIZE 8
 
 // ===================================
 // SECURITY AND AUTHENTICATION
@@ -241,14 +346,18 @@ static const char* const SMS_RECIPIENTS[] = {
 // ADVANCED FEATURES
 // ===================================
 // Power Management
-#define ENABLE_SLEEP_MODE false          // Sleep mode when inactive
+#define ENABLE_SLEEP_MODE false          // Modem slow-clock sleep between uploads (needs DTR and RI wired)
 #define SLEEP_TIMEOUT 1800000           // Sleep after 30 minutes inactive
+#define MODEM_SLEEP_IDLE_TIME 15000     // Modem sleeps after 15 seconds without AT traffic
+#define MODEM_WAKE_SETTLE_TIME 60       // UART is back ~50 ms after DTR goes low
 #define ENABLE_POWER_SAVING true        // General power saving features
 
 // Data Management  
-#define ENABLE_DATA_COMPRESSION false   // Compress data before transmission
+#define ENABLE_DATA_COMPRESSION false   // Billing backend gets binary batches (see TelemetryCodec.h) instead of JSON
 #define ENABLE_OFFLINE_STORAGE true     // Store data when offline
 #define MAX_OFFLINE_STORAGE_DAYS 7      // Maximum days to store offline data
+#define OFFLINE_QUEUE_SEGMENT_RECORDS 128   // Readings per LittleFS segment file (~6.5 KB)
+#define OFFLINE_QUEUE_MAX_SEGMENTS (MAX_OFFLINE_STORAGE_DAYS * (86400000UL / DATA_LOG_INTERVAL) / OFFLINE_QUEUE_SEGMENT_RECORDS + 2)
 
 // Diagnostics
 #define AUTO_DIAGNOSTIC_ENABLED true    // Automatic system diagnostics
@@ -0,0 +1,164 @@
+#include "ATCommandStats.h"
+#include <stdio.h>
+#include <string.h>
+
+const uint32_t ATCommandStats::BUCKET_LIMITS[ATCommandStats::BUCKET_COUNT - 1] = {
+    50, 100, 200, 500, 1000, 2000, 5000, 10000, 30000
+};
+
+ATCommandStats::ATCommandStats() {
+    reset();
+}
+
+void ATCommandStats::reset() {
+    memset(entries, 0, sizeof(entries));
+    used = 0;
+}
+
+size_t ATCommandStats::className(const char* command, char* out, size_t size) {
+    if (size == 0) {
+        return 0;
+    }
+    const char* p = command;
+    if ((p[0] == 'A' || p[0] == 'a') && (p[1] == 'T' || p[1] == 't')) {
+        p += 2;
+        if (*p == '\0') {
+            // Plain "AT"
+            p = command;
+        } else if (*p == '+' || *p == '#') {
+            p++;
+        }
+    } else {
+        // Not a command: a phase name, taken as it is
+        size_t length = strlen(command);
+        if (length >= size) length = size - 1;
+        memcpy(out, command, length);
+        out[length] = '\0';
+        return length;
+    }
+
+    // Extended commands run to the first non-letter; basic ones (E0, &W) keep
+    // their prefix character
+    size_t length = 0;
+    if (*p == '&' && length + 1 < size) {
+        out[length++] = *p++;
+    }
+    while (length + 1 < size && ((*p >= 'A' && *p <= 'Z') || (*p >= 'a' && *p <= 'z'))) {
+        out[length++] = *p++;
+    }
+    out[length] = '\0';
+    return length;
+}
+
+ATCommandStats::Entry* ATCommandStats::lookup(const char* name) {
+    for (size_t i = 0; i < used; i++) {
+        if (strcmp(entries[i].name, name) == 0) {
+            return &entries[i];
+        }
+    }
+    if (used < MAX_CLASSES - 1) {
+        Entry& entry = entries[used++];
+        strncpy(entry.name, name, NAME_LENGTH - 1);
+        return &entry;
+    }
+
+    // The last slot collects every class that did not get one
+    if (used == MAX_CLASSES - 1) {
+        strcpy(entries[used++].name, "OTHER");
+    }
+    return &entries[MAX_CLASSES - 1];
+}
+
+void ATCommandStats::record(const char* command, Outcome outcome, uint32_t latency) {
+    char name[NAME_LENGTH];
+    if (className(command, name, sizeof(name)) == 0) {
+        return;
+    }
+
+    Entry* entry = lookup(name);
+    entry->outcomes[outcome <= OUTCOME_TIMEOUT ? outcome : OUTCOME_ERROR]++;
+    entry->totalLatency += latency;
+    if (latency > entry->maxLatency) {
+        entry->maxLatency = latency;
+    }
+
+    size_t bucket = 0;
+    while (bucket < BUCKET_COUNT - 1 && latency > BUCKET_LIMITS[bucket]) {
+        bucket++;
+    }
+    entry->histogram[bucket]++;
+}
+
+const ATCommandStats::Entry* ATCommandStats::find(const char* name) const {
+    for (size_t i = 0; i < used; i++) {
+        if (strcmp(entries[i].name, name) == 0) {
+            return &entries[i];
+        }
+    }
+    return nullptr;
+}
+
+uint32_t ATCommandStats::calls(const Entry& entry) {
+    return entry.outcomes[OUTCOME_OK] + entry.outcomes[OUTCOME_ERROR] + entry.outcomes[OUTCOME_TIMEOUT];
+}
+
+uint32_t ATCommandStats::percentile(const Entry& entry, uint8_t percent) {
+    uint32_t total = calls(entry);
+    if (total == 0) {
+        return 0;
+    }
+
+    // Calls that must be covered, rounded up
+    uint32_t needed = (total * percent + 99) / 100;
+    uint32_t seen = 0;
+    for (size_t bucket = 0; bucket < BUCKET_COUNT - 1; bucket++) {
+        seen += entry.histogram[bucket];
+        if (seen >= needed) {
+            return BUCKET_LIMITS[bucket];
+        }
+    }
+    return UINT32_MAX;
+}
+
+size_t ATCommandStats::toJSON(char* out, size_t size) const {
+    size_t length = 0;
+    int written = snprintf(out, size, "{");
+    if (written < 0 || (size_t)written >= size) {
+        return 0;
+    }
+    length = written;
+
+    for (size_t i = 0; i < used; i++) {
+        const Entry& entry = entries[i];
+        written = snprintf(out + length, size - length, "%s\"%s\":[%lu,%lu,%lu,%lu,[",
+                           i > 0 ? "," : "", entry.name,
+                           (unsigned long)entry.outcomes[OUTCOME_OK], (unsigned long)entry.outcomes[OUTCOME_ERROR],
+                           (unsigned long)entry.outcomes[OUTCOME_TIMEOUT], (unsigned long)entry.maxLatency);
+        if (written < 0 || length + written >= size) {
+            return 0;
+        }
+        length += written;
+
+        for (size_t bucket = 0; bucket < BUCKET_COUNT; bucket++) {
+            written = snprintf(out + length, size - length, "%s%lu", bucket > 0 ? "," : "",
+                               (unsigned long)entry.histogram[bucket]);
+            if (written < 0 || length + written >= size) {
+                return 0;
+            }
+            length += written;
+        }
+
+        written = snprintf(out + length, size - length, "]]");
+        if (written < 0 || length + written >= size) {
+            return 0;
+        }
+        length += written;
+    }
+
+    if (length + 2 > size) {
+        return 0;
+    }
+    out[length++] = '}';
+    out[length] = '\0';
+    return length;
+}
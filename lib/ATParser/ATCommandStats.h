@@ -0,0 +1,67 @@
+#ifndef ATCOMMANDSTATS_H
+#define ATCOMMANDSTATS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Outcome counts and a latency histogram per AT command class.
+//
+// A class is the command name without its arguments: "AT+CMGS=\"+233...\""
+// counts as CMGS, "AT+HTTPPARA=\"URL\",..." as HTTPPARA, "ATE0" as E and
+// "AT&W" as &W. Phases that are not a command of their own (the text after
+// the CMGS prompt, an HTTPDATA body) are recorded under a name the caller
+// picks, e.g. "CMGS body".
+//
+// Latencies go into fixed buckets (50 ms ... 30 s and above), so the table
+// has a fixed size and percentile() answers "what timeout would have covered
+// 95% of these" to within a bucket. Classes beyond MAX_CLASSES share OTHER.
+class ATCommandStats {
+public:
+    enum Outcome : uint8_t {
+        OUTCOME_OK = 0,
+        OUTCOME_ERROR,
+        OUTCOME_TIMEOUT
+    };
+
+    static const size_t MAX_CLASSES = 24;
+    static const size_t NAME_LENGTH = 16;
+    static const size_t BUCKET_COUNT = 10;
+    static const uint32_t BUCKET_LIMITS[BUCKET_COUNT - 1];     // Upper bounds in ms; the last bucket is open
+
+    struct Entry {
+        char name[NAME_LENGTH];
+        uint32_t outcomes[3];           // By Outcome
+        uint32_t maxLatency;
+        uint32_t totalLatency;
+        uint32_t histogram[BUCKET_COUNT];
+    };
+
+    ATCommandStats();
+
+    // command is either what was sent ("AT+CSQ") or a phase name ("CMGS body")
+    void record(const char* command, Outcome outcome, uint32_t latency);
+    void reset();
+
+    size_t count() const { return used; }
+    const Entry& entry(size_t index) const { return entries[index]; }
+    const Entry* find(const char* name) const;
+
+    // Smallest bucket bound at or below which `percent` of the calls finished;
+    // 0 if nothing was recorded, UINT32_MAX if they fall in the open bucket
+    static uint32_t percentile(const Entry& entry, uint8_t percent);
+    static uint32_t calls(const Entry& entry);
+
+    // {"CSQ":[ok,error,timeout,max_ms,[h0,...,h9]],...}; returns the length,
+    // 0 if it does not fit
+    size_t toJSON(char* out, size_t size) const;
+
+    static size_t className(const char* command, char* out, size_t size);
+
+private:
+    Entry entries[MAX_CLASSES];
+    size_t used;
+
+    Entry* lookup(const char* name);
+};
+
+#endif // ATCOMMANDSTATS_H
@@ -0,0 +1,303 @@
+#include "ATResponseParser.h"
+#include <string.h>
+
+namespace {
+    struct BuiltinToken {
+        const char* pattern;
+        ATResponseParser::Token token;
+        bool exact;
+    };
+
+    const BuiltinToken BUILTIN_TOKENS[] = {
+        {"OK", ATResponseParser::TOKEN_OK, true},
+        {"ERROR", ATResponseParser::TOKEN_ERROR, true},
+        {"+CME ERROR:", ATResponseParser::TOKEN_CME_ERROR, false},
+        {"+CMS ERROR:", ATResponseParser::TOKEN_CMS_ERROR, false},
+        {">", ATResponseParser::TOKEN_PROMPT, false},
+        {"+CMGS:", ATResponseParser::TOKEN_CMGS, false},
+        {"+HTTPACTION:", ATResponseParser::TOKEN_HTTPACTION, false},
+        {"DOWNLOAD", ATResponseParser::TOKEN_DOWNLOAD, true},
+        {"+CMGL:", ATResponseParser::TOKEN_CMGL, false},
+        {"+CMGR:", ATResponseParser::TOKEN_CMGR, false},
+        {"+CMT:", ATResponseParser::TOKEN_CMT, false},
+        {"+CMTI:", ATResponseParser::TOKEN_CMTI, false},
+        {"+CDS:", ATResponseParser::TOKEN_CDS, false},
+        {"RING", ATResponseParser::TOKEN_RING, true},
+        {"+SAPBR ", ATResponseParser::TOKEN_SAPBR_URC, false},
+        {"UNDER-VOLTAGE", ATResponseParser::TOKEN_UNDER_VOLTAGE, false},
+        {"OVER-VOLTAGE", ATResponseParser::TOKEN_OVER_VOLTAGE, false},
+        {"+CIPRXGET:", ATResponseParser::TOKEN_CIPRXGET, false},
+        {"CLOSED", ATResponseParser::TOKEN_TCP_CLOSED, true},
+        {"+PDP: DEACT", ATResponseParser::TOKEN_PDP_DEACT, true}
+    };
+    const size_t BUILTIN_TOKEN_COUNT = sizeof(BUILTIN_TOKENS) / sizeof(BUILTIN_TOKENS[0]);
+}
+
+ATResponseParser::ATResponseParser() {
+    expectedPattern[0] = '\0';
+    expected = TOKEN_NONE;
+    lineHandler = nullptr;
+    handlerContext = nullptr;
+    lastLineLength = 0;
+    lastLineTruncated = false;
+    lineBuffer[0] = '\0';
+    length = 0;
+    payloadPending = false;
+    build();
+    reset();
+}
+
+void ATResponseParser::reset() {
+    length = 0;
+    truncated = false;
+    skipPromptSpace = false;
+    payloadPending = false;
+    startLine();
+}
+
+void ATResponseParser::startLine() {
+    state = 0;
+    alive = !payloadPending;
+    prefixMatch = TOKEN_NONE;
+}
+
+bool ATResponseParser::setExpected(const char* pattern) {
+    if (pattern == nullptr || pattern[0] == '\0') {
+        expectedPattern[0] = '\0';
+        expected = TOKEN_NONE;
+        build();
+        return true;
+    }
+
+    for (size_t i = 0; i < BUILTIN_TOKEN_COUNT; i++) {
+        if (strcmp(pattern, BUILTIN_TOKENS[i].pattern) == 0) {
+            // Already compiled in; just remember which token to report
+            if (expectedPattern[0] != '\0') {
+                expectedPattern[0] = '\0';
+                build();
+            }
+            expected = BUILTIN_TOKENS[i].token;
+            return true;
+        }
+    }
+
+    if (strlen(pattern) > MAX_EXPECTED_LENGTH) {
+        return false;
+    }
+    if (strcmp(pattern, expectedPattern) == 0 && expected == TOKEN_EXPECTED) {
+        return true;
+    }
+
+    strcpy(expectedPattern, pattern);
+    expected = TOKEN_EXPECTED;
+    build();
+    return true;
+}
+
+void ATResponseParser::setLineHandler(LineHandler handler, void* context) {
+    lineHandler = handler;
+    handlerContext = context;
+}
+
+void ATResponseParser::build() {
+    nodeCount = 1;
+    nodes[0].ch = '\0';
+    nodes[0].firstChild = NO_NODE;
+    nodes[0].nextSibling = NO_NODE;
+    nodes[0].token = TOKEN_NONE;
+    nodes[0].exact = false;
+
+    for (size_t i = 0; i < BUILTIN_TOKEN_COUNT; i++) {
+        insert(BUILTIN_TOKENS[i].pattern, BUILTIN_TOKENS[i].token, BUILTIN_TOKENS[i].exact);
+    }
+
+    if (expected == TOKEN_EXPECTED && !insert(expectedPattern, TOKEN_EXPECTED, false)) {
+        expectedPattern[0] = '\0';
+        expected = TOKEN_NONE;
+    }
+
+    // A rebuild invalidates any walk already in progress on a partial line
+    if (length == 0) {
+        startLine();
+    } else {
+        alive = false;
+    }
+}
+
+bool ATResponseParser::insert(const char* pattern, Token token, bool exact) {
+    uint8_t current = 0;
+
+    for (const char* p = pattern; *p != '\0'; p++) {
+        uint8_t child = findChild(current, *p);
+        if (child == NO_NODE) {
+            if (nodeCount >= MAX_NODES) {
+                return false;
+            }
+            child = nodeCount++;
+            nodes[child].ch = *p;
+            nodes[child].firstChild = NO_NODE;
+            nodes[child].nextSibling = nodes[current].firstChild;
+            nodes[child].token = TOKEN_NONE;
+            nodes[child].exact = false;
+            nodes[current].firstChild = child;
+        }
+        current = child;
+    }
+
+    // Caller pattern overrides a built-in token ending on the same node
+    nodes[current].token = token;
+    nodes[current].exact = exact;
+    return true;
+}
+
+uint8_t ATResponseParser::findChild(uint8_t parent, char c) const {
+    for (uint8_t child = nodes[parent].firstChild; child != NO_NODE; child = nodes[child].nextSibling) {
+        if (nodes[child].ch == c) {
+            return child;
+        }
+    }
+    return NO_NODE;
+}
+
+ATResponseParser::Token ATResponseParser::feed(char c) {
+    if (c == '\r') {
+        return TOKEN_NONE;
+    }
+
+    if (c == '\n') {
+        skipPromptSpace = false;
+        return completeLine();
+    }
+
+    if (skipPromptSpace) {
+        skipPromptSpace = false;
+        if (c == ' ') {
+            return TOKEN_NONE;
+        }
+    }
+
+    if (length < LINE_BUFFER_SIZE - 1) {
+        lineBuffer[length] = c;
+    } else {
+        truncated = true;
+    }
+    length++;
+
+    if (!alive) {
+        return TOKEN_NONE;
+    }
+
+    uint8_t next = findChild(state, c);
+    if (next == NO_NODE) {
+        alive = false;
+        return TOKEN_NONE;
+    }
+    state = next;
+
+    const Node& node = nodes[state];
+    if (node.token == TOKEN_NONE || node.exact) {
+        return TOKEN_NONE;
+    }
+
+    // The prompt is never followed by a line break, so report it right away
+    if (node.token == TOKEN_PROMPT && length == 1) {
+        lineBuffer[1] = '\0';
+        lastLineLength = 1;
+        lastLineTruncated = false;
+        if (lineHandler != nullptr) {
+            lineHandler(lineBuffer, 1, TOKEN_PROMPT, handlerContext);
+        }
+        length = 0;
+        truncated = false;
+        skipPromptSpace = true;
+        startLine();
+        return TOKEN_PROMPT;
+    }
+
+    prefixMatch = static_cast<Token>(node.token);
+    return TOKEN_NONE;
+}
+
+ATResponseParser::Token ATResponseParser::feed(const char* data, size_t dataLength, size_t* consumed) {
+    for (size_t i = 0; i < dataLength; i++) {
+        Token token = feed(data[i]);
+        if (token != TOKEN_NONE) {
+            if (consumed != nullptr) *consumed = i + 1;
+            return token;
+        }
+    }
+    if (consumed != nullptr) *consumed = dataLength;
+    return TOKEN_NONE;
+}
+
+ATResponseParser::Token ATResponseParser::completeLine() {
+    // Blank lines separate responses, except an SMS body that is empty
+    if (length == 0 && !payloadPending) {
+        startLine();
+        return TOKEN_NONE;
+    }
+
+    Token token = prefixMatch;
+    if (alive && nodes[state].exact && nodes[state].token != TOKEN_NONE) {
+        token = static_cast<Token>(nodes[state].token);
+    }
+
+    if (payloadPending) {
+        token = TOKEN_PAYLOAD;
+        payloadPending = false;
+    } else if (token == TOKEN_CMT || token == TOKEN_CMGL || token == TOKEN_CMGR) {
+        payloadPending = true;
+    }
+
+    size_t stored = length < LINE_BUFFER_SIZE - 1 ? length : LINE_BUFFER_SIZE - 1;
+    lineBuffer[stored] = '\0';
+    lastLineLength = stored;
+    lastLineTruncated = truncated;
+
+    if (lineHandler != nullptr) {
+        lineHandler(lineBuffer, stored, token, handlerContext);
+    }
+
+    length = 0;
+    truncated = false;
+    startLine();
+    return token;
+}
+
+bool ATResponseParser::isError(Token token) {
+    return token == TOKEN_ERROR || token == TOKEN_CME_ERROR || token == TOKEN_CMS_ERROR;
+}
+
+bool ATResponseParser::isURC(Token token) {
+    return token == TOKEN_CMT || token == TOKEN_CMTI || token == TOKEN_CDS || token == TOKEN_RING ||
+           token == TOKEN_SAPBR_URC || token == TOKEN_UNDER_VOLTAGE || token == TOKEN_OVER_VOLTAGE ||
+           token == TOKEN_CIPRXGET || token == TOKEN_TCP_CLOSED || token == TOKEN_PDP_DEACT;
+}
+
+const char* ATResponseParser::tokenName(Token token) {
+    switch (token) {
+        case TOKEN_OK: return "OK";
+        case TOKEN_ERROR: return "ERROR";
+        case TOKEN_CME_ERROR: return "+CME ERROR";
+        case TOKEN_CMS_ERROR: return "+CMS ERROR";
+        case TOKEN_PROMPT: return ">";
+        case TOKEN_CMGS: return "+CMGS";
+        case TOKEN_HTTPACTION: return "+HTTPACTION";
+        case TOKEN_DOWNLOAD: return "DOWNLOAD";
+        case TOKEN_CMGL: return "+CMGL";
+        case TOKEN_CMGR: return "+CMGR";
+        case TOKEN_CMT: return "+CMT";
+        case TOKEN_CMTI: return "+CMTI";
+        case TOKEN_CDS: return "+CDS";
+        case TOKEN_RING: return "RING";
+        case TOKEN_SAPBR_URC: return "+SAPBR URC";
+        case TOKEN_UNDER_VOLTAGE: return "UNDER-VOLTAGE";
+        case TOKEN_OVER_VOLTAGE: return "OVER-VOLTAGE";
+        case TOKEN_CIPRXGET: return "+CIPRXGET";
+        case TOKEN_TCP_CLOSED: return "CLOSED";
+        case TOKEN_PDP_DEACT: return "+PDP: DEACT";
+        case TOKEN_PAYLOAD: return "PAYLOAD";
+        case TOKEN_EXPECTED: return "EXPECTED";
+        default: return "NONE";
+    }
+}
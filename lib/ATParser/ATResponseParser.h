@@ -0,0 +1,129 @@
+#ifndef ATRESPONSEPARSER_H
+#define ATRESPONSEPARSER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Streaming, line-oriented parser for SIM800L responses.
+//
+// Bytes are fed one at a time into a fixed line buffer. Every result code the
+// module waits on (OK, ERROR, +CME ERROR, >, +CMGS:, +HTTPACTION: ...) plus one
+// caller-supplied pattern are compiled into a single prefix trie, so each byte
+// costs one trie step instead of a rescan of the whole response. Tokens are
+// anchored at the start of a line, so an "OK" inside an SMS body or an echoed
+// command can never be mistaken for a final result code.
+//
+// The line after an SMS header (+CMT, +CMGL, +CMGR) is message text and is
+// reported as TOKEN_PAYLOAD without matching, so a text saying "OK" or
+// "RING" cannot end a command or fake an event.
+//
+// Complete lines are handed out through a callback that points into the
+// internal buffer; nothing is allocated on the heap.
+class ATResponseParser {
+public:
+    enum Token : uint8_t {
+        TOKEN_NONE = 0,
+        TOKEN_OK,
+        TOKEN_ERROR,
+        TOKEN_CME_ERROR,
+        TOKEN_CMS_ERROR,
+        TOKEN_PROMPT,
+        TOKEN_CMGS,
+        TOKEN_HTTPACTION,
+        TOKEN_DOWNLOAD,
+        TOKEN_CMGL,
+        TOKEN_CMGR,
+        // Unsolicited result codes
+        TOKEN_CMT,
+        TOKEN_CMTI,
+        TOKEN_CDS,          // SMS status report: one line in text mode, length then PDU in PDU mode
+        TOKEN_RING,
+        TOKEN_SAPBR_URC,
+        TOKEN_UNDER_VOLTAGE,
+        TOKEN_OVER_VOLTAGE,
+        TOKEN_CIPRXGET,     // +CIPRXGET: 1 (TCP data waiting) or a read response header
+        TOKEN_TCP_CLOSED,
+        TOKEN_PDP_DEACT,
+        TOKEN_PAYLOAD,      // Text line following a +CMT/+CMGL/+CMGR header
+        TOKEN_EXPECTED      // Caller-supplied pattern set with setExpected()
+    };
+
+    typedef void (*LineHandler)(const char* line, size_t length, Token token, void* context);
+
+    static const size_t LINE_BUFFER_SIZE = 256;
+    static const size_t MAX_EXPECTED_LENGTH = 32;
+
+    ATResponseParser();
+
+    // Discard any partially received line
+    void reset();
+
+    // Register the pattern the current command is waiting for. If it matches a
+    // built-in token that token is reported as expected, otherwise the pattern
+    // is added to the trie and reported as TOKEN_EXPECTED. Pass nullptr or ""
+    // to clear. Returns false if the pattern does not fit.
+    bool setExpected(const char* pattern);
+    Token expectedToken() const { return expected; }
+
+    void setLineHandler(LineHandler handler, void* context);
+
+    // Feed one received byte. Returns the token recognised when a line is
+    // completed (or immediately for the SMS/data prompt), TOKEN_NONE otherwise.
+    Token feed(char c);
+
+    // Convenience for buffers; stops at the first recognised token and reports
+    // how many bytes were consumed.
+    Token feed(const char* data, size_t length, size_t* consumed = nullptr);
+
+    // Last completed line (valid until the next byte is fed)
+    const char* line() const { return lineBuffer; }
+    size_t lineLength() const { return lastLineLength; }
+    bool lineTruncated() const { return lastLineTruncated; }
+
+    bool isExpected(Token token) const { return token != TOKEN_NONE && token == expected; }
+    static bool isError(Token token);
+    static bool isURC(Token token);
+    static const char* tokenName(Token token);
+
+private:
+    struct Node {
+        char ch;
+        uint8_t firstChild;
+        uint8_t nextSibling;
+        uint8_t token;
+        bool exact;         // Token only counts if the line ends here
+    };
+
+    static const uint8_t MAX_NODES = 160;
+    static const uint8_t NO_NODE = 0;   // Root is never a child, so 0 marks "none"
+
+    Node nodes[MAX_NODES];
+    uint8_t nodeCount;
+
+    char expectedPattern[MAX_EXPECTED_LENGTH + 1];
+    Token expected;
+
+    char lineBuffer[LINE_BUFFER_SIZE];
+    size_t length;
+    size_t lastLineLength;
+    bool truncated;
+    bool lastLineTruncated;
+
+    // Trie walk state for the current line
+    uint8_t state;
+    bool alive;
+    Token prefixMatch;
+    bool skipPromptSpace;
+    bool payloadPending;
+
+    LineHandler lineHandler;
+    void* handlerContext;
+
+    void build();
+    bool insert(const char* pattern, Token token, bool exact);
+    uint8_t findChild(uint8_t parent, char c) const;
+    Token completeLine();
+    void startLine();
+};
+
+#endif // ATRESPONSEPARSER_H
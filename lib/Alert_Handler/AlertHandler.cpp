@@ -62,7 +62,7 @@ void AlertHandler::clearSystemAlert() {
 }
 
 void AlertHandler::update() {
-    unsigned long currentTime = millis();
+    uint64_t currentTime = monoMillis();
     
     // Handle blinking for active alerts
     if (alertActive || systemAlertActive) {
@@ -3,6 +3,7 @@
 
 #include <Arduino.h>
 #include "config.h"
+#include "MonoClock.h"
 
 class AlertHandler {
 public:
@@ -25,7 +26,7 @@ public:
     void update();
 
 private:
-    unsigned long lastBlinkTime;
+    uint64_t lastBlinkTime;
     bool alertActive;
     bool systemAlertActive;
     bool communicationActive;
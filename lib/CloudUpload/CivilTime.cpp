@@ -0,0 +1,61 @@
+#include "CivilTime.h"
+#include <stdio.h>
+
+// Days-from-civil after H. Hinnant's public-domain algorithm
+uint32_t civilToEpoch(const CivilTime& time) {
+    int32_t year = time.year - (time.month <= 2 ? 1 : 0);
+    int32_t era = year / 400;
+    uint32_t yearOfEra = (uint32_t)(year - era * 400);
+    uint32_t monthIndex = time.month > 2 ? time.month - 3 : time.month + 9;
+    uint32_t dayOfYear = (153 * monthIndex + 2) / 5 + time.day - 1;
+    uint32_t dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+    int32_t days = era * 146097 + (int32_t)dayOfEra - 719468;
+
+    return (uint32_t)days * 86400UL + time.hour * 3600UL + time.minute * 60UL + time.second;
+}
+
+void epochToCivil(uint32_t epoch, CivilTime& time) {
+    uint32_t days = epoch / 86400UL;
+    uint32_t secondsOfDay = epoch % 86400UL;
+
+    time.hour = secondsOfDay / 3600;
+    time.minute = (secondsOfDay % 3600) / 60;
+    time.second = secondsOfDay % 60;
+
+    uint32_t z = days + 719468;
+    uint32_t era = z / 146097;
+    uint32_t dayOfEra = z - era * 146097;
+    uint32_t yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+    uint32_t dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+    uint32_t monthIndex = (5 * dayOfYear + 2) / 153;
+
+    time.day = dayOfYear - (153 * monthIndex + 2) / 5 + 1;
+    time.month = monthIndex < 10 ? monthIndex + 3 : monthIndex - 9;
+    time.year = yearOfEra + era * 400 + (time.month <= 2 ? 1 : 0);
+}
+
+bool parseModemClock(const char* text, uint32_t& epoch) {
+    int year, month, day, hour, minute, second, zone = 0;
+    char sign = '+';
+
+    int fields = sscanf(text, "%d/%d/%d,%d:%d:%d%c%d", &year, &month, &day, &hour, &minute, &second, &sign, &zone);
+    if (fields < 6 || month < 1 || month > 12 || day < 1 || day > 31 || hour > 23 || minute > 59 || second > 60) {
+        return false;
+    }
+
+    CivilTime civil;
+    civil.year = 2000 + year;
+    civil.month = month;
+    civil.day = day;
+    civil.hour = hour;
+    civil.minute = minute;
+    civil.second = second;
+
+    int32_t offset = (fields == 8 ? zone * 15 * 60 : 0);
+    if (sign == '-') {
+        offset = -offset;
+    }
+
+    epoch = civilToEpoch(civil) - offset;
+    return true;
+}
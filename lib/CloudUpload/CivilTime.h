@@ -0,0 +1,23 @@
+#ifndef CIVILTIME_H
+#define CIVILTIME_H
+
+#include <stdint.h>
+
+// Calendar <-> Unix epoch conversion (UTC, proleptic Gregorian, 1970-2105)
+struct CivilTime {
+    uint16_t year;
+    uint8_t month;      // 1-12
+    uint8_t day;        // 1-31
+    uint8_t hour;
+    uint8_t minute;
+    uint8_t second;
+};
+
+uint32_t civilToEpoch(const CivilTime& time);
+void epochToCivil(uint32_t epoch, CivilTime& time);
+
+// Parses the SIM800 clock format "yy/MM/dd,hh:mm:ss+zz" (zz = quarter hours
+// east of UTC) into UTC epoch seconds. Returns false on malformed input.
+bool parseModemClock(const char* text, uint32_t& epoch);
+
+#endif // CIVILTIME_H
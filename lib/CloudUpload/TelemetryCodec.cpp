@@ -0,0 +1,291 @@
+#include "TelemetryCodec.h"
+#include <math.h>
+#include <string.h>
+
+namespace {
+    const int32_t MISSING_VALUE = INT32_MIN;
+
+    const float FIELD_SCALE[] = {1.0f, 10.0f, 100.0f, 1000.0f, 10000.0f};
+
+    struct Bucket {
+        uint8_t prefix;         // Prefix bits, left-aligned in prefixBits
+        uint8_t prefixBits;
+        uint8_t valueBits;
+    };
+
+    // '0' (value 0) is handled separately
+    const Bucket BUCKETS[] = {
+        {0x2, 2, 7},    // 10
+        {0x6, 3, 12},   // 110
+        {0xE, 4, 20},   // 1110
+        {0xF, 4, 32}    // 1111
+    };
+    const int BUCKET_COUNT = sizeof(BUCKETS) / sizeof(BUCKETS[0]);
+
+    bool fitsSigned(int32_t value, uint8_t bits) {
+        if (bits >= 32) return true;
+        int32_t limit = (int32_t)1 << (bits - 1);
+        return value >= -limit && value < limit;
+    }
+
+    int32_t signExtend(uint32_t value, uint8_t bits) {
+        if (bits >= 32) return (int32_t)value;
+        uint32_t sign = (uint32_t)1 << (bits - 1);
+        return (int32_t)((value ^ sign) - sign);
+    }
+
+    // Wrapping difference so MISSING_VALUE transitions never overflow
+    int32_t wrappingDelta(int32_t current, int32_t previous) {
+        return (int32_t)((uint32_t)current - (uint32_t)previous);
+    }
+
+    int32_t wrappingAdd(int32_t previous, int32_t delta) {
+        return (int32_t)((uint32_t)previous + (uint32_t)delta);
+    }
+}
+
+int32_t quantizeTelemetryField(float value, int field) {
+    if (isnan(value) || isinf(value)) {
+        return MISSING_VALUE;
+    }
+    double scaled = (double)value * FIELD_SCALE[TELEMETRY_FIELD_DECIMALS[field]];
+    if (scaled <= (double)INT32_MIN || scaled > (double)INT32_MAX) {
+        return MISSING_VALUE;
+    }
+    return (int32_t)lround(scaled);
+}
+
+float dequantizeTelemetryField(int32_t value, int field) {
+    if (value == MISSING_VALUE) {
+        return NAN;
+    }
+    return (float)((double)value / FIELD_SCALE[TELEMETRY_FIELD_DECIMALS[field]]);
+}
+
+TelemetryEncoder::TelemetryEncoder(uint8_t* buffer, size_t capacity)
+    : buffer(buffer), capacity(capacity), bitPosition(HEADER_LENGTH * 8), records(0),
+      sink(nullptr), sinkContext(nullptr), flushed(0), finished(false),
+      previousSequence(0), previousTime(0), previousDelta(0) {
+    begin(0);
+}
+
+TelemetryEncoder::TelemetryEncoder(uint8_t* window, size_t capacity, uint16_t recordCount, Sink sink, void* context)
+    : buffer(window), capacity(capacity), bitPosition(HEADER_LENGTH * 8), records(0),
+      sink(sink), sinkContext(context), flushed(0), finished(false),
+      previousSequence(0), previousTime(0), previousDelta(0) {
+    begin(recordCount);
+}
+
+void TelemetryEncoder::begin(uint16_t recordCount) {
+    memset(previousFields, 0, sizeof(previousFields));
+
+    if (capacity < HEADER_LENGTH) {
+        capacity = 0;
+        return;
+    }
+    buffer[0] = 'E';
+    buffer[1] = 'M';
+    buffer[2] = VERSION;
+    buffer[3] = 0;
+    buffer[4] = recordCount & 0xFF;
+    buffer[5] = recordCount >> 8;
+}
+
+bool TelemetryEncoder::writeBits(uint32_t value, uint8_t bits) {
+    if (bitPosition + bits > capacity * 8) {
+        return false;
+    }
+    for (int i = bits - 1; i >= 0; i--) {
+        uint8_t mask = 0x80 >> (bitPosition & 7);
+        uint8_t& byte = buffer[bitPosition >> 3];
+        if ((value >> i) & 1) {
+            byte |= mask;
+        } else {
+            byte &= ~mask;
+        }
+        bitPosition++;
+    }
+    return true;
+}
+
+bool TelemetryEncoder::writeSigned(int32_t value) {
+    if (value == 0) {
+        return writeBits(0, 1);
+    }
+    for (int i = 0; i < BUCKET_COUNT; i++) {
+        if (fitsSigned(value, BUCKETS[i].valueBits)) {
+            uint32_t bits = BUCKETS[i].valueBits < 32 ? (uint32_t)value & ((1UL << BUCKETS[i].valueBits) - 1) : (uint32_t)value;
+            return writeBits(BUCKETS[i].prefix, BUCKETS[i].prefixBits) &&
+                   writeBits(bits, BUCKETS[i].valueBits);
+        }
+    }
+    return false;
+}
+
+bool TelemetryEncoder::add(const TelemetryRecord& record, uint32_t createdAtEpoch, uint32_t sequence) {
+    if (capacity == 0 || finished || records >= 0xFFFF) {
+        return false;
+    }
+
+    int32_t fields[TELEMETRY_FIELD_COUNT];
+    for (int i = 0; i < TELEMETRY_FIELD_COUNT; i++) {
+        fields[i] = quantizeTelemetryField(record.fields[i], i);
+    }
+
+    size_t startPosition = bitPosition;
+    int32_t delta = 0;
+    bool ok = encode(fields, createdAtEpoch, sequence, delta);
+    if (!ok && sink != nullptr && startPosition >= 8) {
+        // Hand over the whole bytes before this record and retry at the front
+        size_t whole = startPosition / 8;
+        if (sink(buffer, whole, sinkContext)) {
+            flushed += whole;
+            buffer[0] = buffer[whole];
+            bitPosition = startPosition = startPosition % 8;
+            ok = encode(fields, createdAtEpoch, sequence, delta);
+        }
+    }
+
+    if (!ok) {
+        bitPosition = startPosition;
+        return false;
+    }
+
+    previousSequence = sequence;
+    previousTime = createdAtEpoch;
+    previousDelta = delta;
+    memcpy(previousFields, fields, sizeof(fields));
+    records++;
+    if (sink == nullptr) {
+        buffer[4] = records & 0xFF;
+        buffer[5] = records >> 8;
+    }
+    return true;
+}
+
+bool TelemetryEncoder::encode(const int32_t* fields, uint32_t createdAtEpoch, uint32_t sequence, int32_t& delta) {
+    bool ok;
+    if (records == 0) {
+        ok = writeBits(sequence, 32) && writeBits(createdAtEpoch, 32);
+        for (int i = 0; ok && i < TELEMETRY_FIELD_COUNT; i++) {
+            ok = writeBits((uint32_t)fields[i], 32);
+        }
+    } else {
+        delta = (int32_t)(createdAtEpoch - previousTime);
+        int32_t timeCode = records == 1 ? delta : wrappingDelta(delta, previousDelta);
+        ok = writeSigned((int32_t)(sequence - previousSequence - 1)) && writeSigned(timeCode);
+        for (int i = 0; ok && i < TELEMETRY_FIELD_COUNT; i++) {
+            ok = writeSigned(wrappingDelta(fields[i], previousFields[i]));
+        }
+    }
+    return ok;
+}
+
+bool TelemetryEncoder::finish() {
+    if (sink == nullptr) {
+        return true;
+    }
+    if (capacity == 0 || finished) {
+        return false;
+    }
+    finished = true;
+    return sink(buffer, (bitPosition + 7) / 8, sinkContext);
+}
+
+TelemetryDecoder::TelemetryDecoder(const uint8_t* data, size_t length)
+    : data(data), bitLength(length * 8), bitPosition(TelemetryEncoder::HEADER_LENGTH * 8),
+      valid(false), records(0), decoded(0),
+      previousSequence(0), previousTime(0), previousDelta(0) {
+    memset(previousFields, 0, sizeof(previousFields));
+
+    if (length < TelemetryEncoder::HEADER_LENGTH || data[0] != 'E' || data[1] != 'M' ||
+        data[2] != TelemetryEncoder::VERSION) {
+        return;
+    }
+    records = data[4] | (data[5] << 8);
+    valid = true;
+}
+
+bool TelemetryDecoder::readBits(uint8_t bits, uint32_t& value) {
+    if (bitPosition + bits > bitLength) {
+        return false;
+    }
+    value = 0;
+    for (uint8_t i = 0; i < bits; i++) {
+        value = (value << 1) | ((data[bitPosition >> 3] >> (7 - (bitPosition & 7))) & 1);
+        bitPosition++;
+    }
+    return true;
+}
+
+bool TelemetryDecoder::readSigned(int32_t& value) {
+    // Count leading 1s (at most 4) to pick the bucket
+    int ones = 0;
+    uint32_t bit = 1;
+    while (ones < 4) {
+        if (!readBits(1, bit)) return false;
+        if (bit == 0) break;
+        ones++;
+    }
+
+    if (ones == 0) {
+        value = 0;
+        return true;
+    }
+
+    const Bucket& bucket = BUCKETS[ones - 1];
+    uint32_t raw;
+    if (!readBits(bucket.valueBits, raw)) {
+        return false;
+    }
+    value = signExtend(raw, bucket.valueBits);
+    return true;
+}
+
+bool TelemetryDecoder::next(TelemetryRecord& record, uint32_t& createdAtEpoch, uint32_t& sequence) {
+    if (!valid || decoded >= records) {
+        return false;
+    }
+
+    int32_t fields[TELEMETRY_FIELD_COUNT];
+    int32_t delta = 0;
+
+    if (decoded == 0) {
+        uint32_t raw;
+        if (!readBits(32, sequence) || !readBits(32, createdAtEpoch)) {
+            return false;
+        }
+        for (int i = 0; i < TELEMETRY_FIELD_COUNT; i++) {
+            if (!readBits(32, raw)) return false;
+            fields[i] = (int32_t)raw;
+        }
+    } else {
+        int32_t gap;
+        int32_t timeCode;
+        if (!readSigned(gap) || !readSigned(timeCode)) {
+            return false;
+        }
+        sequence = previousSequence + 1 + (uint32_t)gap;
+        delta = decoded == 1 ? timeCode : wrappingAdd(previousDelta, timeCode);
+        createdAtEpoch = previousTime + (uint32_t)delta;
+
+        for (int i = 0; i < TELEMETRY_FIELD_COUNT; i++) {
+            int32_t fieldDelta;
+            if (!readSigned(fieldDelta)) return false;
+            fields[i] = wrappingAdd(previousFields[i], fieldDelta);
+        }
+    }
+
+    record.capturedAt = 0;
+    record.createdAt = createdAtEpoch;
+    for (int i = 0; i < TELEMETRY_FIELD_COUNT; i++) {
+        record.fields[i] = dequantizeTelemetryField(fields[i], i);
+    }
+
+    previousSequence = sequence;
+    previousTime = createdAtEpoch;
+    previousDelta = delta;
+    memcpy(previousFields, fields, sizeof(fields));
+    decoded++;
+    return true;
+}
@@ -0,0 +1,105 @@
+#ifndef TELEMETRYCODEC_H
+#define TELEMETRYCODEC_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "UploadBatch.h"
+
+// Compact binary batch format for queued readings (ENABLE_DATA_COMPRESSION).
+//
+// Header (6 bytes): 'E' 'M', version, flags (0), record count (uint16 LE).
+// Then an MSB-first bit stream, one record after another:
+//
+//   record 0      sequence, created_at and each field as raw 32-bit values
+//   record 1      sequence gap, created_at delta, field deltas
+//   record 2..n   sequence gap, created_at delta-of-delta, field deltas
+//
+// Fields are quantised to their display precision (TELEMETRY_FIELD_DECIMALS)
+// so consecutive readings differ by small integers; NaN/Inf is stored as
+// INT32_MIN. Every signed value after record 0 uses Gorilla-style buckets:
+//
+//   0             value is 0
+//   10   + 7 bits [-64, 63]
+//   110  + 12 bits [-2048, 2047]
+//   1110 + 20 bits [-524288, 524287]
+//   1111 + 32 bits anything else
+//
+// A steady 5-minute series costs 2 bits for sequence and timestamp plus a few
+// bits per field, against ~200 bytes per entry as ThingSpeak JSON.
+//
+// The header is sent first, so a streaming encoder is told the record count
+// up front (a sizing pass with any count gives the length).
+class TelemetryEncoder : public UploadBatch {
+public:
+    TelemetryEncoder(uint8_t* buffer, size_t capacity);
+    TelemetryEncoder(uint8_t* window, size_t capacity, uint16_t recordCount, Sink sink, void* context);
+
+    bool add(const TelemetryRecord& record, uint32_t createdAtEpoch, uint32_t sequence);
+    bool finish();
+
+    const uint8_t* data() const { return buffer; }
+    const char* payload() const { return reinterpret_cast<const char*>(buffer); }
+    size_t length() const { return capacity == 0 ? 0 : flushed + (bitPosition + 7) / 8; }
+    size_t count() const { return records; }
+    size_t maxEntryLength() const { return MAX_ENTRY_LENGTH; }
+
+    static const uint8_t VERSION = 1;
+    static const size_t HEADER_LENGTH = 6;
+    // Sequence gap, time and every field in the widest bucket, plus a partial byte
+    static const size_t MAX_ENTRY_LENGTH = (2 + TELEMETRY_FIELD_COUNT) * 36 / 8 + 1;
+
+private:
+    uint8_t* buffer;
+    size_t capacity;
+    size_t bitPosition;
+    size_t records;
+    Sink sink;
+    void* sinkContext;
+    size_t flushed;     // Whole bytes already handed to the sink
+    bool finished;
+
+    uint32_t previousSequence;
+    uint32_t previousTime;
+    int32_t previousDelta;
+    int32_t previousFields[TELEMETRY_FIELD_COUNT];
+
+    void begin(uint16_t recordCount);
+    bool encode(const int32_t* fields, uint32_t createdAtEpoch, uint32_t sequence, int32_t& delta);
+    bool writeBits(uint32_t value, uint8_t bits);
+    bool writeSigned(int32_t value);
+};
+
+// Host-side reader for the format above
+class TelemetryDecoder {
+public:
+    TelemetryDecoder(const uint8_t* data, size_t length);
+
+    // False if the header is missing or from another version
+    bool isValid() const { return valid; }
+    size_t count() const { return records; }
+
+    // Decodes the next record; false at the end or on a truncated stream
+    bool next(TelemetryRecord& record, uint32_t& createdAtEpoch, uint32_t& sequence);
+
+private:
+    const uint8_t* data;
+    size_t bitLength;
+    size_t bitPosition;
+    bool valid;
+    size_t records;
+    size_t decoded;
+
+    uint32_t previousSequence;
+    uint32_t previousTime;
+    int32_t previousDelta;
+    int32_t previousFields[TELEMETRY_FIELD_COUNT];
+
+    bool readBits(uint8_t bits, uint32_t& value);
+    bool readSigned(int32_t& value);
+};
+
+// Field quantisation shared by both ends
+int32_t quantizeTelemetryField(float value, int field);
+float dequantizeTelemetryField(int32_t value, int field);
+
+#endif // TELEMETRYCODEC_H
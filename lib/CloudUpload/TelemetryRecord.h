@@ -0,0 +1,29 @@
+#ifndef TELEMETRYRECORD_H
+#define TELEMETRYRECORD_H
+
+#include <stdint.h>
+
+// One interval reading as queued for upload. Fields follow the ThingSpeak
+// channel layout used since v1.0 (field1..field8).
+enum TelemetryField {
+    FIELD_VOLTAGE_A = 0,
+    FIELD_CURRENT_A,
+    FIELD_POWER_A,
+    FIELD_ENERGY_A,
+    FIELD_VOLTAGE_B,
+    FIELD_CURRENT_B,
+    FIELD_POWER_B,
+    FIELD_ENERGY_B,
+    TELEMETRY_FIELD_COUNT
+};
+
+struct TelemetryRecord {
+    uint32_t capturedAt;                    // millis() when the reading was taken
+    uint32_t createdAt;                     // UTC epoch seconds, 0 if no clock at capture
+    float fields[TELEMETRY_FIELD_COUNT];
+};
+
+// Decimal places used when a field is rendered as text
+static const uint8_t TELEMETRY_FIELD_DECIMALS[TELEMETRY_FIELD_COUNT] = {1, 2, 1, 3, 1, 2, 1, 3};
+
+#endif // TELEMETRYRECORD_H
@@ -0,0 +1,90 @@
+#include "ThingSpeakBatch.h"
+#include "CivilTime.h"
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+ThingSpeakBatch::ThingSpeakBatch(char* buffer, size_t capacity, const char* apiKey)
+    : buffer(buffer), capacity(capacity), used(0), records(0), sink(nullptr), sinkContext(nullptr), flushed(0) {
+    begin(apiKey);
+}
+
+ThingSpeakBatch::ThingSpeakBatch(char* window, size_t capacity, const char* apiKey, Sink sink, void* context)
+    : buffer(window), capacity(capacity), used(0), records(0), sink(sink), sinkContext(context), flushed(0) {
+    begin(apiKey);
+}
+
+void ThingSpeakBatch::begin(const char* apiKey) {
+    int written = snprintf(buffer, capacity, "{\"write_api_key\":\"%s\",\"updates\":[", apiKey);
+    if (written < 0 || (size_t)written + CLOSING_LENGTH >= capacity) {
+        // Not even the envelope fits; report a full, empty batch
+        used = 0;
+        if (capacity > 0) buffer[0] = '\0';
+        capacity = 0;
+        return;
+    }
+    used = written;
+    close();
+}
+
+bool ThingSpeakBatch::add(const TelemetryRecord& record, uint32_t createdAtEpoch, uint32_t sequence) {
+    if (capacity == 0) {
+        return false;
+    }
+
+    char entry[MAX_ENTRY_LENGTH];
+    CivilTime time;
+    epochToCivil(createdAtEpoch, time);
+
+    int length = snprintf(entry, sizeof(entry), "%s{\"created_at\":\"%04u-%02u-%02u %02u:%02u:%02u +0000\",\"status\":\"seq:%lu\"",
+                          records > 0 ? "," : "", time.year, time.month, time.day,
+                          time.hour, time.minute, time.second, (unsigned long)sequence);
+
+    for (int i = 0; i < TELEMETRY_FIELD_COUNT && length > 0 && (size_t)length < sizeof(entry); i++) {
+        // JSON has no NaN; leave the field out and ThingSpeak stores it empty
+        if (isnan(record.fields[i]) || isinf(record.fields[i])) {
+            continue;
+        }
+        length += snprintf(entry + length, sizeof(entry) - length, ",\"field%d\":%.*f",
+                           i + 1, TELEMETRY_FIELD_DECIMALS[i], record.fields[i]);
+    }
+
+    if (length < 0 || (size_t)length + 1 >= sizeof(entry)) {
+        return false;
+    }
+    entry[length++] = '}';
+
+    if (used + length + CLOSING_LENGTH >= capacity) {
+        if (sink == nullptr || used == 0 || !sink(reinterpret_cast<const uint8_t*>(buffer), used, sinkContext)) {
+            return false;
+        }
+        flushed += used;
+        used = 0;
+        if ((size_t)length + CLOSING_LENGTH >= capacity) {
+            return false;
+        }
+    }
+
+    memcpy(buffer + used, entry, length);
+    used += length;
+    records++;
+    close();
+    return true;
+}
+
+bool ThingSpeakBatch::finish() {
+    if (sink == nullptr) {
+        return true;
+    }
+    if (capacity == 0) {
+        return false;
+    }
+    capacity = 0;
+    return sink(reinterpret_cast<const uint8_t*>(buffer), used + CLOSING_LENGTH, sinkContext);
+}
+
+void ThingSpeakBatch::close() {
+    buffer[used] = ']';
+    buffer[used + 1] = '}';
+    buffer[used + 2] = '\0';
+}
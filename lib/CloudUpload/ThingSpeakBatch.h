@@ -0,0 +1,48 @@
+#ifndef THINGSPEAKBATCH_H
+#define THINGSPEAKBATCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "UploadBatch.h"
+
+// Packs interval records into a ThingSpeak bulk_update.json body:
+//   {"write_api_key":"...","updates":[{"created_at":"...","status":"seq:42","field1":230.1,...},...]}
+// Records are appended until the caller's buffer is full, so one POST carries
+// as many as fit. The buffer is always left holding a valid document.
+// Streaming, the window needs room for one entry and the closing "]}".
+class ThingSpeakBatch : public UploadBatch {
+public:
+    ThingSpeakBatch(char* buffer, size_t capacity, const char* apiKey);
+    ThingSpeakBatch(char* window, size_t capacity, const char* apiKey, Sink sink, void* context);
+
+    // Returns false (and leaves the body unchanged) if the record does not fit.
+    // The queue sequence number goes in the status field so replays of the
+    // same record after a lost response can be recognised.
+    bool add(const TelemetryRecord& record, uint32_t createdAtEpoch, uint32_t sequence);
+    bool finish();
+
+    const char* body() const { return buffer; }
+    const char* payload() const { return buffer; }
+    size_t length() const { return flushed + used + CLOSING_LENGTH; }
+    size_t count() const { return records; }
+    size_t maxEntryLength() const { return MAX_ENTRY_LENGTH; }
+
+    // Worst-case size of one entry, for sizing buffers
+    static const size_t MAX_ENTRY_LENGTH = 256;
+
+private:
+    static const size_t CLOSING_LENGTH = 2;    // "]}"
+
+    char* buffer;
+    size_t capacity;
+    size_t used;        // Bytes before the closing "]}"
+    size_t records;
+    Sink sink;
+    void* sinkContext;
+    size_t flushed;     // Bytes already handed to the sink
+
+    void begin(const char* apiKey);
+    void close();
+};
+
+#endif // THINGSPEAKBATCH_H
@@ -0,0 +1,31 @@
+#ifndef UPLOADBATCH_H
+#define UPLOADBATCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "TelemetryRecord.h"
+
+// A request body being filled with queued readings, in whatever format the
+// receiving backend expects.
+//
+// Built with a sink, the buffer is only a window: whatever no longer fits is
+// handed to the sink and the body can grow without bound. finish() passes on
+// the rest, and payload() never holds more than the unsent tail.
+class UploadBatch {
+public:
+    // False stops the batch (the add that needed room fails)
+    typedef bool (*Sink)(const uint8_t* data, size_t length, void* context);
+
+    virtual ~UploadBatch() {}
+
+    // Returns false (and leaves the body unchanged) if the record does not fit
+    virtual bool add(const TelemetryRecord& record, uint32_t createdAtEpoch, uint32_t sequence) = 0;
+    virtual bool finish() = 0;
+
+    virtual const char* payload() const = 0;
+    virtual size_t length() const = 0;
+    virtual size_t count() const = 0;
+    virtual size_t maxEntryLength() const = 0;
+};
+
+#endif // UPLOADBATCH_H
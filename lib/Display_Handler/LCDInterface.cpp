@@ -12,7 +12,7 @@ void LCDInterface::begin() {
     lcd.clear();
 
     lastUpdateTime = 0;
-    pageChangeTime = millis();
+    pageChangeTime = monoMillis();
 }
 
 String LCDInterface::formatFloat(float value, int precision) {
@@ -42,7 +42,7 @@ String LCDInterface::formatFloat(float value, int precision) {
 }
 
 void LCDInterface::updateDisplay(const PZEMResult& energyData, const StatusResult& status) {
-    unsigned long currentTime = millis();
+    uint64_t currentTime = monoMillis();
     
     // Check if we're showing a temporary message
     if (showingMessage) {
@@ -85,7 +85,7 @@ void LCDInterface::nextPage() {
 void LCDInterface::showSystemMessage(const String& message, unsigned long duration) {
     showingMessage = true;
     currentMessage = message;
-    messageEndTime = millis() + duration;
+    messageEndTime = monoMillis() + duration;
     
     lcd.clear();
     
@@ -216,7 +216,7 @@ void LCDInterface::displayPage1(const PZEMReading& data) {
     lcd.print("GHC");
     
     // Stale data indicator (top-right corner)
-    if (millis() - data.timestamp > 10000) { // 10 seconds
+    if (monoMillis() - data.timestamp > 10000) { // 10 seconds
         lcd.setCursor(15, 0);
         lcd.print("!");
     }
@@ -263,7 +263,7 @@ void LCDInterface::displayPage2(const PZEMReading& data) {
     lcd.print("GHC");
     
     // Stale data indicator
-    if (millis() - data.timestamp > 10000) {
+    if (monoMillis() - data.timestamp > 10000) {
         lcd.setCursor(15, 0);
         lcd.print("!");
     }
@@ -343,7 +343,7 @@ void LCDInterface::displayPage4(const StatusResult& status) {
     }
     
     // Line 2: Uptime (formatted as HH:MM:SS)
-    unsigned long totalSeconds = millis() / 1000;
+    unsigned long totalSeconds = (unsigned long)(monoMillis() / 1000);
     unsigned long hours = totalSeconds / 3600;
     unsigned long minutes = (totalSeconds % 3600) / 60;
     unsigned long seconds = totalSeconds % 60;
@@ -363,7 +363,7 @@ void LCDInterface::displayPage4(const StatusResult& status) {
     // Line 3: Last Update + Memory
     lcd.setCursor(0, 3);
     lcd.print("Last:");
-    lcd.print((millis() - lastUpdateTime) / 1000);
+    lcd.print((unsigned long)((monoMillis() - lastUpdateTime) / 1000));
     lcd.print("s ");
     
     // Add free memory indicator if available
@@ -381,7 +381,7 @@ void LCDInterface::clearLine(int line) {
 // LCD Screen Light Mode
 void LCDInterface::backLightMode(){
 
-     if (millis() >= LCD_BACKLIGHT_TIMEOUT){
+     if (monoMillis() >= LCD_BACKLIGHT_TIMEOUT){
         lcd.noBacklight();
      }
      else{
@@ -5,6 +5,7 @@
 #include <LiquidCrystal_I2C.h>
 #include "config.h"
 #include "SensorHandler.h"
+#include "MonoClock.h"
 
 class LCDInterface {
 public:
@@ -18,11 +19,11 @@ public:
 
 private:
     LiquidCrystal_I2C lcd;
-    unsigned long lastUpdateTime;
-    unsigned long pageChangeTime;
+    uint64_t lastUpdateTime;       // monoMillis()
+    uint64_t pageChangeTime;
     int currentPage;
     bool showingMessage;
-    unsigned long messageEndTime;
+    uint64_t messageEndTime;
     String currentMessage;
     
     void displayPage1(const PZEMReading& data);
@@ -1,12 +1,82 @@
 #include "GSMModule.h"
 #include "config.h"
+#include "ThingSpeakBatch.h"
+#include "TelemetryCodec.h"
+#include "CivilTime.h"
 
-GSMModule::GSMModule() {
+volatile bool GSMModule::ringIndicated = false;
+
+// SMS-SUBMIT first octet for text mode: relative validity period, plus the
+// status report request bit (0x20) with SMS_DELIVERY_REPORTS
+#if SMS_DELIVERY_REPORTS
+#define SMS_SUBMIT_FIRST_OCTET "49"
+#else
+#define SMS_SUBMIT_FIRST_OCTET "17"
+#endif
+
+namespace {
+    // Settings kept in the modem's saved profile. query/expected check that one
+    // is in effect; a null query means it cannot be read back (ATE0 shows as echo).
+    struct ModemSetting {
+        const char* command;
+        const char* query;
+        const char* expected;
+        bool critical;
+    };
+    
+    const ModemSetting MODEM_PROFILE[] = {
+        {"ATE0", nullptr, nullptr, true},
+        {"AT+CMEE=2", "+CMEE?", "+CMEE: 2", false},
+        {"AT+CMGF=1", "+CMGF?", "+CMGF: 1", true},
+        {"AT+CSCS=\"GSM\"", "+CSCS?", "+CSCS: \"GSM\"", false},
+        {"AT+CNMI=1,2,0,1,0", "+CNMI?", "+CNMI: 1,2,0,1,0", true},
+        {"AT+CSMP=" SMS_SUBMIT_FIRST_OCTET ",167,0,0", "+CSMP?", "+CSMP: " SMS_SUBMIT_FIRST_OCTET ",167,0,0", false},
+        {"AT+CPMS=\"SM\",\"SM\",\"SM\"", "+CPMS?", "+CPMS: \"SM\",", false},
+        {"AT+CLTS=1", "+CLTS?", "+CLTS: 1", false}
+    };
+    const size_t MODEM_PROFILE_COUNT = sizeof(MODEM_PROFILE) / sizeof(MODEM_PROFILE[0]);
+    
+    HardwareSerial& defaultModemUart() {
     #if USE_UART2_FOR_GSM
-        gsmSerial = &Serial2;
+        return Serial2;
     #else
-        gsmSerial = &Serial1;
+        return Serial1;
     #endif
+    }
+}
+
+GSMModule::GSMModule() : GSMModule(static_cast<Stream&>(defaultModemUart())) {
+    gsmUart = &defaultModemUart();
+}
+
+uint8_t GSMModule::enabledUploadBackends() {
+    uint8_t count = (ENABLE_THINGSPEAK_UPLOAD ? 1 : 0) + (ENABLE_BILLING_UPLOAD ? 1 : 0);
+    return count > 0 ? count : 1;
+}
+
+GSMModule::GSMModule(Stream& modem, BaudRateSetter setBaudRate, void* context)
+    :
+#if GSM_FLASH_QUEUE
+      flashQueue(flashStorage, OFFLINE_QUEUE_SEGMENT_RECORDS, OFFLINE_QUEUE_MAX_SEGMENTS, enabledUploadBackends()),
+#endif
+      ramStorage(RAM_QUEUE_SEGMENT_RECORDS * sizeof(UploadQueue::Entry), MAX_BUFFERED_READINGS / RAM_QUEUE_SEGMENT_RECORDS),
+      ramQueue(ramStorage, RAM_QUEUE_SEGMENT_RECORDS, MAX_BUFFERED_READINGS / RAM_QUEUE_SEGMENT_RECORDS,
+               enabledUploadBackends()),
+      uploadHealth{{UPLOAD_RETRY_BASE_DELAY, UPLOAD_RETRY_MAX_DELAY, UPLOAD_BREAKER_THRESHOLD, UPLOAD_BREAKER_OPEN_TIME},
+                   {UPLOAD_RETRY_BASE_DELAY, UPLOAD_RETRY_MAX_DELAY, UPLOAD_BREAKER_THRESHOLD, UPLOAD_BREAKER_OPEN_TIME}},
+      uploadSchedule(UPLOAD_INTERVAL, UPLOAD_JITTER, UPLOAD_INTERVAL_MIN, UPLOAD_INTERVAL_MAX),
+      wallClock(RTC_TRIM_SPAN),
+      smsDelivery(SMS_DELIVERY_TIMEOUT),
+      gprsLink(GPRS_RETRY_BASE_DELAY, GPRS_RETRY_MAX_DELAY, GPRS_BREAKER_THRESHOLD, GPRS_BREAKER_OPEN_TIME),
+      mqttLink(GPRS_RETRY_BASE_DELAY, GPRS_RETRY_MAX_DELAY, GPRS_BREAKER_THRESHOLD, GPRS_BREAKER_OPEN_TIME) {
+    gsmUart = nullptr;
+    gsmSerial = &modem;
+    baudSetter = setBaudRate;
+    baudContext = context;
+    uartBaud = GSM_UART_BAUDRATE;
+    fastBaudFailed = false;
+    linesHeard = 0;
+    silentCommands = 0;
     
     moduleReady = false;
     networkRegistered = false;
@@ -16,207 +86,719 @@ GSMModule::GSMModule() {
     smsSentCount = 0;
     smsFailedCount = 0;
     smsReceivedCount = 0;
-    lastSMSTime = 0;
+    nextSMSAllowedAt = 0;
+    outboxCount = 0;
+    for (int i = 0; i < MAX_OUTBOUND_SMS; i++) {
+        outbox[i].used = false;
+    }
+    for (int i = 0; i < MAX_RECENT_ALERTS; i++) {
+        recentAlerts[i].sentAt = 0;
+    }
     moduleStartTime = 0;
-    bufferedCount = 0;
+    uploadQueue = nullptr;
+    uploadBackendCount = 0;
+    if (ENABLE_THINGSPEAK_UPLOAD) {
+        addUploadBackend("ThingSpeak", THINGSPEAK_BULK_URL, nullptr, THINGSPEAK_API_KEY, false, false, true);
+    }
+    if (ENABLE_BILLING_UPLOAD) {
+        addUploadBackend("Billing", BILLING_UPLOAD_URL, BILLING_FAILOVER_URL, BILLING_API_KEY,
+                         ENABLE_DATA_COMPRESSION, ENABLE_MQTT, false);
+    }
+    lastClockAttempt = 0;
     lastSMSIndex = -1;
+    smsReference = 0;
+    cdsPDUPending = false;
     lastError = "";
+    responseCollector = nullptr;
+    cmtHeaderPending = false;
+    pendingHangup = false;
+    pendingSMSHead = 0;
+    pendingSMSCount = 0;
+    inboxCount = 0;
+    inboxOverflow = false;
+    inboxAwaitingBody = false;
+    collectingInbox = false;
+    httpSessionOpen = false;
+    lastHTTPStatus = 0;
+    lastHTTPResponseLength = 0;
+    uploadDeclared = 0;
+    uploadStreamed = 0;
+    modemAsleep = false;
+    slowClockEnabled = false;
+    lastModemActivity = 0;
+    sleepStartedAt = 0;
+    memset(&sleepStats, 0, sizeof(sleepStats));
+    memset(&signalStats, 0, sizeof(signalStats));
+    lastModemStatsReport = 0;
+    tcpStackReady = false;
+    tcpOpen = false;
+    tcpDataPending = false;
+    tcpRxHeaderPending = false;
+    tcpRxLength = 0;
+    bringUpState = BRINGUP_IDLE;
+    bringUpStartedAt = 0;
+    bringUpNextAt = 0;
+    bringUpStep = 0;
+    profileSaved = false;
+    
+    atParser.setLineHandler(&GSMModule::onParsedLine, this);
+    mqtt.setWriteHandler(&GSMModule::onMQTTWrite, this);
+    mqtt.setMessageHandler(&GSMModule::onMQTTMessage, this);
 }
 
 bool GSMModule::initialize() {
-    moduleStartTime = millis();
+    beginBringUp();
+    while (bringUpState != BRINGUP_READY && bringUpState != BRINGUP_FAILED) {
+        serviceBringUp();
+        delay(10);
+    }
+    
+    if (DEBUG_MODE && moduleReady) {
+        printDetailedStatus();
+    }
+    return moduleReady;
+}
+
+void GSMModule::beginBringUp() {
+    moduleStartTime = monoMillis();
+    gprsLink.seed(esp_random());
+    mqttLink.seed(esp_random());
+    for (int i = 0; i < uploadBackendCount; i++) {
+        uploadHealth[i].seed(esp_random());
+    }
+    uploadSchedule.seed(esp_random());
+    uploadSchedule.begin(millis(), DEVICE_ID);
+    
+    // Readings are queued even if the modem never comes up
+    beginUploadQueue();
     
     if (DEBUG_MODE) {
         Serial.println("Initializing SIM800L module...");
     }
     
-    gsmSerial->begin(GSM_UART_BAUDRATE, GSM_UART_CONFIG, GSM_RX_PIN, GSM_TX_PIN);
-    delay(3000);
+    // DTR low keeps the modem awake until the scheduler lets it sleep
+    pinMode(GSM_DTR_PIN, OUTPUT);
+    digitalWrite(GSM_DTR_PIN, LOW);
+    pinMode(GSM_RI_PIN, INPUT_PULLUP);
+    attachInterrupt(digitalPinToInterrupt(GSM_RI_PIN), &GSMModule::onRingIndicator, FALLING);
+    modemAsleep = false;
+    slowClockEnabled = false;
+    
+    // Always start at the probe rate; a faster one is negotiated once the modem answers
+    if (gsmUart != nullptr) {
+        gsmUart->begin(GSM_UART_BAUDRATE, GSM_UART_CONFIG, GSM_RX_PIN, GSM_TX_PIN);
+        uartBaud = GSM_UART_BAUDRATE;
+    } else {
+        setUartBaud(GSM_UART_BAUDRATE);
+    }
+    fastBaudFailed = false;
+    silentCommands = 0;
     
     clearSerialBuffer();
+    atParser.reset();
     
-    struct InitCommand {
-        const char* command;
-        const char* expected;
-        const char* description;
-        bool critical;
-    };
-    
-    InitCommand initCommands[] = {
-        {"AT", "OK", "Basic communication test", true},
-        {"ATE0", "OK", "Disable echo", true},
-        {"AT+CMEE=2", "OK", "Enable extended error reporting", false},
-        {"AT+CREG?", "+CREG:", "Check network registration", true},
-        {"AT+CSQ", "+CSQ:", "Check signal strength", true},
-        {"AT+COPS?", "+COPS:", "Check network operator", false},
-        {"AT+CMGF=1", "OK", "Set SMS text mode", true},
-        {"AT+CSCS=\"GSM\"", "OK", "Set character set", false},
-        {"AT+CNMI=1,2,0,0,0", "OK", "Configure SMS notifications", true},
-        {"AT+CPMS=\"SM\",\"SM\",\"SM\"", "OK", "Set SMS storage to SIM", false}
-    };
-    
-    bool initSuccess = true;
-    int criticalFailures = 0;
+    moduleReady = false;
+    smsReady = false;
+    bringUpState = BRINGUP_BOOTING;
+    bringUpStartedAt = millis();
+    bringUpNextAt = bringUpStartedAt;
+}
+
+bool GSMModule::serviceBringUp() {
+    unsigned long now = millis();
+    if (bringUpState == BRINGUP_IDLE || bringUpState == BRINGUP_READY || (long)(now - bringUpNextAt) < 0) {
+        return false;
+    }
     
-    for (const auto& cmd : initCommands) {
-        if (DEBUG_MODE) {
-            Serial.print("  ");
-            Serial.println(cmd.description);
+    switch (bringUpState) {
+        case BRINGUP_BOOTING: {
+            // Answers ~3 s after power-on; each probe also trains the modem's auto-baud
+            String response = sendATCommandWithResponse("AT", 300);
+            if (response.endsWith("OK")) {
+                // An echoed probe means the saved profile (ATE0) is not in effect
+                profileSaved = response.indexOf("AT") == -1;
+                bool negotiate = canChangeBaud() && !fastBaudFailed && uartBaud != GSM_UART_FAST_BAUDRATE;
+                bringUpState = negotiate ? BRINGUP_NEGOTIATING_BAUD : BRINGUP_CHECK_PROFILE;
+            } else if (now - bringUpStartedAt >= MODEM_BOOT_TIMEOUT) {
+                failBringUp("Modem not responding");
+            } else {
+                // A modem that saved the fast rate no longer autobauds to the probe rate
+                if (canChangeBaud()) {
+                    setUartBaud(uartBaud == GSM_UART_BAUDRATE ? GSM_UART_FAST_BAUDRATE : GSM_UART_BAUDRATE);
+                }
+                bringUpNextAt = millis() + 1000;
+            }
+            break;
         }
         
-        bool success = sendATCommand(cmd.command, cmd.expected, 15000);
-        
-        if (success) {
-            if (DEBUG_MODE) {
-                Serial.print("    ✓ ");
-                Serial.print(cmd.command);
-                Serial.println(" - OK");
+        case BRINGUP_NEGOTIATING_BAUD: {
+            // The OK still comes at the old rate; the modem switches right after it
+            unsigned long probeBaud = uartBaud;
+            if (!sendATCommand("AT+IPR=" + String(GSM_UART_FAST_BAUDRATE), "OK", 1000)) {
+                fastBaudFailed = true;
+                logError("Modem refused " + String(GSM_UART_FAST_BAUDRATE) + " baud");
+                bringUpState = BRINGUP_CHECK_PROFILE;
+                break;
             }
             
-            if (strcmp(cmd.command, "AT+CSQ") == 0) {
-                String response = sendATCommandWithResponse("AT+CSQ", 5000);
-                parseSignalStrength(response);
-            } else if (strcmp(cmd.command, "AT+COPS?") == 0) {
-                String response = sendATCommandWithResponse("AT+COPS?", 10000);
-                parseOperator(response);
-            } else if (strcmp(cmd.command, "AT+CREG?") == 0) {
-                String response = sendATCommandWithResponse("AT+CREG?", 10000);
-                parseNetworkStatus(response);
+            setUartBaud(GSM_UART_FAST_BAUDRATE);
+            delay(20);
+            if (sendATCommand("AT", "OK", 300)) {
+                // The rate belongs to the saved profile; configuring ends with AT&W
+                profileSaved = false;
+                bringUpState = BRINGUP_CHECK_PROFILE;
+                if (DEBUG_MODE) {
+                    Serial.println("  Modem UART at " + String(uartBaud) + " baud");
+                }
+                break;
             }
-        } else {
+            
+            // Garbled at the fast rate (long wires, weak level shifting): ask the
+            // modem back blind and stay at the probe rate until the next bring-up
+            logError("No answer at " + String(GSM_UART_FAST_BAUDRATE) + " baud, staying at " + String(probeBaud));
+            sendATCommand("AT+IPR=" + String(probeBaud), "OK", 300);
+            setUartBaud(probeBaud);
+            fastBaudFailed = true;
+            bringUpState = BRINGUP_BOOTING;
+            bringUpStartedAt = millis();
+            break;
+        }
+        
+        case BRINGUP_CHECK_PROFILE: {
+            if (profileSaved) {
+                String query = "AT";
+                for (size_t i = 0; i < MODEM_PROFILE_COUNT; i++) {
+                    if (MODEM_PROFILE[i].query != nullptr) {
+                        query += (query.length() > 2 ? ";" : "");
+                        query += MODEM_PROFILE[i].query;
+                    }
+                }
+                String response = sendATCommandWithResponse(query, 5000);
+                for (size_t i = 0; i < MODEM_PROFILE_COUNT && profileSaved; i++) {
+                    if (MODEM_PROFILE[i].expected != nullptr && response.indexOf(MODEM_PROFILE[i].expected) == -1) {
+                        profileSaved = false;
+                    }
+                }
+            }
+            
+            bringUpStep = 0;
+            bringUpState = profileSaved ? BRINGUP_REGISTERING : BRINGUP_CONFIGURING;
+            bringUpStartedAt = millis();
             if (DEBUG_MODE) {
-                Serial.print("    ✗ ");
-                Serial.print(cmd.command);
-                Serial.println(" - Failed");
+                Serial.println(profileSaved ? "  Modem settings already saved" : "  Configuring modem settings");
+            }
+            break;
+        }
+        
+        case BRINGUP_CONFIGURING: {
+            if (bringUpStep < (int)MODEM_PROFILE_COUNT) {
+                const ModemSetting& setting = MODEM_PROFILE[bringUpStep++];
+                if (!sendATCommand(setting.command, "OK", 5000) && setting.critical) {
+                    failBringUp("Critical init failed: " + String(setting.command));
+                }
+                break;
             }
             
-            if (cmd.critical) {
-                criticalFailures++;
-                logError("Critical init failed: " + String(cmd.command));
+            // Saved settings survive a modem power cycle; the next boot only checks them
+            if (!sendATCommand("AT&W", "OK", 5000)) {
+                logError("Could not save modem settings");
             }
-            initSuccess = false;
+            bringUpState = BRINGUP_REGISTERING;
+            bringUpStartedAt = millis();
+            break;
         }
         
-        delay(1000);
+        case BRINGUP_REGISTERING:
+            if (readNetworkState()) {
+                moduleReady = true;
+                smsReady = true;
+                bringUpState = BRINGUP_READY;
+                if (DEBUG_MODE) {
+                    Serial.println("✓ SIM800L ready after " + String((unsigned long)(monoMillis() - moduleStartTime)) + " ms");
+                }
+                return true;
+            }
+            if (now - bringUpStartedAt >= MODEM_REGISTRATION_TIMEOUT) {
+                failBringUp("Network registration timed out");
+            } else {
+                bringUpNextAt = millis() + 2000;
+            }
+            break;
+            
+        case BRINGUP_FAILED:
+            // Start over: the modem may have reset or browned out meanwhile
+            bringUpState = BRINGUP_BOOTING;
+            bringUpStartedAt = now;
+            break;
+            
+        default:
+            break;
     }
+    return false;
+}
+
+void GSMModule::failBringUp(const String& reason) {
+    logError(reason);
+    moduleReady = false;
+    smsReady = false;
+    bringUpState = BRINGUP_FAILED;
+    bringUpNextAt = millis() + MODEM_BRINGUP_RETRY;
     
-    checkModuleStatus();
-    
-    if (moduleReady && criticalFailures == 0) {
-        if (DEBUG_MODE) {
-            Serial.println("✓ SIM800L initialization successful!");
-            printDetailedStatus();
-        }
-    } else {
-        if (DEBUG_MODE) {
-            Serial.print("✗ SIM800L initialization failed - ");
-            Serial.print(criticalFailures);
-            Serial.println(" critical failures");
-        }
+    if (DEBUG_MODE) {
+        Serial.println("✗ SIM800L initialization failed, retrying in " + String(MODEM_BRINGUP_RETRY / 1000) + " s");
+    }
+}
+
+bool GSMModule::readNetworkState() {
+    parseNetworkStatus(sendATCommandWithResponse("AT+CREG?", 5000));
+    if (!networkRegistered) {
+        return false;
+    }
+    parseSignalStrength(sendATCommandWithResponse("AT+CSQ", 5000));
+    parseOperator(sendATCommandWithResponse("AT+COPS?", 10000));
+    return true;
+}
+
+GSMModule::BringUpState GSMModule::getBringUpState() {
+    return bringUpState;
+}
+
+bool GSMModule::canChangeBaud() {
+    return GSM_UART_FAST_BAUDRATE != 0 && GSM_UART_FAST_BAUDRATE != GSM_UART_BAUDRATE &&
+           (gsmUart != nullptr || baudSetter != nullptr);
+}
+
+void GSMModule::setUartBaud(unsigned long baud) {
+    if (gsmUart != nullptr) {
+        gsmUart->updateBaudRate(baud);
+    } else if (baudSetter != nullptr) {
+        baudSetter(baud, baudContext);
+    }
+    uartBaud = baud;
+}
+
+void GSMModule::noteModemAnswered(uint32_t linesBefore) {
+    if (linesHeard != linesBefore) {
+        silentCommands = 0;
+        return;
+    }
+    if (++silentCommands < MODEM_SILENT_LIMIT || bringUpState != BRINGUP_READY) {
+        return;
     }
     
-    return moduleReady;
+    // Reset or brown-out back to autobaud, or a rate it never saved: find it again
+    logError("Modem stopped answering at " + String(uartBaud) + " baud");
+    silentCommands = 0;
+    moduleReady = false;
+    smsReady = false;
+    bringUpState = BRINGUP_BOOTING;
+    bringUpStartedAt = millis();
+    bringUpNextAt = bringUpStartedAt;
+    markGPRSLost();
 }
 
 bool GSMModule::sendATCommand(const String& command, const String& expectedResponse, unsigned long timeout) {
-    clearSerialBuffer();
+    prepareModemForCommand();
+    atParser.setExpected(expectedResponse.c_str());
     
+    uint32_t linesBefore = linesHeard;
+    unsigned long startedAt = millis();
     gsmSerial->println(command);
     
+    ATResponseParser::Token token = waitForToken(timeout);
+    lastModemActivity = millis();
+    noteModemAnswered(linesBefore);
+    bool ok = atParser.isExpected(token);
+    noteCommand(command.c_str(), token, ok, startedAt);
+    if (ok) {
+        return true;
+    }
+    
+    if (token == ATResponseParser::TOKEN_NONE) {
+        lastError = "AT command timeout: " + command;
+    } else {
+        lastError = "AT command failed: " + command + " (" + String(atParser.line()) + ")";
+    }
+    return false;
+}
+
+bool GSMModule::waitForResponse(const String& expected, unsigned long timeout, const char* phase) {
+    unsigned long startedAt = millis();
+    atParser.setExpected(expected.c_str());
+    ATResponseParser::Token token = waitForToken(timeout);
+    bool ok = atParser.isExpected(token);
+    if (phase != nullptr) {
+        noteCommand(phase, token, ok, startedAt);
+    }
+    return ok;
+}
+
+void GSMModule::noteCommand(const char* command, ATResponseParser::Token token, bool ok, unsigned long startedAt) {
+    ATCommandStats::Outcome outcome = ok ? ATCommandStats::OUTCOME_OK
+                                    : (token == ATResponseParser::TOKEN_NONE ? ATCommandStats::OUTCOME_TIMEOUT
+                                                                             : ATCommandStats::OUTCOME_ERROR);
+    commandStats.record(command, outcome, millis() - startedAt);
+}
+
+ATResponseParser::Token GSMModule::waitForToken(unsigned long timeout) {
     unsigned long startTime = millis();
-    String response;
     
     while (millis() - startTime < timeout) {
         while (gsmSerial->available()) {
-            char c = gsmSerial->read();
-            response += c;
-            
-            if (response.indexOf(expectedResponse) != -1) {
-                return true;
+            ATResponseParser::Token token = atParser.feed((char)gsmSerial->read());
+            if (token == ATResponseParser::TOKEN_NONE) {
+                continue;
             }
             
-            if (response.indexOf("ERROR") != -1 || response.indexOf("FAIL") != -1) {
-                lastError = "AT command failed: " + command;
-                return false;
+            // Anything else is a URC; a +HTTPACTION left over from an earlier
+            // request only ends the wait while AT+HTTPACTION is outstanding
+            if (atParser.isExpected(token) || ATResponseParser::isError(token)) {
+                return token;
             }
         }
         delay(10);
     }
     
-    lastError = "AT command timeout: " + command;
-    return false;
+    return ATResponseParser::TOKEN_NONE;
 }
 
 String GSMModule::sendATCommandWithResponse(const String& command, unsigned long timeout) {
-    clearSerialBuffer();
+    prepareModemForCommand();
+    atParser.setExpected(nullptr);
     
-    gsmSerial->println(command);
+    String response;
+    response.reserve(ATResponseParser::LINE_BUFFER_SIZE);
+    responseCollector = &response;
     
+    uint32_t linesBefore = linesHeard;
     unsigned long startTime = millis();
-    String response;
+    gsmSerial->println(command);
     
-    while (millis() - startTime < timeout) {
+    ATResponseParser::Token final = ATResponseParser::TOKEN_NONE;
+    
+    while (final == ATResponseParser::TOKEN_NONE && millis() - startTime < timeout) {
         while (gsmSerial->available()) {
-            char c = gsmSerial->read();
-            response += c;
+            ATResponseParser::Token token = atParser.feed((char)gsmSerial->read());
+            if (token == ATResponseParser::TOKEN_OK || ATResponseParser::isError(token)) {
+                final = token;
+                break;
+            }
+        }
+        if (final == ATResponseParser::TOKEN_NONE) {
+            delay(10);
+        }
+    }
+    
+    responseCollector = nullptr;
+    lastModemActivity = millis();
+    noteModemAnswered(linesBefore);
+    noteCommand(command.c_str(), final, final == ATResponseParser::TOKEN_OK, startTime);
+    return response;
+}
+
+void GSMModule::onParsedLine(const char* line, size_t length, ATResponseParser::Token token, void* context) {
+    GSMModule* self = static_cast<GSMModule*>(context);
+    self->linesHeard++;
+    
+    // Unsolicited codes can arrive in the middle of any exchange
+    if (ATResponseParser::isURC(token)) {
+        self->handleURC(token, line);
+        return;
+    }
+    
+    if (self->cdsPDUPending) {
+        // The PDU line after "+CDS: <length>"
+        self->cdsPDUPending = false;
+        uint8_t reference;
+        uint8_t status;
+        if (DeliveryTracker::parsePDUReport(line, reference, status)) {
+            self->handleStatusReport(reference, status);
+        }
+        return;
+    }
+    
+    if (self->tcpRxHeaderPending) {
+        self->tcpRxHeaderPending = false;
+        self->decodeTCPData(line);
+        return;
+    }
+    
+    if (token == ATResponseParser::TOKEN_PAYLOAD && self->cmtHeaderPending) {
+        self->cmtHeaderPending = false;
+        self->queueIncomingSMS(self->cmtSender, String(line), -1);
+        return;
+    }
+    
+    if (self->collectingInbox) {
+        self->collectInboxLine(token, line);
+        return;
+    }
+    
+    // Whole lines are appended, so the response grows once per line, not per byte
+    if (self->responseCollector != nullptr) {
+        if (self->responseCollector->length() > 0) {
+            *self->responseCollector += "\r\n";
+        }
+        *self->responseCollector += line;
+    }
+}
+
+void GSMModule::handleURC(ATResponseParser::Token token, const char* line) {
+    switch (token) {
+        case ATResponseParser::TOKEN_CMT:
+            // +CMT: "<sender>","<alpha>","<timestamp>" - text follows on the next line
+            cmtSender = extractQuotedField(line, 0);
+            cmtHeaderPending = true;
+            break;
+            
+        case ATResponseParser::TOKEN_CMTI: {
+            // +CMTI: "SM",<index> - stored on the SIM, read it from the main loop
+            const char* comma = strchr(line, ',');
+            if (comma != nullptr) {
+                queueIncomingSMS("", "", atoi(comma + 1));
+            }
+            break;
         }
         
-        if (response.indexOf("OK") != -1 || response.indexOf("ERROR") != -1) {
+        case ATResponseParser::TOKEN_CDS: {
+            // Text mode: +CDS: <fo>,<mr>,...,<st>; PDU mode: +CDS: <length>, PDU next
+            uint8_t reference;
+            uint8_t status;
+            if (strchr(line, ',') == nullptr) {
+                cdsPDUPending = true;
+            } else if (DeliveryTracker::parseTextReport(line, reference, status)) {
+                handleStatusReport(reference, status);
+            }
             break;
         }
-        delay(10);
+        
+        case ATResponseParser::TOKEN_RING:
+            pendingHangup = true;
+            break;
+            
+        case ATResponseParser::TOKEN_SAPBR_URC:
+            // +SAPBR 1: DEACT - the network dropped the bearer
+            markGPRSLost();
+            logError("GPRS bearer deactivated by network");
+            break;
+            
+        case ATResponseParser::TOKEN_CIPRXGET: {
+            // +CIPRXGET: 1 announces data; +CIPRXGET: 3,<len>,<left> heads a hex read
+            int mode = atoi(line + 10);
+            if (mode == 1) {
+                tcpDataPending = true;
+            } else if (mode == 3) {
+                const char* comma = strchr(line, ',');
+                const char* left = comma != nullptr ? strchr(comma + 1, ',') : nullptr;
+                tcpRxHeaderPending = comma != nullptr && atoi(comma + 1) > 0;
+                tcpDataPending = left != nullptr && atoi(left + 1) > 0;
+            }
+            break;
+        }
+        
+        case ATResponseParser::TOKEN_TCP_CLOSED:
+            markTCPClosed();
+            break;
+            
+        case ATResponseParser::TOKEN_PDP_DEACT:
+            // The TCP stack's context is gone; it needs CIICR again
+            tcpStackReady = false;
+            markTCPClosed();
+            logError("GPRS PDP context deactivated");
+            break;
+            
+        case ATResponseParser::TOKEN_UNDER_VOLTAGE:
+        case ATResponseParser::TOKEN_OVER_VOLTAGE:
+            logError("Modem supply: " + String(line));
+            if (strstr(line, "POWER DOWN") != nullptr) {
+                failBringUp("Modem powered down");
+                markGPRSLost();
+            }
+            break;
+            
+        default:
+            break;
+    }
+}
+
+void GSMModule::collectInboxLine(ATResponseParser::Token token, const char* line) {
+    if (token == ATResponseParser::TOKEN_CMGL) {
+        // +CMGL: <index>,"<stat>","<sender>","<alpha>","<timestamp>"
+        inboxAwaitingBody = false;
+        if (inboxCount >= MAX_INBOX_RECORDS) {
+            inboxOverflow = true;
+            return;
+        }
+        IncomingSMS& record = inbox[inboxCount++];
+        record.index = atoi(line + 6);
+        record.sender = extractQuotedField(line, 1);
+        record.message = "";
+        inboxAwaitingBody = true;
+    } else if (token == ATResponseParser::TOKEN_PAYLOAD && inboxAwaitingBody) {
+        inbox[inboxCount - 1].message = line;
+        inboxAwaitingBody = false;
+    }
+}
+
+void GSMModule::queueIncomingSMS(const String& sender, const String& message, int index) {
+    if (pendingSMSCount >= MAX_PENDING_SMS) {
+        logError("Incoming SMS queue full, message dropped");
+        return;
     }
     
-    return response;
+    int slot = (pendingSMSHead + pendingSMSCount) % MAX_PENDING_SMS;
+    pendingSMS[slot].sender = sender;
+    pendingSMS[slot].message = message;
+    pendingSMS[slot].index = index;
+    pendingSMSCount++;
+}
+
+void GSMModule::poll() {
+    // RI fired: wake the modem and keep it up while the SMS is handled
+    if (ringIndicated) {
+        ringIndicated = false;
+        if (modemAsleep) {
+            sleepStats.ringWakes++;
+            wakeFromSleep();
+        }
+        lastModemActivity = millis();
+    }
+    
+    // Route whatever the modem pushed since the last exchange
+    clearSerialBuffer();
+    
+    if (pendingHangup) {
+        pendingHangup = false;
+        if (DEBUG_MODE) {
+            Serial.println("Incoming call rejected");
+        }
+        sendATCommand("ATH", "OK", 5000);
+    }
+}
+
+String GSMModule::processIncomingSMS() {
+    if (pendingSMSCount == 0) {
+        return "";
+    }
+    
+    IncomingSMS sms = pendingSMS[pendingSMSHead];
+    pendingSMS[pendingSMSHead].sender = "";
+    pendingSMS[pendingSMSHead].message = "";
+    pendingSMSHead = (pendingSMSHead + 1) % MAX_PENDING_SMS;
+    pendingSMSCount--;
+    
+    // Stored messages (+CMTI) are fetched by index and removed once read
+    if (sms.index >= 0) {
+        String response = sendATCommandWithResponse("AT+CMGR=" + String(sms.index), 5000);
+        int header = response.indexOf("+CMGR:");
+        if (header == -1) {
+            return "";
+        }
+        int headerEnd = response.indexOf("\r\n", header);
+        sms.sender = extractQuotedField(response.substring(header, headerEnd).c_str(), 1);
+        if (headerEnd != -1) {
+            int bodyEnd = response.indexOf("\r\n", headerEnd + 2);
+            sms.message = response.substring(headerEnd + 2, bodyEnd == -1 ? response.length() : bodyEnd);
+        }
+        deleteSMS(sms.index);
+    }
+    
+    lastSMSMessage = sms.message;
+    lastSMSSender = sms.sender;
+    smsReceivedCount++;
+    
+    if (DEBUG_MODE) {
+        Serial.println("📱 New SMS received:");
+        Serial.println("  From: " + sms.sender);
+        Serial.println("  Message: " + sms.message);
+    }
+    
+    return handleSMS(sms.sender, sms.message);
 }
 
 // NEW: Enhanced SMS Receiving Functions
 bool GSMModule::checkIncomingSMS() {
     if (!smsReady) return false;
     
-    String response = sendATCommandWithResponse("AT+CMGL=\"ALL\"", 10000);
+    // Records are filled straight from the parsed lines; the listing is never
+    // held in memory as one response string
+    inboxCount = 0;
+    inboxOverflow = false;
+    inboxAwaitingBody = false;
+    collectingInbox = true;
+    sendATCommandWithResponse("AT+CMGL=\"ALL\"", 10000);
+    collectingInbox = false;
+    
+    if (DEBUG_MODE && inboxCount > 0) {
+        Serial.print("📱 ");
+        Serial.print(inboxCount);
+        Serial.println(inboxOverflow ? "+ SMS waiting on SIM" : " SMS waiting on SIM");
+    }
     
-    if (response.indexOf("+CMGL:") != -1) {
-        String smsContent = extractSMSContent(response);
-        String smsSender = extractSMSSender(response);
+    return inboxCount > 0;
+}
+
+String GSMModule::parseIncomingSMS() {
+    String summary = "";
+    bool morePending = true;
+    
+    // A full listing means more may be waiting; the processed ones are gone
+    // after the delete, so the next pass picks up the rest
+    while (morePending && checkIncomingSMS()) {
+        morePending = inboxOverflow;
+        String deleteCmd = "AT";
         
-        if (smsContent.length() > 0) {
-            lastSMSMessage = smsContent;
-            lastSMSSender = smsSender;
+        for (int i = 0; i < inboxCount; i++) {
+            IncomingSMS& sms = inbox[i];
+            lastSMSMessage = sms.message;
+            lastSMSSender = sms.sender;
             smsReceivedCount++;
             
             if (DEBUG_MODE) {
                 Serial.println("📱 New SMS received:");
-                Serial.println("  From: " + smsSender);
-                Serial.println("  Message: " + smsContent);
+                Serial.println("  From: " + sms.sender);
+                Serial.println("  Message: " + sms.message);
             }
             
-            return true;
+            String result = handleSMS(sms.sender, sms.message);
+            if (summary.length() > 0) {
+                summary += "; ";
+            }
+            summary += result;
+            
+            deleteCmd += (deleteCmd.length() > 2) ? ";+CMGD=" : "+CMGD=";
+            deleteCmd += String(sms.index);
+        }
+        
+        // Only the indices handled above are removed, in one command line
+        if (deleteCmd.length() > 2 && !sendATCommand(deleteCmd, "OK", 10000)) {
+            logError("Failed to delete processed SMS");
+            break;
+        }
+        
+        for (int i = 0; i < inboxCount; i++) {
+            inbox[i].sender = "";
+            inbox[i].message = "";
         }
     }
     
-    return false;
+    return summary;
 }
 
-String GSMModule::parseIncomingSMS() {
-    if (!checkIncomingSMS()) {
-        return "";
-    }
-    
-    if (isAuthorizedNumber(lastSMSSender)) {
-        SMSCommand cmd = parseSMSCommand(lastSMSMessage, lastSMSSender);
+String GSMModule::handleSMS(const String& sender, const String& message) {
+    if (isAuthorizedNumber(sender)) {
+        SMSCommand cmd = parseSMSCommand(message, sender);
         
         if (cmd.isValid) {
             processSMSCommand(cmd);
-            deleteAllSMS(); // Clean up after processing
             return "Command processed: " + cmd.command;
         } else {
-            sendSMS(lastSMSSender, "Invalid command. Send 'HELP' for available commands.");
-            return "Invalid command from: " + lastSMSSender;
+            sendSMS(sender, "Invalid command. Send 'HELP' for available commands.");
+            return "Invalid command from: " + sender;
         }
     } else {
         if (DEBUG_MODE) {
-            Serial.println("Unauthorized SMS sender: " + lastSMSSender);
+            Serial.println("Unauthorized SMS sender: " + sender);
         }
         return "Unauthorized sender";
     }
@@ -247,25 +829,28 @@ GSMModule::SMSCommand GSMModule::parseSMSCommand(const String& message, const St
 }
 
 bool GSMModule::processSMSCommand(const SMSCommand& cmd) {
+    String response = runCommand(cmd);
+    if (response.length() > 0) {
+        return sendSMS(cmd.sender, response);
+    }
+    return false;
+}
+
+String GSMModule::runCommand(const SMSCommand& cmd) {
     String response = "";
-    bool success = false;
     
     if (cmd.command == "STATUS") {
         response = generateStatusResponse();
-        success = true;
     }
     else if (cmd.command == "REPORT") {
         // This would need integration with sensor data
         response = "Daily report feature requires sensor integration";
-        success = true;
     }
     else if (cmd.command == "HELP") {
         response = generateHelpResponse();
-        success = true;
     }
     else if (cmd.command == "SIGNAL") {
         response = "Signal: " + getSignalQualityDescription();
-        success = true;
     }
     else if (cmd.command == "RESET") {
         if (cmd.parameter == "COUNTERS") {
@@ -274,38 +859,32 @@ bool GSMModule::processSMSCommand(const SMSCommand& cmd) {
         } else {
             response = "Reset requires parameter: COUNTERS";
         }
-        success = true;
     }
     else if (cmd.command == "SET") {
         response = "SET commands not yet implemented";
-        success = true;
-    }
-    
-    if (success) {
-        return sendSMS(cmd.sender, response);
     }
     
-    return false;
+    return response;
 }
 
 String GSMModule::generateStatusResponse() {
-    String status = "SYSTEM STATUS\\n";
-    status += "Network: " + getNetworkStatusDescription() + "\\n";
-    status += "Signal: " + getSignalQualityDescription() + "\\n";
-    status += "SMS Sent: " + String(smsSentCount) + "\\n";
-    status += "SMS Received: " + String(smsReceivedCount) + "\\n";
-    status += "GPRS: " + String(gprsConnected ? "Connected" : "Disconnected") + "\\n";
-    status += "Uptime: " + String((millis() - moduleStartTime) / 60000) + " min";
+    String status = "SYSTEM STATUS\n";
+    status += "Network: " + getNetworkStatusDescription() + "\n";
+    status += "Signal: " + getSignalQualityDescription() + "\n";
+    status += "SMS Sent: " + String(smsSentCount) + "\n";
+    status += "SMS Received: " + String(smsReceivedCount) + "\n";
+    status += "GPRS: " + (gprsConnected ? String("Connected") : getLinkStatusDescription()) + "\n";
+    status += "Uptime: " + String((unsigned long)((monoMillis() - moduleStartTime) / 60000)) + " min";
     
     return status;
 }
 
 String GSMModule::generateHelpResponse() {
-    String help = "AVAILABLE COMMANDS:\\n";
-    help += "STATUS - System status\\n";
-    help += "REPORT - Daily report\\n";
-    help += "SIGNAL - Signal strength\\n";
-    help += "RESET COUNTERS - Reset stats\\n";
+    String help = "AVAILABLE COMMANDS:\n";
+    help += "STATUS - System status\n";
+    help += "REPORT - Daily report\n";
+    help += "SIGNAL - Signal strength\n";
+    help += "RESET COUNTERS - Reset stats\n";
     help += "HELP - This message";
     
     return help;
@@ -317,6 +896,16 @@ bool GSMModule::setupGPRS(const String& apn) {
         Serial.println("Setting up GPRS connection...");
     }
 
+    // The bearer outlives an ESP32-only reset, and SAPBR=1,1 fails on an open one
+    if (sendATCommandWithResponse("AT+SAPBR=2,1", 5000).indexOf("+SAPBR: 1,1") != -1) {
+        gprsConnected = true;
+        gprsLink.attemptSucceeded(millis());
+        if (DEBUG_MODE) {
+            Serial.println("✓ GPRS bearer already open");
+        }
+        return true;
+    }
+    
     String apnCommand = "AT+SAPBR=3,1,\"APN\",\"" + apn + "\"";
     
     bool success = true;
@@ -350,35 +939,64 @@ bool GSMModule::setupGPRS(const String& apn) {
             success = false;
             break;
         }
-        delay(2000);
     }
     
     if (success) {
         gprsConnected = true;
-        String response = sendATCommandWithResponse("AT+SAPBR=2,1", 5000);
-        // Extract IP address from response if available
+        gprsLink.attemptSucceeded(millis());
         
         if (DEBUG_MODE) {
             Serial.println("✓ GPRS connection established!");
         }
+    } else {
+        gprsConnected = false;
+        gprsLink.attemptFailed(millis());
+        logError("GPRS setup failed, " + getLinkStatusDescription());
     }
     
     return success;
 }
 
-bool GSMModule::sendDataWithRetry(const String& url, const String& data, int maxRetries) {
-    for (int attempt = 1; attempt <= maxRetries; attempt++) {
-        if (DEBUG_MODE) {
-            Serial.print("📡 HTTP attempt ");
-            Serial.print(attempt);
-            Serial.print("/");
-            Serial.println(maxRetries);
+bool GSMModule::ensureGPRS() {
+    if (gprsConnected) {
+        return true;
+    }
+    if (bringUpState != BRINGUP_READY || !gprsLink.shouldAttempt(millis())) {
+        return false;
+    }
+    return setupGPRS();
+}
+
+void GSMModule::markGPRSLost() {
+    gprsConnected = false;
+    ipAddress = "";
+    httpSessionOpen = false;
+    httpContentType = "";
+    gprsLink.linkLost(millis());
+}
+
+String GSMModule::getLinkStatusDescription() {
+    unsigned long now = millis();
+    LinkSupervisor::State state = gprsLink.state(now);
+    String description = LinkSupervisor::stateName(state);
+    if (state == LinkSupervisor::LINK_BACKOFF || state == LinkSupervisor::LINK_CIRCUIT_OPEN) {
+        description += ", retry in " + String(gprsLink.retryIn(now) / 1000) + "s";
+    }
+    return description;
+}
+
+bool GSMModule::sendDataWithRetry(const String& url, const String& data, int maxRetries) {
+    for (int attempt = 1; attempt <= maxRetries; attempt++) {
+        if (DEBUG_MODE) {
+            Serial.print("📡 HTTP attempt ");
+            Serial.print(attempt);
+            Serial.print("/");
+            Serial.println(maxRetries);
         }
         
-        if (!gprsConnected) {
-            if (!setupGPRS()) {
-                continue;
-            }
+        // Retrying is pointless while the link supervisor holds off
+        if (!ensureGPRS()) {
+            break;
         }
         
         if (sendHTTPRequest(url, data)) {
@@ -388,7 +1006,7 @@ bool GSMModule::sendDataWithRetry(const String& url, const String& data, int max
             return true;
         }
         
-        if (attempt < maxRetries) {
+        if (attempt < maxRetries && gprsConnected) {
             if (DEBUG_MODE) {
                 Serial.println("HTTP failed, retrying in 5 seconds...");
             }
@@ -396,195 +1014,1436 @@ bool GSMModule::sendDataWithRetry(const String& url, const String& data, int max
         }
     }
     
-    if (DEBUG_MODE) {
-        Serial.println("✗ HTTP failed after all retries, buffering data");
+    if (DEBUG_MODE) {
+        Serial.println("✗ HTTP failed after all retries");
+    }
+    return false;
+}
+
+bool GSMModule::beginUploadQueue() {
+    if (uploadQueue != nullptr) {
+        return true;
+    }
+    
+#if GSM_FLASH_QUEUE
+    if (flashQueue.begin()) {
+        uploadQueue = &flashQueue;
+    } else {
+        logError("Offline storage unavailable - buffering in RAM");
+    }
+#endif
+    
+    if (uploadQueue == nullptr) {
+        if (!ramQueue.begin()) {
+            return false;
+        }
+        uploadQueue = &ramQueue;
+    }
+    
+    if (DEBUG_MODE) {
+        Serial.print("Upload queue ready: ");
+        Serial.print(uploadQueue->pending());
+        Serial.print(" readings pending, boot #");
+        Serial.println(uploadQueue->currentBootId());
+    }
+    return true;
+}
+
+bool GSMModule::bufferRecord(const TelemetryRecord& record) {
+    if (!beginUploadQueue()) {
+        return false;
+    }
+    
+    // Stamp the reading now if the clock is known; after a reboot its
+    // millis() age means nothing. millis() is the low half of monoMillis(),
+    // so the age carries over to the 64-bit count.
+    TelemetryRecord stamped = record;
+    if (stamped.createdAt == 0 && wallClock.valid()) {
+        uint64_t now = monoMillis();
+        stamped.createdAt = wallClock.epoch(now - (uint32_t)((uint32_t)now - stamped.capturedAt));
+    }
+    
+    uint32_t droppedBefore = uploadQueue->droppedCount();
+    if (!uploadQueue->push(stamped)) {
+        logError("Failed to queue reading");
+        return false;
+    }
+    
+    if (DEBUG_MODE) {
+        if (uploadQueue->droppedCount() != droppedBefore) {
+            Serial.println("Queue full, discarded oldest readings");
+        }
+        Serial.print("Reading queued (");
+        Serial.print(uploadQueue->pending());
+        Serial.print("/");
+        Serial.print(uploadQueue->capacity());
+        Serial.println(")");
+    }
+    return true;
+}
+
+int GSMModule::getBufferedCount() {
+    return uploadQueue != nullptr ? uploadQueue->pending() : 0;
+}
+
+uint32_t GSMModule::resolveCreatedAt(const UploadQueue::Entry& entry, bool clockValid, uint32_t clockEpoch, unsigned long now) {
+    if (entry.record.createdAt != 0) {
+        return entry.record.createdAt;
+    }
+    // Unstamped readings can be back-dated only within the boot that took them
+    if (clockValid && entry.bootId == uploadQueue->currentBootId()) {
+        return clockEpoch - (uint32_t)((now - entry.record.capturedAt) / 1000);
+    }
+    return 0;
+}
+
+void GSMModule::addUploadBackend(const char* name, const char* url, const char* failoverURL, const char* apiKey,
+                                 bool binary, bool viaMQTT, bool needsTimestamps) {
+    UploadBackend& backend = uploadBackends[uploadBackendCount++];
+    backend.name = name;
+    backend.urls[0] = url;
+    backend.urls[1] = failoverURL != nullptr && failoverURL[0] != '\0' ? failoverURL : nullptr;
+    backend.apiKey = apiKey;
+    backend.binary = binary;
+    backend.viaMQTT = viaMQTT;
+    backend.needsTimestamps = needsTimestamps;
+    backend.activeURL = 0;
+    backend.urlFailures = 0;
+    backend.sentCount = 0;
+    backend.failedCount = 0;
+    backend.heldUntil = 0;
+}
+
+int GSMModule::getUploadBackendCount() {
+    return uploadBackendCount;
+}
+
+GSMModule::UploadBackendStatus GSMModule::getUploadBackendStatus(int index) {
+    UploadBackendStatus status;
+    memset(&status, 0, sizeof(status));
+    if (index < 0 || index >= uploadBackendCount) {
+        return status;
+    }
+    
+    const UploadBackend& backend = uploadBackends[index];
+    unsigned long now = millis();
+    status.name = backend.name;
+    status.url = backend.urls[backend.activeURL];
+    status.pending = uploadQueue != nullptr ? uploadQueue->pending(index) : 0;
+    status.sentCount = backend.sentCount;
+    status.failedCount = backend.failedCount;
+    status.health = uploadHealth[index].state(now);
+    status.retryIn = uploadHealth[index].retryIn(now);
+    status.heldFor = (long)(backend.heldUntil - now) > 0 ? backend.heldUntil - now : 0;
+    return status;
+}
+
+bool GSMModule::serviceUploads() {
+    unsigned long now = millis();
+    if (!uploadSchedule.due(now)) {
+        return false;
+    }
+    if (!beginUploadQueue() || uploadQueue->pending() == 0) {
+        uploadSchedule.windowUsed(now);
+        return true;
+    }
+    
+    // One short command tells whether this window is worth the airtime
+    if (moduleReady) {
+        parseSignalStrength(sendATCommandWithResponse("AT+CSQ", 5000));
+    }
+    int signal = signalStrength >= 0 && signalStrength <= 5 ? signalStrength : 0;
+    if (moduleReady && (signal == 0 || (signal <= UPLOAD_POOR_SIGNAL && !backlogUrgent(now)))) {
+        signalStats.deferred[signal]++;
+        uploadSchedule.deferWindow(now, UPLOAD_DEFER_RETRY);
+        if (DEBUG_MODE) {
+            Serial.println("Signal " + String(signal) + "/5 - upload put off for " +
+                           String(UPLOAD_DEFER_RETRY / 1000) + " s");
+        }
+        return false;
+    }
+    
+    // Directives in the responses apply from the next window on
+    uploadSchedule.windowUsed(now);
+    bool sent = sendBufferedData(uploadBodyLimit(signal));
+    if (sent) {
+        signalStats.sent[signal]++;
+    }
+    
+    // The bearer is known to be up now, so the stats report costs one request
+    if (ENABLE_MODEM_STATS_REPORT && ENABLE_BILLING_UPLOAD && sent &&
+        (lastModemStatsReport == 0 || monoMillis() - lastModemStatsReport >= MODEM_STATS_INTERVAL)) {
+        lastModemStatsReport = monoMillis();
+        reportModemStats();
+    }
+    return sent;
+}
+
+bool GSMModule::backlogUrgent(unsigned long now) {
+    // A backlog that is filling the queue cannot wait for a better signal
+    if (uploadQueue->pending() >= uploadQueue->capacity() * 3 / 4) {
+        return true;
+    }
+    
+    // Neither can one whose oldest reading is past its staleness budget
+    uint32_t sequence = uploadQueue->writeSequence();
+    for (int i = 0; i < uploadBackendCount; i++) {
+        if (uploadQueue->readCursor(i) < sequence) {
+            sequence = uploadQueue->readCursor(i);
+        }
+    }
+    UploadQueue::Entry entry;
+    while (sequence < uploadQueue->writeSequence() && !uploadQueue->read(sequence, entry)) {
+        sequence++;
+    }
+    if (sequence >= uploadQueue->writeSequence()) {
+        return false;
+    }
+    // Readings from an earlier boot are at least as old as this one
+    return entry.bootId != uploadQueue->currentBootId() || now - entry.record.capturedAt >= UPLOAD_MAX_STALENESS;
+}
+
+size_t GSMModule::uploadBodyLimit(int signal) {
+    // A weak link is more likely to drop a long transfer halfway through
+    if (signal >= 4) {
+        return UPLOAD_MAX_BODY;
+    }
+    if (signal == 3) {
+        return UPLOAD_MAX_BODY / 4;
+    }
+    return UPLOAD_MAX_BODY / 16;
+}
+
+GSMModule::SignalStats GSMModule::getSignalStats() {
+    return signalStats;
+}
+
+const ATCommandStats& GSMModule::getCommandStats() {
+    return commandStats;
+}
+
+bool GSMModule::reportModemStats() {
+    char* body = (char*)malloc(MODEM_STATS_MAX_BODY);
+    if (body == nullptr) {
+        return false;
+    }
+    
+    // Counters run from boot; the server takes differences between reports
+    int length = snprintf(body, MODEM_STATS_MAX_BODY, "{\"device\":\"%s\",\"uptime\":%lu,\"baud\":%lu,\"commands\":",
+                          DEVICE_ID, (unsigned long)((monoMillis() - moduleStartTime) / 1000), uartBaud);
+    size_t table = commandStats.toJSON(body + length, MODEM_STATS_MAX_BODY - length - 1);
+    if (table == 0) {
+        free(body);
+        logError("Modem stats do not fit MODEM_STATS_MAX_BODY");
+        return false;
+    }
+    length += table;
+    body[length++] = '}';
+    body[length] = '\0';
+    
+    bool sent = false;
+    if (ENABLE_MQTT && isMQTTConnected()) {
+        sent = publishMQTT(MQTT_MODEM_TOPIC, reinterpret_cast<const uint8_t*>(body), length);
+    }
+    if (!sent) {
+        sent = sendHTTPPost(MODEM_STATS_URL, body, length, "application/json");
+    }
+    free(body);
+    
+    if (DEBUG_MODE) {
+        Serial.println(String(sent ? "✓" : "✗") + " Modem stats report (" + String(length) + " bytes)");
+    }
+    return sent;
+}
+
+unsigned long GSMModule::getUploadInterval() {
+    return uploadSchedule.interval();
+}
+
+unsigned long GSMModule::getNextUploadIn() {
+    return uploadSchedule.dueIn(millis());
+}
+
+bool GSMModule::sendBufferedData(size_t maxBody) {
+    if (!beginUploadQueue()) return false;
+    if (uploadQueue->pending() == 0) return true;
+    
+    if (!ensureGPRS()) {
+        if (DEBUG_MODE) {
+            Serial.print("GPRS ");
+            Serial.print(getLinkStatusDescription());
+            Serial.print(" - ");
+            Serial.print(uploadQueue->pending());
+            Serial.println(" readings stay queued");
+        }
+        return false;
+    }
+    
+    // Each window re-reads network time (which also syncs the wall clock);
+    // if the modem has none, the RTC's time still stamps the batch
+    uint32_t clockEpoch = 0;
+    readNetworkTime(clockEpoch);
+    unsigned long now = millis();
+    bool clockValid = wallClock.valid();
+    clockEpoch = wallClock.epoch(monoMillis());
+    
+    // Every backend gets its turn; one that is backing off costs no AT traffic
+    bool allSent = true;
+    for (int i = 0; i < uploadBackendCount; i++) {
+        if (!uploadTo(i, maxBody, clockValid, clockEpoch, now)) {
+            allSent = false;
+        }
+        if (!gprsConnected) {
+            // The bearer went away under us: nobody else gets through either
+            return false;
+        }
+    }
+    return allSent;
+}
+
+bool GSMModule::uploadTo(uint8_t reader, size_t maxBody, bool clockValid, uint32_t clockEpoch, unsigned long now) {
+    UploadBackend& backend = uploadBackends[reader];
+    if (uploadQueue->pending(reader) == 0) {
+        return true;
+    }
+    if (!uploadHealth[reader].isUp() && !uploadHealth[reader].shouldAttempt(now)) {
+        return false;
+    }
+    if ((long)(backend.heldUntil - now) > 0) {
+        return false;
+    }
+    
+    // Sizing pass: which readings go and how long the body is, without keeping it
+    uint8_t window[UPLOAD_STREAM_WINDOW];
+    uint32_t end = uploadQueue->writeSequence();
+    uint32_t lastPacked = 0;
+    uint32_t stoppedAt;
+    size_t count;
+    size_t length;
+    if (backend.binary) {
+        TelemetryEncoder sizing(window, sizeof(window), 0, &GSMModule::discardBody, nullptr);
+        stoppedAt = packBatch(sizing, reader, end - 1, maxBody, clockValid, clockEpoch, now, lastPacked);
+        count = sizing.count();
+        length = sizing.length();
+    } else {
+        ThingSpeakBatch sizing(reinterpret_cast<char*>(window), sizeof(window), backend.apiKey,
+                               &GSMModule::discardBody, nullptr);
+        stoppedAt = packBatch(sizing, reader, end - 1, maxBody, clockValid, clockEpoch, now, lastPacked);
+        count = sizing.count();
+        length = sizing.length();
+    }
+    
+    if (count == 0) {
+        if (stoppedAt >= end) {
+            // Nothing readable left
+            uploadQueue->acknowledge(end - 1, reader);
+            return true;
+        }
+        if (backend.needsTimestamps) {
+            // No timestamp for the oldest reading: a plain update is stamped on arrival
+            bool sent = sendBufferedIndividually(reader, clockValid, clockEpoch);
+            if (sent) {
+                uploadHealth[reader].attemptSucceeded(now);
+                backend.sentCount++;
+            } else if (gprsConnected) {
+                uploadFailed(reader, now);
+            }
+            return sent;
+        }
+        return false;
+    }
+    
+    if (DEBUG_MODE) {
+        Serial.print(backend.name);
+        Serial.print(": sending ");
+        Serial.print(count);
+        Serial.print(" of ");
+        Serial.print(uploadQueue->pending(reader));
+        Serial.print(" buffered readings in one batch (");
+        Serial.print(length);
+        Serial.println(" bytes)");
+    }
+    
+    // One batch per call (ThingSpeak allows a bulk update every 15 s);
+    // anything that did not fit waits for the next call
+    // MQTT packs its own batch, which may hold fewer records than the HTTP one
+    uint32_t lastSent = 0;
+    size_t published = backend.viaMQTT ? publishBatchMQTT(reader, maxBody, clockValid, clockEpoch, now, lastSent) : 0;
+    bool delivered = published > 0;
+    if (delivered) {
+        count = published;
+    } else {
+        delivered = postBatchStream(reader, count, length, lastPacked, clockValid, clockEpoch, now);
+        lastSent = lastPacked;
+        applyServerDirectives(reader, now);
+    }
+    if (!delivered) {
+        // A lost bearer is not the backend's fault
+        if (gprsConnected) {
+            uploadFailed(reader, now);
+        }
+        return false;
+    }
+    
+    uploadQueue->acknowledge(lastSent, reader);
+    uploadHealth[reader].attemptSucceeded(now);
+    backend.urlFailures = 0;
+    backend.sentCount += count;
+    
+    if (DEBUG_MODE) {
+        Serial.println("✓ " + String(backend.name) + " has buffered readings through sequence " + String(lastSent));
+    }
+    
+    return true;
+}
+
+void GSMModule::uploadFailed(uint8_t reader, unsigned long now) {
+    UploadBackend& backend = uploadBackends[reader];
+    uploadHealth[reader].attemptFailed(now);
+    backend.failedCount++;
+    
+    if (backend.urls[1] != nullptr && ++backend.urlFailures >= UPLOAD_FAILOVER_AFTER) {
+        backend.activeURL ^= 1;
+        backend.urlFailures = 0;
+        if (DEBUG_MODE) {
+            Serial.println(String(backend.name) + " failing over to " + backend.urls[backend.activeURL]);
+        }
+    }
+}
+
+static long directiveSeconds(const String& body, const char* key) {
+    int at = body.indexOf(key);
+    if (at < 0) {
+        return -1;
+    }
+    const char* value = body.c_str() + at + strlen(key);
+    while (*value == ' ' || *value == ':' || *value == '"') {
+        value++;
+    }
+    return *value >= '0' && *value <= '9' ? atol(value) : -1;
+}
+
+void GSMModule::applyServerDirectives(uint8_t reader, unsigned long now) {
+    if (lastHTTPResponse.length() == 0) {
+        return;
+    }
+    
+    long interval = directiveSeconds(lastHTTPResponse, "\"upload_interval\"");
+    if (interval > 0) {
+        uploadSchedule.setInterval(now, (uint32_t)interval * 1000UL);
+        if (DEBUG_MODE) {
+            Serial.println("Server set the upload interval to " + String(uploadSchedule.interval() / 1000) + " s");
+        }
+    }
+    
+    long hold = directiveSeconds(lastHTTPResponse, "\"retry_after\"");
+    if (hold > 0) {
+        // Spread the return too, or every device told to wait comes back at once
+        unsigned long pause = (unsigned long)hold * 1000UL;
+        if (hold > UPLOAD_HOLD_MAX / 1000) {
+            pause = UPLOAD_HOLD_MAX;
+        }
+        uploadBackends[reader].heldUntil = now + pause + esp_random() % (UPLOAD_JITTER + 1);
+        if (DEBUG_MODE) {
+            Serial.println(String(uploadBackends[reader].name) + " asked us to hold off for " + String(pause / 1000) + " s");
+        }
+    }
+}
+
+uint32_t GSMModule::packBatch(UploadBatch& batch, uint8_t reader, uint32_t last, size_t maxLength, bool clockValid,
+                              uint32_t clockEpoch, unsigned long now, uint32_t& lastPacked) {
+    // Pending readings in order, skipping any that fail their CRC
+    UploadQueue::Entry entry;
+    bool needsTimestamps = uploadBackends[reader].needsTimestamps;
+    uint32_t sequence = uploadQueue->readCursor(reader);
+    while (sequence <= last && batch.length() + batch.maxEntryLength() <= maxLength) {
+        if (!uploadQueue->read(sequence, entry)) {
+            sequence++;
+            continue;
+        }
+        uint32_t createdAt = resolveCreatedAt(entry, clockValid, clockEpoch, now);
+        if ((createdAt == 0 && needsTimestamps) || !batch.add(entry.record, createdAt, entry.sequence)) {
+            break;
+        }
+        lastPacked = sequence;
+        sequence++;
+    }
+    return sequence;
+}
+
+bool GSMModule::postBatchStream(uint8_t reader, size_t count, size_t length, uint32_t lastPacked, bool clockValid,
+                                uint32_t clockEpoch, unsigned long now) {
+    const UploadBackend& backend = uploadBackends[reader];
+    const char* contentType = backend.binary ? "application/octet-stream" : "application/json";
+    if (!beginHTTPPost(backend.urls[backend.activeURL], length, contentType)) {
+        return false;
+    }
+    
+    // Sending pass: the same readings again, encoded a window at a time straight into the UART
+    uint8_t window[UPLOAD_STREAM_WINDOW];
+    uint32_t packed = 0;
+    bool streamed;
+    uploadDeclared = length;
+    uploadStreamed = 0;
+    if (backend.binary) {
+        TelemetryEncoder batch(window, sizeof(window), count, &GSMModule::writeBody, this);
+        packBatch(batch, reader, lastPacked, UPLOAD_MAX_BODY, clockValid, clockEpoch, now, packed);
+        streamed = batch.count() == count && batch.finish();
+    } else {
+        ThingSpeakBatch batch(reinterpret_cast<char*>(window), sizeof(window), backend.apiKey,
+                              &GSMModule::writeBody, this);
+        packBatch(batch, reader, lastPacked, UPLOAD_MAX_BODY, clockValid, clockEpoch, now, packed);
+        streamed = batch.count() == count && batch.finish();
+    }
+    
+    if (!streamed || uploadStreamed != length) {
+        // A reading that no longer reads back: fill the declared length so the
+        // modem leaves data mode, and drop this request
+        logError("Upload body changed while streaming");
+        while (uploadStreamed < length) {
+            gsmSerial->write(' ');
+            uploadStreamed++;
+        }
+        waitForResponse("OK", 10000);
+        return false;
+    }
+    
+    return finishHTTPPost(length);
+}
+
+size_t GSMModule::publishBatchMQTT(uint8_t reader, size_t maxBody, bool clockValid, uint32_t clockEpoch,
+                                   unsigned long now, uint32_t& lastPacked) {
+    // QoS 1 may have to resend the publish, so it is built whole in RAM
+    char* body = static_cast<char*>(malloc(MQTT_MAX_PAYLOAD));
+    if (body == nullptr) {
+        logError("No memory for MQTT batch");
+        return 0;
+    }
+    
+    size_t published = 0;
+    const UploadBackend& backend = uploadBackends[reader];
+    uint32_t last = uploadQueue->writeSequence() - 1;
+    size_t limit = maxBody < MQTT_MAX_PAYLOAD ? maxBody : MQTT_MAX_PAYLOAD;
+    if (backend.binary) {
+        TelemetryEncoder batch(reinterpret_cast<uint8_t*>(body), MQTT_MAX_PAYLOAD);
+        packBatch(batch, reader, last, limit, clockValid, clockEpoch, now, lastPacked);
+        if (batch.count() > 0 && publishMQTT(MQTT_TELEMETRY_TOPIC, batch.data(), batch.length())) {
+            published = batch.count();
+        }
+    } else {
+        ThingSpeakBatch batch(body, MQTT_MAX_PAYLOAD, backend.apiKey);
+        packBatch(batch, reader, last, limit, clockValid, clockEpoch, now, lastPacked);
+        if (batch.count() > 0 &&
+            publishMQTT(MQTT_TELEMETRY_TOPIC, reinterpret_cast<const uint8_t*>(batch.payload()), batch.length())) {
+            published = batch.count();
+        }
+    }
+    
+    free(body);
+    return published;
+}
+
+bool GSMModule::discardBody(const uint8_t* data, size_t length, void* context) {
+    return true;
+}
+
+bool GSMModule::writeBody(const uint8_t* data, size_t length, void* context) {
+    GSMModule* self = static_cast<GSMModule*>(context);
+    
+    // Past the declared length the bytes would land in the command parser
+    if (self->uploadStreamed + length > self->uploadDeclared) {
+        return false;
+    }
+    self->gsmSerial->write(data, length);
+    self->uploadStreamed += length;
+    return true;
+}
+
+bool GSMModule::sendBufferedIndividually(uint8_t reader, bool clockValid, uint32_t clockEpoch) {
+    // One reading per call keeps within ThingSpeak's 15 s update limit
+    UploadQueue::Entry entry;
+    uint32_t sequence = uploadQueue->readCursor(reader);
+    while (sequence < uploadQueue->writeSequence() && !uploadQueue->read(sequence, entry)) {
+        sequence++;
+    }
+    if (sequence >= uploadQueue->writeSequence()) {
+        return true;
+    }
+    
+    String url = THINGSPEAK_UPDATE_URL "?api_key=" THINGSPEAK_API_KEY;
+    for (int f = 0; f < TELEMETRY_FIELD_COUNT; f++) {
+        float value = entry.record.fields[f];
+        if (isnan(value) || isinf(value)) {
+            continue;
+        }
+        url += "&field" + String(f + 1) + "=" + String(value, TELEMETRY_FIELD_DECIMALS[f]);
+    }
+    url += "&status=seq:" + String(entry.sequence);
+    
+    uint32_t createdAt = resolveCreatedAt(entry, clockValid, clockEpoch, millis());
+    if (createdAt != 0) {
+        CivilTime time;
+        epochToCivil(createdAt, time);
+        char stamp[32];     // Wide enough for any field values
+        snprintf(stamp, sizeof(stamp), "%04u-%02u-%02uT%02u:%02u:%02uZ",
+                 time.year, time.month, time.day, time.hour, time.minute, time.second);
+        url += "&created_at=";
+        url += stamp;
+    }
+    
+    if (!sendHTTPRequest(url)) {
+        return false;
+    }
+    uploadQueue->acknowledge(sequence, reader);
+    
+    if (DEBUG_MODE) {
+        Serial.println("✓ Sent buffered reading #" + String(entry.sequence));
+    }
+    return true;
+}
+
+bool GSMModule::readNetworkTime(uint32_t& epoch) {
+    // +CCLK: "yy/MM/dd,hh:mm:ss+zz"
+    String response = sendATCommandWithResponse("AT+CCLK?", 5000);
+    int start = response.indexOf("+CCLK: \"");
+    if (start < 0) {
+        return false;
+    }
+    
+    if (!parseModemClock(response.c_str() + start + 8, epoch)) {
+        return false;
+    }
+    
+    // An unsynchronised RTC restarts at its 2004 (or 2000) default
+    if (epoch < WallClock::MIN_VALID_EPOCH) {
+        return false;
+    }
+    
+    wallClock.syncNetwork(epoch, monoMillis());
+    return true;
+}
+
+void GSMModule::attachRTC(RTCDevice* rtc) {
+    wallClock.attachRTC(rtc);
+    if (wallClock.begin(monoMillis()) && DEBUG_MODE) {
+        Serial.println("Clock set from RTC: " + getTimestamp());
+    }
+}
+
+void GSMModule::serviceClock() {
+    if (!moduleReady) {
+        return;
+    }
+    uint64_t now = monoMillis();
+    bool synced = wallClock.source() == WallClock::SOURCE_NETWORK;
+    if (synced && wallClock.sinceSync(now) < CLOCK_SYNC_INTERVAL) {
+        return;
+    }
+    // A failing read (no network time, modem RTC back at its default) is
+    // retried at this pace whether or not the clock was ever synced
+    if (lastClockAttempt != 0 && now - lastClockAttempt < CLOCK_SYNC_RETRY) {
+        return;
+    }
+    lastClockAttempt = now;
+    
+    uint32_t epoch;
+    if (readNetworkTime(epoch) && DEBUG_MODE) {
+        const WallClock::DriftStats& drift = wallClock.drift();
+        Serial.println("Clock synced: " + getTimestamp() + " (offset " + String(drift.lastOffset) + " ms)");
+    }
+}
+
+const WallClock& GSMModule::getWallClock() {
+    return wallClock;
+}
+
+// Enhanced SMS Functions
+bool GSMModule::sendSMS(const String& number, const String& message) {
+    return queueSMS(number, message, SMS_PRIORITY_COMMAND_REPLY);
+}
+
+bool GSMModule::queueSMS(const String& number, const String& message, SMSPriority priority, const String& coalesceKey) {
+    uint64_t now = monoMillis();
+    
+    if (coalesceKey.length() > 0) {
+        for (int i = 0; i < MAX_OUTBOUND_SMS; i++) {
+            OutboundSMS& queued = outbox[i];
+            if (queued.used && queued.deliveryId < 0 && queued.coalesceKey == coalesceKey && queued.number == number) {
+                // Keep the queue position, send the latest text
+                queued.message = message;
+                queued.merged++;
+                if (priority < queued.priority) queued.priority = priority;
+                if (DEBUG_MODE) {
+                    Serial.println("SMS merged into queued " + coalesceKey + " (" + String(queued.merged) + " repeats)");
+                }
+                return true;
+            }
+        }
+    }
+    
+    int slot = -1;
+    for (int i = 0; i < MAX_OUTBOUND_SMS && slot < 0; i++) {
+        if (!outbox[i].used) slot = i;
+    }
+    
+    if (slot < 0) {
+        // Full: make room by evicting the newest message of the lowest priority
+        for (int i = 0; i < MAX_OUTBOUND_SMS; i++) {
+            if (slot < 0 || outbox[i].priority > outbox[slot].priority ||
+                (outbox[i].priority == outbox[slot].priority && outbox[i].queuedAt > outbox[slot].queuedAt)) {
+                slot = i;
+            }
+        }
+        if (outbox[slot].priority <= priority) {
+            logError("SMS queue full, message to " + number + " dropped");
+            return false;
+        }
+        logError("SMS queue full, dropped queued message to " + outbox[slot].number);
+        outboxCount--;
+    }
+    
+    OutboundSMS& entry = outbox[slot];
+    entry.used = true;
+    entry.number = number;
+    entry.message = message;
+    entry.coalesceKey = coalesceKey;
+    entry.priority = priority;
+    entry.merged = 0;
+    entry.attempts = 0;
+    entry.redeliveries = 0;
+    entry.deliveryId = -1;
+    entry.queuedAt = now;
+    entry.notBefore = now;
+    outboxCount++;
+    
+    if (DEBUG_MODE) {
+        Serial.println("SMS queued for " + number + " (" + String(countSMSSegments(message)) + " segment(s))");
+    }
+    
+    if (coalesceKey.length() > 0) {
+        for (int i = 0; i < MAX_RECENT_ALERTS; i++) {
+            const RecentAlert& recent = recentAlerts[i];
+            if (recent.sentAt != 0 && recent.key == coalesceKey && recent.number == number &&
+                now - recent.sentAt < SMS_COALESCE_WINDOW) {
+                entry.notBefore = recent.sentAt + SMS_COALESCE_WINDOW;
+                if (DEBUG_MODE) {
+                    Serial.println("SMS " + coalesceKey + " held for the coalescing window");
+                }
+                break;
+            }
+        }
+    }
+    
+    return true;
+}
+
+int GSMModule::getQueuedSMSCount() {
+    int count = outboxCount;
+    for (int i = 0; i < MAX_OUTBOUND_SMS; i++) {
+        if (outbox[i].used && outbox[i].deliveryId >= 0) {
+            count--;
+        }
+    }
+    return count;
+}
+
+const DeliveryTracker& GSMModule::getDeliveryTracker() {
+    return smsDelivery;
+}
+
+void GSMModule::processOutgoingSMS() {
+    serviceDeliveryReports();
+    
+    // Messages queued during bring-up wait until the modem is registered
+    if (outboxCount == 0 || bringUpState != BRINGUP_READY) {
+        return;
+    }
+    
+    uint64_t now = monoMillis();
+    if (now < nextSMSAllowedAt) {
+        return;
+    }
+    
+    // Highest priority first, oldest first within a priority
+    int next = -1;
+    for (int i = 0; i < MAX_OUTBOUND_SMS; i++) {
+        const OutboundSMS& entry = outbox[i];
+        if (!entry.used || entry.deliveryId >= 0 || now < entry.notBefore) {
+            continue;
+        }
+        if (next < 0 || entry.priority < outbox[next].priority ||
+            (entry.priority == outbox[next].priority && entry.queuedAt < outbox[next].queuedAt)) {
+            next = i;
+        }
+    }
+    if (next < 0) {
+        return;
+    }
+    
+    OutboundSMS& entry = outbox[next];
+    String message = entry.message;
+    if (entry.merged > 0) {
+        message += "\n(+" + String(entry.merged) + " repeat" + (entry.merged > 1 ? "s" : "") + " merged)";
+    }
+    
+    int deliveryId = SMS_DELIVERY_REPORTS ? smsDelivery.begin(entry.number.c_str(), millis()) : -1;
+    bool sent = transmitSMS(entry.number, message, deliveryId);
+    nextSMSAllowedAt = monoMillis() + SMS_MIN_INTERVAL;
+    
+    if (sent) {
+        if (entry.coalesceKey.length() > 0) {
+            rememberAlert(entry.coalesceKey, entry.number);
+        }
+        // Alerts stay queued until the report confirms them; the rest are
+        // only tracked for the delivery statistics
+        if (deliveryId >= 0 && entry.priority <= SMS_PRIORITY_THRESHOLD_ALERT) {
+            entry.deliveryId = deliveryId;
+            return;
+        }
+    } else {
+        smsDelivery.release(deliveryId);
+        entry.attempts++;
+        if (entry.attempts < SMS_RETRY_COUNT) {
+            entry.notBefore = monoMillis() + (uint64_t)entry.attempts * SMS_MIN_INTERVAL;
+            return;
+        }
+        logError("SMS to " + entry.number + " dropped after " + String(entry.attempts) + " attempts");
+    }
+    
+    releaseOutbound(next);
+}
+
+void GSMModule::releaseOutbound(int index) {
+    OutboundSMS& entry = outbox[index];
+    entry.used = false;
+    entry.deliveryId = -1;
+    entry.number = "";
+    entry.message = "";
+    entry.coalesceKey = "";
+    outboxCount--;
+}
+
+void GSMModule::handleStatusReport(uint8_t reference, uint8_t status) {
+    int id = smsDelivery.report(reference, status, millis());
+    if (id >= 0 && DEBUG_MODE) {
+        Serial.println("SMS to " + String(smsDelivery.number(id)) + ": status report " + String(status) +
+                       " after " + String(smsDelivery.latency(id) / 1000) + " s");
+    }
+}
+
+void GSMModule::serviceDeliveryReports() {
+    int id;
+    while ((id = smsDelivery.nextSettled(millis())) >= 0) {
+        DeliveryTracker::State state = smsDelivery.state(id);
+        int index = -1;
+        for (int i = 0; i < MAX_OUTBOUND_SMS && index < 0; i++) {
+            if (outbox[i].used && outbox[i].deliveryId == id) {
+                index = i;
+            }
+        }
+        
+        // Only the recipient whose SMS centre reported that it gave up for now
+        // hears it again. No report at all says nothing: some centres and
+        // networks never send one, so an expired alert is not sent twice.
+        if (index >= 0 && state == DeliveryTracker::STATE_EXPIRED) {
+            logError("SMS to " + outbox[index].number + " not confirmed within the report timeout");
+        } else if (index >= 0 && state == DeliveryTracker::STATE_FAILED) {
+            OutboundSMS& entry = outbox[index];
+            bool temporary = DeliveryTracker::isTemporary(smsDelivery.status(id));
+            if (temporary && entry.redeliveries < SMS_REDELIVERY_COUNT) {
+                entry.redeliveries++;
+                entry.attempts = 0;
+                entry.deliveryId = -1;
+                entry.notBefore = monoMillis();
+                logError("SMS to " + entry.number + " not delivered, sending again");
+                index = -1;
+            } else {
+                logError("SMS to " + entry.number + " not delivered (status " + String(smsDelivery.status(id)) + ")");
+            }
+        }
+        if (index >= 0) {
+            releaseOutbound(index);
+        }
+        smsDelivery.release(id);
+    }
+}
+
+void GSMModule::rememberAlert(const String& key, const String& number) {
+    // Reuse the slot for this key, else the oldest one
+    int slot = 0;
+    for (int i = 0; i < MAX_RECENT_ALERTS; i++) {
+        if (recentAlerts[i].key == key && recentAlerts[i].number == number) {
+            slot = i;
+            break;
+        }
+        if (recentAlerts[i].sentAt < recentAlerts[slot].sentAt) {
+            slot = i;
+        }
+    }
+    recentAlerts[slot].key = key;
+    recentAlerts[slot].number = number;
+    recentAlerts[slot].sentAt = monoMillis();
+}
+
+bool GSMModule::transmitSMS(const String& number, const String& message, int deliveryId) {
+    if (!smsReady) {
+        if (DEBUG_MODE) {
+            Serial.println("SMS not ready - checking module status...");
+        }
+        checkModuleStatus();
+        if (!smsReady) {
+            return false;
+        }
+    }
+    
+    if (!smsComposer.compose(message.c_str())) {
+        logError("SMS to " + number + " truncated to " + String(smsComposer.segmentCount()) + " segments");
+    }
+    
+    if (DEBUG_MODE) {
+        Serial.print("Sending SMS to ");
+        Serial.print(number);
+        Serial.print(" (");
+        Serial.print(smsComposer.segmentCount());
+        Serial.print(" segment(s), ");
+        Serial.print(smsComposer.septetCount());
+        Serial.println(" septets)...");
+    }
+    
+    if (smsComposer.needsPDU()) {
+        return transmitSMSPDU(number, deliveryId);
+    }
+    
+    clearSerialBuffer();
+    
+    String cmd = "AT+CMGS=\"" + number + "\"";
+    bool success = sendATCommand(cmd, ">", 15000);
+    
+    if (!success) {
+        if (DEBUG_MODE) {
+            Serial.println("✗ Failed to set SMS recipient");
+        }
+        smsFailedCount++;
+        return false;
+    }
+    
+    atParser.setExpected("+CMGS:");
+    unsigned long startTime = millis();
+    gsmSerial->print(smsComposer.text());
+    gsmSerial->write(26);
+    
+    while (millis() - startTime < 30000) {
+        while (gsmSerial->available()) {
+            ATResponseParser::Token token = atParser.feed((char)gsmSerial->read());
+            
+            if (token == ATResponseParser::TOKEN_CMGS) {
+                noteCommand("CMGS body", token, true, startTime);
+                if (deliveryId >= 0) {
+                    smsDelivery.addPart(deliveryId, (uint8_t)atoi(atParser.line() + 6));
+                }
+                if (DEBUG_MODE) {
+                    Serial.println("✓ SMS sent successfully");
+                }
+                smsSentCount++;
+                return true;
+            }
+            
+            if (ATResponseParser::isError(token)) {
+                noteCommand("CMGS body", token, false, startTime);
+                if (DEBUG_MODE) {
+                    Serial.println("✗ SMS failed with error");
+                }
+                lastError = "SMS send failed: " + String(atParser.line());
+                smsFailedCount++;
+                return false;
+            }
+        }
+        delay(100);
+    }
+    
+    noteCommand("CMGS body", ATResponseParser::TOKEN_NONE, false, startTime);
+    if (DEBUG_MODE) {
+        Serial.println("✗ SMS timeout");
+    }
+    smsFailedCount++;
+    return false;
+}
+
+bool GSMModule::transmitSMSPDU(const String& number, int deliveryId) {
+    clearSerialBuffer();
+    
+    // In PDU mode a +CMT would arrive as hex, so park incoming messages on
+    // the SIM (+CMTI) until text mode is back; status reports keep coming
+    bool success = sendATCommand("AT+CNMI=1,1,0,1,0", "OK", 5000) &&
+                   sendATCommand("AT+CMGF=0", "OK", 5000);
+    
+    char hex[SMSComposer::MAX_PDU_HEX];
+    uint8_t reference = smsReference++;
+    
+    for (size_t part = 0; success && part < smsComposer.segmentCount(); part++) {
+        size_t length = smsComposer.buildPDU(part, number.c_str(), reference, hex, sizeof(hex), SMS_DELIVERY_REPORTS);
+        if (length == 0) {
+            logError("Cannot encode SMS for " + number);
+            success = false;
+            break;
+        }
+        
+        if (!sendATCommand("AT+CMGS=" + String(length), ">", 15000)) {
+            success = false;
+            break;
+        }
+        
+        atParser.setExpected("+CMGS:");
+        unsigned long startedAt = millis();
+        gsmSerial->print(hex);
+        gsmSerial->write(26);
+        
+        ATResponseParser::Token token = waitForToken(60000);
+        noteCommand("CMGS body", token, token == ATResponseParser::TOKEN_CMGS, startedAt);
+        if (token != ATResponseParser::TOKEN_CMGS) {
+            lastError = "SMS part " + String(part + 1) + " failed: " + String(atParser.line());
+            success = false;
+        } else if (deliveryId >= 0) {
+            smsDelivery.addPart(deliveryId, (uint8_t)atoi(atParser.line() + 6));
+        }
+    }
+    
+    sendATCommand("AT+CMGF=1", "OK", 5000);
+    sendATCommand("AT+CNMI=1,2,0,1,0", "OK", 5000);
+    
+    if (success) {
+        if (DEBUG_MODE) {
+            Serial.println("✓ SMS sent successfully");
+        }
+        smsSentCount++;
+    } else {
+        if (DEBUG_MODE) {
+            Serial.println("✗ SMS failed");
+        }
+        smsFailedCount++;
+    }
+    return success;
+}
+
+int GSMModule::countSMSSegments(const String& message) {
+    smsComposer.compose(message.c_str());
+    return smsComposer.segmentCount();
+}
+
+bool GSMModule::sendHTTPRequest(const String& url, const String& data) {
+    if (data.length() > 0) {
+        return sendHTTPPost(url, data.c_str(), data.length(), "application/x-www-form-urlencoded");
+    }
+    
+    if (!openHTTPSession()) {
+        return false;
+    }
+    
+    // Per request only the URL (and body) change; CID and content type persist
+    String urlCmd = "AT+HTTPPARA=\"URL\",\"" + url + "\"";
+    if (!sendATCommand(urlCmd, "OK", 10000)) {
+        closeHTTPSession();
+        return false;
+    }
+    
+    int status = performHTTPAction(0, HTTP_TIMEOUT);
+    return status >= 200 && status < 300;
+}
+
+bool GSMModule::sendHTTPPost(const String& url, const char* body, size_t length, const String& contentType) {
+    if (!beginHTTPPost(url, length, contentType)) {
+        return false;
+    }
+    gsmSerial->write(reinterpret_cast<const uint8_t*>(body), length);
+    return finishHTTPPost(length);
+}
+
+bool GSMModule::beginHTTPPost(const String& url, size_t length, const String& contentType) {
+    lastHTTPResponse = "";
+    if (!openHTTPSession()) {
+        return false;
+    }
+    
+    String urlCmd = "AT+HTTPPARA=\"URL\",\"" + url + "\"";
+    if (!sendATCommand(urlCmd, "OK", 10000)) {
+        closeHTTPSession();
+        return false;
+    }
+    
+    if (!setHTTPContentType(contentType)) {
+        return false;
     }
-    bufferDataForLater(data);
-    return false;
+    
+    // Input window: the body's time on the wire at 10 bits a byte, plus margin
+    unsigned long inputTime = (unsigned long)(length * 10000ULL / uartBaud) + 5000;
+    if (inputTime > 120000) {
+        inputTime = 120000;
+    }
+    String dataCmd = "AT+HTTPDATA=" + String(length) + "," + String(inputTime);
+    if (!sendATCommand(dataCmd, "DOWNLOAD", 15000)) {
+        closeHTTPSession();
+        return false;
+    }
+    return true;
 }
 
-bool GSMModule::bufferDataForLater(const String& data) {
-    if (bufferedCount < MAX_BUFFERED_ENTRIES) {
-        bufferedData[bufferedCount] = data;
-        bufferedCount++;
-        
-        if (DEBUG_MODE) {
-            Serial.print("Data buffered (");
-            Serial.print(bufferedCount);
-            Serial.print("/");
-            Serial.print(MAX_BUFFERED_ENTRIES);
-            Serial.println(")");
-        }
+bool GSMModule::finishHTTPPost(size_t length) {
+    // The module answers OK as soon as it has the declared number of bytes
+    if (!waitForResponse("OK", length + 10000, "HTTPDATA body")) {
+        closeHTTPSession();
+        return false;
+    }
+    
+    // ThingSpeak answers a bulk update with 202 Accepted
+    int status = performHTTPAction(1, HTTP_TIMEOUT);
+    return status >= 200 && status < 300;
+}
+
+bool GSMModule::openHTTPSession() {
+    if (!ensureGPRS()) {
+        return false;
+    }
+    
+    if (httpSessionOpen) {
         return true;
     }
     
-    if (DEBUG_MODE) {
-        Serial.println("Buffer full, discarding oldest data");
+    if (!sendATCommand("AT+HTTPINIT", "OK", 10000)) {
+        // A session left over from before a reset makes HTTPINIT fail; clear it once
+        sendATCommand("AT+HTTPTERM", "OK", 5000);
+        if (!sendATCommand("AT+HTTPINIT", "OK", 10000)) {
+            logError("HTTP service could not be started");
+            return false;
+        }
     }
     
-    for (int i = 0; i < MAX_BUFFERED_ENTRIES - 1; i++) {
-        bufferedData[i] = bufferedData[i + 1];
+    if (!sendATCommand("AT+HTTPPARA=\"CID\",1", "OK", 5000)) {
+        sendATCommand("AT+HTTPTERM", "OK", 5000);
+        return false;
     }
-    bufferedData[MAX_BUFFERED_ENTRIES - 1] = data;
     
+    httpSessionOpen = true;
+    httpContentType = "";
+    
+    if (DEBUG_MODE) {
+        Serial.println("HTTP session opened");
+    }
     return true;
 }
 
-bool GSMModule::sendBufferedData() {
-    if (bufferedCount == 0) return true;
-    
-    if (!gprsConnected) {
-        if (!setupGPRS()) {
-            return false;
-        }
+void GSMModule::closeHTTPSession() {
+    if (httpSessionOpen) {
+        sendATCommand("AT+HTTPTERM", "OK", 5000);
+    }
+    httpSessionOpen = false;
+    httpContentType = "";
+}
+
+bool GSMModule::setHTTPContentType(const String& contentType) {
+    if (httpContentType == contentType) {
+        return true;
     }
     
-    if (DEBUG_MODE) {
-        Serial.print("Sending ");
-        Serial.print(bufferedCount);
-        Serial.println(" buffered entries");
+    if (!sendATCommand("AT+HTTPPARA=\"CONTENT\",\"" + contentType + "\"", "OK", 5000)) {
+        closeHTTPSession();
+        return false;
+    }
+    httpContentType = contentType;
+    return true;
+}
+
+int GSMModule::getLastHTTPStatus() {
+    return lastHTTPStatus;
+}
+
+int GSMModule::performHTTPAction(int method, unsigned long timeout) {
+    lastHTTPResponse = "";
+    
+    // OK comes back at once; the status arrives later as a +HTTPACTION URC
+    if (!sendATCommand("AT+HTTPACTION=" + String(method), "+HTTPACTION:", timeout)) {
+        lastHTTPStatus = -1;
+        closeHTTPSession();
+        return -1;
     }
     
-    int sent = 0;
-    for (int i = 0; i < bufferedCount; i++) {
-        if (sendHTTPRequest(bufferedData[i])) {
-            sent++;
-        } else {
-            break;
+    // +HTTPACTION: <method>,<status>,<length>
+    const char* line = atParser.line();
+    const char* comma = strchr(line, ',');
+    lastHTTPStatus = comma != nullptr ? atoi(comma + 1) : -1;
+    const char* lengthField = comma != nullptr ? strchr(comma + 1, ',') : nullptr;
+    lastHTTPResponseLength = lengthField != nullptr ? atoi(lengthField + 1) : 0;
+    
+    if (lastHTTPStatus >= 600) {
+        // 6xx are module-side network/DNS/stack errors: rebuild on next use
+        logError("HTTP action failed with status " + String(lastHTTPStatus));
+        closeHTTPSession();
+        if (lastHTTPStatus == 601) {
+            markGPRSLost();
+        }
+    } else {
+        if ((lastHTTPStatus < 200 || lastHTTPStatus >= 300) && DEBUG_MODE) {
+            Serial.println("HTTP status " + String(lastHTTPStatus));
+        }
+        // Short bodies may carry directives for the upload schedule
+        if (lastHTTPResponseLength > 0 && lastHTTPResponseLength <= HTTP_RESPONSE_MAX) {
+            String response = sendATCommandWithResponse("AT+HTTPREAD", 5000);
+            int start = response.indexOf("+HTTPREAD:");
+            int body = start >= 0 ? response.indexOf("\r\n", start) : -1;
+            if (body >= 0) {
+                lastHTTPResponse = response.substring(body + 2);
+            }
         }
-        delay(1000);
     }
     
-    if (sent > 0) {
-        for (int i = sent; i < bufferedCount; i++) {
-            bufferedData[i - sent] = bufferedData[i];
+    return lastHTTPStatus;
+}
+
+bool GSMModule::openTCP(const char* host, uint16_t port) {
+    if (!tcpStackReady) {
+        struct TCPCommand {
+            const char* command;
+            const char* expected;
+            unsigned long timeout;
+        };
+        
+        TCPCommand tcpCommands[] = {
+            {"AT+CIPSHUT", "SHUT OK", 65000},
+            {"AT+CIPMUX=0", "OK", 5000},
+            {"AT+CIPRXGET=1", "OK", 5000},
+            {"AT+CSTT=\"" GSM_APN "\",\"" GSM_USERNAME "\",\"" GSM_PASSWORD "\"", "OK", 5000},
+            {"AT+CIICR", "OK", 85000}
+        };
+        
+        for (const auto& cmd : tcpCommands) {
+            if (!sendATCommand(cmd.command, cmd.expected, cmd.timeout)) {
+                logError("TCP stack setup failed: " + String(cmd.command));
+                return false;
+            }
         }
-        bufferedCount -= sent;
         
+        // CIFSR answers with the bare address and no OK, but must be issued
+        // before the stack accepts CIPSTART
+        String address = sendATCommandWithResponse("AT+CIFSR", 2000);
         if (DEBUG_MODE) {
-            Serial.print("✓ Sent ");
-            Serial.print(sent);
-            Serial.println(" buffered entries");
+            Serial.println("TCP stack up, address " + address);
         }
+        tcpStackReady = true;
+    }
+    
+    String startCmd = "AT+CIPSTART=\"TCP\",\"" + String(host) + "\",\"" + String(port) + "\"";
+    if (!sendATCommand(startCmd, "CONNECT", 75000) || strcmp(atParser.line(), "CONNECT OK") != 0) {
+        // CONNECT FAIL or no answer: rebuild the stack next time
+        tcpStackReady = false;
+        return false;
     }
     
-    return (sent > 0);
+    tcpOpen = true;
+    tcpDataPending = false;
+    return true;
 }
 
-// Enhanced SMS Functions
-bool GSMModule::sendSMS(const String& number, const String& message) {
-    if (!smsReady) {
-        if (DEBUG_MODE) {
-            Serial.println("SMS not ready - checking module status...");
+void GSMModule::closeTCP() {
+    if (tcpOpen) {
+        sendATCommand("AT+CIPCLOSE=1", "CLOSE OK", 5000);
+    }
+    tcpOpen = false;
+    tcpDataPending = false;
+    mqtt.reset();
+}
+
+void GSMModule::markTCPClosed() {
+    tcpOpen = false;
+    tcpDataPending = false;
+    mqtt.reset();
+    mqttLink.linkLost(millis());
+}
+
+bool GSMModule::sendTCP(const uint8_t* head, size_t headLength, const uint8_t* body, size_t bodyLength) {
+    if (!tcpOpen) {
+        return false;
+    }
+    
+    // Header and body go out as one stream, split only at the CIPSEND limit
+    size_t total = headLength + bodyLength;
+    size_t offset = 0;
+    while (offset < total) {
+        size_t chunk = total - offset < TCP_SEND_CHUNK ? total - offset : TCP_SEND_CHUNK;
+        if (!sendATCommand("AT+CIPSEND=" + String(chunk), ">", 5000)) {
+            return false;
         }
-        checkModuleStatus();
-        if (!smsReady) {
+        
+        size_t end = offset + chunk;
+        if (offset < headLength) {
+            size_t n = (end < headLength ? end : headLength) - offset;
+            gsmSerial->write(head + offset, n);
+            offset += n;
+        }
+        if (offset < end) {
+            gsmSerial->write(body + (offset - headLength), end - offset);
+            offset = end;
+        }
+        
+        unsigned long startedAt = millis();
+        bool answered = waitForResponse("SEND ", 10000 + chunk);
+        bool sent = answered && strcmp(atParser.line(), "SEND OK") == 0;
+        noteCommand("CIPSEND body", answered ? ATResponseParser::TOKEN_ERROR : ATResponseParser::TOKEN_NONE, sent, startedAt);
+        if (!sent) {
+            logError("TCP send failed");
             return false;
         }
     }
-    
-    unsigned long currentTime = millis();
-    if (currentTime - lastSMSTime < 10000) {
-        if (DEBUG_MODE) {
-            Serial.println("SMS rate limited - waiting...");
-        }
-        delay(10000 - (currentTime - lastSMSTime));
+    return true;
+}
+
+size_t GSMModule::receiveTCP() {
+    tcpRxLength = 0;
+    tcpDataPending = false;
+    if (!sendATCommand("AT+CIPRXGET=3," + String(TCP_RX_CHUNK), "OK", 5000)) {
+        return 0;
+    }
+    return tcpRxLength;
+}
+
+void GSMModule::decodeTCPData(const char* hex) {
+    tcpRxLength = 0;
+    for (const char* p = hex; p[0] != '\0' && p[1] != '\0' && tcpRxLength < TCP_RX_CHUNK; p += 2) {
+        char pair[3] = {p[0], p[1], '\0'};
+        tcpRxBuffer[tcpRxLength++] = (uint8_t)strtoul(pair, nullptr, 16);
+    }
+}
+
+bool GSMModule::onMQTTWrite(const uint8_t* head, size_t headLength, const uint8_t* body, size_t bodyLength, void* context) {
+    return static_cast<GSMModule*>(context)->sendTCP(head, headLength, body, bodyLength);
+}
+
+void GSMModule::onMQTTMessage(const char* topic, size_t topicLength, const uint8_t* payload, size_t payloadLength, void* context) {
+    GSMModule* self = static_cast<GSMModule*>(context);
+    
+    // Only the command topic is subscribed; run it from serviceMQTT(), not
+    // from inside the packet decoder
+    String command;
+    command.reserve(payloadLength);
+    for (size_t i = 0; i < payloadLength; i++) {
+        command += (char)payload[i];
+    }
+    self->mqttCommand = command;
+}
+
+bool GSMModule::ensureMQTT() {
+    if (tcpOpen && mqtt.connected()) {
+        return true;
+    }
+    if (!mqttLink.shouldAttempt(millis())) {
+        return false;
     }
     
     if (DEBUG_MODE) {
-        Serial.print("Sending SMS to ");
-        Serial.print(number);
-        Serial.println("...");
+        Serial.println("Connecting to MQTT broker " MQTT_BROKER_HOST "...");
     }
     
-    clearSerialBuffer();
-    
-    String cmd = "AT+CMGS=\"" + number + "\"";
-    bool success = sendATCommand(cmd, ">", 15000);
+    bool connected = openTCP(MQTT_BROKER_HOST, MQTT_BROKER_PORT) &&
+                     mqtt.connect(DEVICE_ID, MQTT_KEEPALIVE, MQTT_USERNAME, MQTT_PASSWORD, millis()) &&
+                     waitForMQTT(0, MQTT_ACK_TIMEOUT);
     
-    if (!success) {
+    if (connected) {
+        mqtt.subscribe(MQTT_COMMAND_TOPIC, 1);
+        mqttLink.attemptSucceeded(millis());
         if (DEBUG_MODE) {
-            Serial.println("✗ Failed to set SMS recipient");
+            Serial.println("✓ MQTT connected");
         }
-        smsFailedCount++;
-        return false;
+    } else {
+        if (mqtt.connectReturnCode() != 0) {
+            logError("MQTT broker refused connection, code " + String(mqtt.connectReturnCode()));
+        }
+        closeTCP();
+        mqttLink.attemptFailed(millis());
     }
-    
-    gsmSerial->print(message);
-    gsmSerial->write(26);
-    
+    return connected;
+}
+
+bool GSMModule::waitForMQTT(uint16_t packetId, unsigned long timeout) {
+    // packetId 0 waits for CONNACK, anything else for that PUBACK
     unsigned long startTime = millis();
-    String response;
     
-    while (millis() - startTime < 30000) {
-        while (gsmSerial->available()) {
-            char c = gsmSerial->read();
-            response += c;
-            
-            if (response.indexOf("+CMGS:") != -1) {
-                if (DEBUG_MODE) {
-                    Serial.println("✓ SMS sent successfully");
-                }
-                smsSentCount++;
-                lastSMSTime = millis();
-                return true;
-            }
-            
-            if (response.indexOf("ERROR") != -1) {
-                if (DEBUG_MODE) {
-                    Serial.println("✗ SMS failed with error");
-                }
-                smsFailedCount++;
-                return false;
+    while (millis() - startTime < timeout) {
+        if (tcpDataPending) {
+            size_t received = receiveTCP();
+            mqtt.feed(tcpRxBuffer, received, millis());
+        } else {
+            clearSerialBuffer();
+            if (!tcpDataPending) {
+                delay(20);
             }
         }
-        delay(100);
-    }
-    
-    if (DEBUG_MODE) {
-        Serial.println("✗ SMS timeout");
+        
+        if (!tcpOpen || mqtt.state() == MQTTSession::MQTT_DISCONNECTED) {
+            return false;
+        }
+        if (packetId == 0 ? mqtt.connected() : !mqtt.isPending(packetId)) {
+            return true;
+        }
     }
-    smsFailedCount++;
     return false;
 }
 
-bool GSMModule::sendHTTPRequest(const String& url, const String& data) {
-    if (!gprsConnected) {
-        if (!setupGPRS()) {
-            return false;
-        }
+bool GSMModule::publishMQTT(const char* topic, const uint8_t* payload, size_t length) {
+    if (!ensureMQTT()) {
+        return false;
     }
     
-    if (!sendATCommand("AT+HTTPINIT", "OK", 10000)) {
-        return false;
+    unsigned long startTime = millis();
+    uint16_t packetId = 0;
+    if (mqtt.publish(topic, payload, length, 1, &packetId) && waitForMQTT(packetId, MQTT_ACK_TIMEOUT)) {
+        if (DEBUG_MODE) {
+            Serial.println("✓ MQTT publish of " + String(length) + " bytes acknowledged in " +
+                           String(millis() - startTime) + " ms");
+        }
+        return true;
     }
     
-    sendATCommand("AT+HTTPPARA=\"CID\",1", "OK", 5000);
+    // No PUBACK: the socket is most likely half-open, so start over after a backoff
+    logError("MQTT publish not acknowledged");
+    closeTCP();
+    mqttLink.attemptFailed(millis());
+    return false;
+}
+
+void GSMModule::serviceMQTT() {
+    if (!ENABLE_MQTT) {
+        return;
+    }
     
-    String urlCmd = "AT+HTTPPARA=\"URL\",\"" + url + "\"";
-    if (!sendATCommand(urlCmd, "OK", 10000)) {
-        sendATCommand("AT+HTTPTERM", "OK", 5000);
-        return false;
+    // Stay subscribed between uploads; the supervisor paces reconnects
+    if (!tcpOpen) {
+        if (moduleReady && mqttLink.shouldAttempt(millis())) {
+            ensureMQTT();
+        }
+        return;
     }
     
-    bool success = false;
+    if (tcpDataPending) {
+        size_t received = receiveTCP();
+        mqtt.feed(tcpRxBuffer, received, millis());
+    }
     
-    if (data.length() > 0) {
-        sendATCommand("AT+HTTPPARA=\"CONTENT\",\"application/x-www-form-urlencoded\"", "OK", 5000);
-        String dataCmd = "AT+HTTPDATA=" + String(data.length()) + ",10000";
-        
-        if (sendATCommand(dataCmd, "DOWNLOAD", 15000)) {
-            gsmSerial->print(data);
-            delay(2000);
-            
-            success = sendATCommand("AT+HTTPACTION=1", "+HTTPACTION: 1,200", 30000);
-        }
-    } else {
-        success = sendATCommand("AT+HTTPACTION=0", "+HTTPACTION: 0,200", 30000);
+    mqtt.loop(millis());
+    if (!mqtt.connected()) {
+        logError("MQTT connection lost");
+        closeTCP();
+        mqttLink.linkLost(millis());
+        return;
     }
     
-    sendATCommand("AT+HTTPTERM", "OK", 5000);
-    return success;
+    if (mqttCommand.length() > 0) {
+        SMSCommand cmd = parseSMSCommand(mqttCommand, "mqtt");
+        mqttCommand = "";
+        String reply = cmd.isValid ? runCommand(cmd) : "Invalid command. Send 'HELP' for available commands.";
+        mqtt.publish(MQTT_REPLY_TOPIC, reinterpret_cast<const uint8_t*>(reply.c_str()), reply.length(), 0);
+    }
+}
+
+bool GSMModule::isMQTTConnected() {
+    return tcpOpen && mqtt.connected();
 }
 
 // Diagnostic Functions
@@ -599,7 +2458,7 @@ bool GSMModule::runFullDiagnostics() {
     // Test 1: Basic Communication
     if (DEBUG_MODE) Serial.print("1. Basic AT Communication... ");
     if (sendATCommand("AT", "OK", 5000)) {
-        if (DEBUG_MODE) Serial.println("✓ PASS");
+        if (DEBUG_MODE) Serial.println("✓ PASS (" + String(uartBaud) + " baud, " + String(uartBaud / 10) + " bytes/s)");
     } else {
         if (DEBUG_MODE) Serial.println("✗ FAIL");
         allPassed = false;
@@ -670,6 +2529,13 @@ bool GSMModule::testHTTPRequest() {
     return sendHTTPRequest(testUrl);
 }
 
+static String latencyBound(uint32_t bound) {
+    if (bound == UINT32_MAX) {
+        return ">" + String(ATCommandStats::BUCKET_LIMITS[ATCommandStats::BUCKET_COUNT - 2]) + " ms";
+    }
+    return "<=" + String(bound) + " ms";
+}
+
 void GSMModule::printDetailedStatus() {
     Serial.println("\\nGSM MODULE STATUS:");
     Serial.println("=====================");
@@ -678,11 +2544,83 @@ void GSMModule::printDetailedStatus() {
     Serial.println("Signal: " + getSignalQualityDescription());
     Serial.println("Operator: " + (operatorName.length() > 0 ? operatorName : "Unknown"));
     Serial.println("SMS Ready: " + String(smsReady ? "YES" : "NO"));
+    // 8N1 spends 10 bits per byte
+    Serial.println("Modem UART: " + String(uartBaud) + " baud, " + String(uartBaud / 10) + " bytes/s" +
+                   (fastBaudFailed ? " (fast rate failed)" : ""));
+    const WallClock::DriftStats& drift = wallClock.drift();
+    Serial.println("Clock: " + getTimestamp() + " UTC from " + WallClock::sourceName(wallClock.source()) + ", " +
+                   String(drift.syncs) + " syncs (" + String(drift.steps) + " steps), last offset " +
+                   String(drift.lastOffset) + " ms, max " + String(drift.maxOffset) + " ms, " + String(drift.ppm) +
+                   " ppm");
+    Serial.println("RTC: " + String(drift.rtcOffset) + " s off, trim " + String(drift.rtcTrim) + " (" +
+                   String(drift.rtcTrims) + " trims)");
     Serial.println("GPRS Connected: " + String(gprsConnected ? "YES" : "NO"));
+    Serial.println("GPRS Link: " + getLinkStatusDescription() + " (" + String(gprsLink.consecutiveFailures()) +
+                   " failures, breaker tripped " + String(gprsLink.circuitTrips()) + "x)");
     Serial.println("SMS Sent: " + String(smsSentCount));
     Serial.println("SMS Failed: " + String(smsFailedCount));
     Serial.println("SMS Received: " + String(smsReceivedCount));
-    Serial.println("Uptime: " + String((millis() - moduleStartTime) / 1000) + " seconds");
+    Serial.println("SMS Queued: " + String(getQueuedSMSCount()) + ", " + String(outboxCount - getQueuedSMSCount()) +
+                   " alerts awaiting delivery");
+    for (size_t i = 0; i < smsDelivery.recipientCount(); i++) {
+        const DeliveryTracker::Recipient& recipient = smsDelivery.recipient(i);
+        String latency = recipient.delivered > 0
+            ? " (avg " + String(recipient.totalLatency / recipient.delivered / 1000) + " s, max " +
+              String(recipient.maxLatency / 1000) + " s)"
+            : String("");
+        Serial.println("SMS to " + String(recipient.number) + ": " + String(recipient.delivered) + " delivered" +
+                       latency + ", " + String(recipient.failed) + " failed, " + String(recipient.expired) +
+                       " unconfirmed");
+    }
+    if (uploadQueue != nullptr) {
+        Serial.println("Upload Queue: " + String(uploadQueue->pending()) + " pending, " +
+                       String(uploadQueue->droppedCount()) + " dropped" +
+                       (uploadQueue == &ramQueue ? " (RAM)" : ""));
+    }
+    Serial.println("Upload Window: every " + String(uploadSchedule.interval() / 1000) + " s, phase " +
+                   String(uploadSchedule.phase() / 1000) + " s, next in " + String(getNextUploadIn() / 1000) + " s");
+    String deferred;
+    String sent;
+    for (int b = 0; b <= 5; b++) {
+        deferred += (b > 0 ? "/" : "") + String(signalStats.deferred[b]);
+        sent += (b > 0 ? "/" : "") + String(signalStats.sent[b]);
+    }
+    Serial.println("Uploads by signal 0-5: sent " + sent + ", put off " + deferred);
+    for (size_t i = 0; i < commandStats.count(); i++) {
+        const ATCommandStats::Entry& entry = commandStats.entry(i);
+        Serial.println("AT " + String(entry.name) + ": " + String(entry.outcomes[ATCommandStats::OUTCOME_OK]) +
+                       " ok, " + String(entry.outcomes[ATCommandStats::OUTCOME_ERROR]) + " error, " +
+                       String(entry.outcomes[ATCommandStats::OUTCOME_TIMEOUT]) + " timeout, p50 " +
+                       latencyBound(ATCommandStats::percentile(entry, 50)) + ", p95 " +
+                       latencyBound(ATCommandStats::percentile(entry, 95)) + ", max " +
+                       String(entry.maxLatency) + " ms");
+    }
+    for (int i = 0; i < uploadBackendCount; i++) {
+        UploadBackendStatus backend = getUploadBackendStatus(i);
+        String health = LinkSupervisor::stateName(backend.health);
+        if (backend.retryIn > 0) {
+            health += " " + String(backend.retryIn / 1000) + "s";
+        }
+        if (backend.heldFor > 0) {
+            health += ", held " + String(backend.heldFor / 1000) + "s by server";
+        }
+        Serial.println("Upload " + String(backend.name) + ": " + health + ", " + String(backend.pending) +
+                       " pending, " + String(backend.sentCount) + " sent, " + String(backend.failedCount) +
+                       " failed, next to " + backend.url);
+    }
+    if (ENABLE_MQTT) {
+        Serial.println("MQTT: " + String(isMQTTConnected() ? "CONNECTED" : "DISCONNECTED") + ", " +
+                       String(mqtt.bytesSent()) + " bytes sent, " + String(mqtt.bytesReceived()) + " received, " +
+                       String(mqtt.acknowledgedCount()) + " publishes acknowledged");
+    }
+    if (ENABLE_SLEEP_MODE) {
+        Serial.println("Modem Sleep: " + String(modemAsleep ? "ASLEEP" : "AWAKE") + ", awake " +
+                       String(getModemDutyCycle(), 1) + "% of uptime");
+        Serial.println("Modem Wakes: " + String(sleepStats.wakeCount) + " (" + String(sleepStats.ringWakes) +
+                       " by RI, " + String(sleepStats.wakeFailures) + " failed), latency last " +
+                       String(sleepStats.lastWakeLatency) + " ms, max " + String(sleepStats.maxWakeLatency) + " ms");
+    }
+    Serial.println("Uptime: " + String((unsigned long)((monoMillis() - moduleStartTime) / 1000)) + " seconds");
     if (lastError.length() > 0) {
         Serial.println("Last Error: " + lastError);
     }
@@ -691,9 +2629,22 @@ void GSMModule::printDetailedStatus() {
 
 // Helper Functions
 void GSMModule::clearSerialBuffer() {
+    // Stale bytes still go through the parser so pushed URCs are not lost
+    if (gsmSerial->available()) {
+        lastModemActivity = millis();
+    }
     while (gsmSerial->available()) {
-        gsmSerial->read();
+        atParser.feed((char)gsmSerial->read());
+    }
+}
+
+void GSMModule::prepareModemForCommand() {
+    // Bytes sent to a sleeping modem are lost, so wake it first
+    if (modemAsleep) {
+        wakeFromSleep();
     }
+    clearSerialBuffer();
+    lastModemActivity = millis();
 }
 
 String GSMModule::getSignalQualityDescription() {
@@ -792,23 +2743,19 @@ bool GSMModule::checkModuleStatus() {
     return moduleReady;
 }
 
-String GSMModule::extractSMSContent(const String& response) {
-    int contentStart = response.lastIndexOf('\n');
-    if (contentStart != -1) {
-        String content = response.substring(contentStart + 1);
-        content.trim();
-        return content;
-    }
-    return "";
-}
-
-String GSMModule::extractSMSSender(const String& response) {
-    int quote1 = response.indexOf('"');
-    if (quote1 != -1) {
-        int quote2 = response.indexOf('"', quote1 + 1);
-        if (quote2 != -1) {
-            return response.substring(quote1 + 1, quote2);
+String GSMModule::extractQuotedField(const char* line, int field) {
+    const char* p = line;
+    for (int i = 0; p != nullptr; i++) {
+        const char* open = strchr(p, '"');
+        if (open == nullptr) break;
+        const char* close = strchr(open + 1, '"');
+        if (close == nullptr) break;
+        if (i == field) {
+            String value(open + 1);
+            value.remove(close - open - 1);
+            return value;
         }
+        p = close + 1;
     }
     return "";
 }
@@ -834,8 +2781,7 @@ void GSMModule::resetCounters() {
     smsSentCount = 0;
     smsFailedCount = 0;
     smsReceivedCount = 0;
-    bufferedCount = 0;
-    moduleStartTime = millis();
+    moduleStartTime = monoMillis();
 }
 
 void GSMModule::logError(const String& error) {
@@ -850,7 +2796,9 @@ bool GSMModule::reconnectGPRS() {
         Serial.println("🔄 Reconnecting GPRS...");
     }
     
+    closeHTTPSession();
     sendATCommand("AT+SAPBR=0,1", "OK", 5000);
+    markGPRSLost();
     delay(2000);
     
     return setupGPRS();
@@ -861,6 +2809,10 @@ bool GSMModule::isGPRSConnected() {
     return response.indexOf("+SAPBR: 1,1") != -1;
 }
 
+bool GSMModule::isSMSReady() {
+    return smsReady;
+}
+
 GSMModule::ModuleStatus GSMModule::getStatus() {
     ModuleStatus status;
     status.moduleReady = moduleReady;
@@ -873,22 +2825,22 @@ GSMModule::ModuleStatus GSMModule::getStatus() {
     status.smsFailedCount = smsFailedCount;
     status.smsReceivedCount = smsReceivedCount;
     status.lastError = lastError;
-    status.uptime = millis() - moduleStartTime;
+    status.uptime = monoMillis() - moduleStartTime;
     status.ipAddress = ipAddress;
+    status.uartBaud = uartBaud;
     return status;
 }
 
-bool GSMModule::sendSMSToRecipients(const String message) {
-    bool anySuccess = false;
+bool GSMModule::sendSMSToRecipients(const String message, SMSPriority priority, const String& coalesceKey) {
+    bool anyQueued = false;
     
     for (int i = 0; i < SMS_RECIPIENT_COUNT; i++) {
-        if (sendSMS(SMS_RECIPIENTS[i], message)) {
-            anySuccess = true;
+        if (queueSMS(SMS_RECIPIENTS[i], message, priority, coalesceKey)) {
+            anyQueued = true;
         }
-        delay(3000);
     }
     
-    return anySuccess;
+    return anyQueued;
 }
 
 bool GSMModule::sendThresholdAlert(const String& tenant, const String& alertType, float value, float threshold) {
@@ -911,30 +2863,21 @@ bool GSMModule::sendThresholdAlert(const String& tenant, const String& alertType
         message += "Please reduce usage.";
     }
     
-    return sendSMSToRecipients(message);
+    return sendSMSToRecipients(message, SMS_PRIORITY_THRESHOLD_ALERT, "threshold:" + alertType + ":" + tenant);
 }
 
 bool GSMModule::sendDailyReport(float energyA, float costA, float energyB, float costB) {
     String date = getTimestamp().substring(0, 10);
     
-    String message = "DAILY ENERGY REPORT\n";
-    message += "Date: " + date + "\n\n";
-    message += "TENANT A:\n";
-    message += "  Energy: " + String(energyA, 1) + "kWh\n";
-    message += "  Cost: ₵" + String(costA, 2) + "\n\n";
-    message += "TENANT B:\n";
-    message += "  Energy: " + String(energyB, 1) + "kWh\n";
-    message += "  Cost: ₵" + String(costB, 2) + "\n\n";
-    
-    float totalEnergy = energyA + energyB;
-    float totalCost = costA + costB;
-    
-    message += "TOTAL:\n";
-    message += "  Energy: " + String(totalEnergy, 1) + "kWh\n";
-    message += "  Cost: ₵" + String(totalCost, 2) + "\n\n";
+    // Laid out to stay within one 160-character segment
+    String message = "DAILY REPORT " + date + "\n";
+    message += "A: " + String(energyA, 1) + "kWh ₵" + String(costA, 2) + "\n";
+    message += "B: " + String(energyB, 1) + "kWh ₵" + String(costB, 2) + "\n";
+    message += "Total: " + String(energyA + energyB, 1) + "kWh ₵" + String(costA + costB, 2) + "\n";
     message += "Monitor: bit.ly/energy-dashboard";
     
-    return sendSMSToRecipients(message);
+    // A newer report replaces one still waiting in the queue
+    return sendSMSToRecipients(message, SMS_PRIORITY_REPORT, "daily-report");
 }
 
 bool GSMModule::sendSystemAlert(const String& errorMessage) {
@@ -945,11 +2888,21 @@ bool GSMModule::sendSystemAlert(const String& errorMessage) {
     message += "Error: " + errorMessage + "\n";
     message += "Check device immediately.";
     
-    return sendSMSToRecipients(message);
+    return sendSMSToRecipients(message, SMS_PRIORITY_SYSTEM_ALERT, "system:" + errorMessage);
 }
 
 String GSMModule::getTimestamp() {
-    unsigned long seconds = millis() / 1000;
+    if (wallClock.valid()) {
+        CivilTime time;
+        epochToCivil(wallClock.epoch(monoMillis()), time);
+        char buffer[24];
+        snprintf(buffer, sizeof(buffer), "%02u/%02u/%04u %02u:%02u",
+                 time.day, time.month, time.year, time.hour, time.minute);
+        return String(buffer);
+    }
+    
+    // Not set yet: time since boot, dressed as a date
+    unsigned long seconds = (unsigned long)(monoMillis() / 1000);
     unsigned long minutes = seconds / 60;
     unsigned long hours = minutes / 60;
     unsigned long days = hours / 24;
@@ -968,17 +2921,120 @@ bool GSMModule::testSMSFunctionality(const String& testNumber) {
     }
     
     String testMessage = "SMS Test - " + getTimestamp();
-    return sendSMS(testNumber, testMessage);
+    return transmitSMS(testNumber, testMessage);
+}
+
+void IRAM_ATTR GSMModule::onRingIndicator() {
+    ringIndicated = true;
 }
 
 bool GSMModule::enterSleepMode() {
-    return sendATCommand("AT+CSCLK=1", "OK", 5000);
+    if (modemAsleep) {
+        return true;
+    }
+    
+    // Not saved by the modem, so set once per power cycle
+    if (!slowClockEnabled) {
+        if (!sendATCommand("AT+CSCLK=1", "OK", 5000)) {
+            return false;
+        }
+        slowClockEnabled = true;
+    }
+    
+    digitalWrite(GSM_DTR_PIN, HIGH);
+    modemAsleep = true;
+    sleepStartedAt = millis();
+    sleepStats.sleepCount++;
+    
+    if (DEBUG_MODE) {
+        Serial.println("Modem sleeping");
+    }
+    return true;
 }
 
 bool GSMModule::wakeFromSleep() {
-    gsmSerial->println("AT");
-    delay(1000);
-    return sendATCommand("AT+CSCLK=0", "OK", 5000);
+    if (!modemAsleep) {
+        return true;
+    }
+    
+    unsigned long start = millis();
+    digitalWrite(GSM_DTR_PIN, LOW);
+    modemAsleep = false;
+    sleepStats.asleepTime += start - sleepStartedAt;
+    delay(MODEM_WAKE_SETTLE_TIME);
+    
+    bool awake = false;
+    for (int attempt = 0; attempt < 5 && !awake; attempt++) {
+        awake = sendATCommand("AT", "OK", 500);
+    }
+    
+    unsigned long latency = millis() - start;
+    if (!awake) {
+        sleepStats.wakeFailures++;
+        logError("Modem did not answer after wake (" + String(latency) + " ms)");
+        return false;
+    }
+    
+    sleepStats.wakeCount++;
+    sleepStats.lastWakeLatency = latency;
+    sleepStats.totalWakeLatency += latency;
+    if (latency > sleepStats.maxWakeLatency) {
+        sleepStats.maxWakeLatency = latency;
+    }
+    
+    if (DEBUG_MODE) {
+        Serial.println("Modem awake after " + String(latency) + " ms");
+    }
+    return true;
+}
+
+void GSMModule::manageSleep() {
+    if (!ENABLE_SLEEP_MODE || !moduleReady || modemAsleep) {
+        return;
+    }
+    
+    unsigned long now = millis();
+    if (now - lastModemActivity < MODEM_SLEEP_IDLE_TIME) {
+        return;
+    }
+    
+    // Stay up for received messages still to be read and SMS about to go out;
+    // upload windows and later SMS wake the modem when they send their first command
+    if (pendingSMSCount > 0 || pendingHangup || tcpDataPending || outboundSMSDueSoon(monoMillis())) {
+        return;
+    }
+    
+    enterSleepMode();
+}
+
+bool GSMModule::outboundSMSDueSoon(uint64_t now) {
+    for (int i = 0; i < MAX_OUTBOUND_SMS; i++) {
+        if (outbox[i].used && outbox[i].deliveryId < 0 && outbox[i].notBefore < now + MODEM_SLEEP_IDLE_TIME) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool GSMModule::isModemAsleep() {
+    return modemAsleep;
+}
+
+GSMModule::SleepStats GSMModule::getSleepStats() {
+    SleepStats stats = sleepStats;
+    if (modemAsleep) {
+        stats.asleepTime += millis() - sleepStartedAt;
+    }
+    return stats;
+}
+
+float GSMModule::getModemDutyCycle() {
+    uint64_t uptime = monoMillis() - moduleStartTime;
+    if (uptime == 0) {
+        return 100.0f;
+    }
+    uint64_t asleep = getSleepStats().asleepTime;
+    return 100.0f * (float)(uptime - asleep) / (float)uptime;
 }
 
 bool GSMModule::setPowerSaveMode(bool enable) {
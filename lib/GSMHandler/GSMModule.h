@@ -4,15 +4,73 @@
 #include <HardwareSerial.h>
 #include <Arduino.h>
 #include "config.h"
+#include "ATResponseParser.h"
+#include "ATCommandStats.h"
+#include "TelemetryRecord.h"
+#include "UploadBatch.h"
+#include "SMSComposer.h"
+#include "DeliveryTracker.h"
+#include "WallClock.h"
+#include "MonoClock.h"
+#include "LinkSupervisor.h"
+#include "UploadScheduler.h"
+#include "MQTTSession.h"
+#include "UploadQueue.h"
+#include "RAMLogStorage.h"
+
+// The flash-backed queue needs LittleFS; host builds buffer in RAM
+#if ENABLE_OFFLINE_STORAGE && defined(ARDUINO)
+#define GSM_FLASH_QUEUE 1
+#include "LittleFSLogStorage.h"
+#else
+#define GSM_FLASH_QUEUE 0
+#endif
 
 class GSMModule {
 public:
+    // Outgoing SMS wait in a queue and leave highest priority first
+    enum SMSPriority {
+        SMS_PRIORITY_SYSTEM_ALERT = 0,
+        SMS_PRIORITY_THRESHOLD_ALERT,
+        SMS_PRIORITY_COMMAND_REPLY,
+        SMS_PRIORITY_REPORT
+    };
+    
     GSMModule();
+    
+    // Talk to the modem over an already opened stream (a simulator on host builds).
+    // Without a way to re-time the stream the link stays at GSM_UART_BAUDRATE.
+    typedef void (*BaudRateSetter)(unsigned long baud, void* context);
+    explicit GSMModule(Stream& modem, BaudRateSetter setBaudRate = nullptr, void* context = nullptr);
+    
+    // Modem bring-up runs in the background: beginBringUp() returns at once and
+    // every serviceBringUp() call sends at most a couple of short commands.
+    // Settings the modem keeps in its saved profile (AT&W) are checked with one
+    // query and only sent again if they were lost. initialize() runs it to the end.
+    enum BringUpState {
+        BRINGUP_IDLE,
+        BRINGUP_BOOTING,        // Probing with AT until the modem answers, alternating rates
+        BRINGUP_NEGOTIATING_BAUD,   // AT+IPR to GSM_UART_FAST_BAUDRATE, then verified
+        BRINGUP_CHECK_PROFILE,
+        BRINGUP_CONFIGURING,    // Profile lost: one setting per call, then AT&W
+        BRINGUP_REGISTERING,    // Polling AT+CREG? until the network accepts us
+        BRINGUP_READY,
+        BRINGUP_FAILED          // Starts over after MODEM_BRINGUP_RETRY
+    };
     bool initialize();
+    void beginBringUp();
+    bool serviceBringUp();      // True on the call that made the modem ready
+    BringUpState getBringUpState();
     
-    // SMS Functions
+    // SMS Functions - these queue the message and return at once
     bool sendSMS(const String& number, const String& message);
-    bool sendSMSToRecipients(const String message);
+    bool sendSMSToRecipients(const String message, SMSPriority priority = SMS_PRIORITY_REPORT, const String& coalesceKey = "");
+    bool queueSMS(const String& number, const String& message, SMSPriority priority, const String& coalesceKey = "");
+    void processOutgoingSMS();
+    bool isSMSReady();           // As of bring-up; no AT traffic
+    int getQueuedSMSCount();     // Not yet sent; alerts waiting for their report are not counted
+    const DeliveryTracker& getDeliveryTracker();
+    int countSMSSegments(const String& message);
     bool sendThresholdAlert(const String& tenant, const String& alertType, float value, float threshold);
     bool sendDailyReport(float energyA, float costA, float energyB, float costB);
     bool sendSystemAlert(const String& errorMessage);
@@ -25,6 +83,10 @@ public:
     bool deleteSMS(int index);
     bool deleteAllSMS();
     
+    // URC-driven reception: call poll() every loop pass, then process what arrived
+    void poll();
+    String processIncomingSMS();
+    
     // SMS Command Processing
     struct SMSCommand {
         String sender;
@@ -34,19 +96,78 @@ public:
     };
     SMSCommand parseSMSCommand(const String& message, const String& sender);
     bool processSMSCommand(const SMSCommand& cmd);
+    String runCommand(const SMSCommand& cmd);
     String generateStatusResponse();
     String generateHelpResponse();
     
     // GPRS/Data Functions
     bool setupGPRS(const String& apn = "internet");
     bool sendHTTPRequest(const String& url, const String& data = "");
+    bool sendHTTPPost(const String& url, const char* body, size_t length, const String& contentType);
     bool reconnectGPRS();
     bool isGPRSConnected();
+    String getLinkStatusDescription();
+    
+    // HTTP session is kept open across requests and rebuilt only on failure
+    bool openHTTPSession();
+    void closeHTTPSession();
+    int getLastHTTPStatus();
     
     // NEW: Enhanced Data Functions
     bool sendDataWithRetry(const String& url, const String& data = "", int maxRetries = 3);
-    bool bufferDataForLater(const String& data);
-    bool sendBufferedData();
+    bool beginUploadQueue();
+    bool bufferRecord(const TelemetryRecord& record);
+    bool sendBufferedData(size_t maxBody = UPLOAD_MAX_BODY);    // Body size limit per backend
+    int getBufferedCount();     // Readings some backend still has to take
+    
+    // Upload windows are spread across the fleet (UploadScheduler); call every
+    // loop pass. True if a window opened and everything went out.
+    // Each window samples AT+CSQ first: at poor signal it is put off unless
+    // the backlog is getting stale, and batches shrink as the signal weakens.
+    bool serviceUploads();
+    unsigned long getUploadInterval();
+    unsigned long getNextUploadIn();
+    struct SignalStats {
+        uint32_t deferred[6];   // Windows put off, by signal bucket 0-5
+        uint32_t sent[6];       // Windows that delivered everything
+    };
+    SignalStats getSignalStats();
+    
+    // OK/ERROR/timeout and latency per AT command class since boot
+    const ATCommandStats& getCommandStats();
+    bool reportModemStats();
+    
+    // Upload backends (ENABLE_THINGSPEAK_UPLOAD, ENABLE_BILLING_UPLOAD)
+    struct UploadBackendStatus {
+        const char* name;
+        const char* url;        // Where the next upload goes
+        int pending;
+        uint32_t sentCount;
+        uint32_t failedCount;
+        LinkSupervisor::State health;
+        uint32_t retryIn;
+        uint32_t heldFor;       // Pause the server asked for (retry_after)
+    };
+    int getUploadBackendCount();
+    UploadBackendStatus getUploadBackendStatus(int index);
+    
+    // MQTT over the modem's TCP stack (ENABLE_MQTT): one long-lived connection,
+    // QoS 1 uploads and commands taken from MQTT_COMMAND_TOPIC
+    bool publishMQTT(const char* topic, const uint8_t* payload, size_t length);
+    void serviceMQTT();
+    bool isMQTTConnected();
+    
+    // Network time from the modem RTC (AT+CCLK?), UTC epoch seconds; every
+    // good read also syncs the wall clock
+    bool readNetworkTime(uint32_t& epoch);
+    
+    // Wall clock (WallClock): loaded from the RTC at boot if one is attached,
+    // then kept to network time. serviceClock() re-reads network time every
+    // CLOCK_SYNC_INTERVAL, and no more than every CLOCK_SYNC_RETRY while reads fail;
+    // call it every loop pass.
+    void attachRTC(RTCDevice* rtc);
+    void serviceClock();
+    const WallClock& getWallClock();
     
     // Status Functions
     struct ModuleStatus {
@@ -60,8 +181,9 @@ public:
         int smsFailedCount;
         int smsReceivedCount;
         String lastError;
-        unsigned long uptime;
+        uint64_t uptime;        // ms
         String ipAddress;
+        unsigned long uartBaud;
     };
     
     ModuleStatus getStatus();
@@ -78,12 +200,30 @@ public:
     String getTimestamp();
     
     // NEW: Power Management
+    // With ENABLE_SLEEP_MODE the modem runs in slow-clock mode (AT+CSCLK=1)
+    // whenever it is idle. Any AT command wakes it through DTR first; an
+    // incoming SMS or call wakes it through RI.
+    struct SleepStats {
+        uint32_t sleepCount;
+        uint32_t wakeCount;
+        uint32_t ringWakes;
+        uint32_t wakeFailures;
+        unsigned long lastWakeLatency;
+        unsigned long maxWakeLatency;
+        unsigned long totalWakeLatency;
+        uint64_t asleepTime;
+    };
     bool enterSleepMode();
     bool wakeFromSleep();
     bool setPowerSaveMode(bool enable);
+    void manageSleep();
+    bool isModemAsleep();
+    SleepStats getSleepStats();
+    float getModemDutyCycle();
     
 private:
-    HardwareSerial* gsmSerial;
+    HardwareSerial* gsmUart;    // Opened in initialize(); null if the stream came from outside
+    Stream* gsmSerial;
     bool moduleReady;
     bool networkRegistered;
     bool smsReady;
@@ -93,8 +233,8 @@ private:
     int smsSentCount;
     int smsFailedCount;
     int smsReceivedCount;
-    unsigned long lastSMSTime;
-    unsigned long moduleStartTime;
+    uint64_t nextSMSAllowedAt;      // monoMillis()
+    uint64_t moduleStartTime;       // monoMillis()
     String lastError;
     String ipAddress;
     
@@ -103,10 +243,219 @@ private:
     String lastSMSSender;
     int lastSMSIndex;
     
-    // NEW: Data buffering
-    static const int MAX_BUFFERED_ENTRIES = 10;
-    String bufferedData[MAX_BUFFERED_ENTRIES];
-    int bufferedCount;
+    // NEW: Data buffering - readings wait in a flash log (RAM if no filesystem)
+    // until the server acknowledges them
+    static const uint32_t RAM_QUEUE_SEGMENT_RECORDS = 10;
+#if GSM_FLASH_QUEUE
+    LittleFSLogStorage flashStorage;
+    UploadQueue flashQueue;
+#endif
+    RAMLogStorage ramStorage;
+    UploadQueue ramQueue;
+    UploadQueue* uploadQueue;
+    
+    // Where buffered readings go. Each backend has a reader of its own on the
+    // queue and its own backoff; after UPLOAD_FAILOVER_AFTER failures in a row
+    // it moves to its other URL, if it has one.
+    static const int MAX_UPLOAD_BACKENDS = 2;
+    struct UploadBackend {
+        const char* name;
+        const char* urls[2];        // Primary and failover (null if none)
+        const char* apiKey;
+        bool binary;                // TelemetryCodec batches instead of ThingSpeak JSON
+        bool viaMQTT;               // MQTT_TELEMETRY_TOPIC first, HTTP while the broker is away
+        bool needsTimestamps;       // Unstamped readings go one at a time, stamped on arrival;
+                                    // otherwise they are sent with created_at 0
+        uint8_t activeURL;
+        uint8_t urlFailures;
+        uint32_t sentCount;
+        uint32_t failedCount;
+        unsigned long heldUntil;
+    };
+    UploadBackend uploadBackends[MAX_UPLOAD_BACKENDS];
+    LinkSupervisor uploadHealth[MAX_UPLOAD_BACKENDS];
+    int uploadBackendCount;
+    static uint8_t enabledUploadBackends();
+    void addUploadBackend(const char* name, const char* url, const char* failoverURL, const char* apiKey,
+                          bool binary, bool viaMQTT, bool needsTimestamps);
+    bool uploadTo(uint8_t reader, size_t maxBody, bool clockValid, uint32_t clockEpoch, unsigned long now);
+    void uploadFailed(uint8_t reader, unsigned long now);
+    
+    // The server steers the schedule through the response body
+    UploadScheduler uploadSchedule;
+    void applyServerDirectives(uint8_t reader, unsigned long now);
+    SignalStats signalStats;
+    bool backlogUrgent(unsigned long now);
+    static size_t uploadBodyLimit(int signal);
+    
+    // HTTP bodies are packed twice from the queue: once to size them for
+    // AT+HTTPDATA, then again through a small window straight into the UART
+    size_t uploadDeclared;
+    size_t uploadStreamed;
+    uint32_t packBatch(UploadBatch& batch, uint8_t reader, uint32_t last, size_t maxLength, bool clockValid,
+                       uint32_t clockEpoch, unsigned long now, uint32_t& lastPacked);
+    bool postBatchStream(uint8_t reader, size_t count, size_t length, uint32_t lastPacked, bool clockValid,
+                         uint32_t clockEpoch, unsigned long now);
+    size_t publishBatchMQTT(uint8_t reader, size_t maxBody, bool clockValid, uint32_t clockEpoch, unsigned long now,
+                            uint32_t& lastPacked);
+    static bool discardBody(const uint8_t* data, size_t length, void* context);
+    static bool writeBody(const uint8_t* data, size_t length, void* context);
+    bool sendBufferedIndividually(uint8_t reader, bool clockValid, uint32_t clockEpoch);
+    uint32_t resolveCreatedAt(const UploadQueue::Entry& entry, bool clockValid, uint32_t clockEpoch, unsigned long now);
+    
+    WallClock wallClock;
+    uint64_t lastClockAttempt;      // monoMillis()
+    
+    // Streaming response parser shared by every AT exchange
+    ATResponseParser atParser;
+    String* responseCollector;
+    
+    // OK/ERROR/timeout and latency per command class; the second step of
+    // CMGS, HTTPDATA and CIPSEND is kept under "<class> body"
+    ATCommandStats commandStats;
+    uint64_t lastModemStatsReport;  // monoMillis()
+    void noteCommand(const char* command, ATResponseParser::Token token, bool ok, unsigned long startedAt);
+    static void onParsedLine(const char* line, size_t length, ATResponseParser::Token token, void* context);
+    void handleURC(ATResponseParser::Token token, const char* line);
+    
+    // Messages pushed by the modem (+CMT) or stored on the SIM (+CMTI, index >= 0)
+    struct IncomingSMS {
+        String sender;
+        String message;
+        int index;
+    };
+    static const int MAX_PENDING_SMS = 5;
+    IncomingSMS pendingSMS[MAX_PENDING_SMS];
+    int pendingSMSHead;
+    int pendingSMSCount;
+    String cmtSender;
+    bool cmtHeaderPending;
+    bool pendingHangup;
+    void queueIncomingSMS(const String& sender, const String& message, int index);
+    
+    // One AT+CMGL pass, parsed into a bounded list of (index, sender, body)
+    static const int MAX_INBOX_RECORDS = 10;
+    IncomingSMS inbox[MAX_INBOX_RECORDS];
+    int inboxCount;
+    bool inboxOverflow;
+    bool inboxAwaitingBody;
+    bool collectingInbox;
+    void collectInboxLine(ATResponseParser::Token token, const char* line);
+    String handleSMS(const String& sender, const String& message);
+    
+    // Outgoing SMS queue. A repeat with the same coalesce key either folds
+    // into the queued copy or is held until SMS_COALESCE_WINDOW has passed
+    // since the last one went out, collecting further repeats meanwhile.
+    struct OutboundSMS {
+        bool used;
+        String number;
+        String message;
+        String coalesceKey;
+        SMSPriority priority;
+        int merged;
+        int attempts;
+        int redeliveries;
+        int deliveryId;         // Sent, waiting for its report (alerts only); -1 otherwise
+        uint64_t queuedAt;      // monoMillis()
+        uint64_t notBefore;
+    };
+    static const int MAX_OUTBOUND_SMS = 12;
+    OutboundSMS outbox[MAX_OUTBOUND_SMS];
+    int outboxCount;
+    
+    struct RecentAlert {
+        String key;
+        String number;
+        uint64_t sentAt;        // monoMillis(), 0 if never
+    };
+    static const int MAX_RECENT_ALERTS = 8;
+    RecentAlert recentAlerts[MAX_RECENT_ALERTS];
+    void rememberAlert(const String& key, const String& number);
+    void releaseOutbound(int index);
+    bool transmitSMS(const String& number, const String& message, int deliveryId = -1);
+    bool transmitSMSPDU(const String& number, int deliveryId);
+    
+    // Status reports (+CDS) are matched to sent messages by reference; settled
+    // ones are handled from processOutgoingSMS()
+    DeliveryTracker smsDelivery;
+    bool cdsPDUPending;
+    void handleStatusReport(uint8_t reference, uint8_t status);
+    void serviceDeliveryReports();
+    SMSComposer smsComposer;
+    uint8_t smsReference;
+    
+    BringUpState bringUpState;
+    unsigned long bringUpStartedAt;
+    unsigned long bringUpNextAt;
+    int bringUpStep;
+    bool profileSaved;
+    void failBringUp(const String& reason);
+    
+    // Line rate of our end of the UART. A modem that stops answering
+    // (MODEM_SILENT_LIMIT commands in a row) is probed again at both rates.
+    BaudRateSetter baudSetter;
+    void* baudContext;
+    unsigned long uartBaud;
+    bool fastBaudFailed;
+    uint32_t linesHeard;
+    int silentCommands;
+    bool canChangeBaud();
+    void setUartBaud(unsigned long baud);
+    void noteModemAnswered(uint32_t linesBefore);
+    bool readNetworkState();
+    
+    // Owns bearer bring-up: data paths call ensureGPRS() and give up at once
+    // while the supervisor is backing off, so an outage costs no AT traffic
+    LinkSupervisor gprsLink;
+    bool ensureGPRS();
+    void markGPRSLost();
+    
+    // Slow-clock sleep state
+    static volatile bool ringIndicated;
+    static void IRAM_ATTR onRingIndicator();
+    bool modemAsleep;
+    bool slowClockEnabled;
+    unsigned long lastModemActivity;
+    unsigned long sleepStartedAt;
+    SleepStats sleepStats;
+    void prepareModemForCommand();
+    bool outboundSMSDueSoon(uint64_t now);
+    
+    // Raw TCP socket on the SIM800L IP stack (CSTT/CIICR/CIPSTART). Received
+    // data is read as hex (AT+CIPRXGET=3) so binary never reaches the line parser.
+    static const size_t TCP_SEND_CHUNK = 1024;
+    static const size_t TCP_RX_CHUNK = 120;
+    bool tcpStackReady;
+    bool tcpOpen;
+    bool tcpDataPending;
+    bool tcpRxHeaderPending;
+    uint8_t tcpRxBuffer[TCP_RX_CHUNK];
+    size_t tcpRxLength;
+    bool openTCP(const char* host, uint16_t port);
+    void closeTCP();
+    void markTCPClosed();
+    bool sendTCP(const uint8_t* head, size_t headLength, const uint8_t* body, size_t bodyLength);
+    size_t receiveTCP();
+    void decodeTCPData(const char* hex);
+    
+    MQTTSession mqtt;
+    LinkSupervisor mqttLink;
+    String mqttCommand;
+    bool ensureMQTT();
+    bool waitForMQTT(uint16_t packetId, unsigned long timeout);
+    static bool onMQTTWrite(const uint8_t* head, size_t headLength, const uint8_t* body, size_t bodyLength, void* context);
+    static void onMQTTMessage(const char* topic, size_t topicLength, const uint8_t* payload, size_t payloadLength, void* context);
+    
+    // HTTP session state
+    bool httpSessionOpen;
+    String httpContentType;
+    int lastHTTPStatus;
+    int lastHTTPResponseLength;
+    String lastHTTPResponse;    // Read back if no longer than HTTP_RESPONSE_MAX
+    bool setHTTPContentType(const String& contentType);
+    int performHTTPAction(int method, unsigned long timeout);
+    bool beginHTTPPost(const String& url, size_t length, const String& contentType);
+    bool finishHTTPPost(size_t length);
     
     // Helper functions
     bool sendATCommand(const String& command, const String& expectedResponse = "OK", unsigned long timeout = 10000);
@@ -118,15 +467,13 @@ private:
     
     // NEW: Enhanced helper functions
     void clearSerialBuffer();
-    bool waitForResponse(const String& expected, unsigned long timeout);
-    String extractQuotedString(const String& input);
+    bool waitForResponse(const String& expected, unsigned long timeout, const char* phase = nullptr);
+    ATResponseParser::Token waitForToken(unsigned long timeout);
+    String extractQuotedField(const char* line, int field);
     bool isAuthorizedNumber(const String& number);
     void logError(const String& error);
     
     // NEW: SMS parsing helpers
-    String extractSMSContent(const String& response);
-    String extractSMSSender(const String& response);
-    int findNextSMSIndex();
     bool isValidSMSCommand(const String& command);
 };
 
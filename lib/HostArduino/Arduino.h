@@ -0,0 +1,214 @@
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+// Host stand-in for the parts of the Arduino/ESP32 core the firmware
+// libraries use, so they can run under `pio test -e native`.
+//
+// Time is virtual: millis() only moves when delay() is called or a test
+// advances it with hostAdvanceMillis(), so code that waits on the modem runs
+// instantly and deterministically. As on the ESP32, millis() and micros()
+// are the low 32 bits of the count and wrap; esp_timer_get_time() does not.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdarg.h>
+#include <string.h>
+#include <strings.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <ctype.h>
+#include <math.h>
+#include <string>
+#include <algorithm>
+
+using std::min;
+using std::max;
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+#define RISING 1
+#define FALLING 2
+#define CHANGE 3
+#define SERIAL_8N1 0x800001c
+#define DEC 10
+#define HEX 16
+#define IRAM_ATTR
+
+typedef uint8_t byte;
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+void yield();
+
+void pinMode(int pin, int mode);
+void digitalWrite(int pin, int value);
+int digitalRead(int pin);
+int digitalPinToInterrupt(int pin);
+void attachInterrupt(int interrupt, void (*handler)(), int mode);
+void detachInterrupt(int interrupt);
+
+template <typename T> T constrain(T value, T low, T high) { return value < low ? low : (value > high ? high : value); }
+
+long random(long max);
+long random(long min, long max);
+void randomSeed(unsigned long seed);
+uint32_t esp_random();
+int64_t esp_timer_get_time();
+
+// Test hooks
+void hostAdvanceMillis(unsigned long ms);
+void hostResetClock();
+void hostSetMicros(uint64_t micros);      // Jump the clock, e.g. to just before millis() wraps
+int hostPinLevel(int pin);
+void hostTriggerInterrupt(int pin);
+void hostSetSerialOutput(bool enabled);   // Echo Serial to stdout (off by default)
+
+class String {
+public:
+    String() {}
+    String(const char* text) : value(text != nullptr ? text : "") {}
+    String(const std::string& text) : value(text) {}
+    explicit String(char c) : value(1, c) {}
+    String(int number, unsigned char base = DEC) { formatInteger(number, base); }
+    String(unsigned int number, unsigned char base = DEC) { formatUnsigned(number, base); }
+    String(long number, unsigned char base = DEC) { formatInteger(number, base); }
+    String(unsigned long number, unsigned char base = DEC) { formatUnsigned(number, base); }
+    String(float number, unsigned char decimals = 2) { formatFloat(number, decimals); }
+    String(double number, unsigned char decimals = 2) { formatFloat(number, decimals); }
+
+    unsigned int length() const { return value.size(); }
+    const char* c_str() const { return value.c_str(); }
+    bool reserve(unsigned int size) { value.reserve(size); return true; }
+    bool isEmpty() const { return value.empty(); }
+
+    int indexOf(char c, unsigned int from = 0) const { return position(value.find(c, from)); }
+    int indexOf(const String& text, unsigned int from = 0) const { return position(value.find(text.value, from)); }
+    int lastIndexOf(char c) const { return position(value.rfind(c)); }
+    int lastIndexOf(char c, unsigned int from) const { return position(value.rfind(c, from)); }
+    int lastIndexOf(const String& text) const { return position(value.rfind(text.value)); }
+    String substring(unsigned int from) const { return from >= value.size() ? String() : String(value.substr(from)); }
+    String substring(unsigned int from, unsigned int to) const {
+        if (from > to) std::swap(from, to);
+        if (from >= value.size()) return String();
+        return String(value.substr(from, to - from));
+    }
+    bool startsWith(const String& prefix) const { return value.compare(0, prefix.value.size(), prefix.value) == 0; }
+    bool startsWith(const String& prefix, unsigned int offset) const {
+        return offset <= value.size() && value.compare(offset, prefix.value.size(), prefix.value) == 0;
+    }
+    bool endsWith(const String& suffix) const {
+        return value.size() >= suffix.value.size() &&
+               value.compare(value.size() - suffix.value.size(), suffix.value.size(), suffix.value) == 0;
+    }
+    bool equals(const String& other) const { return value == other.value; }
+    bool equalsIgnoreCase(const String& other) const { return strcasecmp(value.c_str(), other.value.c_str()) == 0; }
+
+    char charAt(unsigned int index) const { return index < value.size() ? value[index] : 0; }
+    void setCharAt(unsigned int index, char c) { if (index < value.size()) value[index] = c; }
+    char operator[](unsigned int index) const { return charAt(index); }
+    char& operator[](unsigned int index) { return value[index]; }
+
+    void trim();
+    void toUpperCase() { for (size_t i = 0; i < value.size(); i++) value[i] = toupper((unsigned char)value[i]); }
+    void toLowerCase() { for (size_t i = 0; i < value.size(); i++) value[i] = tolower((unsigned char)value[i]); }
+    void replace(const String& from, const String& to);
+    void remove(unsigned int index) { if (index < value.size()) value.erase(index); }
+    void remove(unsigned int index, unsigned int count) { if (index < value.size()) value.erase(index, count); }
+    long toInt() const { return atol(value.c_str()); }
+    float toFloat() const { return (float)atof(value.c_str()); }
+    void toCharArray(char* buffer, unsigned int size) const {
+        if (size == 0) return;
+        strncpy(buffer, value.c_str(), size - 1);
+        buffer[size - 1] = '\0';
+    }
+
+    bool concat(const String& text) { value += text.value; return true; }
+    bool concat(const char* text) { value += text; return true; }
+    bool concat(char c) { value += c; return true; }
+    template <typename T> String& operator+=(const T& other) { value += String(other).value; return *this; }
+    String& operator+=(const String& other) { value += other.value; return *this; }
+    String& operator+=(const char* text) { value += text; return *this; }
+    String& operator+=(char c) { value += c; return *this; }
+
+    bool operator==(const String& other) const { return value == other.value; }
+    bool operator==(const char* text) const { return value == text; }
+    bool operator!=(const String& other) const { return value != other.value; }
+    bool operator!=(const char* text) const { return value != text; }
+    bool operator<(const String& other) const { return value < other.value; }
+
+    friend String operator+(const String& a, const String& b) { return String(a.value + b.value); }
+    friend String operator+(const String& a, const char* b) { return String(a.value + b); }
+    friend String operator+(const char* a, const String& b) { return String(std::string(a) + b.value); }
+    friend String operator+(const String& a, char b) { return String(a.value + b); }
+    template <typename T> friend String operator+(const String& a, T b) { return a + String(b); }
+
+private:
+    std::string value;
+
+    static int position(size_t index) { return index == std::string::npos ? -1 : (int)index; }
+    void formatInteger(long number, unsigned char base);
+    void formatUnsigned(unsigned long number, unsigned char base);
+    void formatFloat(double number, unsigned char decimals);
+};
+
+class Print {
+public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t* buffer, size_t size) {
+        for (size_t i = 0; i < size; i++) write(buffer[i]);
+        return size;
+    }
+    size_t write(const char* text) { return write(reinterpret_cast<const uint8_t*>(text), strlen(text)); }
+    size_t write(const char* buffer, size_t size) { return write(reinterpret_cast<const uint8_t*>(buffer), size); }
+
+    size_t print(const String& text) { return write(text.c_str()); }
+    size_t print(const char* text) { return write(text); }
+    size_t print(char c) { return write((uint8_t)c); }
+    size_t print(int number, int base = DEC) { return print(String(number, base)); }
+    size_t print(unsigned int number, int base = DEC) { return print(String(number, base)); }
+    size_t print(long number, int base = DEC) { return print(String(number, base)); }
+    size_t print(unsigned long number, int base = DEC) { return print(String(number, base)); }
+    size_t print(double number, int decimals = 2) { return print(String(number, decimals)); }
+    template <typename T> size_t println(const T& value) { return print(value) + println(); }
+    template <typename T> size_t println(const T& value, int format) { return print(value, format) + println(); }
+    size_t println() { return write("\r\n"); }
+    int printf(const char* format, ...);
+    virtual void flush() {}
+};
+
+class Stream : public Print {
+public:
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int peek() = 0;
+    void setTimeout(unsigned long timeout) { (void)timeout; }
+};
+
+class HardwareSerial : public Stream {
+public:
+    explicit HardwareSerial(int port) : port(port) {}
+    void begin(unsigned long baud, uint32_t config = SERIAL_8N1, int8_t rxPin = -1, int8_t txPin = -1);
+    void end() {}
+    void updateBaudRate(unsigned long baud) { (void)baud; }
+    int available() { return 0; }
+    int read() { return -1; }
+    int peek() { return -1; }
+    size_t write(uint8_t c);
+    using Print::write;
+    operator bool() const { return true; }
+
+private:
+    int port;
+};
+
+extern HardwareSerial Serial;
+extern HardwareSerial Serial1;
+extern HardwareSerial Serial2;
+
+#endif // HOST_ARDUINO_H
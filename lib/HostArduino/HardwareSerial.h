@@ -0,0 +1,6 @@
+#ifndef HOST_HARDWARESERIAL_H
+#define HOST_HARDWARESERIAL_H
+
+#include "Arduino.h"
+
+#endif // HOST_HARDWARESERIAL_H
@@ -0,0 +1,195 @@
+#include "Arduino.h"
+#include "Wire.h"
+
+namespace {
+    unsigned long long virtualMicros = 0;
+    bool serialOutput = false;
+    uint32_t randomState = 0x2545F491;
+
+    const int PIN_COUNT = 40;
+    int pinLevels[PIN_COUNT];
+    void (*interruptHandlers[PIN_COUNT])();
+}
+
+HardwareSerial Serial(0);
+HardwareSerial Serial1(1);
+HardwareSerial Serial2(2);
+TwoWire Wire;
+
+unsigned long millis() {
+    return (uint32_t)(virtualMicros / 1000);
+}
+
+unsigned long micros() {
+    return (uint32_t)virtualMicros;
+}
+
+int64_t esp_timer_get_time() {
+    return (int64_t)virtualMicros;
+}
+
+void delay(unsigned long ms) {
+    virtualMicros += (unsigned long long)ms * 1000;
+}
+
+void delayMicroseconds(unsigned int us) {
+    virtualMicros += us;
+}
+
+void yield() {}
+
+void hostAdvanceMillis(unsigned long ms) {
+    delay(ms);
+}
+
+void hostResetClock() {
+    virtualMicros = 0;
+}
+
+void hostSetMicros(uint64_t micros) {
+    virtualMicros = micros;
+}
+
+void hostSetSerialOutput(bool enabled) {
+    serialOutput = enabled;
+}
+
+void pinMode(int pin, int mode) {
+    if (pin >= 0 && pin < PIN_COUNT && mode == INPUT_PULLUP) {
+        pinLevels[pin] = HIGH;
+    }
+}
+
+void digitalWrite(int pin, int value) {
+    if (pin >= 0 && pin < PIN_COUNT) {
+        pinLevels[pin] = value;
+    }
+}
+
+int digitalRead(int pin) {
+    return pin >= 0 && pin < PIN_COUNT ? pinLevels[pin] : LOW;
+}
+
+int hostPinLevel(int pin) {
+    return digitalRead(pin);
+}
+
+int digitalPinToInterrupt(int pin) {
+    return pin;
+}
+
+void attachInterrupt(int interrupt, void (*handler)(), int mode) {
+    (void)mode;
+    if (interrupt >= 0 && interrupt < PIN_COUNT) {
+        interruptHandlers[interrupt] = handler;
+    }
+}
+
+void detachInterrupt(int interrupt) {
+    if (interrupt >= 0 && interrupt < PIN_COUNT) {
+        interruptHandlers[interrupt] = nullptr;
+    }
+}
+
+void hostTriggerInterrupt(int pin) {
+    if (pin >= 0 && pin < PIN_COUNT && interruptHandlers[pin] != nullptr) {
+        interruptHandlers[pin]();
+    }
+}
+
+uint32_t esp_random() {
+    randomState ^= randomState << 13;
+    randomState ^= randomState >> 17;
+    randomState ^= randomState << 5;
+    return randomState;
+}
+
+void randomSeed(unsigned long seed) {
+    randomState = seed != 0 ? (uint32_t)seed : 0x2545F491;
+}
+
+long random(long max) {
+    return max > 0 ? (long)(esp_random() % (uint32_t)max) : 0;
+}
+
+long random(long min, long max) {
+    return max > min ? min + random(max - min) : min;
+}
+
+void String::trim() {
+    size_t first = value.find_first_not_of(" \t\r\n");
+    if (first == std::string::npos) {
+        value.clear();
+        return;
+    }
+    size_t last = value.find_last_not_of(" \t\r\n");
+    value = value.substr(first, last - first + 1);
+}
+
+void String::replace(const String& from, const String& to) {
+    if (from.value.empty()) {
+        return;
+    }
+    size_t index = 0;
+    while ((index = value.find(from.value, index)) != std::string::npos) {
+        value.replace(index, from.value.size(), to.value);
+        index += to.value.size();
+    }
+}
+
+void String::formatInteger(long number, unsigned char base) {
+    if (base == DEC || number >= 0) {
+        if (base == DEC) {
+            char buffer[24];
+            snprintf(buffer, sizeof(buffer), "%ld", number);
+            value = buffer;
+            return;
+        }
+    }
+    formatUnsigned((unsigned long)number, base);
+}
+
+void String::formatUnsigned(unsigned long number, unsigned char base) {
+    if (base < 2 || base > 36) {
+        base = DEC;
+    }
+    char buffer[72];
+    size_t n = sizeof(buffer) - 1;
+    buffer[n] = '\0';
+    do {
+        unsigned digit = number % base;
+        buffer[--n] = digit < 10 ? '0' + digit : 'a' + digit - 10;
+        number /= base;
+    } while (number > 0);
+    value = buffer + n;
+}
+
+void String::formatFloat(double number, unsigned char decimals) {
+    char buffer[48];
+    snprintf(buffer, sizeof(buffer), "%.*f", decimals, number);
+    value = buffer;
+}
+
+int Print::printf(const char* format, ...) {
+    char buffer[256];
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(buffer, sizeof(buffer), format, args);
+    va_end(args);
+    write(buffer);
+    return length;
+}
+
+void HardwareSerial::begin(unsigned long baud, uint32_t config, int8_t rxPin, int8_t txPin) {
+    (void)baud;
+    (void)config;
+    (void)rxPin;
+    (void)txPin;
+}
+
+size_t HardwareSerial::write(uint8_t c) {
+    if (port == 0 && serialOutput) {
+        fputc(c, stdout);
+    }
+    return 1;
+}
@@ -0,0 +1,56 @@
+#ifndef HOST_LIQUIDCRYSTAL_I2C_H
+#define HOST_LIQUIDCRYSTAL_I2C_H
+
+#include "Arduino.h"
+
+// A character LCD that keeps what is on screen, for tests to read back.
+// The display last init()ed is the one hostActive() returns.
+class LiquidCrystal_I2C : public Print {
+public:
+    static const int MAX_COLS = 20;
+    static const int MAX_ROWS = 4;
+
+    LiquidCrystal_I2C(uint8_t address, uint8_t cols, uint8_t rows)
+        : cols(cols < MAX_COLS ? cols : MAX_COLS), rows(rows < MAX_ROWS ? rows : MAX_ROWS), lit(false) {
+        (void)address;
+        clear();
+    }
+    void init() { clear(); active() = this; }
+    void backlight() { lit = true; }
+    void noBacklight() { lit = false; }
+    void clear() {
+        for (int r = 0; r < MAX_ROWS; r++) {
+            memset(screen[r], ' ', MAX_COLS);
+            screen[r][cols] = '\0';
+        }
+        row = 0;
+        col = 0;
+    }
+    void setCursor(uint8_t column, uint8_t line) { col = column; row = line; }
+    size_t write(uint8_t c) {
+        if (row < rows && col < cols) screen[row][col] = (char)c;
+        col++;
+        return 1;
+    }
+    using Print::write;
+
+    // Test hooks
+    const char* hostRow(int line) const { return screen[line]; }
+    bool hostBacklight() const { return lit; }
+    static const LiquidCrystal_I2C* hostActive() { return active(); }
+
+private:
+    int cols;
+    int rows;
+    int row;
+    int col;
+    bool lit;
+    char screen[MAX_ROWS][MAX_COLS + 1];
+
+    static LiquidCrystal_I2C*& active() {
+        static LiquidCrystal_I2C* display = nullptr;
+        return display;
+    }
+};
+
+#endif // HOST_LIQUIDCRYSTAL_I2C_H
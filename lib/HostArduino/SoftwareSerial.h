@@ -0,0 +1,47 @@
+#ifndef HOST_SOFTWARESERIAL_H
+#define HOST_SOFTWARESERIAL_H
+
+#include "Arduino.h"
+#include <deque>
+
+// A software UART with a device on the other end: each frame written is
+// handed to the responder, which queues the device's reply for read()
+class SoftwareSerial : public Stream {
+public:
+    typedef void (*Responder)(SoftwareSerial& serial, const uint8_t* frame, size_t length);
+
+    SoftwareSerial(int rxPin, int txPin) : listening(false) { (void)rxPin; (void)txPin; }
+    void begin(long baud) { (void)baud; listening = true; }
+    void end() { listening = false; }
+    bool isListening() { return listening; }
+
+    int available() { return (int)rx.size(); }
+    int read() {
+        if (rx.empty()) return -1;
+        uint8_t c = rx.front();
+        rx.pop_front();
+        return c;
+    }
+    int peek() { return rx.empty() ? -1 : rx.front(); }
+    size_t write(uint8_t c) { return write(&c, 1); }
+    size_t write(const uint8_t* buffer, size_t size) {
+        if (responder() != nullptr) responder()(*this, buffer, size);
+        return size;
+    }
+    using Print::write;
+
+    // Test hooks
+    static void hostSetResponder(Responder handler) { responder() = handler; }
+    void hostQueue(const uint8_t* data, size_t length) { rx.insert(rx.end(), data, data + length); }
+
+private:
+    bool listening;
+    std::deque<uint8_t> rx;
+
+    static Responder& responder() {
+        static Responder handler = nullptr;
+        return handler;
+    }
+};
+
+#endif // HOST_SOFTWARESERIAL_H
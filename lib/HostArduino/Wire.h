@@ -0,0 +1,21 @@
+#ifndef HOST_WIRE_H
+#define HOST_WIRE_H
+
+#include "Arduino.h"
+
+// An I2C bus with nothing on it: every address NACKs
+class TwoWire {
+public:
+    bool begin(int sda = -1, int scl = -1, uint32_t frequency = 0) { (void)sda; (void)scl; (void)frequency; return true; }
+    void beginTransmission(uint8_t address) { (void)address; }
+    uint8_t endTransmission(bool stop = true) { (void)stop; return 2; }
+    size_t write(uint8_t c) { (void)c; return 1; }
+    size_t write(const uint8_t* data, size_t length) { (void)data; return length; }
+    uint8_t requestFrom(uint8_t address, uint8_t length) { (void)address; (void)length; return 0; }
+    int available() { return 0; }
+    int read() { return -1; }
+};
+
+extern TwoWire Wire;
+
+#endif // HOST_WIRE_H
@@ -0,0 +1,102 @@
+#include "LinkSupervisor.h"
+
+LinkSupervisor::LinkSupervisor(uint32_t baseDelay, uint32_t maxDelay, uint8_t breakerThreshold, uint32_t breakerOpenTime)
+    : baseDelay(baseDelay > 0 ? baseDelay : 1),
+      maxDelay(maxDelay > baseDelay ? maxDelay : baseDelay),
+      breakerThreshold(breakerThreshold > 0 ? breakerThreshold : 1),
+      breakerOpenTime(breakerOpenTime) {
+    current = LINK_DOWN;
+    failures = 0;
+    probing = false;
+    trips = 0;
+    nextAttemptAt = 0;
+    randomState = 0x9E3779B9;
+}
+
+void LinkSupervisor::seed(uint32_t value) {
+    // xorshift never leaves an all-zero state
+    randomState = value != 0 ? value : 0x9E3779B9;
+}
+
+bool LinkSupervisor::shouldAttempt(uint32_t now) const {
+    if (current == LINK_UP) {
+        return false;
+    }
+    return current == LINK_DOWN || (int32_t)(now - nextAttemptAt) >= 0;
+}
+
+void LinkSupervisor::attemptSucceeded(uint32_t now) {
+    (void)now;
+    current = LINK_UP;
+    failures = 0;
+    probing = false;
+}
+
+void LinkSupervisor::attemptFailed(uint32_t now) {
+    if (failures < 255) {
+        failures++;
+    }
+
+    if (probing || failures >= breakerThreshold) {
+        // A failed probe reopens the breaker without waiting for another run
+        current = LINK_CIRCUIT_OPEN;
+        probing = true;
+        trips++;
+        nextAttemptAt = now + breakerOpenTime + nextRandom() % (baseDelay + 1);
+        return;
+    }
+
+    uint32_t delay = baseDelay;
+    for (uint8_t i = 1; i < failures && delay < maxDelay; i++) {
+        delay = delay > maxDelay / 2 ? maxDelay : delay * 2;
+    }
+    current = LINK_BACKOFF;
+    nextAttemptAt = now + jitter(delay);
+}
+
+void LinkSupervisor::linkLost(uint32_t now) {
+    if (current != LINK_UP) {
+        return;
+    }
+    current = LINK_DOWN;
+    failures = 0;
+    probing = false;
+    nextAttemptAt = now;
+}
+
+LinkSupervisor::State LinkSupervisor::state(uint32_t now) const {
+    if (current != LINK_UP && shouldAttempt(now)) {
+        return LINK_DOWN;
+    }
+    return current;
+}
+
+uint32_t LinkSupervisor::retryIn(uint32_t now) const {
+    if (current == LINK_UP || shouldAttempt(now)) {
+        return 0;
+    }
+    return nextAttemptAt - now;
+}
+
+const char* LinkSupervisor::stateName(State state) {
+    switch (state) {
+        case LINK_DOWN: return "DOWN";
+        case LINK_UP: return "UP";
+        case LINK_BACKOFF: return "BACKOFF";
+        case LINK_CIRCUIT_OPEN: return "CIRCUIT OPEN";
+        default: return "UNKNOWN";
+    }
+}
+
+uint32_t LinkSupervisor::nextRandom() {
+    randomState ^= randomState << 13;
+    randomState ^= randomState >> 17;
+    randomState ^= randomState << 5;
+    return randomState;
+}
+
+uint32_t LinkSupervisor::jitter(uint32_t delay) {
+    // Equal jitter: at least half the delay, at most all of it
+    uint32_t half = delay / 2;
+    return delay - half + nextRandom() % (half + 1);
+}
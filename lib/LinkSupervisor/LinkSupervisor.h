@@ -0,0 +1,69 @@
+#ifndef LINKSUPERVISOR_H
+#define LINKSUPERVISOR_H
+
+#include <stdint.h>
+
+// Decides when a dropped data link may be brought up again.
+//
+// Callers report the outcome of each connect attempt and any loss of the
+// link; in return shouldAttempt() tells them whether trying now is worth it.
+// Failed attempts back off exponentially (base, 2x base, ... up to a cap),
+// with equal jitter so a fleet that lost the same tower does not retry in
+// lockstep. After a run of consecutive failures the breaker opens and no
+// attempt is allowed for a longer cool-down; the first attempt after that
+// is a single probe that either closes the breaker or opens it again.
+//
+// Time is passed in as milliseconds from any free-running counter; wrap
+// around is handled.
+class LinkSupervisor {
+public:
+    enum State : uint8_t {
+        LINK_DOWN = 0,      // Not connected, an attempt may be made now
+        LINK_UP,
+        LINK_BACKOFF,       // Waiting out the delay after a failed attempt
+        LINK_CIRCUIT_OPEN   // Too many failures in a row, cooling down
+    };
+
+    LinkSupervisor(uint32_t baseDelay, uint32_t maxDelay, uint8_t breakerThreshold, uint32_t breakerOpenTime);
+
+    void seed(uint32_t value);
+
+    // True if the link is down and its retry delay has passed
+    bool shouldAttempt(uint32_t now) const;
+
+    void attemptSucceeded(uint32_t now);
+    void attemptFailed(uint32_t now);
+
+    // The link was up and went away (bearer closed by the network, module
+    // reset). The first reconnect is allowed straight away.
+    void linkLost(uint32_t now);
+
+    bool isUp() const { return current == LINK_UP; }
+    State state(uint32_t now) const;
+
+    // Milliseconds until shouldAttempt() turns true, 0 if up or due
+    uint32_t retryIn(uint32_t now) const;
+
+    uint8_t consecutiveFailures() const { return failures; }
+    uint32_t circuitTrips() const { return trips; }
+
+    static const char* stateName(State state);
+
+private:
+    uint32_t baseDelay;
+    uint32_t maxDelay;
+    uint8_t breakerThreshold;
+    uint32_t breakerOpenTime;
+
+    State current;
+    uint8_t failures;
+    bool probing;           // Next attempt is the half-open probe
+    uint32_t trips;
+    uint32_t nextAttemptAt;
+    uint32_t randomState;
+
+    uint32_t nextRandom();
+    uint32_t jitter(uint32_t delay);
+};
+
+#endif // LINKSUPERVISOR_H
@@ -0,0 +1,400 @@
+#include "MQTTSession.h"
+#include <string.h>
+
+namespace {
+    enum PacketType : uint8_t {
+        CONNECT = 1,
+        CONNACK = 2,
+        PUBLISH = 3,
+        PUBACK = 4,
+        SUBSCRIBE = 8,
+        SUBACK = 9,
+        PINGREQ = 12,
+        PINGRESP = 13,
+        DISCONNECT = 14
+    };
+
+    enum RxStage : uint8_t {
+        RX_HEADER = 0,
+        RX_LENGTH,
+        RX_BODY,
+        RX_SKIP             // Packet too large for the buffer, drop its bytes
+    };
+}
+
+MQTTSession::MQTTSession() {
+    writeHandler = nullptr;
+    writeContext = nullptr;
+    messageHandler = nullptr;
+    messageContext = nullptr;
+    nextPacketId = 1;
+    publishSequence = 0;
+    clock = 0;
+    sentBytes = 0;
+    receivedBytes = 0;
+    acked = 0;
+    reset();
+}
+
+void MQTTSession::setWriteHandler(WriteHandler handler, void* context) {
+    writeHandler = handler;
+    writeContext = context;
+}
+
+void MQTTSession::setMessageHandler(MessageHandler handler, void* context) {
+    messageHandler = handler;
+    messageContext = context;
+}
+
+void MQTTSession::reset() {
+    current = MQTT_DISCONNECTED;
+    returnCode = 0;
+    subscribeRejected = false;
+    keepAlive = 0;
+    connectSentAt = 0;
+    lastSentAt = 0;
+    pingOutstanding = false;
+    pingSentAt = 0;
+    for (uint8_t i = 0; i < MAX_INFLIGHT; i++) {
+        inflight[i].packetId = 0;
+    }
+    rxStage = RX_HEADER;
+    rxHeader = 0;
+    rxRemaining = 0;
+    rxLength = 0;
+    rxLengthBytes = 0;
+    rxLengthMultiplier = 1;
+}
+
+bool MQTTSession::connect(const char* clientId, uint16_t keepAliveSeconds,
+                          const char* username, const char* password, uint32_t now) {
+    reset();
+
+    size_t clientLength = clientId != nullptr ? strlen(clientId) : 0;
+    size_t userLength = username != nullptr ? strlen(username) : 0;
+    size_t passLength = password != nullptr ? strlen(password) : 0;
+
+    uint32_t remaining = 10 + 2 + clientLength;
+    if (userLength > 0) remaining += 2 + userLength;
+    if (passLength > 0) remaining += 2 + passLength;
+    if (remaining + 5 > MAX_HEADER) {
+        return false;
+    }
+
+    uint8_t flags = 0x02;   // Clean session
+    if (userLength > 0) flags |= 0x80;
+    if (passLength > 0) flags |= 0x40;
+
+    size_t n = 0;
+    header[n++] = CONNECT << 4;
+    n += encodeLength(header + n, remaining);
+    n += putString(header + n, "MQTT", 4);
+    header[n++] = 4;        // Protocol level 3.1.1
+    header[n++] = flags;
+    header[n++] = keepAliveSeconds >> 8;
+    header[n++] = keepAliveSeconds & 0xFF;
+    n += putString(header + n, clientId != nullptr ? clientId : "", clientLength);
+    if (userLength > 0) n += putString(header + n, username, userLength);
+    if (passLength > 0) n += putString(header + n, password, passLength);
+
+    keepAlive = keepAliveSeconds;
+    clock = now;
+    connectSentAt = now;
+    if (!send(header, n, nullptr, 0)) {
+        return false;
+    }
+    current = MQTT_CONNECTING;
+    return true;
+}
+
+bool MQTTSession::subscribe(const char* topic, uint8_t qos) {
+    if (current != MQTT_CONNECTED) {
+        return false;
+    }
+    size_t topicLength = strlen(topic);
+    uint32_t remaining = 2 + 2 + topicLength + 1;
+    if (remaining + 5 > MAX_HEADER) {
+        return false;
+    }
+
+    uint16_t packetId = allocatePacketId();
+    size_t n = 0;
+    header[n++] = (SUBSCRIBE << 4) | 0x02;
+    n += encodeLength(header + n, remaining);
+    header[n++] = packetId >> 8;
+    header[n++] = packetId & 0xFF;
+    n += putString(header + n, topic, topicLength);
+    header[n++] = qos > 1 ? 1 : qos;
+    subscribeRejected = false;
+    return send(header, n, nullptr, 0);
+}
+
+bool MQTTSession::publish(const char* topic, const uint8_t* payload, size_t length,
+                          uint8_t qos, uint16_t* packetId) {
+    if (current != MQTT_CONNECTED) {
+        return false;
+    }
+    qos = qos > 1 ? 1 : qos;
+    size_t topicLength = strlen(topic);
+    if (2 + topicLength + 2 + 5 > MAX_HEADER) {
+        return false;
+    }
+
+    uint32_t remaining = 2 + topicLength + (qos > 0 ? 2 : 0) + length;
+    size_t n = 0;
+    header[n++] = (PUBLISH << 4) | (qos << 1);
+    n += encodeLength(header + n, remaining);
+    n += putString(header + n, topic, topicLength);
+
+    uint16_t id = 0;
+    if (qos > 0) {
+        id = allocatePacketId();
+        header[n++] = id >> 8;
+        header[n++] = id & 0xFF;
+
+        // Track it, evicting the oldest if the table is full
+        uint8_t slot = 0;
+        for (uint8_t i = 0; i < MAX_INFLIGHT; i++) {
+            if (inflight[i].packetId == 0) {
+                slot = i;
+                break;
+            }
+            if (inflight[i].sequence < inflight[slot].sequence) {
+                slot = i;
+            }
+        }
+        inflight[slot].packetId = id;
+        inflight[slot].sequence = publishSequence++;
+    }
+
+    if (packetId != nullptr) {
+        *packetId = id;
+    }
+    return send(header, n, payload, length);
+}
+
+void MQTTSession::disconnect() {
+    if (current != MQTT_DISCONNECTED) {
+        uint8_t packet[2] = {DISCONNECT << 4, 0};
+        send(packet, sizeof(packet), nullptr, 0);
+    }
+    reset();
+}
+
+bool MQTTSession::isPending(uint16_t packetId) const {
+    if (packetId == 0) {
+        return false;
+    }
+    for (uint8_t i = 0; i < MAX_INFLIGHT; i++) {
+        if (inflight[i].packetId == packetId) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void MQTTSession::loop(uint32_t now) {
+    clock = now;
+    if (current == MQTT_CONNECTING) {
+        if (now - connectSentAt >= CONNECT_TIMEOUT) {
+            reset();
+        }
+        return;
+    }
+    if (current != MQTT_CONNECTED || keepAlive == 0) {
+        return;
+    }
+
+    uint32_t period = (uint32_t)keepAlive * 1000;
+    if (pingOutstanding) {
+        // The broker gives up at 1.5x keepalive; do not wait longer than that
+        if (now - pingSentAt >= period / 2) {
+            reset();
+        }
+        return;
+    }
+    if (now - lastSentAt >= period && sendSimple(PINGREQ, 0)) {
+        pingOutstanding = true;
+        pingSentAt = now;
+    }
+}
+
+void MQTTSession::feed(const uint8_t* data, size_t length, uint32_t now) {
+    clock = now;
+    receivedBytes += length;
+
+    for (size_t i = 0; i < length; i++) {
+        uint8_t b = data[i];
+        switch (rxStage) {
+            case RX_HEADER:
+                rxHeader = b;
+                rxRemaining = 0;
+                rxLength = 0;
+                rxLengthBytes = 0;
+                rxLengthMultiplier = 1;
+                rxStage = RX_LENGTH;
+                break;
+
+            case RX_LENGTH:
+                rxRemaining += (b & 0x7F) * rxLengthMultiplier;
+                rxLengthMultiplier *= 128;
+                rxLengthBytes++;
+                if ((b & 0x80) != 0) {
+                    if (rxLengthBytes >= 4) {
+                        // Malformed length; nothing after this can be trusted
+                        reset();
+                        return;
+                    }
+                    break;
+                }
+                if (rxRemaining == 0) {
+                    handlePacket(rxHeader >> 4, rxHeader & 0x0F, rxBuffer, 0);
+                    rxStage = RX_HEADER;
+                } else {
+                    rxStage = rxRemaining <= MAX_INCOMING_PACKET ? RX_BODY : RX_SKIP;
+                }
+                break;
+
+            case RX_BODY:
+                rxBuffer[rxLength++] = b;
+                if (rxLength == rxRemaining) {
+                    handlePacket(rxHeader >> 4, rxHeader & 0x0F, rxBuffer, rxLength);
+                    rxStage = RX_HEADER;
+                }
+                break;
+
+            case RX_SKIP:
+                if (++rxLength == rxRemaining) {
+                    rxStage = RX_HEADER;
+                }
+                break;
+        }
+        if (current == MQTT_DISCONNECTED) {
+            return;
+        }
+    }
+}
+
+void MQTTSession::handlePacket(uint8_t type, uint8_t flags, const uint8_t* body, size_t length) {
+    switch (type) {
+        case CONNACK:
+            if (current != MQTT_CONNECTING || length < 2) {
+                break;
+            }
+            returnCode = body[1];
+            if (returnCode == 0) {
+                current = MQTT_CONNECTED;
+            } else {
+                uint8_t code = returnCode;
+                reset();
+                returnCode = code;
+            }
+            break;
+
+        case PUBACK:
+            if (length >= 2) {
+                uint16_t id = (body[0] << 8) | body[1];
+                for (uint8_t i = 0; i < MAX_INFLIGHT; i++) {
+                    if (inflight[i].packetId == id) {
+                        inflight[i].packetId = 0;
+                        acked++;
+                    }
+                }
+            }
+            break;
+
+        case SUBACK:
+            // Return code 0x80 means the broker refused the subscription
+            if (length >= 3 && body[2] == 0x80) {
+                subscribeRejected = true;
+            }
+            break;
+
+        case PINGRESP:
+            pingOutstanding = false;
+            break;
+
+        case PUBLISH: {
+            uint8_t qos = (flags >> 1) & 0x03;
+            if (length < 2) {
+                break;
+            }
+            size_t topicLength = (body[0] << 8) | body[1];
+            size_t offset = 2 + topicLength;
+            uint16_t id = 0;
+            if (qos > 0) {
+                if (offset + 2 > length) {
+                    break;
+                }
+                id = (body[offset] << 8) | body[offset + 1];
+                offset += 2;
+            }
+            if (offset > length) {
+                break;
+            }
+            if (messageHandler != nullptr) {
+                messageHandler(reinterpret_cast<const char*>(body + 2), topicLength,
+                               body + offset, length - offset, messageContext);
+            }
+            // Subscriptions are made at QoS 1 at most, so QoS 2 never arrives
+            if (qos == 1) {
+                sendSimple(PUBACK, id);
+            }
+            break;
+        }
+
+        default:
+            break;
+    }
+}
+
+uint16_t MQTTSession::allocatePacketId() {
+    uint16_t id = nextPacketId++;
+    if (nextPacketId == 0) {
+        nextPacketId = 1;
+    }
+    return id;
+}
+
+bool MQTTSession::send(const uint8_t* head, size_t headLength, const uint8_t* body, size_t bodyLength) {
+    if (writeHandler == nullptr || !writeHandler(head, headLength, body, bodyLength, writeContext)) {
+        return false;
+    }
+    sentBytes += headLength + bodyLength;
+    lastSentAt = clock;
+    return true;
+}
+
+bool MQTTSession::sendSimple(uint8_t type, uint16_t packetId) {
+    uint8_t packet[4];
+    size_t n = 0;
+    packet[n++] = type << 4;
+    if (type == PUBACK) {
+        packet[n++] = 2;
+        packet[n++] = packetId >> 8;
+        packet[n++] = packetId & 0xFF;
+    } else {
+        packet[n++] = 0;
+    }
+    return send(packet, n, nullptr, 0);
+}
+
+size_t MQTTSession::encodeLength(uint8_t* out, uint32_t length) {
+    size_t n = 0;
+    do {
+        uint8_t digit = length % 128;
+        length /= 128;
+        if (length > 0) {
+            digit |= 0x80;
+        }
+        out[n++] = digit;
+    } while (length > 0 && n < 4);
+    return n;
+}
+
+size_t MQTTSession::putString(uint8_t* out, const char* text, size_t length) {
+    out[0] = length >> 8;
+    out[1] = length & 0xFF;
+    memcpy(out + 2, text, length);
+    return 2 + length;
+}
@@ -0,0 +1,117 @@
+#ifndef MQTTSESSION_H
+#define MQTTSESSION_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// MQTT 3.1.1 client state machine, independent of the transport.
+//
+// Outgoing packets leave through a write callback as a header plus an
+// optional body, so a publish payload is never copied and the transport can
+// send both in one go. Received bytes are fed in as they arrive, in pieces
+// of any size; complete packets are decoded from a fixed buffer and
+// incoming PUBLISH messages are handed to the message callback.
+//
+// Sessions are always clean. QoS 1 publishes are tracked by packet id until
+// their PUBACK arrives; the caller keeps the data and sends it again if the
+// ack never comes, so nothing is retained across a reconnect here.
+class MQTTSession {
+public:
+    enum State : uint8_t {
+        MQTT_DISCONNECTED = 0,
+        MQTT_CONNECTING,    // CONNECT sent, waiting for CONNACK
+        MQTT_CONNECTED
+    };
+
+    typedef bool (*WriteHandler)(const uint8_t* head, size_t headLength,
+                                 const uint8_t* body, size_t bodyLength, void* context);
+    typedef void (*MessageHandler)(const char* topic, size_t topicLength,
+                                   const uint8_t* payload, size_t payloadLength, void* context);
+
+    static const size_t MAX_INCOMING_PACKET = 256;
+    static const size_t MAX_HEADER = 192;
+    static const uint8_t MAX_INFLIGHT = 4;
+    static const uint32_t CONNECT_TIMEOUT = 15000;
+
+    MQTTSession();
+
+    void setWriteHandler(WriteHandler handler, void* context);
+    void setMessageHandler(MessageHandler handler, void* context);
+
+    // Empty or null username/password are left out of the CONNECT
+    bool connect(const char* clientId, uint16_t keepAliveSeconds,
+                 const char* username, const char* password, uint32_t now);
+    bool subscribe(const char* topic, uint8_t qos);
+    bool publish(const char* topic, const uint8_t* payload, size_t length,
+                 uint8_t qos, uint16_t* packetId = nullptr);
+    void disconnect();
+
+    // The transport went away; forget the session without writing anything
+    void reset();
+
+    void feed(const uint8_t* data, size_t length, uint32_t now);
+
+    // Sends PINGREQ when the link has been quiet for the keepalive period and
+    // drops the session if the broker stops answering
+    void loop(uint32_t now);
+
+    State state() const { return current; }
+    bool connected() const { return current == MQTT_CONNECTED; }
+    bool isPending(uint16_t packetId) const;
+    uint8_t connectReturnCode() const { return returnCode; }
+    bool subscriptionRejected() const { return subscribeRejected; }
+
+    uint32_t bytesSent() const { return sentBytes; }
+    uint32_t bytesReceived() const { return receivedBytes; }
+    uint32_t acknowledgedCount() const { return acked; }
+
+private:
+    struct Inflight {
+        uint16_t packetId;
+        uint32_t sequence;      // Publish order, to evict the oldest
+    };
+
+    WriteHandler writeHandler;
+    void* writeContext;
+    MessageHandler messageHandler;
+    void* messageContext;
+
+    State current;
+    uint8_t returnCode;
+    bool subscribeRejected;
+    uint16_t keepAlive;     // Seconds, 0 = off
+    uint32_t connectSentAt;
+    uint32_t lastSentAt;
+    bool pingOutstanding;
+    uint32_t pingSentAt;
+    uint32_t clock;         // Latest time passed in
+
+    uint16_t nextPacketId;
+    Inflight inflight[MAX_INFLIGHT];
+    uint32_t publishSequence;
+
+    // Incoming packet assembly
+    uint8_t rxHeader;
+    uint32_t rxRemaining;
+    uint32_t rxLength;
+    uint8_t rxLengthBytes;
+    uint32_t rxLengthMultiplier;
+    uint8_t rxStage;
+    uint8_t rxBuffer[MAX_INCOMING_PACKET];
+
+    uint8_t header[MAX_HEADER];
+
+    uint32_t sentBytes;
+    uint32_t receivedBytes;
+    uint32_t acked;
+
+    uint16_t allocatePacketId();
+    bool send(const uint8_t* head, size_t headLength, const uint8_t* body, size_t bodyLength);
+    bool sendSimple(uint8_t type, uint16_t packetId);
+    void handlePacket(uint8_t type, uint8_t flags, const uint8_t* body, size_t length);
+
+    static size_t encodeLength(uint8_t* out, uint32_t length);
+    static size_t putString(uint8_t* out, const char* text, size_t length);
+};
+
+#endif // MQTTSESSION_H
@@ -0,0 +1,24 @@
+#ifndef MONOCLOCK_H
+#define MONOCLOCK_H
+
+#include <Arduino.h>
+#ifdef ARDUINO
+#include <esp_timer.h>
+#endif
+
+// Time since boot from the 64-bit esp_timer count. millis() wraps after
+// 49.7 days; this does not in the life of the unit, so absolute times can
+// be compared directly and 0 can stand for "never". On the host it runs on
+// HostArduino's virtual clock.
+//
+// Keep interval arithmetic in uint64_t: narrowing to unsigned long brings
+// the wrap back.
+inline uint64_t monoMicros() {
+    return (uint64_t)esp_timer_get_time();
+}
+
+inline uint64_t monoMillis() {
+    return monoMicros() / 1000;
+}
+
+#endif // MONOCLOCK_H
@@ -0,0 +1,141 @@
+#ifdef ARDUINO
+
+#include "LittleFSLogStorage.h"
+#include <LittleFS.h>
+
+LittleFSLogStorage::LittleFSLogStorage(const char* directory)
+    : directory(directory), mounted(false), readFileSegment(0), readFileOpen(false) {
+}
+
+bool LittleFSLogStorage::begin() {
+    if (mounted) {
+        return true;
+    }
+
+    // Format on first use; the partition holds nothing else
+    if (!LittleFS.begin(true)) {
+        return false;
+    }
+    if (!LittleFS.exists(directory) && !LittleFS.mkdir(directory)) {
+        return false;
+    }
+    mounted = true;
+    return true;
+}
+
+String LittleFSLogStorage::segmentPath(uint32_t segment) const {
+    char name[16];
+    snprintf(name, sizeof(name), "/%08lx.seg", (unsigned long)segment);
+    return String(directory) + name;
+}
+
+void LittleFSLogStorage::closeReadFile() {
+    if (readFileOpen) {
+        readFile.close();
+        readFileOpen = false;
+    }
+}
+
+size_t LittleFSLogStorage::segmentSize(uint32_t segment) {
+    File file = LittleFS.open(segmentPath(segment), "r");
+    if (!file) {
+        return 0;
+    }
+    size_t size = file.size();
+    file.close();
+    return size;
+}
+
+bool LittleFSLogStorage::readSegment(uint32_t segment, size_t offset, void* data, size_t length) {
+    if (!readFileOpen || readFileSegment != segment) {
+        closeReadFile();
+        readFile = LittleFS.open(segmentPath(segment), "r");
+        if (!readFile) {
+            return false;
+        }
+        readFileSegment = segment;
+        readFileOpen = true;
+    }
+
+    if (!readFile.seek(offset)) {
+        return false;
+    }
+    return readFile.read(static_cast<uint8_t*>(data), length) == length;
+}
+
+bool LittleFSLogStorage::writeSegment(uint32_t segment, size_t offset, const void* data, size_t length) {
+    // The cached handle would not see the new data
+    if (readFileOpen && readFileSegment == segment) {
+        closeReadFile();
+    }
+
+    String path = segmentPath(segment);
+    File file = LittleFS.open(path, LittleFS.exists(path) ? "r+" : "w");
+    if (!file) {
+        return false;
+    }
+
+    bool ok = file.seek(offset) && file.write(static_cast<const uint8_t*>(data), length) == length;
+    file.close();
+    return ok;
+}
+
+bool LittleFSLogStorage::removeSegment(uint32_t segment) {
+    if (readFileOpen && readFileSegment == segment) {
+        closeReadFile();
+    }
+
+    String path = segmentPath(segment);
+    return !LittleFS.exists(path) || LittleFS.remove(path);
+}
+
+bool LittleFSLogStorage::segmentRange(uint32_t& first, uint32_t& last) {
+    File dir = LittleFS.open(directory);
+    if (!dir || !dir.isDirectory()) {
+        return false;
+    }
+
+    bool any = false;
+    for (File entry = dir.openNextFile(); entry; entry = dir.openNextFile()) {
+        const char* name = strrchr(entry.name(), '/');
+        name = name != nullptr ? name + 1 : entry.name();
+
+        char* end = nullptr;
+        unsigned long segment = strtoul(name, &end, 16);
+        if (end == name || strcmp(end, ".seg") != 0) {
+            continue;
+        }
+
+        if (!any || segment < first) first = segment;
+        if (!any || segment > last) last = segment;
+        any = true;
+    }
+    return any;
+}
+
+bool LittleFSLogStorage::readMeta(void* data, size_t length) {
+    File file = LittleFS.open(String(directory) + "/meta", "r");
+    if (!file) {
+        return false;
+    }
+    bool ok = file.read(static_cast<uint8_t*>(data), length) == length;
+    file.close();
+    return ok;
+}
+
+bool LittleFSLogStorage::writeMeta(const void* data, size_t length) {
+    // Write aside and rename over: littlefs renames atomically, so a reset
+    // mid-write leaves the previous cursor rather than an empty file
+    String path = String(directory) + "/meta";
+    String temp = path + ".tmp";
+
+    File file = LittleFS.open(temp, "w");
+    if (!file) {
+        return false;
+    }
+    bool ok = file.write(static_cast<const uint8_t*>(data), length) == length;
+    file.close();
+    return ok && LittleFS.rename(temp, path);
+}
+
+#endif // ARDUINO
@@ -0,0 +1,40 @@
+#ifndef LITTLEFSLOGSTORAGE_H
+#define LITTLEFSLOGSTORAGE_H
+
+#ifdef ARDUINO
+
+#include <FS.h>
+#include "LogStorage.h"
+
+// LogStorage on the LittleFS data partition. Each segment is one file in
+// `directory`; littlefs commits a file on close, so a record is either fully
+// written or not there after a power loss.
+class LittleFSLogStorage : public LogStorage {
+public:
+    explicit LittleFSLogStorage(const char* directory = "/uq");
+
+    bool begin();
+    size_t segmentSize(uint32_t segment);
+    bool readSegment(uint32_t segment, size_t offset, void* data, size_t length);
+    bool writeSegment(uint32_t segment, size_t offset, const void* data, size_t length);
+    bool removeSegment(uint32_t segment);
+    bool segmentRange(uint32_t& first, uint32_t& last);
+    bool readMeta(void* data, size_t length);
+    bool writeMeta(const void* data, size_t length);
+
+private:
+    const char* directory;
+    bool mounted;
+
+    // Drains read one record at a time, so keep the segment being read open
+    File readFile;
+    uint32_t readFileSegment;
+    bool readFileOpen;
+
+    String segmentPath(uint32_t segment) const;
+    void closeReadFile();
+};
+
+#endif // ARDUINO
+
+#endif // LITTLEFSLOGSTORAGE_H
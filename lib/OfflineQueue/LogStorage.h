@@ -0,0 +1,28 @@
+#ifndef LOGSTORAGE_H
+#define LOGSTORAGE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Backing store for UploadQueue: numbered segment blobs plus one small
+// metadata blob. Segments that do not exist read as empty.
+class LogStorage {
+public:
+    virtual ~LogStorage() {}
+
+    virtual bool begin() = 0;
+
+    virtual size_t segmentSize(uint32_t segment) = 0;
+    virtual bool readSegment(uint32_t segment, size_t offset, void* data, size_t length) = 0;
+    // Creates the segment if needed; offset must not be past its current end
+    virtual bool writeSegment(uint32_t segment, size_t offset, const void* data, size_t length) = 0;
+    virtual bool removeSegment(uint32_t segment) = 0;
+
+    // Lowest and highest segment present; false if there are none
+    virtual bool segmentRange(uint32_t& first, uint32_t& last) = 0;
+
+    virtual bool readMeta(void* data, size_t length) = 0;
+    virtual bool writeMeta(const void* data, size_t length) = 0;
+};
+
+#endif // LOGSTORAGE_H
@@ -0,0 +1,117 @@
+#include "RAMLogStorage.h"
+#include <string.h>
+
+RAMLogStorage::RAMLogStorage(size_t segmentBytes, uint32_t maxSegments)
+    : segmentBytes(segmentBytes), maxSegments(maxSegments), metaSize(0) {
+    slots = new Slot[maxSegments];
+    for (uint32_t i = 0; i < maxSegments; i++) {
+        slots[i].used = false;
+        slots[i].segment = 0;
+        slots[i].size = 0;
+        slots[i].data = nullptr;
+    }
+}
+
+RAMLogStorage::~RAMLogStorage() {
+    for (uint32_t i = 0; i < maxSegments; i++) {
+        delete[] slots[i].data;
+    }
+    delete[] slots;
+}
+
+bool RAMLogStorage::begin() {
+    return true;
+}
+
+RAMLogStorage::Slot* RAMLogStorage::find(uint32_t segment) {
+    for (uint32_t i = 0; i < maxSegments; i++) {
+        if (slots[i].used && slots[i].segment == segment) {
+            return &slots[i];
+        }
+    }
+    return nullptr;
+}
+
+size_t RAMLogStorage::segmentSize(uint32_t segment) {
+    Slot* slot = find(segment);
+    return slot != nullptr ? slot->size : 0;
+}
+
+bool RAMLogStorage::readSegment(uint32_t segment, size_t offset, void* data, size_t length) {
+    Slot* slot = find(segment);
+    if (slot == nullptr || offset + length > slot->size) {
+        return false;
+    }
+    memcpy(data, slot->data + offset, length);
+    return true;
+}
+
+bool RAMLogStorage::writeSegment(uint32_t segment, size_t offset, const void* data, size_t length) {
+    if (offset + length > segmentBytes) {
+        return false;
+    }
+
+    Slot* slot = find(segment);
+    if (slot == nullptr) {
+        for (uint32_t i = 0; i < maxSegments && slot == nullptr; i++) {
+            if (!slots[i].used) {
+                slot = &slots[i];
+            }
+        }
+        if (slot == nullptr) {
+            return false;
+        }
+        if (slot->data == nullptr) {
+            slot->data = new uint8_t[segmentBytes];
+        }
+        slot->used = true;
+        slot->segment = segment;
+        slot->size = 0;
+    }
+
+    if (offset > slot->size) {
+        return false;
+    }
+    memcpy(slot->data + offset, data, length);
+    if (offset + length > slot->size) {
+        slot->size = offset + length;
+    }
+    return true;
+}
+
+bool RAMLogStorage::removeSegment(uint32_t segment) {
+    Slot* slot = find(segment);
+    if (slot != nullptr) {
+        slot->used = false;
+        slot->size = 0;
+    }
+    return true;
+}
+
+bool RAMLogStorage::segmentRange(uint32_t& first, uint32_t& last) {
+    bool any = false;
+    for (uint32_t i = 0; i < maxSegments; i++) {
+        if (!slots[i].used) continue;
+        if (!any || slots[i].segment < first) first = slots[i].segment;
+        if (!any || slots[i].segment > last) last = slots[i].segment;
+        any = true;
+    }
+    return any;
+}
+
+bool RAMLogStorage::readMeta(void* data, size_t length) {
+    if (metaSize != length) {
+        return false;
+    }
+    memcpy(data, meta, length);
+    return true;
+}
+
+bool RAMLogStorage::writeMeta(const void* data, size_t length) {
+    if (length > META_SIZE) {
+        return false;
+    }
+    memcpy(meta, data, length);
+    metaSize = length;
+    return true;
+}
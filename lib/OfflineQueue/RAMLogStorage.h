@@ -0,0 +1,45 @@
+#ifndef RAMLOGSTORAGE_H
+#define RAMLOGSTORAGE_H
+
+#include "LogStorage.h"
+
+// Volatile LogStorage used when no filesystem is available (and by the host
+// tests). Holds up to maxSegments segments of segmentBytes each.
+class RAMLogStorage : public LogStorage {
+public:
+    RAMLogStorage(size_t segmentBytes, uint32_t maxSegments);
+    ~RAMLogStorage();
+
+    bool begin();
+    size_t segmentSize(uint32_t segment);
+    bool readSegment(uint32_t segment, size_t offset, void* data, size_t length);
+    bool writeSegment(uint32_t segment, size_t offset, const void* data, size_t length);
+    bool removeSegment(uint32_t segment);
+    bool segmentRange(uint32_t& first, uint32_t& last);
+    bool readMeta(void* data, size_t length);
+    bool writeMeta(const void* data, size_t length);
+
+private:
+    struct Slot {
+        bool used;
+        uint32_t segment;
+        size_t size;
+        uint8_t* data;
+    };
+
+    static const size_t META_SIZE = 32;
+
+    size_t segmentBytes;
+    uint32_t maxSegments;
+    Slot* slots;
+    uint8_t meta[META_SIZE];
+    size_t metaSize;
+
+    Slot* find(uint32_t segment);
+
+    // Not copyable
+    RAMLogStorage(const RAMLogStorage&);
+    RAMLogStorage& operator=(const RAMLogStorage&);
+};
+
+#endif // RAMLOGSTORAGE_H
@@ -0,0 +1,163 @@
+#include "UploadQueue.h"
+#include <string.h>
+
+UploadQueue::UploadQueue(LogStorage& storage, uint32_t recordsPerSegment, uint32_t maxSegments, uint8_t readers)
+    : storage(storage),
+      recordsPerSegment(recordsPerSegment > 0 ? recordsPerSegment : 1),
+      maxSegments(maxSegments > 1 ? maxSegments : 2),
+      readers(readers < 1 ? 1 : (readers > MAX_READERS ? MAX_READERS : readers)),
+      ready(false), cursor(0), nextSequence(0), firstSegment(0), bootId(0),
+      dropped(0), corrupt(0) {
+    memset(cursors, 0, sizeof(cursors));
+}
+
+uint32_t UploadQueue::crc32(const void* data, size_t length) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    uint32_t crc = 0xFFFFFFFF;
+    for (size_t i = 0; i < length; i++) {
+        crc ^= bytes[i];
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+        }
+    }
+    return ~crc;
+}
+
+bool UploadQueue::begin() {
+    ready = false;
+    if (!storage.begin()) {
+        return false;
+    }
+
+    Meta meta;
+    if (storage.readMeta(&meta, sizeof(meta)) && meta.magic == META_MAGIC &&
+        meta.crc == crc32(&meta, offsetof(Meta, crc))) {
+        memcpy(cursors, meta.cursors, sizeof(cursors));
+        bootId = (uint16_t)(meta.bootId + 1);
+    } else {
+        memset(cursors, 0, sizeof(cursors));
+        bootId = 1;
+    }
+    updateTail();
+
+    uint32_t first = 0;
+    uint32_t last = 0;
+    if (storage.segmentRange(first, last)) {
+        // A torn trailing write leaves a partial slot; it is overwritten next
+        uint32_t stored = storage.segmentSize(last) / sizeof(Entry);
+        if (stored > recordsPerSegment) stored = recordsPerSegment;
+        nextSequence = last * recordsPerSegment + stored;
+        firstSegment = first;
+
+        // Segments below the first one present were delivered or dropped
+        for (uint8_t r = 0; r < readers; r++) {
+            if (cursors[r] < first * recordsPerSegment) cursors[r] = first * recordsPerSegment;
+            if (cursors[r] > nextSequence) cursors[r] = nextSequence;
+        }
+    } else {
+        // Nothing stored: everyone is caught up at the furthest cursor
+        uint32_t furthest = 0;
+        for (uint8_t r = 0; r < readers; r++) {
+            if (cursors[r] > furthest) furthest = cursors[r];
+        }
+        for (uint8_t r = 0; r < readers; r++) cursors[r] = furthest;
+        nextSequence = furthest;
+        firstSegment = furthest / recordsPerSegment;
+    }
+    updateTail();
+
+    ready = saveMeta();
+    return ready;
+}
+
+bool UploadQueue::push(const TelemetryRecord& record) {
+    if (!ready) {
+        return false;
+    }
+
+    uint32_t segment = nextSequence / recordsPerSegment;
+    while (segment - firstSegment >= maxSegments) {
+        dropOldestSegment();
+    }
+
+    Entry entry;
+    memset(&entry, 0, sizeof(entry));
+    entry.sequence = nextSequence;
+    entry.bootId = bootId;
+    entry.record = record;
+    entry.crc = crc32(&entry, offsetof(Entry, crc));
+
+    size_t offset = (nextSequence % recordsPerSegment) * sizeof(Entry);
+    if (!storage.writeSegment(segment, offset, &entry, sizeof(entry))) {
+        return false;
+    }
+    nextSequence++;
+    return true;
+}
+
+bool UploadQueue::read(uint32_t sequence, Entry& entry) {
+    if (!ready || sequence < cursor || sequence >= nextSequence) {
+        return false;
+    }
+
+    uint32_t segment = sequence / recordsPerSegment;
+    size_t offset = (sequence % recordsPerSegment) * sizeof(Entry);
+    if (!storage.readSegment(segment, offset, &entry, sizeof(entry)) ||
+        entry.sequence != sequence || entry.crc != crc32(&entry, offsetof(Entry, crc))) {
+        corrupt++;
+        return false;
+    }
+    return true;
+}
+
+bool UploadQueue::acknowledge(uint32_t sequence, uint8_t reader) {
+    if (!ready || reader >= readers || sequence < cursors[reader]) {
+        return false;
+    }
+
+    cursors[reader] = sequence + 1 < nextSequence ? sequence + 1 : nextSequence;
+    updateTail();
+    removeConsumedSegments();
+    return saveMeta();
+}
+
+void UploadQueue::updateTail() {
+    cursor = cursors[0];
+    for (uint8_t r = 1; r < readers; r++) {
+        if (cursors[r] < cursor) cursor = cursors[r];
+    }
+}
+
+bool UploadQueue::saveMeta() {
+    Meta meta;
+    memset(&meta, 0, sizeof(meta));
+    meta.magic = META_MAGIC;
+    memcpy(meta.cursors, cursors, sizeof(cursors));
+    meta.bootId = bootId;
+    meta.crc = crc32(&meta, offsetof(Meta, crc));
+    return storage.writeMeta(&meta, sizeof(meta));
+}
+
+void UploadQueue::dropOldestSegment() {
+    uint32_t segmentEnd = (firstSegment + 1) * recordsPerSegment;
+    if (cursor < segmentEnd) {
+        // Counted once, for the reader that was furthest behind
+        dropped += segmentEnd - cursor;
+        for (uint8_t r = 0; r < readers; r++) {
+            if (cursors[r] < segmentEnd) cursors[r] = segmentEnd;
+        }
+        updateTail();
+        saveMeta();
+    }
+    storage.removeSegment(firstSegment);
+    firstSegment++;
+}
+
+void UploadQueue::removeConsumedSegments() {
+    // The segment being written stays even when fully read
+    uint32_t writeSegment = nextSequence / recordsPerSegment;
+    while (firstSegment < writeSegment && (firstSegment + 1) * recordsPerSegment <= cursor) {
+        storage.removeSegment(firstSegment);
+        firstSegment++;
+    }
+}
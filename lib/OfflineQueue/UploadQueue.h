@@ -0,0 +1,92 @@
+#ifndef UPLOADQUEUE_H
+#define UPLOADQUEUE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "LogStorage.h"
+#include "TelemetryRecord.h"
+
+// Append-only log of readings waiting for upload.
+//
+// Every record gets a sequence number and is written once, CRC-protected, at
+// a fixed slot in segment (sequence / recordsPerSegment). A persistent read
+// cursor marks the first record not yet acknowledged by the server; segments
+// that fall fully behind it are deleted whole. When the log reaches
+// maxSegments the oldest segment is dropped, so flash is always reclaimed in
+// segment-sized chunks and nothing is rewritten in place.
+//
+// Several readers (one per upload backend) can drain the same log, each
+// with its own persistent cursor. A segment is deleted once every reader is
+// past it; rotation moves any reader still inside the dropped segment on.
+class UploadQueue {
+public:
+    struct Entry {
+        uint32_t sequence;
+        uint16_t bootId;        // Boot the record was captured in
+        uint16_t reserved;
+        TelemetryRecord record;
+        uint32_t crc;
+    };
+
+    static const uint8_t MAX_READERS = 4;
+
+    UploadQueue(LogStorage& storage, uint32_t recordsPerSegment, uint32_t maxSegments, uint8_t readers = 1);
+
+    // Recovers cursor and write position from storage and starts a new boot
+    bool begin();
+    bool isReady() const { return ready; }
+
+    bool push(const TelemetryRecord& record);
+
+    // Reads one record; false if no reader still needs it or it fails its CRC
+    bool read(uint32_t sequence, Entry& entry);
+
+    // Marks every record up to and including `sequence` as delivered by reader
+    bool acknowledge(uint32_t sequence, uint8_t reader = 0);
+
+    uint32_t readCursor(uint8_t reader = 0) const { return cursors[reader < readers ? reader : 0]; }
+    uint32_t writeSequence() const { return nextSequence; }
+    uint32_t pending() const { return nextSequence - cursor; }     // For the slowest reader
+    uint32_t pending(uint8_t reader) const { return nextSequence - readCursor(reader); }
+    uint8_t readerCount() const { return readers; }
+    uint32_t capacity() const { return recordsPerSegment * maxSegments; }
+    uint16_t currentBootId() const { return bootId; }
+
+    // Records lost to rotation or failed CRC checks since begin()
+    uint32_t droppedCount() const { return dropped; }
+    uint32_t corruptCount() const { return corrupt; }
+
+    static uint32_t crc32(const void* data, size_t length);
+
+private:
+    struct Meta {
+        uint32_t magic;
+        uint32_t cursors[MAX_READERS];
+        uint32_t bootId;
+        uint32_t crc;
+    };
+
+    static const uint32_t META_MAGIC = 0x55510002;
+
+    LogStorage& storage;
+    uint32_t recordsPerSegment;
+    uint32_t maxSegments;
+    uint8_t readers;
+    bool ready;
+
+    uint32_t cursors[MAX_READERS];
+    uint32_t cursor;            // Slowest reader
+    uint32_t nextSequence;
+    uint32_t firstSegment;
+    uint16_t bootId;
+
+    uint32_t dropped;
+    uint32_t corrupt;
+
+    bool saveMeta();
+    void updateTail();
+    void dropOldestSegment();
+    void removeConsumedSegments();
+};
+
+#endif // UPLOADQUEUE_H
@@ -0,0 +1,1086 @@
+#include "SIM800Simulator.h"
+#include "CivilTime.h"
+
+namespace {
+    const int SIM_CAPACITY = 30;
+    const char CTRL_Z = 26;
+    const char ESC = 27;
+
+    bool startsWith(const String& text, const char* prefix) {
+        return strncmp(text.c_str(), prefix, strlen(prefix)) == 0;
+    }
+
+    // n-th quoted field, or the bare value after the n-th comma-separated
+    // position if it is not quoted ("CID",1)
+    String field(const String& command, int n) {
+        int start = command.indexOf('=') + 1;
+        int index = 0;
+        bool quoted = false;
+        String value;
+        for (unsigned int i = start; i < command.length(); i++) {
+            char c = command[i];
+            if (c == '"') {
+                quoted = !quoted;
+            } else if (c == ',' && !quoted) {
+                if (index == n) return value;
+                index++;
+                value = "";
+            } else if (index == n) {
+                value += c;
+            }
+        }
+        return index == n ? value : String();
+    }
+
+    int hexValue(char c) {
+        if (c >= '0' && c <= '9') return c - '0';
+        if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+        if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+        return -1;
+    }
+
+    char septetToChar(uint8_t septet, bool escaped) {
+        if (escaped) {
+            switch (septet) {
+                case 0x14: return '^';
+                case 0x28: return '{';
+                case 0x29: return '}';
+                case 0x2F: return '\\';
+                case 0x3C: return '[';
+                case 0x3D: return '~';
+                case 0x3E: return ']';
+                case 0x40: return '|';
+                default: return '?';
+            }
+        }
+        switch (septet) {
+            case 0x00: return '@';
+            case 0x02: return '$';
+            case 0x0A: return '\n';
+            case 0x0D: return '\r';
+            case 0x11: return '_';
+            case 0x24:
+            case 0x40:
+                return '?';
+            default:
+                break;
+        }
+        bool ascii = (septet >= 0x20 && septet <= 0x5A) || (septet >= 0x61 && septet <= 0x7A);
+        return ascii ? (char)septet : '?';
+    }
+}
+
+SIM800Simulator::SIM800Simulator() {
+    readPosition = 0;
+    inputMode = INPUT_COMMAND;
+    skipLineFeed = false;
+    smsDeclaredLength = 0;
+    httpDataRemaining = 0;
+    lineBaud = 0;
+    hostBaud = 9600;
+    baudSwitchPending = false;
+    nextLineBaud = 0;
+    responseDelay = 20;
+    dropPerMille = 0;
+    dropState = 1;
+    settings.echo = true;
+    settings.errorMode = 0;
+    settings.textMode = false;
+    settings.charset = "IRA";
+    settings.messageIndication = "2,1,0,0,0";
+    settings.submitParameters = "17,167,0,0";
+    settings.networkTimeSync = false;
+    settings.baud = 0;
+    savedSettings = settings;
+    bootedAt = 0;
+    slowClock = false;
+    dtrPin = -1;
+    networkUp = true;
+    bearer = false;
+    httpInitialized = false;
+    httpStatus = 200;
+    rssi = 18;
+    clockEpoch = 0;
+    clockSetAt = 0;
+    messageReference = 0;
+    nextStoredIndex = 1;
+    hostBytes = 0;
+    modemBytes = 0;
+
+    // Typical latencies measured on a SIM800L on a 2G network
+    setCommandDelay("AT+SAPBR=1", 1500);
+    setCommandDelay("AT+SAPBR=0", 300);
+    setCommandDelay("AT+CMGS", 2500);
+    setCommandDelay("AT+HTTPACTION", 1800);
+    setCommandDelay("AT+COPS", 200);
+    setCommandDelay("AT+CMGL", 100);
+}
+
+int SIM800Simulator::available() {
+    tick();
+    unsigned long now = micros();
+    size_t released = 0;
+    while (released < pending.size() && (long)(now - pending[released].dueMicros) >= 0) {
+        if (pending[released].baud == hostBaud) {
+            readable += pending[released].bytes;
+        }
+        released++;
+    }
+    pending.erase(pending.begin(), pending.begin() + released);
+    return (int)(readable.size() - readPosition);
+}
+
+int SIM800Simulator::read() {
+    if (available() == 0) {
+        return -1;
+    }
+    char c = readable[readPosition++];
+    modemBytes++;
+    if (readPosition == readable.size()) {
+        readable.clear();
+        readPosition = 0;
+    }
+    return (uint8_t)c;
+}
+
+int SIM800Simulator::peek() {
+    if (available() == 0) {
+        return -1;
+    }
+    return (uint8_t)readable[readPosition];
+}
+
+size_t SIM800Simulator::write(uint8_t c) {
+    tick();
+
+    // Bytes sent to a sleeping or still booting modem are lost
+    if (asleep() || (long)(millis() - bootedAt) < 0) {
+        return 1;
+    }
+    if (lineBaud == 0) {
+        lineBaud = hostBaud;
+    }
+    if (lineBaud != hostBaud) {
+        return 1;
+    }
+    hostBytes++;
+
+    if (skipLineFeed) {
+        skipLineFeed = false;
+        if (c == '\n') {
+            return 1;
+        }
+    }
+
+    switch (inputMode) {
+        case INPUT_COMMAND:
+            if (c == '\r' || c == '\n') {
+                if (!inputLine.empty()) {
+                    String line(inputLine);
+                    inputLine.clear();
+                    skipLineFeed = c == '\r';
+                    executeLine(line);
+                }
+            } else {
+                inputLine += (char)c;
+            }
+            break;
+
+        case INPUT_SMS:
+            if (c == CTRL_Z) {
+                std::string body = inputLine;
+                inputLine.clear();
+                inputMode = INPUT_COMMAND;
+                finishSMS(body);
+            } else if (c == ESC) {
+                inputLine.clear();
+                inputMode = INPUT_COMMAND;
+                emitLines(std::vector<String>(1, "OK"), responseDelay);
+            } else {
+                inputLine += (char)c;
+            }
+            break;
+
+        case INPUT_HTTP_DATA:
+            httpBody += (char)c;
+            if (--httpDataRemaining == 0) {
+                finishHTTPData();
+            }
+            break;
+    }
+    return 1;
+}
+
+void SIM800Simulator::setBaudRate(unsigned long baud) {
+    settings.baud = baud;
+    savedSettings.baud = baud;
+    lineBaud = baud;
+}
+
+void SIM800Simulator::setHostBaudRate(unsigned long baud) {
+    hostBaud = baud;
+}
+
+void SIM800Simulator::hostBaudRateSetter(unsigned long baud, void* simulator) {
+    static_cast<SIM800Simulator*>(simulator)->setHostBaudRate(baud);
+}
+
+void SIM800Simulator::setResponseDelay(unsigned long ms) {
+    responseDelay = ms;
+}
+
+void SIM800Simulator::setCommandDelay(const char* prefix, unsigned long ms) {
+    for (size_t i = 0; i < delays.size(); i++) {
+        if (delays[i].prefix == prefix) {
+            delays[i].ms = ms;
+            return;
+        }
+    }
+    Delay entry;
+    entry.prefix = prefix;
+    entry.ms = ms;
+    delays.push_back(entry);
+}
+
+void SIM800Simulator::injectFault(const char* prefix, Fault fault, int count) {
+    ScriptedFault entry;
+    entry.prefix = prefix;
+    entry.fault = fault;
+    entry.remaining = count;
+    faults.push_back(entry);
+}
+
+void SIM800Simulator::setLineDropRate(unsigned int perMille, uint32_t seed) {
+    dropPerMille = perMille;
+    dropState = seed != 0 ? seed : 1;
+}
+
+void SIM800Simulator::setNetworkAvailable(bool available) {
+    if (available == networkUp) {
+        return;
+    }
+    networkUp = available;
+    if (!networkUp && bearer) {
+        bearer = false;
+        emitURC("+SAPBR 1: DEACT");
+    }
+}
+
+void SIM800Simulator::scheduleNetworkOutage(unsigned long at, unsigned long duration) {
+    Outage outage;
+    outage.start = at;
+    outage.end = at + duration;
+    outage.started = false;
+    outages.push_back(outage);
+}
+
+void SIM800Simulator::setSignalQuality(int value) {
+    rssi = value;
+}
+
+void SIM800Simulator::setHTTPStatus(int status) {
+    httpStatus = status;
+}
+
+void SIM800Simulator::setHTTPStatus(const char* urlPrefix, int status) {
+    for (size_t i = 0; i < endpoints.size(); i++) {
+        if (endpoints[i].prefix == urlPrefix) {
+            endpoints[i].status = status;
+            return;
+        }
+    }
+    Endpoint entry;
+    entry.prefix = urlPrefix;
+    entry.status = status;
+    endpoints.push_back(entry);
+}
+
+void SIM800Simulator::setHTTPResponse(const char* body) {
+    httpResponse = body;
+}
+
+void SIM800Simulator::setNetworkTime(uint32_t epoch) {
+    clockEpoch = epoch;
+    clockSetAt = millis();
+}
+
+void SIM800Simulator::setDeliveryReport(const char* numberPrefix, int status, unsigned long delay) {
+    for (size_t i = 0; i < deliveryScripts.size(); i++) {
+        if (deliveryScripts[i].prefix == numberPrefix) {
+            deliveryScripts[i].status = status;
+            deliveryScripts[i].delay = delay;
+            return;
+        }
+    }
+    DeliveryScript script;
+    script.prefix = numberPrefix;
+    script.status = status;
+    script.delay = delay;
+    deliveryScripts.push_back(script);
+}
+
+void SIM800Simulator::setSleepControl(int pin) {
+    dtrPin = pin;
+}
+
+void SIM800Simulator::receiveSMS(const char* sender, const char* text) {
+    if (settings.textMode && messageMode() == 2) {
+        std::vector<String> lines;
+        lines.push_back("+CMT: \"" + String(sender) + "\",\"\",\"" + clockText() + "\"");
+        lines.push_back(text);
+        emitLines(lines, 0);
+        return;
+    }
+
+    storeSMS(sender, text);
+    emitURC("+CMTI: \"SM\"," + String(storage.back().index));
+}
+
+void SIM800Simulator::storeSMS(const char* sender, const char* text) {
+    if ((int)storage.size() >= SIM_CAPACITY) {
+        return;
+    }
+    StoredSMS sms;
+    sms.index = nextStoredIndex;
+    sms.sender = sender;
+    sms.text = text;
+    sms.read = false;
+    storage.push_back(sms);
+    nextStoredIndex = nextStoredIndex % SIM_CAPACITY + 1;
+}
+
+void SIM800Simulator::powerCycle(unsigned long bootTime) {
+    settings = savedSettings;
+    lineBaud = settings.baud;
+    slowClock = false;
+    bearer = false;
+    httpInitialized = false;
+    inputMode = INPUT_COMMAND;
+    inputLine.clear();
+    pending.clear();
+    readable.clear();
+    readPosition = 0;
+    bootedAt = millis() + bootTime;
+
+    std::vector<String> lines;
+    lines.push_back("RDY");
+    lines.push_back("+CFUN: 1");
+    lines.push_back("+CPIN: READY");
+    lines.push_back("Call Ready");
+    lines.push_back("SMS Ready");
+    emitLines(lines, bootTime);
+}
+
+void SIM800Simulator::ring() {
+    emitURC("RING");
+}
+
+int SIM800Simulator::commandCount(const char* prefix) const {
+    int count = 0;
+    for (size_t i = 0; i < commands.size(); i++) {
+        if (startsWith(commands[i], prefix)) {
+            count++;
+        }
+    }
+    return count;
+}
+
+int SIM800Simulator::storedSMSCount() const {
+    return (int)storage.size();
+}
+
+bool SIM800Simulator::asleep() const {
+    return slowClock && dtrPin >= 0 && digitalRead(dtrPin) == HIGH;
+}
+
+void SIM800Simulator::clearLogs() {
+    smsSent.clear();
+    requests.clear();
+    commands.clear();
+    hostBytes = 0;
+    modemBytes = 0;
+}
+
+void SIM800Simulator::tick() {
+    unsigned long now = millis();
+    for (size_t i = 0; i < outages.size(); ) {
+        Outage& outage = outages[i];
+        if (!outage.started && (long)(now - outage.start) >= 0) {
+            outage.started = true;
+            setNetworkAvailable(false);
+        }
+        if (outage.started && (long)(now - outage.end) >= 0) {
+            setNetworkAvailable(true);
+            outages.erase(outages.begin() + i);
+            continue;
+        }
+        i++;
+    }
+    for (size_t i = 0; i < statusReports.size(); ) {
+        if ((long)(now - statusReports[i].due) >= 0) {
+            StatusReport report = statusReports[i];
+            statusReports.erase(statusReports.begin() + i);
+            emitReport(report);
+            continue;
+        }
+        i++;
+    }
+}
+
+void SIM800Simulator::schedule(const std::string& bytes, unsigned long delayMs) {
+    // Due once the latency has passed and the last byte is on the wire
+    Chunk chunk;
+    chunk.baud = lineBaud != 0 ? lineBaud : hostBaud;
+    chunk.dueMicros = micros() + delayMs * 1000 + (unsigned long)(bytes.size() * 10000000ULL / chunk.baud);
+    chunk.bytes = bytes;
+
+    // Keep release order by due time; equal times keep their send order
+    size_t position = pending.size();
+    while (position > 0 && (long)(pending[position - 1].dueMicros - chunk.dueMicros) > 0) {
+        position--;
+    }
+    pending.insert(pending.begin() + position, chunk);
+}
+
+void SIM800Simulator::emitLines(const std::vector<String>& lines, unsigned long delayMs, bool dropFinal) {
+    std::string bytes;
+    for (size_t i = 0; i < lines.size(); i++) {
+        if (dropFinal && i + 1 == lines.size()) {
+            break;
+        }
+        if (dropLine()) {
+            continue;
+        }
+        // An SMS text follows its header directly, with no blank line
+        bool body = i > 0 && (startsWith(lines[i - 1], "+CMT:") || startsWith(lines[i - 1], "+CMGL:") ||
+                              startsWith(lines[i - 1], "+CMGR:"));
+        if (!body) {
+            bytes += "\r\n";
+        }
+        bytes += lines[i].c_str();
+        bytes += "\r\n";
+    }
+    if (!bytes.empty()) {
+        schedule(bytes, delayMs);
+    }
+}
+
+void SIM800Simulator::emitURC(const String& line, unsigned long delayMs) {
+    emitLines(std::vector<String>(1, line), delayMs);
+}
+
+bool SIM800Simulator::dropLine() {
+    if (dropPerMille == 0) {
+        return false;
+    }
+    dropState ^= dropState << 13;
+    dropState ^= dropState >> 17;
+    dropState ^= dropState << 5;
+    return dropState % 1000 < dropPerMille;
+}
+
+unsigned long SIM800Simulator::delayFor(const String& command) const {
+    for (size_t i = 0; i < delays.size(); i++) {
+        if (startsWith(command, delays[i].prefix.c_str())) {
+            return delays[i].ms;
+        }
+    }
+    return responseDelay;
+}
+
+int SIM800Simulator::statusFor(const String& url) const {
+    for (size_t i = 0; i < endpoints.size(); i++) {
+        if (startsWith(url, endpoints[i].prefix.c_str())) {
+            return endpoints[i].status;
+        }
+    }
+    return httpStatus;
+}
+
+SIM800Simulator::ScriptedFault* SIM800Simulator::faultFor(const String& command) {
+    for (size_t i = 0; i < faults.size(); i++) {
+        if (faults[i].remaining > 0 && startsWith(command, faults[i].prefix.c_str())) {
+            faults[i].remaining--;
+            return &faults[i];
+        }
+    }
+    return nullptr;
+}
+
+void SIM800Simulator::executeLine(const String& line) {
+    commands.push_back(line);
+    if (settings.echo) {
+        schedule(std::string(line.c_str()) + "\r\n", 0);
+    }
+
+    if (line.length() < 2 || !(toupper(line[0]) == 'A' && toupper(line[1]) == 'T')) {
+        return;
+    }
+
+    // Chained commands share one final result: AT+CMGD=1;+CMGD=2
+    std::vector<String> parts;
+    String part = "AT";
+    bool quoted = false;
+    for (unsigned int i = 2; i < line.length(); i++) {
+        char c = line[i];
+        if (c == '"') {
+            quoted = !quoted;
+        }
+        if (c == ';' && !quoted) {
+            parts.push_back(part);
+            part = "AT";
+        } else {
+            part += c;
+        }
+    }
+    parts.push_back(part);
+
+    std::vector<String> lines;
+    unsigned long latency = responseDelay;
+    bool dropFinal = false;
+    baudSwitchPending = false;
+
+    for (size_t i = 0; i < parts.size(); i++) {
+        const String& command = parts[i];
+
+        ScriptedFault* fault = faultFor(command);
+        if (fault != nullptr && fault->fault == FAULT_NO_RESPONSE) {
+            return;
+        }
+        if (fault != nullptr && fault->fault == FAULT_ERROR) {
+            lines.push_back("ERROR");
+            emitLines(lines, latency);
+            return;
+        }
+        dropFinal = dropFinal || fault != nullptr;
+
+        // Two-step commands answer the first step right away
+        if (!startsWith(command, "AT+CMGS") && !startsWith(command, "AT+HTTPACTION")) {
+            unsigned long commandDelay = delayFor(command);
+            if (commandDelay > latency) latency = commandDelay;
+        }
+
+        activeCommand = command;
+        Result result = execute(command, lines);
+        if (result == RESULT_PENDING) {
+            emitLines(lines, latency);
+            return;
+        }
+        if (result == RESULT_ERROR) {
+            lines.push_back("ERROR");
+            emitLines(lines, latency, dropFinal);
+            return;
+        }
+    }
+
+    lines.push_back("OK");
+    emitLines(lines, latency, dropFinal);
+    if (baudSwitchPending) {
+        lineBaud = nextLineBaud;
+    }
+}
+
+SIM800Simulator::Result SIM800Simulator::execute(const String& command, std::vector<String>& lines) {
+    if (command == "AT" || command == "ATH" || startsWith(command, "AT+CFUN=")) {
+        return RESULT_OK;
+    }
+    if (command == "ATE0" || command == "ATE1") {
+        settings.echo = command == "ATE1";
+        return RESULT_OK;
+    }
+    if (command == "AT&W") {
+        savedSettings = settings;
+        return RESULT_OK;
+    }
+    if (startsWith(command, "AT+CMEE") || startsWith(command, "AT+CSCS") || startsWith(command, "AT+CLTS") ||
+        startsWith(command, "AT+CSMP")) {
+        return executeSetting(command, lines);
+    }
+    if (startsWith(command, "AT+IPR")) {
+        return executeRate(command, lines);
+    }
+    if (command == "AT+CREG?") {
+        lines.push_back(networkUp ? "+CREG: 0,1" : "+CREG: 0,2");
+        return RESULT_OK;
+    }
+    if (command == "AT+CSQ") {
+        lines.push_back("+CSQ: " + String(networkUp ? rssi : 99) + ",0");
+        return RESULT_OK;
+    }
+    if (command == "AT+COPS?") {
+        lines.push_back(networkUp ? "+COPS: 0,0,\"SIM-NET\"" : "+COPS: 0");
+        return RESULT_OK;
+    }
+    if (command == "AT+CCLK?") {
+        lines.push_back("+CCLK: \"" + clockText() + "\"");
+        return RESULT_OK;
+    }
+    if (startsWith(command, "AT+CSCLK=")) {
+        slowClock = command.substring(9).toInt() == 1;
+        return RESULT_OK;
+    }
+    if (startsWith(command, "AT+SAPBR=")) {
+        return executeBearer(command, lines);
+    }
+    if (startsWith(command, "AT+HTTP")) {
+        return executeHTTP(command, lines);
+    }
+    if (startsWith(command, "AT+CMG") || startsWith(command, "AT+CNMI") || startsWith(command, "AT+CPMS")) {
+        return executeSMS(command, lines);
+    }
+    return RESULT_ERROR;
+}
+
+SIM800Simulator::Result SIM800Simulator::executeSetting(const String& command, std::vector<String>& lines) {
+    String name = command.substring(3, 7);
+    bool query = command.endsWith("?");
+    if (!query && command[7] != '=') {
+        return RESULT_ERROR;
+    }
+
+    if (name == "CMEE") {
+        if (query) {
+            lines.push_back("+CMEE: " + String(settings.errorMode));
+        } else {
+            settings.errorMode = command.substring(8).toInt();
+        }
+    } else if (name == "CSMP") {
+        if (query) {
+            lines.push_back("+CSMP: " + settings.submitParameters);
+        } else {
+            settings.submitParameters = command.substring(8);
+        }
+    } else if (name == "CSCS") {
+        if (query) {
+            lines.push_back("+CSCS: \"" + settings.charset + "\"");
+        } else {
+            settings.charset = field(command, 0);
+        }
+    } else {
+        if (query) {
+            lines.push_back("+CLTS: " + String(settings.networkTimeSync ? 1 : 0));
+        } else {
+            settings.networkTimeSync = command.substring(8).toInt() == 1;
+        }
+    }
+    return RESULT_OK;
+}
+
+SIM800Simulator::Result SIM800Simulator::executeRate(const String& command, std::vector<String>& lines) {
+    static const unsigned long RATES[] = {0, 1200, 2400, 4800, 9600, 19200, 38400, 57600, 115200, 230400, 460800};
+
+    if (command == "AT+IPR?") {
+        lines.push_back("+IPR: " + String(settings.baud));
+        return RESULT_OK;
+    }
+    if (!startsWith(command, "AT+IPR=")) {
+        return RESULT_ERROR;
+    }
+    unsigned long baud = (unsigned long)command.substring(7).toInt();
+    for (size_t i = 0; i < sizeof(RATES) / sizeof(RATES[0]); i++) {
+        if (RATES[i] == baud) {
+            settings.baud = baud;
+            baudSwitchPending = true;
+            nextLineBaud = baud;
+            return RESULT_OK;
+        }
+    }
+    return RESULT_ERROR;
+}
+
+SIM800Simulator::Result SIM800Simulator::executeSMS(const String& command, std::vector<String>& lines) {
+    if (startsWith(command, "AT+CMGF=")) {
+        settings.textMode = command.substring(8).toInt() == 1;
+        return RESULT_OK;
+    }
+    if (command == "AT+CMGF?") {
+        lines.push_back("+CMGF: " + String(settings.textMode ? 1 : 0));
+        return RESULT_OK;
+    }
+    if (startsWith(command, "AT+CNMI=")) {
+        settings.messageIndication = command.substring(8);
+        return RESULT_OK;
+    }
+    if (command == "AT+CNMI?") {
+        lines.push_back("+CNMI: " + settings.messageIndication);
+        return RESULT_OK;
+    }
+    if (command == "AT+CPMS?") {
+        String used = String((int)storage.size());
+        lines.push_back("+CPMS: \"SM\"," + used + ",30,\"SM\"," + used + ",30,\"SM\"," + used + ",30");
+        return RESULT_OK;
+    }
+    if (startsWith(command, "AT+CPMS=")) {
+        String used = String((int)storage.size());
+        lines.push_back("+CPMS: " + used + ",30," + used + ",30," + used + ",30");
+        return RESULT_OK;
+    }
+    if (startsWith(command, "AT+CMGS=")) {
+        bool quoted = command.indexOf('"') != -1;
+        if (quoted != settings.textMode) {
+            return RESULT_ERROR;
+        }
+        if (settings.textMode) {
+            smsNumber = field(command, 0);
+        } else {
+            smsDeclaredLength = command.substring(8).toInt();
+        }
+        inputMode = INPUT_SMS;
+        inputLine.clear();
+        schedule("\r\n> ", responseDelay);
+        return RESULT_PENDING;
+    }
+    if (startsWith(command, "AT+CMGL=")) {
+        if (!settings.textMode) {
+            return RESULT_ERROR;
+        }
+        listStored(field(command, 0), lines);
+        return RESULT_OK;
+    }
+    if (startsWith(command, "AT+CMGR=")) {
+        int index = command.substring(8).toInt();
+        for (size_t i = 0; i < storage.size(); i++) {
+            if (storage[i].index == index) {
+                lines.push_back(storedHeader(storage[i], false));
+                lines.push_back(storage[i].text);
+                storage[i].read = true;
+                break;
+            }
+        }
+        return RESULT_OK;
+    }
+    if (startsWith(command, "AT+CMGDA=")) {
+        storage.clear();
+        return RESULT_OK;
+    }
+    if (startsWith(command, "AT+CMGD=")) {
+        int index = command.substring(8).toInt();
+        for (size_t i = 0; i < storage.size(); i++) {
+            if (storage[i].index == index) {
+                storage.erase(storage.begin() + i);
+                break;
+            }
+        }
+        return RESULT_OK;
+    }
+    return RESULT_ERROR;
+}
+
+SIM800Simulator::Result SIM800Simulator::executeBearer(const String& command, std::vector<String>& lines) {
+    int operation = command.substring(9).toInt();
+    switch (operation) {
+        case 0:     // Close
+            if (!bearer) {
+                return RESULT_ERROR;
+            }
+            bearer = false;
+            return RESULT_OK;
+
+        case 1:     // Open; fails on an open bearer and without a network
+            if (bearer || !networkUp) {
+                return RESULT_ERROR;
+            }
+            bearer = true;
+            return RESULT_OK;
+
+        case 2:     // Query
+            lines.push_back(bearer ? "+SAPBR: 1,1,\"10.64.12.7\"" : "+SAPBR: 1,3,\"0.0.0.0\"");
+            return RESULT_OK;
+
+        case 3:     // Set parameter
+            return RESULT_OK;
+
+        default:
+            return RESULT_ERROR;
+    }
+}
+
+SIM800Simulator::Result SIM800Simulator::executeHTTP(const String& command, std::vector<String>& lines) {
+    if (command == "AT+HTTPINIT") {
+        if (httpInitialized) {
+            return RESULT_ERROR;
+        }
+        httpInitialized = true;
+        httpURL = "";
+        httpContentType = "";
+        return RESULT_OK;
+    }
+    if (command == "AT+HTTPTERM") {
+        if (!httpInitialized) {
+            return RESULT_ERROR;
+        }
+        httpInitialized = false;
+        return RESULT_OK;
+    }
+    if (!httpInitialized) {
+        return RESULT_ERROR;
+    }
+
+    if (startsWith(command, "AT+HTTPPARA=")) {
+        String name = field(command, 0);
+        if (name == "URL") {
+            httpURL = field(command, 1);
+        } else if (name == "CONTENT") {
+            httpContentType = field(command, 1);
+        } else if (name != "CID" && name != "UA" && name != "USERDATA") {
+            return RESULT_ERROR;
+        }
+        return RESULT_OK;
+    }
+    if (startsWith(command, "AT+HTTPDATA=")) {
+        // Up to 319488 bytes, input window 1-120 s
+        httpDataRemaining = field(command, 0).toInt();
+        long inputTime = field(command, 1).toInt();
+        if (httpDataRemaining == 0 || httpDataRemaining > 319488 || inputTime < 1000 || inputTime > 120000) {
+            return RESULT_ERROR;
+        }
+        httpBody = "";
+        inputMode = INPUT_HTTP_DATA;
+        lines.push_back("DOWNLOAD");
+        return RESULT_PENDING;
+    }
+    if (startsWith(command, "AT+HTTPACTION=")) {
+        HTTPRequest request;
+        request.method = command.substring(14).toInt();
+        request.url = httpURL;
+        request.contentType = httpContentType;
+        request.body = request.method == 1 ? httpBody : String();
+        request.status = networkUp && bearer ? statusFor(httpURL) : 601;
+        request.at = millis();
+        requests.push_back(request);
+
+        int length = request.status == 601 ? 0 : (int)httpResponse.length();
+        emitURC("+HTTPACTION: " + String(request.method) + "," + String(request.status) + "," + String(length),
+                delayFor(command));
+        return RESULT_OK;
+    }
+    if (command == "AT+HTTPREAD") {
+        lines.push_back("+HTTPREAD: " + String((int)httpResponse.length()));
+        lines.push_back(httpResponse);
+        return RESULT_OK;
+    }
+    return RESULT_ERROR;
+}
+
+void SIM800Simulator::finishSMS(const std::string& body) {
+    unsigned long latency = delayFor("AT+CMGS");
+    if (!networkUp) {
+        emitURC("+CMS ERROR: 331", latency);
+        return;
+    }
+
+    SentSMS sms;
+    if (settings.textMode) {
+        sms.number = smsNumber;
+        sms.text = String(body);
+        sms.pdu = false;
+        sms.part = 1;
+        sms.parts = 1;
+        sms.reportRequested = (settings.submitParameters.toInt() & 0x20) != 0;
+    } else if (!decodePDU(body, smsDeclaredLength, sms)) {
+        emitURC("+CMS ERROR: 304", latency);
+        return;
+    }
+    sms.reference = messageReference++;
+    smsSent.push_back(sms);
+    if (sms.reportRequested) {
+        scheduleReport(sms);
+    }
+
+    std::vector<String> lines;
+    lines.push_back("+CMGS: " + String(sms.reference));
+    lines.push_back("OK");
+    emitLines(lines, latency);
+}
+
+void SIM800Simulator::finishHTTPData() {
+    inputMode = INPUT_COMMAND;
+    emitURC("OK", responseDelay);
+}
+
+void SIM800Simulator::listStored(const String& filter, std::vector<String>& lines) {
+    for (size_t i = 0; i < storage.size(); i++) {
+        StoredSMS& sms = storage[i];
+        if (filter == "ALL" || (filter == "REC UNREAD" && !sms.read) || (filter == "REC READ" && sms.read)) {
+            lines.push_back(storedHeader(sms, true));
+            lines.push_back(sms.text);
+            sms.read = true;
+        }
+    }
+}
+
+String SIM800Simulator::storedHeader(const StoredSMS& sms, bool withIndex) const {
+    String header = withIndex ? "+CMGL: " + String(sms.index) + "," : String("+CMGR: ");
+    header += sms.read ? "\"REC READ\"" : "\"REC UNREAD\"";
+    header += ",\"" + sms.sender + "\",\"\",\"" + clockText() + "\"";
+    return header;
+}
+
+int SIM800Simulator::messageMode() const {
+    // <mt>, the second field of AT+CNMI
+    int comma = settings.messageIndication.indexOf(',');
+    return comma == -1 ? 0 : settings.messageIndication.substring(comma + 1).toInt();
+}
+
+int SIM800Simulator::reportMode() const {
+    // <ds>, the fourth field of AT+CNMI
+    int comma = -1;
+    for (int i = 0; i < 3; i++) {
+        comma = settings.messageIndication.indexOf(',', comma + 1);
+        if (comma == -1) {
+            return 0;
+        }
+    }
+    return settings.messageIndication.substring(comma + 1).toInt();
+}
+
+void SIM800Simulator::scheduleReport(const SentSMS& sms) {
+    StatusReport report;
+    report.due = millis() + delayFor("AT+CMGS") + 5000;
+    report.number = sms.number;
+    report.reference = sms.reference;
+    report.status = 0;
+    for (size_t i = 0; i < deliveryScripts.size(); i++) {
+        if (startsWith(sms.number, deliveryScripts[i].prefix.c_str())) {
+            report.due = millis() + delayFor("AT+CMGS") + deliveryScripts[i].delay;
+            report.status = deliveryScripts[i].status;
+            break;
+        }
+    }
+    if (report.status >= 0) {
+        statusReports.push_back(report);
+    }
+}
+
+void SIM800Simulator::emitReport(const StatusReport& report) {
+    // Reports the host did not ask to have routed are dropped
+    if (reportMode() != 1) {
+        return;
+    }
+
+    bool international = startsWith(report.number, "+");
+    String digits = international ? report.number.substring(1) : report.number;
+    if (settings.textMode) {
+        String stamp = "\"" + clockText() + "\"";
+        emitURC("+CDS: 6," + String(report.reference) + ",\"" + report.number + "\"," +
+                String(international ? 145 : 129) + "," + stamp + "," + stamp + "," + String(report.status));
+        return;
+    }
+
+    // SMS-STATUS-REPORT without an SMSC address; both timestamps 24-06-01 12:00:00
+    char octet[3];
+    String tpdu = "06";
+    snprintf(octet, sizeof(octet), "%02X", (unsigned)report.reference & 0xFF);
+    tpdu += octet;
+    snprintf(octet, sizeof(octet), "%02X", (unsigned)digits.length());
+    tpdu += octet;
+    tpdu += international ? "91" : "81";
+    for (size_t i = 0; i < digits.length(); i += 2) {
+        tpdu += i + 1 < digits.length() ? digits[i + 1] : 'F';
+        tpdu += digits[i];
+    }
+    tpdu += "42106021000000";
+    tpdu += "42106021000000";
+    snprintf(octet, sizeof(octet), "%02X", (unsigned)report.status & 0xFF);
+    tpdu += octet;
+
+    std::vector<String> lines;
+    lines.push_back("+CDS: " + String((int)tpdu.length() / 2));
+    lines.push_back("00" + tpdu);
+    emitLines(lines, 0);
+}
+
+String SIM800Simulator::clockText() const {
+    // An unsynchronised RTC counts from its 2004 default
+    uint32_t epoch = clockEpoch != 0 ? clockEpoch + (millis() - clockSetAt) / 1000 : 1072915200UL;
+    CivilTime time;
+    epochToCivil(epoch, time);
+    char text[32];
+    snprintf(text, sizeof(text), "%02u/%02u/%02u,%02u:%02u:%02u+00",
+             time.year % 100, time.month, time.day, time.hour, time.minute, time.second);
+    return String(text);
+}
+
+bool SIM800Simulator::decodePDU(const std::string& hex, size_t declaredLength, SentSMS& sms) const {
+    if (hex.size() % 2 != 0) {
+        return false;
+    }
+    std::vector<uint8_t> octets;
+    for (size_t i = 0; i < hex.size(); i += 2) {
+        int high = hexValue(hex[i]);
+        int low = hexValue(hex[i + 1]);
+        if (high < 0 || low < 0) {
+            return false;
+        }
+        octets.push_back((uint8_t)(high << 4 | low));
+    }
+
+    // SMSC address, then the TPDU whose length AT+CMGS declared
+    if (octets.empty() || (size_t)octets[0] + 1 > octets.size()) {
+        return false;
+    }
+    const uint8_t* tpdu = octets.data() + 1 + octets[0];
+    size_t length = octets.size() - 1 - octets[0];
+    if (length != declaredLength || length < 7) {
+        return false;
+    }
+
+    uint8_t firstOctet = tpdu[0];
+    size_t digits = tpdu[2];
+    size_t p = 4 + (digits + 1) / 2;
+    if (p + 3 > length) {
+        return false;
+    }
+    sms.number = tpdu[3] == 0x91 ? "+" : "";
+    for (size_t i = 0; i < digits; i++) {
+        uint8_t octet = tpdu[4 + i / 2];
+        sms.number += (char)('0' + (i % 2 == 0 ? octet & 0x0F : octet >> 4));
+    }
+
+    uint8_t dcs = tpdu[p + 1];
+    p += 2;
+    uint8_t validity = firstOctet & 0x18;
+    p += validity == 0x10 ? 1 : (validity != 0 ? 7 : 0);
+    if (p >= length || dcs != 0x00) {
+        return false;
+    }
+
+    size_t septets = tpdu[p++];
+    const uint8_t* userData = tpdu + p;
+    size_t userDataOctets = length - p;
+    if ((septets * 7 + 7) / 8 > userDataOctets) {
+        return false;
+    }
+
+    size_t skip = 0;
+    sms.pdu = true;
+    sms.reportRequested = (firstOctet & 0x20) != 0;
+    sms.part = 1;
+    sms.parts = 1;
+    if (firstOctet & 0x40) {
+        size_t headerLength = userData[0];
+        if (headerLength >= 5 && userData[1] == 0x00) {
+            sms.parts = userData[4];
+            sms.part = userData[5];
+        }
+        skip = ((headerLength + 1) * 8 + 6) / 7;
+    }
+
+    sms.text = "";
+    bool escaped = false;
+    for (size_t i = skip; i < septets; i++) {
+        size_t bit = i * 7;
+        uint8_t septet = (uint8_t)(userData[bit / 8] >> (bit % 8));
+        if (bit % 8 > 1) {
+            septet |= (uint8_t)(userData[bit / 8 + 1] << (8 - bit % 8));
+        }
+        septet &= 0x7F;
+        if (septet == 0x1B && !escaped) {
+            escaped = true;
+            continue;
+        }
+        sms.text += septetToChar(septet, escaped);
+        escaped = false;
+    }
+    return true;
+}
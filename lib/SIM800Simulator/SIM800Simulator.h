@@ -0,0 +1,265 @@
+#ifndef SIM800SIMULATOR_H
+#define SIM800SIMULATOR_H
+
+#include <Arduino.h>
+#include <vector>
+
+// Scripted SIM800L for host builds.
+//
+// Plugs in wherever GSMModule talks to its UART (GSMModule(Stream&)) and
+// answers the AT subset the firmware uses: registration and signal (CREG,
+// CSQ, COPS), SMS in text and PDU mode (CMGF, CMGS, CMGL, CMGR, CMGD,
+// CNMI), the bearer (SAPBR), the HTTP service (HTTPINIT ... HTTPREAD), the
+// RTC (CCLK), slow-clock sleep (CSCLK with DTR) and the line rate (IPR).
+//
+// Messages sent with the status report bit (AT+CSMP in text mode, the PDU's
+// first octet otherwise) get a +CDS report when AT+CNMI asks for them
+// (<ds> = 1), as one line in text mode or length and PDU in PDU mode.
+//
+// Both ends of the UART have a rate. Until AT+IPR fixes one the modem
+// autobauds to the first byte it hears; bytes sent at a rate the other end
+// is not at are lost in either direction.
+//
+// Replies are released on the host's virtual clock (see HostArduino), after
+// a per-command latency plus the time the bytes take at the configured baud
+// rate, so a test sees the same waits and ordering as on the bench and can
+// count how long an upload or SMS takes.
+//
+// Faults are scripted: ERROR instead of the normal answer, no answer at all,
+// a lost final line, random line loss, and network outages that drop the
+// bearer (+SAPBR 1: DEACT), fail SAPBR=1,1 and turn HTTP requests into 601.
+class SIM800Simulator : public Stream {
+public:
+    enum Fault {
+        FAULT_ERROR,            // Answer ERROR without executing the command
+        FAULT_NO_RESPONSE,      // Swallow the command
+        FAULT_DROP_FINAL_LINE   // Execute it but lose the final OK/ERROR
+    };
+
+    struct SentSMS {
+        String number;
+        String text;            // Decoded user data for PDU mode (header skipped)
+        bool pdu;
+        int part;               // 1-based part of a concatenated message, 1 otherwise
+        int parts;
+        int reference;          // TP-MR returned by +CMGS
+        bool reportRequested;
+    };
+
+    struct HTTPRequest {
+        int method;             // 0 GET, 1 POST
+        String url;
+        String contentType;
+        String body;
+        int status;
+        unsigned long at;       // millis() when the action ran
+    };
+
+    SIM800Simulator();
+
+    // Stream, as seen by the firmware
+    int available();
+    int read();
+    int peek();
+    size_t write(uint8_t c);
+    using Print::write;
+
+    // Timing
+    void setBaudRate(unsigned long baud);       // Modem rate as if saved with AT+IPR; 0 autobauds
+    void setHostBaudRate(unsigned long baud);   // Our end of the UART, 9600 by default
+    static void hostBaudRateSetter(unsigned long baud, void* simulator);  // For GSMModule(Stream&, ...)
+    void setResponseDelay(unsigned long ms);
+    // Latency of commands starting with prefix ("AT+SAPBR=1"). For commands
+    // that answer in two steps (CMGS, HTTPACTION) it applies to the second.
+    void setCommandDelay(const char* prefix, unsigned long ms);
+
+    // Faults
+    void injectFault(const char* prefix, Fault fault, int count = 1);
+    void setLineDropRate(unsigned int perMille, uint32_t seed = 1);
+    void setNetworkAvailable(bool available);
+    void scheduleNetworkOutage(unsigned long at, unsigned long duration);
+
+    // Network and peer state
+    void setSignalQuality(int rssi);
+    void setHTTPStatus(int status);
+    void setHTTPStatus(const char* urlPrefix, int status);     // Only for URLs starting with urlPrefix
+    void setHTTPResponse(const char* body);
+    void setNetworkTime(uint32_t epoch);
+    // Status report (TP-ST) for messages to numbers starting with prefix, that
+    // long after +CMGS; a negative status never reports. Default: 0 after 5 s.
+    void setDeliveryReport(const char* numberPrefix, int status, unsigned long delay = 5000);
+    void setSleepControl(int dtrPin);   // Honour AT+CSCLK=1: ignore input while DTR is high
+    void receiveSMS(const char* sender, const char* text);  // As +CMT or stored with +CMTI, per AT+CNMI
+    void storeSMS(const char* sender, const char* text);    // Already on the SIM, no URC
+    void ring();
+    // Restart with the profile last saved by AT&W; input is ignored until booted
+    void powerCycle(unsigned long bootTime = 3000);
+
+    // Inspection
+    const std::vector<SentSMS>& sentSMS() const { return smsSent; }
+    const std::vector<HTTPRequest>& httpRequests() const { return requests; }
+    const std::vector<String>& commandLog() const { return commands; }
+    int commandCount(const char* prefix) const;
+    int storedSMSCount() const;
+    bool bearerOpen() const { return bearer; }
+    bool asleep() const;
+    unsigned long lineBaudRate() const { return lineBaud; }    // 0 until autobaud locks
+    unsigned long bytesFromHost() const { return hostBytes; }
+    unsigned long bytesToHost() const { return modemBytes; }
+    void clearLogs();
+
+private:
+    enum InputMode {
+        INPUT_COMMAND,
+        INPUT_SMS,
+        INPUT_HTTP_DATA
+    };
+
+    enum Result {
+        RESULT_OK,
+        RESULT_ERROR,
+        RESULT_PENDING          // The command answers on its own (prompt, DOWNLOAD)
+    };
+
+    struct Chunk {
+        unsigned long dueMicros;
+        unsigned long baud;     // Lost unless our end is at this rate on arrival
+        std::string bytes;
+    };
+
+    struct Delay {
+        String prefix;
+        unsigned long ms;
+    };
+
+    struct Endpoint {
+        String prefix;
+        int status;
+    };
+
+    struct DeliveryScript {
+        String prefix;
+        int status;
+        unsigned long delay;
+    };
+
+    struct StatusReport {
+        unsigned long due;
+        String number;
+        int reference;
+        int status;
+    };
+
+    struct ScriptedFault {
+        String prefix;
+        Fault fault;
+        int remaining;
+    };
+
+    struct StoredSMS {
+        int index;
+        String sender;
+        String text;
+        bool read;
+    };
+
+    // Settings AT&W saves and a power cycle restores
+    struct Profile {
+        bool echo;
+        int errorMode;
+        bool textMode;
+        String charset;
+        String messageIndication;   // AT+CNMI parameters as given
+        String submitParameters;    // AT+CSMP
+        bool networkTimeSync;
+        unsigned long baud;         // AT+IPR, 0 for autobaud
+    };
+
+    struct Outage {
+        unsigned long start;
+        unsigned long end;
+        bool started;
+    };
+
+    // Output waiting for its due time, ordered by it; bytes already due
+    std::vector<Chunk> pending;
+    std::string readable;
+    size_t readPosition;
+
+    InputMode inputMode;
+    std::string inputLine;
+    bool skipLineFeed;
+    String activeCommand;
+    String smsNumber;
+    size_t smsDeclaredLength;
+    size_t httpDataRemaining;
+
+    unsigned long lineBaud;
+    unsigned long hostBaud;
+    bool baudSwitchPending;     // AT+IPR takes effect after its OK is on the wire
+    unsigned long nextLineBaud;
+    unsigned long responseDelay;
+    std::vector<Delay> delays;
+    std::vector<ScriptedFault> faults;
+    unsigned int dropPerMille;
+    uint32_t dropState;
+    std::vector<Outage> outages;
+
+    Profile settings;
+    Profile savedSettings;
+    unsigned long bootedAt;
+    bool slowClock;
+    int dtrPin;
+    bool networkUp;
+    bool bearer;
+    bool httpInitialized;
+    String httpURL;
+    String httpContentType;
+    String httpBody;
+    int httpStatus;
+    std::vector<Endpoint> endpoints;
+    String httpResponse;
+    std::vector<DeliveryScript> deliveryScripts;
+    std::vector<StatusReport> statusReports;
+    int rssi;
+    uint32_t clockEpoch;
+    unsigned long clockSetAt;
+    uint8_t messageReference;
+    int nextStoredIndex;
+
+    std::vector<StoredSMS> storage;
+    std::vector<SentSMS> smsSent;
+    std::vector<HTTPRequest> requests;
+    std::vector<String> commands;
+    unsigned long hostBytes;
+    unsigned long modemBytes;
+
+    void tick();
+    void schedule(const std::string& bytes, unsigned long delayMs);
+    void emitLines(const std::vector<String>& lines, unsigned long delayMs, bool dropFinal = false);
+    void emitURC(const String& line, unsigned long delayMs = 0);
+    bool dropLine();
+    unsigned long delayFor(const String& command) const;
+    int statusFor(const String& url) const;
+    ScriptedFault* faultFor(const String& command);
+
+    void executeLine(const String& line);
+    Result execute(const String& command, std::vector<String>& lines);
+    Result executeSetting(const String& command, std::vector<String>& lines);
+    Result executeRate(const String& command, std::vector<String>& lines);
+    Result executeSMS(const String& command, std::vector<String>& lines);
+    Result executeBearer(const String& command, std::vector<String>& lines);
+    Result executeHTTP(const String& command, std::vector<String>& lines);
+    void finishSMS(const std::string& body);
+    void finishHTTPData();
+    void listStored(const String& filter, std::vector<String>& lines);
+    String storedHeader(const StoredSMS& sms, bool withIndex) const;
+    int messageMode() const;
+    int reportMode() const;
+    void scheduleReport(const SentSMS& sms);
+    void emitReport(const StatusReport& report);
+    String clockText() const;
+    bool decodePDU(const std::string& hex, size_t declaredLength, SentSMS& sms) const;
+};
+
+#endif // SIM800SIMULATOR_H
@@ -0,0 +1,272 @@
+#include "SMSComposer.h"
+#include <string.h>
+
+namespace {
+    const uint8_t ESCAPE = 0x1B;
+    const uint16_t NO_CHARACTER = 0xFFFF;
+
+    // GSM 03.38 default alphabet, indexed by septet
+    const uint16_t DEFAULT_ALPHABET[128] = {
+        '@',    0x00A3, '$',    0x00A5, 0x00E8, 0x00E9, 0x00F9, 0x00EC,
+        0x00F2, 0x00C7, '\n',   0x00D8, 0x00F8, '\r',   0x00C5, 0x00E5,
+        0x0394, '_',    0x03A6, 0x0393, 0x039B, 0x03A9, 0x03A0, 0x03A8,
+        0x03A3, 0x0398, 0x039E, NO_CHARACTER, 0x00C6, 0x00E6, 0x00DF, 0x00C9,
+        ' ',    '!',    '"',    '#',    0x00A4, '%',    '&',    '\'',
+        '(',    ')',    '*',    '+',    ',',    '-',    '.',    '/',
+        '0',    '1',    '2',    '3',    '4',    '5',    '6',    '7',
+        '8',    '9',    ':',    ';',    '<',    '=',    '>',    '?',
+        0x00A1, 'A',    'B',    'C',    'D',    'E',    'F',    'G',
+        'H',    'I',    'J',    'K',    'L',    'M',    'N',    'O',
+        'P',    'Q',    'R',    'S',    'T',    'U',    'V',    'W',
+        'X',    'Y',    'Z',    0x00C4, 0x00D6, 0x00D1, 0x00DC, 0x00A7,
+        0x00BF, 'a',    'b',    'c',    'd',    'e',    'f',    'g',
+        'h',    'i',    'j',    'k',    'l',    'm',    'n',    'o',
+        'p',    'q',    'r',    's',    't',    'u',    'v',    'w',
+        'x',    'y',    'z',    0x00E4, 0x00F6, 0x00F1, 0x00FC, 0x00E0
+    };
+
+    struct ExtensionCharacter {
+        uint16_t codepoint;
+        uint8_t code;
+    };
+
+    // Sent as ESC + code, two septets each
+    const ExtensionCharacter EXTENSION_TABLE[] = {
+        {0x000C, 0x0A}, {'^', 0x14}, {'{', 0x28}, {'}', 0x29}, {'\\', 0x2F},
+        {'[', 0x3C}, {'~', 0x3D}, {']', 0x3E}, {'|', 0x40}, {0x20AC, 0x65}
+    };
+
+    struct Transliteration {
+        uint16_t codepoint;
+        const char* replacement;
+    };
+
+    const Transliteration TRANSLITERATIONS[] = {
+        {0x20B5, "GHS"},                    // Cedi sign
+        {0x2018, "'"}, {0x2019, "'"}, {0x201C, "\""}, {0x201D, "\""},
+        {0x2013, "-"}, {0x2014, "-"}, {0x2026, "..."}, {0x2022, "*"},
+        {0x00A0, " "}, {'\t', " "}, {'`', "'"}, {0x00D7, "x"}, {0x00B0, "o"},
+        {0x00E1, "a"}, {0x00E2, "a"}, {0x00EA, "e"}, {0x00EB, "e"}, {0x00ED, "i"},
+        {0x00EE, "i"}, {0x00F3, "o"}, {0x00F4, "o"}, {0x00FA, "u"}, {0x00FB, "u"},
+        {0x00E7, "c"}
+    };
+
+    int findDefault(uint32_t codepoint) {
+        for (int i = 0; i < 128; i++) {
+            if (DEFAULT_ALPHABET[i] == codepoint) return i;
+        }
+        return -1;
+    }
+
+    // Decodes one UTF-8 sequence; malformed input yields U+FFFD
+    uint32_t nextCodepoint(const char*& text) {
+        uint8_t lead = (uint8_t)*text++;
+        if (lead < 0x80) return lead;
+
+        int extra;
+        uint32_t codepoint;
+        if ((lead & 0xE0) == 0xC0) { extra = 1; codepoint = lead & 0x1F; }
+        else if ((lead & 0xF0) == 0xE0) { extra = 2; codepoint = lead & 0x0F; }
+        else if ((lead & 0xF8) == 0xF0) { extra = 3; codepoint = lead & 0x07; }
+        else return 0xFFFD;
+
+        for (int i = 0; i < extra; i++) {
+            if (((uint8_t)*text & 0xC0) != 0x80) return 0xFFFD;
+            codepoint = (codepoint << 6) | ((uint8_t)*text++ & 0x3F);
+        }
+        return codepoint;
+    }
+
+    const char HEX_DIGITS[] = "0123456789ABCDEF";
+}
+
+SMSComposer::SMSComposer() {
+    compose("");
+}
+
+bool SMSComposer::compose(const char* utf8) {
+    septetLength = 0;
+    segments = 0;
+    substitutions = 0;
+    truncated = false;
+    asciiSafe = true;
+    asciiText[0] = '\0';
+
+    const char* cursor = utf8 != nullptr ? utf8 : "";
+    while (*cursor != '\0') {
+        if (!appendCodepoint(nextCodepoint(cursor))) {
+            truncated = true;
+            break;
+        }
+    }
+
+    splitSegments();
+
+    for (size_t i = 0; i < septetLength && asciiSafe; i++) {
+        uint8_t septet = septets[i];
+        asciiSafe = septet == '\n' || septet == '\r' ||
+                    (septet >= 0x20 && septet < 0x7F && DEFAULT_ALPHABET[septet] == septet);
+    }
+
+    if (asciiSafe && segments == 1) {
+        memcpy(asciiText, septets, septetLength);
+        asciiText[septetLength] = '\0';
+    }
+
+    return !truncated;
+}
+
+bool SMSComposer::appendSeptets(const uint8_t* codes, size_t count) {
+    if (septetLength + count > MAX_SEPTETS) {
+        return false;
+    }
+    memcpy(septets + septetLength, codes, count);
+    septetLength += count;
+    return true;
+}
+
+bool SMSComposer::appendCodepoint(uint32_t codepoint) {
+    int code = findDefault(codepoint);
+    if (code >= 0) {
+        uint8_t septet = (uint8_t)code;
+        return appendSeptets(&septet, 1);
+    }
+
+    for (size_t i = 0; i < sizeof(EXTENSION_TABLE) / sizeof(EXTENSION_TABLE[0]); i++) {
+        if (EXTENSION_TABLE[i].codepoint == codepoint) {
+            uint8_t pair[2] = {ESCAPE, EXTENSION_TABLE[i].code};
+            return appendSeptets(pair, 2);
+        }
+    }
+
+    substitutions++;
+    for (size_t i = 0; i < sizeof(TRANSLITERATIONS) / sizeof(TRANSLITERATIONS[0]); i++) {
+        if (TRANSLITERATIONS[i].codepoint == codepoint) {
+            for (const char* r = TRANSLITERATIONS[i].replacement; *r != '\0'; r++) {
+                uint8_t septet = (uint8_t)findDefault((uint8_t)*r);
+                if (!appendSeptets(&septet, 1)) return false;
+            }
+            return true;
+        }
+    }
+
+    uint8_t unknown = '?';
+    return appendSeptets(&unknown, 1);
+}
+
+void SMSComposer::splitSegments() {
+    segmentStart[0] = 0;
+
+    if (septetLength <= SINGLE_SEGMENT_SEPTETS) {
+        segments = 1;
+        segmentStart[1] = septetLength;
+        return;
+    }
+
+    size_t position = 0;
+    segments = 0;
+    while (position < septetLength && segments < MAX_SEGMENTS) {
+        size_t end = position + MULTI_SEGMENT_SEPTETS;
+        if (end >= septetLength) {
+            end = septetLength;
+        } else {
+            // Walk escape pairs so ESC never ends a segment
+            size_t i = position;
+            while (i < end) {
+                size_t width = septets[i] == ESCAPE ? 2 : 1;
+                if (i + width > end) break;
+                i += width;
+            }
+            end = i;
+        }
+        segments++;
+        segmentStart[segments] = end;
+        position = end;
+    }
+
+    if (position < septetLength) {
+        septetLength = position;
+        truncated = true;
+    }
+}
+
+size_t SMSComposer::buildPDU(size_t segment, const char* number, uint8_t reference,
+                             char* hex, size_t hexCapacity, bool statusReport) const {
+    if (segment >= segments || number == nullptr) {
+        return 0;
+    }
+
+    const bool concatenated = segments > 1;
+    const size_t start = segmentStart[segment];
+    const size_t count = segmentStart[segment + 1] - start;
+
+    const char* digits = number;
+    bool international = *digits == '+';
+    if (international) digits++;
+    size_t digitCount = strlen(digits);
+    if (digitCount == 0 || digitCount > 20) {
+        return 0;
+    }
+
+    uint8_t pdu[160];
+    size_t n = 0;
+
+    // SMS-SUBMIT, no validity period
+    pdu[n++] = 0x01 | (statusReport ? 0x20 : 0x00) | (concatenated ? 0x40 : 0x00);
+    pdu[n++] = 0x00;                                    // Message reference (set by the modem)
+    pdu[n++] = (uint8_t)digitCount;
+    pdu[n++] = international ? 0x91 : 0x81;
+    for (size_t i = 0; i < digitCount; i += 2) {
+        if (digits[i] < '0' || digits[i] > '9') return 0;
+        uint8_t low = digits[i] - '0';
+        uint8_t high = 0x0F;
+        if (i + 1 < digitCount) {
+            if (digits[i + 1] < '0' || digits[i + 1] > '9') return 0;
+            high = digits[i + 1] - '0';
+        }
+        pdu[n++] = (uint8_t)((high << 4) | low);
+    }
+    pdu[n++] = 0x00;                                    // Protocol identifier
+    pdu[n++] = 0x00;                                    // GSM 7-bit default alphabet
+
+    // A 6-octet concatenation header occupies 7 septets (one fill bit)
+    const size_t headerSeptets = concatenated ? 7 : 0;
+    pdu[n++] = (uint8_t)(headerSeptets + count);
+
+    const size_t udStart = n;
+    const size_t udOctets = ((headerSeptets + count) * 7 + 7) / 8;
+    memset(pdu + udStart, 0, udOctets);
+    if (concatenated) {
+        pdu[udStart] = 0x05;
+        pdu[udStart + 1] = 0x00;
+        pdu[udStart + 2] = 0x03;
+        pdu[udStart + 3] = reference;
+        pdu[udStart + 4] = (uint8_t)segments;
+        pdu[udStart + 5] = (uint8_t)(segment + 1);
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        size_t bit = (headerSeptets + i) * 7;
+        size_t byte = udStart + bit / 8;
+        size_t shift = bit % 8;
+        uint8_t septet = septets[start + i];
+        pdu[byte] |= (uint8_t)(septet << shift);
+        if (shift > 1) {
+            pdu[byte + 1] |= (uint8_t)(septet >> (8 - shift));
+        }
+    }
+    n = udStart + udOctets;
+
+    if (hexCapacity < 2 + 2 * n + 1) {
+        return 0;
+    }
+    // "00": use the SMSC stored on the SIM
+    hex[0] = '0';
+    hex[1] = '0';
+    for (size_t i = 0; i < n; i++) {
+        hex[2 + 2 * i] = HEX_DIGITS[pdu[i] >> 4];
+        hex[3 + 2 * i] = HEX_DIGITS[pdu[i] & 0x0F];
+    }
+    hex[2 + 2 * n] = '\0';
+    return n;
+}
@@ -0,0 +1,62 @@
+#ifndef SMSCOMPOSER_H
+#define SMSCOMPOSER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Turns UTF-8 text into GSM 03.38 7-bit septets and splits it into SMS
+// segments.
+//
+// Characters outside the GSM-7 default and extension tables would force the
+// whole message into UCS-2 (70 characters per segment), so they are replaced
+// with GSM-7 equivalents instead: the cedi sign becomes "GHS", typographic
+// quotes and dashes become their ASCII forms, anything else becomes '?'.
+//
+// One segment holds 160 septets; a concatenated message holds 153 per segment
+// (the rest carries the UDH), and an escape pair is never split across two.
+class SMSComposer {
+public:
+    static const size_t MAX_SEGMENTS = 4;
+    static const size_t SINGLE_SEGMENT_SEPTETS = 160;
+    static const size_t MULTI_SEGMENT_SEPTETS = 153;
+    static const size_t MAX_SEPTETS = MAX_SEGMENTS * MULTI_SEGMENT_SEPTETS;
+
+    // Hex PDU for one segment, including the "00" SMSC prefix
+    static const size_t MAX_PDU_HEX = 2 * (1 + 1 + 1 + 12 + 3 + 1 + 140) + 1;
+
+    SMSComposer();
+
+    // Returns false if the text had to be cut at MAX_SEGMENTS
+    bool compose(const char* utf8);
+
+    size_t septetCount() const { return septetLength; }
+    size_t segmentCount() const { return segments; }
+    size_t substitutionCount() const { return substitutions; }
+    bool wasTruncated() const { return truncated; }
+
+    // Plain text is only safe for text mode when every septet has the same
+    // code as its ASCII character; otherwise the message goes out as PDUs
+    bool needsPDU() const { return segments > 1 || !asciiSafe; }
+    const char* text() const { return asciiText; }
+
+    // Builds the SMS-SUBMIT PDU for one segment as hex. Returns the TPDU
+    // length in octets (the value AT+CMGS takes in PDU mode), 0 on error.
+    size_t buildPDU(size_t segment, const char* number, uint8_t reference,
+                    char* hex, size_t hexCapacity, bool statusReport = false) const;
+
+private:
+    uint8_t septets[MAX_SEPTETS];
+    size_t septetLength;
+    size_t segmentStart[MAX_SEGMENTS + 1];
+    size_t segments;
+    size_t substitutions;
+    bool truncated;
+    bool asciiSafe;
+    char asciiText[SINGLE_SEGMENT_SEPTETS + 1];
+
+    bool appendSeptets(const uint8_t* codes, size_t count);
+    bool appendCodepoint(uint32_t codepoint);
+    void splitSegments();
+};
+
+#endif // SMSCOMPOSER_H
@@ -0,0 +1,208 @@
+#include "DeliveryTracker.h"
+#include <stdlib.h>
+#include <string.h>
+
+namespace {
+    int hexOctet(const char* p) {
+        int value = 0;
+        for (int i = 0; i < 2; i++) {
+            char c = p[i];
+            int digit = c >= '0' && c <= '9' ? c - '0'
+                      : c >= 'A' && c <= 'F' ? c - 'A' + 10
+                      : c >= 'a' && c <= 'f' ? c - 'a' + 10 : -1;
+            if (digit < 0) {
+                return -1;
+            }
+            value = value << 4 | digit;
+        }
+        return value;
+    }
+}
+
+DeliveryTracker::DeliveryTracker(uint32_t timeout) : recipients(0), timeout(timeout) {
+    memset(messages, 0, sizeof(messages));
+    memset(table, 0, sizeof(table));
+}
+
+int DeliveryTracker::begin(const char* number, uint32_t now) {
+    for (size_t i = 0; i < MAX_MESSAGES; i++) {
+        Message& message = messages[i];
+        if (message.state == STATE_FREE) {
+            memset(&message, 0, sizeof(message));
+            message.state = STATE_PENDING;
+            strncpy(message.number, number, NUMBER_LENGTH - 1);
+            message.sentAt = now;
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+void DeliveryTracker::addPart(int id, uint8_t reference) {
+    Message& message = messages[id];
+    if (message.state == STATE_PENDING && message.parts < MAX_PARTS) {
+        message.references[message.parts++] = reference;
+    }
+}
+
+int DeliveryTracker::report(uint8_t reference, uint8_t status, uint32_t now) {
+    // References wrap at 256; the youngest message that still waits on one wins
+    int match = -1;
+    size_t part = 0;
+    for (size_t i = 0; i < MAX_MESSAGES; i++) {
+        const Message& message = messages[i];
+        if (message.state != STATE_PENDING) {
+            continue;
+        }
+        for (size_t p = 0; p < message.parts; p++) {
+            if (message.references[p] == reference && !(message.settledParts & (1 << p)) &&
+                (match < 0 || now - message.sentAt < now - messages[match].sentAt)) {
+                match = (int)i;
+                part = p;
+            }
+        }
+    }
+    if (match < 0 || !isFinal(status)) {
+        return -1;
+    }
+
+    Message& message = messages[match];
+    message.status = status;
+    if (!isDelivered(status)) {
+        settle(message, STATE_FAILED, now);
+        return match;
+    }
+    message.settledParts |= 1 << part;
+    if (message.settledParts != (1 << message.parts) - 1) {
+        return -1;
+    }
+    settle(message, STATE_DELIVERED, now);
+    return match;
+}
+
+int DeliveryTracker::nextSettled(uint32_t now) {
+    for (size_t i = 0; i < MAX_MESSAGES; i++) {
+        if (messages[i].state == STATE_PENDING && now - messages[i].sentAt >= timeout) {
+            settle(messages[i], STATE_EXPIRED, now);
+        }
+    }
+    for (size_t i = 0; i < MAX_MESSAGES; i++) {
+        if (messages[i].state != STATE_FREE && messages[i].state != STATE_PENDING) {
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+void DeliveryTracker::release(int id) {
+    if (id >= 0 && (size_t)id < MAX_MESSAGES) {
+        messages[id].state = STATE_FREE;
+    }
+}
+
+DeliveryTracker::State DeliveryTracker::state(int id) const {
+    return id >= 0 && (size_t)id < MAX_MESSAGES ? messages[id].state : STATE_FREE;
+}
+
+size_t DeliveryTracker::pendingCount() const {
+    size_t count = 0;
+    for (size_t i = 0; i < MAX_MESSAGES; i++) {
+        if (messages[i].state == STATE_PENDING) {
+            count++;
+        }
+    }
+    return count;
+}
+
+void DeliveryTracker::settle(Message& message, State state, uint32_t now) {
+    message.state = state;
+    message.settledAt = now;
+
+    Recipient& recipient = recipientFor(message.number);
+    if (state == STATE_DELIVERED) {
+        uint32_t latency = now - message.sentAt;
+        recipient.delivered++;
+        recipient.lastLatency = latency;
+        recipient.totalLatency += latency;
+        if (latency > recipient.maxLatency) {
+            recipient.maxLatency = latency;
+        }
+    } else if (state == STATE_FAILED) {
+        recipient.failed++;
+    } else {
+        recipient.expired++;
+    }
+}
+
+DeliveryTracker::Recipient& DeliveryTracker::recipientFor(const char* number) {
+    for (size_t i = 0; i < recipients; i++) {
+        if (strcmp(table[i].number, number) == 0) {
+            return table[i];
+        }
+    }
+    if (recipients < MAX_RECIPIENTS - 1) {
+        strncpy(table[recipients].number, number, NUMBER_LENGTH - 1);
+        return table[recipients++];
+    }
+
+    // The last row collects every number that did not get one
+    if (recipients == MAX_RECIPIENTS - 1) {
+        strcpy(table[recipients++].number, "OTHER");
+    }
+    return table[MAX_RECIPIENTS - 1];
+}
+
+const DeliveryTracker::Recipient* DeliveryTracker::findRecipient(const char* number) const {
+    for (size_t i = 0; i < recipients; i++) {
+        if (strcmp(table[i].number, number) == 0) {
+            return &table[i];
+        }
+    }
+    return nullptr;
+}
+
+bool DeliveryTracker::parseTextReport(const char* line, uint8_t& reference, uint8_t& status) {
+    // The reference is the second field; the status the last, after the
+    // quoted timestamps (which contain commas of their own)
+    const char* colon = strchr(line, ':');
+    const char* first = colon != nullptr ? strchr(colon, ',') : nullptr;
+    const char* last = strrchr(line, ',');
+    if (first == nullptr || last == first) {
+        return false;
+    }
+    reference = (uint8_t)atoi(first + 1);
+    status = (uint8_t)atoi(last + 1);
+    return true;
+}
+
+bool DeliveryTracker::parsePDUReport(const char* hex, uint8_t& reference, uint8_t& status) {
+    size_t length = strlen(hex);
+    if (length < 2) {
+        return false;
+    }
+
+    // SMSC address, then SMS-STATUS-REPORT: first octet, TP-MR, TP-RA,
+    // TP-SCTS, TP-DT, TP-ST
+    int smscLength = hexOctet(hex);
+    size_t p = 2 * (1 + (size_t)(smscLength < 0 ? 0 : smscLength));
+    if (smscLength < 0 || p + 6 > length) {
+        return false;
+    }
+    int firstOctet = hexOctet(hex + p);
+    int mr = hexOctet(hex + p + 2);
+    int digits = hexOctet(hex + p + 4);
+    if (firstOctet < 0 || (firstOctet & 0x03) != 0x02 || mr < 0 || digits < 0) {
+        return false;
+    }
+    p += 2 * (3 + 1 + ((size_t)digits + 1) / 2 + 7 + 7);
+    if (p + 2 > length) {
+        return false;
+    }
+    int st = hexOctet(hex + p);
+    if (st < 0) {
+        return false;
+    }
+    reference = (uint8_t)mr;
+    status = (uint8_t)st;
+    return true;
+}
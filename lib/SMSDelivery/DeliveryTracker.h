@@ -0,0 +1,105 @@
+#ifndef DELIVERYTRACKER_H
+#define DELIVERYTRACKER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Matches SMS status reports (+CDS) to the messages they are about.
+//
+// +CMGS only says the message reached the SMS centre. With the status report
+// request bit set, the centre reports back once the phone has it (or once it
+// gave up), quoting the message reference +CMGS returned. A concatenated
+// message has one reference per part and counts as delivered when every
+// part is.
+//
+// TP-ST values (3GPP TS 23.040 9.2.3.15): below 0x20 the message was
+// delivered; 0x20-0x3F the centre is still trying; 0x40-0x5F it failed for
+// good (unknown number, barred); 0x60-0x7F it failed for now and the centre
+// stopped trying. A message with no final report within the timeout counts
+// as expired.
+//
+// Delivery counts and latencies (from +CMGS to the last report) are kept per
+// recipient; numbers beyond MAX_RECIPIENTS share the last row.
+//
+// now is millis(). Ages are taken as now - sentAt, which stays right across
+// the rollover; the timeout settles a message long before it could alias.
+class DeliveryTracker {
+public:
+    enum State : uint8_t {
+        STATE_FREE = 0,
+        STATE_PENDING,
+        STATE_DELIVERED,
+        STATE_FAILED,           // Final error report; see status()
+        STATE_EXPIRED           // No final report in time
+    };
+
+    static const size_t MAX_MESSAGES = 16;
+    static const size_t MAX_PARTS = 4;
+    static const size_t MAX_RECIPIENTS = 8;
+    static const size_t NUMBER_LENGTH = 20;
+
+    struct Recipient {
+        char number[NUMBER_LENGTH];
+        uint32_t delivered;
+        uint32_t failed;
+        uint32_t expired;
+        uint32_t lastLatency;
+        uint32_t maxLatency;
+        uint32_t totalLatency;  // Over the delivered ones
+    };
+
+    explicit DeliveryTracker(uint32_t timeout);
+
+    // Starts tracking a message; -1 if every slot is in use
+    int begin(const char* number, uint32_t now);
+    // One part was accepted (+CMGS: <reference>)
+    void addPart(int id, uint8_t reference);
+    // A status report; returns the message it settled, -1 if none
+    int report(uint8_t reference, uint8_t status, uint32_t now);
+
+    // A settled message not yet released (expiring overdue ones first); -1 if none
+    int nextSettled(uint32_t now);
+    void release(int id);
+
+    State state(int id) const;
+    uint8_t status(int id) const { return messages[id].status; }
+    uint32_t latency(int id) const { return messages[id].settledAt - messages[id].sentAt; }
+    const char* number(int id) const { return messages[id].number; }
+    size_t pendingCount() const;
+
+    size_t recipientCount() const { return recipients; }
+    const Recipient& recipient(size_t index) const { return table[index]; }
+    const Recipient* findRecipient(const char* number) const;
+
+    static bool isDelivered(uint8_t status) { return status < 0x20; }
+    static bool isFinal(uint8_t status) { return status < 0x20 || status >= 0x40; }
+    static bool isPermanent(uint8_t status) { return status >= 0x40 && status < 0x60; }
+    static bool isTemporary(uint8_t status) { return status >= 0x60 && status < 0x80; }
+
+    // +CDS: <fo>,<mr>,"<ra>",<tora>,"<scts>","<dt>",<st>
+    static bool parseTextReport(const char* line, uint8_t& reference, uint8_t& status);
+    // The hex line after "+CDS: <length>" in PDU mode, SMSC address first
+    static bool parsePDUReport(const char* hex, uint8_t& reference, uint8_t& status);
+
+private:
+    struct Message {
+        State state;
+        char number[NUMBER_LENGTH];
+        uint8_t references[MAX_PARTS];
+        uint8_t parts;
+        uint8_t settledParts;   // Bit per part
+        uint8_t status;
+        uint32_t sentAt;
+        uint32_t settledAt;
+    };
+
+    Message messages[MAX_MESSAGES];
+    Recipient table[MAX_RECIPIENTS];
+    size_t recipients;
+    uint32_t timeout;
+
+    void settle(Message& message, State state, uint32_t now);
+    Recipient& recipientFor(const char* number);
+};
+
+#endif // DELIVERYTRACKER_H
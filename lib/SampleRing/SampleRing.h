@@ -0,0 +1,108 @@
+#ifndef SAMPLERING_H
+#define SAMPLERING_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+
+// Block the indices are padded to. The classic ESP32 does not cache its
+// internal DRAM, so the two cores share no lines there and the padding buys
+// no speed; 32 bytes is the line of its flash/PSRAM cache, so the indices
+// still stay apart if the ring moves to PSRAM, at 48 bytes of padding. On a
+// host, 64 keeps the two threads off each other's cache line.
+#ifdef ARDUINO
+#define SAMPLE_RING_CACHE_LINE 32
+#else
+#define SAMPLE_RING_CACHE_LINE 64
+#endif
+
+// Lock-free ring of fixed-size records from one producer task to one
+// consumer task, possibly on the other core.
+//
+// push() never blocks and never fails. When the ring is full it drops the
+// oldest record and counts the drop. Dropping moves the read index, so the
+// read index is advanced by compare-and-swap from both sides. The producer
+// only reads it again once the ring looks full, so a consumer that keeps up
+// costs the producer no read of the other side's index.
+//
+// popBatch() copies records out and then claims them with one CAS. If the
+// producer dropped any of them meanwhile, the CAS fails and the copy is
+// taken again, so a record the producer overwrote is never returned.
+//
+// T must be trivially copyable. N is a power of two; indices are free
+// running and wrap at 2^32.
+template <typename T, uint32_t N>
+class SampleRing {
+    static_assert(N >= 2 && (N & (N - 1)) == 0, "SampleRing size must be a power of two");
+
+public:
+    static const uint32_t CAPACITY = N;
+
+    SampleRing() : head(0), cachedTail(0), dropCount(0), tail(0) {}
+
+    // Producer side
+    void push(const T& record) {
+        uint32_t h = head.load(std::memory_order_relaxed);
+        if (h - cachedTail >= N) {
+            cachedTail = tail.load(std::memory_order_acquire);
+            if (h - cachedTail >= N) {
+                // Full: take the oldest from under the consumer. Failing means
+                // the consumer claimed it first, which frees the slot too.
+                uint32_t expected = cachedTail;
+                if (tail.compare_exchange_strong(expected, cachedTail + 1, std::memory_order_acq_rel)) {
+                    dropCount.fetch_add(1, std::memory_order_relaxed);
+                    cachedTail++;
+                } else {
+                    cachedTail = expected;
+                }
+            }
+        }
+        memcpy(&slots[h & (N - 1)], &record, sizeof(T));
+        head.store(h + 1, std::memory_order_release);
+    }
+
+    // Consumer side: up to `max` records, oldest first
+    size_t popBatch(T* out, size_t max) {
+        uint32_t t = tail.load(std::memory_order_acquire);
+        for (;;) {
+            uint32_t h = head.load(std::memory_order_acquire);
+            uint32_t available = h - t;
+            size_t count = available < max ? available : max;
+            if (count == 0) {
+                return 0;
+            }
+            for (size_t i = 0; i < count; i++) {
+                memcpy(&out[i], &slots[(t + i) & (N - 1)], sizeof(T));
+            }
+            // Also orders the copies before the slots are handed back
+            if (tail.compare_exchange_strong(t, t + (uint32_t)count, std::memory_order_acq_rel)) {
+                return count;
+            }
+        }
+    }
+
+    bool pop(T& out) {
+        return popBatch(&out, 1) == 1;
+    }
+
+    // Either side; a snapshot that may be stale by the time it is used
+    uint32_t size() const {
+        uint32_t t = tail.load(std::memory_order_acquire);
+        uint32_t h = head.load(std::memory_order_acquire);
+        return h - t > N ? N : h - t;
+    }
+    uint32_t dropped() const { return dropCount.load(std::memory_order_relaxed); }
+    uint32_t pushed() const { return head.load(std::memory_order_relaxed); }
+
+private:
+    // Written by the producer
+    alignas(SAMPLE_RING_CACHE_LINE) std::atomic<uint32_t> head;
+    uint32_t cachedTail;
+    std::atomic<uint32_t> dropCount;
+    // Written by the consumer (and by the producer only when dropping)
+    alignas(SAMPLE_RING_CACHE_LINE) std::atomic<uint32_t> tail;
+    alignas(SAMPLE_RING_CACHE_LINE) T slots[N];
+};
+
+#endif // SAMPLERING_H
@@ -93,10 +93,10 @@ bool SensorHandler::sendAndReceive(SoftwareSerial &serial, uint8_t address, uint
     serial.write(cmd, sizeof(cmd));
     
     // Wait for response
-    unsigned long start = millis();
+    uint64_t start = monoMillis();
     uint8_t idx = 0;
     
-    while((millis() - start) < timeout) {
+    while((monoMillis() - start) < timeout) {
         if(serial.available()) {
             response[idx++] = serial.read();
             if(idx >= responseSize) {
@@ -200,14 +200,14 @@ bool SensorHandler::parseResponse(uint8_t *response, uint8_t len, uint8_t addres
     //     Serial.println("---");
     // }
     
-    result.timestamp = millis();
+    result.timestamp = monoMillis();
     result.ok = true;
     
     return true;
 }
 
 PZEMReading SensorHandler::readTenant(SoftwareSerial &serial, uint8_t address, 
-                                     unsigned long &lastReading, float &energy, float &dailyEnergy) {
+                                     uint64_t &lastReading, float &energy, float &dailyEnergy) {
     PZEMReading result = emptyReading(energy);
     
     if(mockMode) {
@@ -233,9 +233,9 @@ if(!success) {
 };
     
     // Energy accumulation
-    unsigned long now = millis();
+    uint64_t now = monoMillis();
     if(lastReading > 0 && now > lastReading) {
-        unsigned long elapsed = now - lastReading;
+        uint64_t elapsed = now - lastReading;
         if(elapsed <= 600000) { // Max 10 minutes between readings
             float deltaHours = elapsed / 3600000.0f; // ms to hours
             float deltaKwh = (result.power * deltaHours) / 1000.0f;
@@ -264,7 +264,7 @@ PZEMReading SensorHandler::emptyReading(float energy) {
     result.daily_cost = 0.0f;
     result.frequency = 0.0f;
     result.power_factor = 0.0f;
-    result.timestamp = millis();
+    result.timestamp = monoMillis();
     result.ok = false;
     return result;
 }
@@ -289,7 +289,7 @@ PZEMReading SensorHandler::mockRead() {
     result.daily_cost = result.daily_energy_kwh * ENERGY_COST_PER_KWH;
     result.frequency = 50.0f;
     result.power_factor = 0.95f;
-    result.timestamp = millis();
+    result.timestamp = monoMillis();
     result.ok = true;
     
     return result;
@@ -367,9 +367,9 @@ uint8_t SensorHandler::discoverAddresses(uint8_t tenant) {
         targetSerial->write(cmd, sizeof(cmd));
         
         // Wait for response
-        unsigned long start = millis();
+        uint64_t start = monoMillis();
         uint8_t idx = 0;
-        while((millis() - start) < 500) { // 500ms timeout
+        while((monoMillis() - start) < 500) { // 500ms timeout
             if(targetSerial->available()) {
                 response[idx++] = targetSerial->read();
                 if(idx >= sizeof(response)) break;
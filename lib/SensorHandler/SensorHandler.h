@@ -5,6 +5,7 @@
 #include <Arduino.h>
 #include <SoftwareSerial.h>
 #include "config.h"
+#include "MonoClock.h"
 
 struct PZEMReading {
     float voltage;
@@ -16,7 +17,7 @@ struct PZEMReading {
     float daily_cost;
     float frequency;
     float power_factor;
-    unsigned long timestamp;
+    uint64_t timestamp;         // monoMillis()
     bool ok;
 };
 
@@ -27,7 +28,7 @@ struct PZEMResult {
         float total_power;
         float total_daily_energy_kwh;
         float total_daily_cost;
-        unsigned long timestamp;
+        uint64_t timestamp;
     } summary;
 };
 
@@ -61,8 +62,8 @@ private:
     float dailyEnergyA;
     float dailyEnergyB;
     
-    unsigned long lastReadingA;
-    unsigned long lastReadingB;
+    uint64_t lastReadingA;      // monoMillis() of the last good reading, 0 before the first
+    uint64_t lastReadingB;
     
     StatusResult status;
 
@@ -74,7 +75,7 @@ private:
     uint16_t crc16Modbus(const uint8_t *data, uint16_t len);
     void buildReadCommand(uint8_t address, uint8_t *cmd);
     void buildWriteSingleCommand(uint8_t address, uint16_t reg, uint16_t value, uint8_t *cmd);
-    PZEMReading readTenant(SoftwareSerial &serial, uint8_t address, unsigned long &lastReading, 
+    PZEMReading readTenant(SoftwareSerial &serial, uint8_t address, uint64_t &lastReading, 
                           float &energy, float &dailyEnergy);
     PZEMReading emptyReading(float energy = 0.0f);
     bool sendAndReceive(SoftwareSerial &serial, uint8_t address, uint8_t *response, 
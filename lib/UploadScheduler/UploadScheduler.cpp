@@ -0,0 +1,74 @@
+#include "UploadScheduler.h"
+
+UploadScheduler::UploadScheduler(uint32_t interval, uint32_t jitter, uint32_t minInterval, uint32_t maxInterval)
+    : minInterval(minInterval > 0 ? minInterval : 1),
+      maxInterval(maxInterval > minInterval ? maxInterval : minInterval) {
+    currentInterval = interval < this->minInterval ? this->minInterval
+                    : (interval > this->maxInterval ? this->maxInterval : interval);
+    jitterSpan = jitter < currentInterval ? jitter : currentInterval;
+    phaseOffset = 0;
+    nextAt = 0;
+    randomState = 0x9E3779B9;
+}
+
+void UploadScheduler::seed(uint32_t value) {
+    // xorshift never leaves an all-zero state
+    randomState = value != 0 ? value : 0x9E3779B9;
+}
+
+void UploadScheduler::begin(uint32_t now, const char* deviceId) {
+    phaseOffset = hashId(deviceId) % currentInterval;
+    nextAt = now + phaseOffset;
+}
+
+bool UploadScheduler::due(uint32_t now) const {
+    return (int32_t)(now - nextAt) >= 0;
+}
+
+uint32_t UploadScheduler::dueIn(uint32_t now) const {
+    return due(now) ? 0 : nextAt - now;
+}
+
+void UploadScheduler::windowUsed(uint32_t now) {
+    nextAt = now + jittered(currentInterval);
+}
+
+void UploadScheduler::deferWindow(uint32_t now, uint32_t delay) {
+    nextAt = now + (delay < currentInterval ? delay : currentInterval);
+}
+
+void UploadScheduler::setInterval(uint32_t now, uint32_t interval) {
+    if (interval < minInterval) interval = minInterval;
+    if (interval > maxInterval) interval = maxInterval;
+    if (interval == currentInterval) {
+        return;
+    }
+
+    // Heard at this device's own window, so counting from now keeps the
+    // fleet as spread out as it already is
+    currentInterval = interval;
+    if (jitterSpan > currentInterval) jitterSpan = currentInterval;
+    nextAt = now + jittered(currentInterval);
+}
+
+uint32_t UploadScheduler::hashId(const char* id) {
+    // FNV-1a
+    uint32_t hash = 2166136261UL;
+    while (id != nullptr && *id != '\0') {
+        hash ^= (uint8_t)*id++;
+        hash *= 16777619UL;
+    }
+    return hash;
+}
+
+uint32_t UploadScheduler::nextRandom() {
+    randomState ^= randomState << 13;
+    randomState ^= randomState >> 17;
+    randomState ^= randomState << 5;
+    return randomState;
+}
+
+uint32_t UploadScheduler::jittered(uint32_t delay) {
+    uint32_t half = jitterSpan / 2;
+    return delay - half + nextRandom() % (jitterSpan + 1);
+}
@@ -0,0 +1,59 @@
+#ifndef UPLOADSCHEDULER_H
+#define UPLOADSCHEDULER_H
+
+#include <stdint.h>
+
+// Decides when the next upload window opens.
+//
+// A fleet that powers up together (a district-wide restore) would otherwise
+// upload in lockstep on boot-relative boundaries. Each device starts its
+// schedule at a fixed phase within the interval, derived from its ID, and
+// every window is jittered by up to +/- jitter/2 so devices that happen to
+// share a phase drift apart again.
+//
+// The server can change the interval at runtime. The window after the change
+// opens one new interval (+/- jitter) later; the phase only places the first.
+//
+// now is millis(). A window is due once the signed difference to it turns
+// non-negative, so one set just before the 49-day rollover still opens.
+class UploadScheduler {
+public:
+    UploadScheduler(uint32_t interval, uint32_t jitter, uint32_t minInterval, uint32_t maxInterval);
+
+    void seed(uint32_t value);
+
+    // First window: phase (ID hash modulo the interval) after now
+    void begin(uint32_t now, const char* deviceId);
+
+    bool due(uint32_t now) const;
+    uint32_t dueIn(uint32_t now) const;
+
+    // The window was used; the next one opens an interval (+/- jitter) later
+    void windowUsed(uint32_t now);
+
+    // The window was passed up; look again after delay, keeping the interval
+    void deferWindow(uint32_t now, uint32_t delay);
+
+    // Server-set interval, clamped to [minInterval, maxInterval]; the next
+    // window opens that far (+/- jitter) after now
+    void setInterval(uint32_t now, uint32_t interval);
+
+    uint32_t interval() const { return currentInterval; }
+    uint32_t phase() const { return phaseOffset; }
+
+    static uint32_t hashId(const char* id);
+
+private:
+    uint32_t currentInterval;
+    uint32_t jitterSpan;
+    uint32_t minInterval;
+    uint32_t maxInterval;
+    uint32_t phaseOffset;
+    uint32_t nextAt;
+    uint32_t randomState;
+
+    uint32_t nextRandom();
+    uint32_t jittered(uint32_t delay);
+};
+
+#endif // UPLOADSCHEDULER_H
@@ -0,0 +1,126 @@
+#ifdef ARDUINO
+
+#include "DS3231.h"
+#include "CivilTime.h"
+
+namespace {
+    const uint8_t REG_SECONDS = 0x00;
+    const uint8_t REG_CONTROL = 0x0E;
+    const uint8_t REG_STATUS = 0x0F;
+    const uint8_t REG_AGING = 0x10;
+
+    const uint8_t CONTROL_CONV = 0x20;
+    const uint8_t STATUS_OSF = 0x80;    // Oscillator stopped: the time is not to be trusted
+
+    uint8_t fromBCD(uint8_t value) {
+        return (value >> 4) * 10 + (value & 0x0F);
+    }
+
+    uint8_t toBCD(uint8_t value) {
+        return (uint8_t)((value / 10) << 4 | value % 10);
+    }
+}
+
+DS3231::DS3231(TwoWire& wire, uint8_t address) : wire(wire), address(address) {
+}
+
+bool DS3231::begin() {
+    wire.beginTransmission(address);
+    return wire.endTransmission() == 0;
+}
+
+bool DS3231::readTime(uint32_t& epoch) {
+    uint8_t status;
+    if (!readRegisters(REG_STATUS, &status, 1) || (status & STATUS_OSF)) {
+        return false;
+    }
+
+    uint8_t data[7];
+    if (!readRegisters(REG_SECONDS, data, sizeof(data))) {
+        return false;
+    }
+    CivilTime time;
+    time.second = fromBCD(data[0] & 0x7F);
+    time.minute = fromBCD(data[1] & 0x7F);
+    time.hour = fromBCD(data[2] & 0x3F);    // Written in 24-hour mode
+    time.day = fromBCD(data[4] & 0x3F);
+    time.month = fromBCD(data[5] & 0x1F);
+    time.year = 2000 + fromBCD(data[6]) + ((data[5] & 0x80) ? 100 : 0);
+    if (time.month < 1 || time.month > 12 || time.day < 1 || time.day > 31) {
+        return false;
+    }
+    epoch = civilToEpoch(time);
+    return true;
+}
+
+bool DS3231::writeTime(uint32_t epoch) {
+    CivilTime time;
+    epochToCivil(epoch, time);
+    uint8_t data[7];
+    data[0] = toBCD(time.second);
+    data[1] = toBCD(time.minute);
+    data[2] = toBCD(time.hour);
+    data[3] = (uint8_t)((epoch / 86400 + 4) % 7 + 1);  // 1970-01-01 was a Thursday; 1 = Sunday
+    data[4] = toBCD(time.day);
+    data[5] = toBCD(time.month) | (time.year >= 2100 ? 0x80 : 0);
+    data[6] = toBCD((uint8_t)(time.year % 100));
+    if (!writeRegisters(REG_SECONDS, data, sizeof(data))) {
+        return false;
+    }
+
+    // The time is good again
+    uint8_t status;
+    if (!readRegisters(REG_STATUS, &status, 1)) {
+        return false;
+    }
+    status &= ~STATUS_OSF;
+    return writeRegisters(REG_STATUS, &status, 1);
+}
+
+bool DS3231::readTrim(int8_t& trim) {
+    uint8_t value;
+    if (!readRegisters(REG_AGING, &value, 1)) {
+        return false;
+    }
+    trim = (int8_t)value;
+    return true;
+}
+
+bool DS3231::writeTrim(int8_t trim) {
+    uint8_t value = (uint8_t)trim;
+    if (!writeRegisters(REG_AGING, &value, 1)) {
+        return false;
+    }
+
+    // The new offset applies from the next temperature conversion; start one
+    uint8_t control;
+    if (!readRegisters(REG_CONTROL, &control, 1)) {
+        return false;
+    }
+    control |= CONTROL_CONV;
+    return writeRegisters(REG_CONTROL, &control, 1);
+}
+
+bool DS3231::readRegisters(uint8_t first, uint8_t* data, uint8_t count) {
+    wire.beginTransmission(address);
+    wire.write(first);
+    if (wire.endTransmission(false) != 0) {
+        return false;
+    }
+    if (wire.requestFrom(address, count) != count) {
+        return false;
+    }
+    for (uint8_t i = 0; i < count; i++) {
+        data[i] = (uint8_t)wire.read();
+    }
+    return true;
+}
+
+bool DS3231::writeRegisters(uint8_t first, const uint8_t* data, uint8_t count) {
+    wire.beginTransmission(address);
+    wire.write(first);
+    wire.write(data, count);
+    return wire.endTransmission() == 0;
+}
+
+#endif // ARDUINO
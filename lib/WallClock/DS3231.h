@@ -0,0 +1,34 @@
+#ifndef DS3231_H
+#define DS3231_H
+
+#ifdef ARDUINO
+
+#include <Wire.h>
+#include "RTCDevice.h"
+
+// Maxim DS3231 on I2C, kept in UTC. The trim is the aging offset register:
+// one step is about 0.1 ppm at 25 C, positive slows the oscillator.
+class DS3231 : public RTCDevice {
+public:
+    DS3231(TwoWire& wire, uint8_t address);
+
+    // True if the chip answers; the bus must already be up
+    bool begin();
+
+    bool readTime(uint32_t& epoch);
+    bool writeTime(uint32_t epoch);
+    bool readTrim(int8_t& trim);
+    bool writeTrim(int8_t trim);
+    int trimStep() const { return 1; }
+
+private:
+    TwoWire& wire;
+    uint8_t address;
+
+    bool readRegisters(uint8_t first, uint8_t* data, uint8_t count);
+    bool writeRegisters(uint8_t first, const uint8_t* data, uint8_t count);
+};
+
+#endif // ARDUINO
+
+#endif // DS3231_H
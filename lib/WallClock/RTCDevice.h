@@ -0,0 +1,22 @@
+#ifndef RTCDEVICE_H
+#define RTCDEVICE_H
+
+#include <stdint.h>
+
+// Battery-backed real-time clock as seen by WallClock. Time is UTC epoch
+// seconds; the trim is the chip's own rate adjustment in its native units.
+class RTCDevice {
+public:
+    virtual ~RTCDevice() {}
+
+    // False if the chip does not answer or lost the time (oscillator stopped)
+    virtual bool readTime(uint32_t& epoch) = 0;
+    virtual bool writeTime(uint32_t epoch) = 0;
+
+    virtual bool readTrim(int8_t& trim) = 0;
+    virtual bool writeTrim(int8_t trim) = 0;
+    // Rate change of one trim step in tenths of a ppm; positive trims slow the clock
+    virtual int trimStep() const = 0;
+};
+
+#endif // RTCDEVICE_H
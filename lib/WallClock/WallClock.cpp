@@ -0,0 +1,151 @@
+#include "WallClock.h"
+#include <string.h>
+
+namespace {
+    const uint64_t RATE_MIN_SPAN = 3600000ULL;       // Below this a 1 s reading says nothing about the rate
+    const uint64_t RATE_MAX_SPAN = 7ULL * 86400000ULL; // Restart weekly so the rate follows temperature
+}
+
+WallClock::WallClock(uint32_t trimSpan) : rtc(nullptr), trimSpan(trimSpan > 0 ? trimSpan : 1) {
+    current = SOURCE_NONE;
+    anchorEpochMillis = 0;
+    anchorAt = 0;
+    lastSyncAt = 0;
+    rateReferenceSet = false;
+    rateReferenceEpoch = 0;
+    rateReferenceAt = 0;
+    rtcReferenceSet = false;
+    rtcReferenceEpoch = 0;
+    memset(&stats, 0, sizeof(stats));
+}
+
+void WallClock::attachRTC(RTCDevice* device) {
+    rtc = device;
+}
+
+bool WallClock::begin(uint64_t now) {
+    uint32_t epoch;
+    if (rtc != nullptr && rtc->readTime(epoch) && epoch >= MIN_VALID_EPOCH) {
+        anchor((uint64_t)epoch * 1000, now, SOURCE_RTC);
+        lastSyncAt = now;
+        rtc->readTrim(stats.rtcTrim);
+    }
+    return valid();
+}
+
+uint64_t WallClock::epochMillis(uint64_t now) const {
+    if (current == SOURCE_NONE) {
+        return 0;
+    }
+    // Signed, so a reading taken just before the anchor moved still resolves
+    return anchorEpochMillis + (int64_t)(now - anchorAt);
+}
+
+void WallClock::syncNetwork(uint32_t epoch, uint64_t now) {
+    if (epoch < MIN_VALID_EPOCH) {
+        return;
+    }
+    uint64_t network = (uint64_t)epoch * 1000;
+    stats.syncs++;
+    lastSyncAt = now;
+
+    if (current == SOURCE_NETWORK) {
+        int64_t offset = (int64_t)(network - epochMillis(now));
+        stats.lastOffset = (int32_t)offset;
+        int32_t magnitude = stats.lastOffset < 0 ? -stats.lastOffset : stats.lastOffset;
+        if (magnitude > stats.maxOffset) {
+            stats.maxOffset = magnitude;
+        }
+        // Within the resolution of network time: keep counting from the
+        // estimate rather than snap to whole seconds
+        if (magnitude < 1000) {
+            anchor(epochMillis(now), now, SOURCE_NETWORK);
+        } else {
+            anchor(network, now, SOURCE_NETWORK);
+            stats.steps++;
+        }
+    } else {
+        anchor(network, now, SOURCE_NETWORK);
+        stats.steps++;
+    }
+
+    // Rate error from network time at both ends of a long enough span
+    uint64_t span = now - rateReferenceAt;
+    if (!rateReferenceSet || span >= RATE_MAX_SPAN) {
+        rateReferenceSet = true;
+        rateReferenceEpoch = epoch;
+        rateReferenceAt = now;
+    } else if (span >= RATE_MIN_SPAN) {
+        int64_t error = (int64_t)(epoch - rateReferenceEpoch) * 1000 - (int64_t)span;
+        stats.ppm = (int32_t)(error * 1000000 / (int64_t)span);
+    }
+
+    disciplineRTC(epoch);
+}
+
+void WallClock::anchor(uint64_t epochMillis, uint64_t now, Source source) {
+    anchorEpochMillis = epochMillis;
+    anchorAt = now;
+    current = source;
+}
+
+void WallClock::disciplineRTC(uint32_t epoch) {
+    if (rtc == nullptr) {
+        return;
+    }
+
+    uint32_t rtcEpoch;
+    if (!rtc->readTime(rtcEpoch)) {
+        // Lost power or never set
+        if (rtc->writeTime(epoch)) {
+            rtcReferenceSet = true;
+            rtcReferenceEpoch = epoch;
+        }
+        return;
+    }
+    int32_t error = (int32_t)(rtcEpoch - epoch);
+    stats.rtcOffset = error;
+    int32_t magnitude = error < 0 ? -error : error;
+
+    // Nothing is known about how long it ran since it was last set before this boot
+    if (!rtcReferenceSet) {
+        if (error == 0 || rtc->writeTime(epoch)) {
+            rtcReferenceSet = true;
+            rtcReferenceEpoch = epoch;
+        }
+        return;
+    }
+
+    uint32_t span = epoch - rtcReferenceEpoch;
+    if (span >= trimSpan && error != 0) {
+        // A fast RTC (ahead of network time) needs a positive trim to slow it
+        int64_t tenthsPPM = (int64_t)error * 10000000 / span;
+        int step = rtc->trimStep() > 0 ? rtc->trimStep() : 1;
+        int32_t steps = (int32_t)((tenthsPPM + (tenthsPPM >= 0 ? step / 2 : -step / 2)) / step);
+        int8_t trim = 0;
+        if (steps != 0 && rtc->readTrim(trim)) {
+            int32_t adjusted = trim + steps;
+            adjusted = adjusted > 127 ? 127 : (adjusted < -128 ? -128 : adjusted);
+            if (rtc->writeTrim((int8_t)adjusted)) {
+                stats.rtcTrim = (int8_t)adjusted;
+                stats.rtcTrims++;
+            }
+        }
+        if (rtc->writeTime(epoch)) {
+            rtcReferenceEpoch = epoch;
+        }
+    } else if (magnitude >= 2) {
+        // Stepped (or far off after a battery swap): restart the measurement
+        if (rtc->writeTime(epoch)) {
+            rtcReferenceEpoch = epoch;
+        }
+    }
+}
+
+const char* WallClock::sourceName(Source source) {
+    switch (source) {
+        case SOURCE_RTC: return "RTC";
+        case SOURCE_NETWORK: return "NETWORK";
+        default: return "NONE";
+    }
+}
@@ -0,0 +1,81 @@
+#ifndef WALLCLOCK_H
+#define WALLCLOCK_H
+
+#include <stdint.h>
+#include "RTCDevice.h"
+
+// UTC time of day for stamping readings, kept against the 64-bit
+// millisecond count since boot (monoMillis()).
+//
+// The clock is anchored to one (epoch, count) pair, so reading it is one
+// subtraction. The count does not wrap, so an anchor that is never moved
+// (RTC time and no network time) stays good for the life of the unit. At
+// boot the anchor comes from the RTC, if one is attached and kept its time;
+// network time (AT+CCLK after AT+CLTS) then takes over.
+//
+// Network time has one-second resolution, so a sync keeps the running
+// estimate unless it is off by a second or more. What it was off by, and
+// the rate error of the local oscillator against network time (measured
+// over at least an hour), are kept as drift statistics.
+//
+// The RTC is set from network time when it is off by two seconds or more.
+// Once it has run for trimSpan seconds since it was last set, its rate error
+// over that span goes into the chip's trim (aging offset on the DS3231).
+class WallClock {
+public:
+    enum Source : uint8_t {
+        SOURCE_NONE = 0,
+        SOURCE_RTC,
+        SOURCE_NETWORK
+    };
+
+    struct DriftStats {
+        uint32_t syncs;             // Network time readings
+        uint32_t steps;             // Of those, the ones that stepped the estimate
+        int32_t lastOffset;         // ms, network time minus our estimate at the last sync
+        int32_t maxOffset;          // Largest |lastOffset| seen
+        int32_t ppm;                // Local rate error against network time; positive runs slow
+        int32_t rtcOffset;          // s, RTC minus network time at the last sync
+        int8_t rtcTrim;
+        uint32_t rtcTrims;
+    };
+
+    static const uint32_t MIN_VALID_EPOCH = 1577836800UL;  // 2020-01-01; RTCs restart in 2000
+
+    explicit WallClock(uint32_t trimSpan = 604800);
+
+    void attachRTC(RTCDevice* rtc);
+    // Loads the time from the RTC if it kept it; true if the clock is set
+    bool begin(uint64_t now);
+
+    void syncNetwork(uint32_t epoch, uint64_t now);
+
+    bool valid() const { return current != SOURCE_NONE; }
+    Source source() const { return current; }
+    // 0 while the clock is not set; `now` may lie before the last sync
+    uint64_t epochMillis(uint64_t now) const;
+    uint32_t epoch(uint64_t now) const { return (uint32_t)(epochMillis(now) / 1000); }
+    uint64_t sinceSync(uint64_t now) const { return now - lastSyncAt; }
+    const DriftStats& drift() const { return stats; }
+
+    static const char* sourceName(Source source);
+
+private:
+    RTCDevice* rtc;
+    uint32_t trimSpan;
+    Source current;
+    uint64_t anchorEpochMillis;
+    uint64_t anchorAt;
+    uint64_t lastSyncAt;
+    bool rateReferenceSet;          // First network sync of the rate measurement
+    uint32_t rateReferenceEpoch;
+    uint64_t rateReferenceAt;
+    bool rtcReferenceSet;
+    uint32_t rtcReferenceEpoch;     // When the RTC was last set
+    DriftStats stats;
+
+    void anchor(uint64_t epochMillis, uint64_t now, Source source);
+    void disciplineRTC(uint32_t epoch);
+};
+
+#endif // WALLCLOCK_H
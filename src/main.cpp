@@ -4,19 +4,93 @@
 #include "GSMModule.h"
 #include "LCDInterface.h"
 #include "AlertHandler.h"
+#include "DS3231.h"
+#include "MonoClock.h"
+#include "SampleRing.h"
 
 // Global instances
 SensorHandler sensorHandler;
 GSMModule gsmModule;
 LCDInterface lcdInterface;
 AlertHandler alertHandler;
+DS3231 rtc(Wire, RTC_I2C_ADDR);
 
-// Timing variables
-unsigned long lastSensorReadTime = 0;
-unsigned long lastDataLogTime = 0;
-unsigned long lastSMSCheckTime = 0;
-unsigned long lastAPIUpdateTime = 0;
-unsigned long lastDailyResetCheck = 0;
+// Sensing, the modem and the UI run as FreeRTOS tasks (started in setup()).
+// Only the sensor task reads the meters, only the GSM task talks to the
+// modem and only the UI task drives the LCD and LEDs; they hand work to
+// each other through the bounded queues below.
+//
+// The I2C bus is the exception: the GSM task reads and sets the DS3231 when
+// it syncs the clock, while the UI task writes the LCD on the same Wire.
+// That relies on the Arduino-ESP32 core locking Wire for each transaction;
+// the two devices have their own addresses, so interleaved transactions do
+// not disturb each other.
+
+// Latest readings, overwritten by the sensor task (one-slot mailbox)
+struct SensorSnapshot {
+  PZEMResult readings;
+  bool tenantAOk;
+  bool tenantBOk;
+  char lastError[8];
+};
+
+struct UIEvent {
+  enum Type : uint8_t {
+    MESSAGE,              // text for `duration` ms
+    ALERT,                // text (or error code) until the next page
+    ENERGY_ALERT,         // value = tenant
+    CLEAR_ENERGY_ALERT,
+    SYSTEM_ALERT,
+    CLEAR_SYSTEM_ALERT,
+    COMMUNICATION         // value = on/off
+  };
+  Type type;
+  uint8_t value;
+  uint16_t duration;
+  char text[32];
+};
+
+// SMS alerts raised by the sensor task, queued with the modem by the GSM task
+struct AlertRequest {
+  bool threshold;         // sendThresholdAlert(), else sendSystemAlert(text)
+  char tenant[8];
+  char metric[8];
+  float value;
+  float limit;
+  char text[64];
+};
+
+QueueHandle_t snapshotQueue;
+// Sensor task -> GSM task only; a full ring drops the oldest reading
+SampleRing<TelemetryRecord, TELEMETRY_RING_SIZE> telemetryRing;
+QueueHandle_t alertQueue;
+QueueHandle_t uiEventQueue;
+SemaphoreHandle_t sensorLock;           // sensorHandler and the alert flags
+volatile uint32_t alertDrops = 0;
+volatile uint32_t uiEventDrops = 0;
+volatile bool gsmSMSReady = false;      // Published by the GSM task
+
+// Stack and CPU use per task, for sizing them (serial command "tasks")
+struct TaskInfo {
+  const char* name;
+  uint32_t stackSize;
+  UBaseType_t priority;
+  BaseType_t core;
+  TaskHandle_t handle;
+  uint64_t busyMicros;    // Summed over passes, from start to end of the work
+  uint32_t passes;
+  uint32_t maxPassMicros;
+};
+TaskInfo sensorTaskInfo = {"sensors", STACK_SIZE_SENSORS, TASK_PRIORITY_SENSORS, TASK_CORE_SENSORS, nullptr, 0, 0, 0};
+TaskInfo gsmTaskInfo = {"gsm", STACK_SIZE_GSM, TASK_PRIORITY_GSM, TASK_CORE_GSM, nullptr, 0, 0, 0};
+TaskInfo uiTaskInfo = {"ui", STACK_SIZE_UI, TASK_PRIORITY_UI, TASK_CORE_UI, nullptr, 0, 0, 0};
+// The counters are updated from both cores and a 64-bit add is two stores on
+// the Xtensa, so they are written and read under this lock
+portMUX_TYPE taskStatsLock = portMUX_INITIALIZER_UNLOCKED;
+
+// Timing variables (monoMillis(), which does not wrap like millis())
+uint64_t lastDataLogTime = 0;
+uint64_t lastDailyResetCheck = 0;
 
 // Alert tracking
 bool energyAlertSent = false;
@@ -24,9 +98,27 @@ bool costAlertSent = false;
 bool systemAlertSent = false;
 
 // Diagnotics & Function  prototypes
-void updateAPI();
+void sensorTask(void* parameter);
+void gsmTask(void* parameter);
+void uiTask(void* parameter);
+void startTask(TaskFunction_t function, TaskInfo& info);
+void noteTaskPass(TaskInfo& info, uint64_t startedAt);
+void printTaskStats();
+void publishSnapshot(const PZEMResult& readings, const StatusResult& status);
+bool latestSnapshot(SensorSnapshot& snapshot);
+bool postUIEvent(UIEvent::Type type, const char* text = "", uint8_t value = 0, uint16_t duration = 0);
+bool postSystemAlert(const String& message);
+bool postThresholdAlert(const char* tenant, const char* metric, float value, float limit);
+void sendAlert(const AlertRequest& alert);
+void drainTelemetry();
+void handleUIEvent(const UIEvent& event);
+
 void checkForIncomingSMS();
-void logDataToCloud();
+void serviceGSMBringUp();
+void logDataToCloud(const PZEMResult& energyData);
+TelemetryRecord makeTelemetryRecord(const PZEMResult& energyData);
+void serviceCloudUploads();
+void checkSensorStatus(const StatusResult& sensorStatus);
 void checkEnergyThresholds(const PZEMResult& energyData);
 void printInstructions();
 
@@ -45,31 +137,33 @@ void setup() {
   Serial.begin(115200);
   while (!Serial) { ; }    // Wait for serial port to connect
 
+  snapshotQueue = xQueueCreate(1, sizeof(SensorSnapshot));
+  alertQueue = xQueueCreate(ALERT_QUEUE_LENGTH, sizeof(AlertRequest));
+  uiEventQueue = xQueueCreate(UI_EVENT_QUEUE_LENGTH, sizeof(UIEvent));
+  sensorLock = xSemaphoreCreateMutex();
+
   // Initialize components
-  lcdInterface.begin();
+  lcdInterface.begin();    // Also brings up the I2C bus the RTC shares
+  if (ENABLE_RTC && rtc.begin()) {
+    gsmModule.attachRTC(&rtc);
+  }
   sensorHandler.init();
   alertHandler.begin();
 
   // Show startup message
   lcdInterface.showSystemMessage("Initializing ...",2000);
 
-  // Initialize GSM module (non-blocking)
+  // Start GSM bring-up; the GSM task finishes it in the background so
+  // metering, the display and alerts run straight away
   if (DEBUG_MODE) {
     Serial.println("Initializing GSM module...");
   }
-  bool gsmInitialized = gsmModule.initialize();
-  
-  if (gsmInitialized && DEBUG_MODE) {
-    Serial.println("GSM initialized successfully");
-    lcdInterface.showSystemMessage("GSM Ready", 1500);
-  } else if (DEBUG_MODE) {
-    Serial.println("GSM initialization failed");
-    lcdInterface.showSystemMessage("GSM Init Failed", 1500);
-  }
+  gsmModule.beginBringUp();
 
   // Initial sensor read
   PZEMResult initialReadings = sensorHandler.readAll();
   StatusResult sensorStatus = sensorHandler.getStatus();
+  publishSnapshot(initialReadings, sensorStatus);
   
   // Initial display update
   lcdInterface.updateDisplay(initialReadings, sensorStatus);
@@ -79,109 +173,263 @@ void setup() {
 
   printInstructions();
   printDiagnosticsMenu();
+
+  // Meters on one core, the modem on the other; the UI takes what is left
+  startTask(sensorTask, sensorTaskInfo);
+  startTask(gsmTask, gsmTaskInfo);
+  startTask(uiTask, uiTaskInfo);
 }
 
 void loop() {
-  unsigned long currentTime = millis();
+  // Everything runs in the tasks started by setup()
+  vTaskDelete(NULL);
+}
 
-  //Handle Serial commands first
-  handleSerialCommands();
+////////////  TASKS ////////////////////
 
-  // Handle sensor readings at fixed interval
-  if (currentTime - lastSensorReadTime >= SENSOR_READ_INTERVAL) {
-    lastSensorReadTime = currentTime;
-    
-    // Read sensor data
+void startTask(TaskFunction_t function, TaskInfo& info) {
+  xTaskCreatePinnedToCore(function, info.name, info.stackSize, &info, info.priority, &info.handle, info.core);
+}
+
+void noteTaskPass(TaskInfo& info, uint64_t startedAt) {
+  uint32_t spent = (uint32_t)(monoMicros() - startedAt);
+  portENTER_CRITICAL(&taskStatsLock);
+  info.busyMicros += spent;
+  info.passes++;
+  if (spent > info.maxPassMicros) {
+    info.maxPassMicros = spent;
+  }
+  portEXIT_CRITICAL(&taskStatsLock);
+}
+
+// Meters, thresholds and the daily reset, every SENSOR_READ_INTERVAL however
+// long the modem is busy
+void sensorTask(void* parameter) {
+  TaskInfo& info = *static_cast<TaskInfo*>(parameter);
+  TickType_t lastWake = xTaskGetTickCount();
+
+  for (;;) {
+    uint64_t started = monoMicros();
+    uint64_t currentTime = monoMillis();
+
+    xSemaphoreTake(sensorLock, portMAX_DELAY);
     PZEMResult energyData = sensorHandler.readAll();
     StatusResult sensorStatus = sensorHandler.getStatus();
+    checkSensorStatus(sensorStatus);
+    checkEnergyThresholds(energyData);
 
-    // Update display
-    lcdInterface.updateDisplay(energyData, sensorStatus);
+    // Daily data reset check (once per day)
+    if (currentTime - lastDailyResetCheck >=86400000) { //  86400000 24 hours
+      lastDailyResetCheck = currentTime;
+      sensorHandler.resetDailyCounters();
+      energyAlertSent = false;
+      costAlertSent = false;
+      
+      if (DEBUG_MODE) Serial.println("Daily counters reset");
+    }
+    xSemaphoreGive(sensorLock);
 
-// Check for system alerts
-if (!sensorStatus.tenant_a_ok || !sensorStatus.tenant_b_ok) {
-    // Determine which sensor failed
-    String sensorName = !sensorStatus.tenant_a_ok ? "A" : "B";
-    
-    // For serial debugging - show raw code
-    if (DEBUG_MODE) {
-        Serial.print("Sensor ");
-        Serial.print(sensorName);
-        Serial.print(" error: ");
-        Serial.println(sensorStatus.last_error);
+    // The UI task shows whatever was read last
+    publishSnapshot(energyData, sensorStatus);
+
+    // Readings are queued at a fixed interval
+    if (currentTime - lastDataLogTime >= DATA_LOG_INTERVAL) {
+      lastDataLogTime = currentTime;
+      logDataToCloud(energyData);
     }
-    
-    // Trigger visual/audio alerts
-    alertHandler.triggerSystemAlert();
-    lcdInterface.showAlert(sensorStatus.last_error); // Pass raw code to LCD
-    
-    // Send detailed SMS if ready
-    if (!systemAlertSent && gsmModule.getStatus().smsReady) {
-        String smsMsg = "UNIT " + sensorName + " error: ";
-        
-        // Add description for SMS
-        if (sensorStatus.last_error == "E1") {
-            smsMsg += "UNIT A communication failure";
-        } 
-        else if (sensorStatus.last_error == "E2") {
-            smsMsg += "UNIT B communication failure";
-        }
-        else {
-            smsMsg += sensorStatus.last_error; // fallback
-        }
-        
-        if (gsmModule.sendSystemAlert(smsMsg)) {
-            systemAlertSent = true;
-        }
+
+    noteTaskPass(info, started);
+    vTaskDelayUntil(&lastWake, pdMS_TO_TICKS(SENSOR_READ_INTERVAL));
+  }
+}
+
+// Everything that talks to the modem, plus the serial console
+void gsmTask(void* parameter) {
+  TaskInfo& info = *static_cast<TaskInfo*>(parameter);
+
+  for (;;) {
+    uint64_t started = monoMicros();
+
+    //Handle Serial commands first
+    handleSerialCommands();
+
+    // Readings and alerts handed over by the sensor task
+    drainTelemetry();
+    AlertRequest alert;
+    while (xQueueReceive(alertQueue, &alert, 0) == pdTRUE) {
+      sendAlert(alert);
     }
-} else {
-    alertHandler.clearSystemAlert();
-    systemAlertSent = false;
+
+    // Buffered readings go out in this device's own upload window, so a
+    // fleet restarted together does not upload together
+    serviceCloudUploads();
+
+    // Advance modem bring-up by at most one short exchange per pass
+    serviceGSMBringUp();
+
+    // Incoming SMS arrive as +CMT URCs; handle them as soon as they land
+    checkForIncomingSMS();
+
+    // Send at most one queued SMS when the rate limiter allows
+    gsmModule.processOutgoingSMS();
+
+    // Keep the wall clock to network time (one AT+CCLK? an hour once synced)
+    gsmModule.serviceClock();
+
+    // MQTT keepalive and downlink commands (no-op unless ENABLE_MQTT)
+    gsmModule.serviceMQTT();
+
+    // Let the modem sleep once nothing is due; the next command or RI wakes it
+    gsmModule.manageSleep();
+
+    gsmSMSReady = gsmModule.isSMSReady();
+
+    noteTaskPass(info, started);
+    vTaskDelay(pdMS_TO_TICKS(GSM_TASK_PERIOD));
+  }
 }
 
-    // Check for energy threshold alerts
-    checkEnergyThresholds(energyData);
+// LCD pages, LEDs and the buzzer
+void uiTask(void* parameter) {
+  TaskInfo& info = *static_cast<TaskInfo*>(parameter);
+
+  for (;;) {
+    uint64_t started = monoMicros();
+
+    UIEvent event;
+    while (xQueueReceive(uiEventQueue, &event, 0) == pdTRUE) {
+      handleUIEvent(event);
+    }
 
-    // Update communication LED
-    alertHandler.setCommunicationStatus(false); // Reset after operations
+    // The display rotates pages on its own clock (DISPLAY_PAGE_DURATION)
+    SensorSnapshot snapshot;
+    if (latestSnapshot(snapshot)) {
+      StatusResult status;
+      status.tenant_a_ok = snapshot.tenantAOk;
+      status.tenant_b_ok = snapshot.tenantBOk;
+      status.last_error = snapshot.lastError;
+      lcdInterface.updateDisplay(snapshot.readings, status);
+    }
+
+    // Update alert handler (for blinking LEDs, etc.)
+    alertHandler.update();
+
+    // Check Screen Mode.
+    lcdInterface.backLightMode();
+
+    noteTaskPass(info, started);
+    vTaskDelay(pdMS_TO_TICKS(UI_TASK_PERIOD));
   }
+}
 
-  // Daily data reset check (once per day)
-  if (currentTime - lastDailyResetCheck >=86400000) { //  86400000 24 hours
-    lastDailyResetCheck = currentTime;
-    sensorHandler.resetDailyCounters();
-    energyAlertSent = false;
-    costAlertSent = false;
-    
-    if (DEBUG_MODE) Serial.println("Daily counters reset");
+void drainTelemetry() {
+  TelemetryRecord records[TELEMETRY_RING_SIZE];
+  size_t count;
+  while ((count = telemetryRing.popBatch(records, TELEMETRY_RING_SIZE)) > 0) {
+    for (size_t i = 0; i < count; i++) {
+      gsmModule.bufferRecord(records[i]);
+    }
   }
+}
 
-  // Data logging to cloud at fixed interval
-  if (currentTime - lastDataLogTime >= DATA_LOG_INTERVAL) {
-    lastDataLogTime = currentTime;
-    logDataToCloud();
+void handleUIEvent(const UIEvent& event) {
+  switch (event.type) {
+    case UIEvent::MESSAGE: lcdInterface.showSystemMessage(event.text, event.duration); break;
+    case UIEvent::ALERT: lcdInterface.showAlert(event.text); break;
+    case UIEvent::ENERGY_ALERT: alertHandler.triggerEnergyAlert(event.value); break;
+    case UIEvent::CLEAR_ENERGY_ALERT: alertHandler.clearEnergyAlert(); break;
+    case UIEvent::SYSTEM_ALERT: alertHandler.triggerSystemAlert(); break;
+    case UIEvent::CLEAR_SYSTEM_ALERT: alertHandler.clearSystemAlert(); break;
+    case UIEvent::COMMUNICATION: alertHandler.setCommunicationStatus(event.value != 0); break;
   }
+}
 
-  // SMS alert check at fixed interval
-  if (currentTime - lastSMSCheckTime >= SMS_CHECK_INTERVAL) {
-    lastSMSCheckTime = currentTime;
-    checkForIncomingSMS();
+void publishSnapshot(const PZEMResult& readings, const StatusResult& status) {
+  SensorSnapshot snapshot;
+  snapshot.readings = readings;
+  snapshot.tenantAOk = status.tenant_a_ok;
+  snapshot.tenantBOk = status.tenant_b_ok;
+  status.last_error.toCharArray(snapshot.lastError, sizeof(snapshot.lastError));
+  xQueueOverwrite(snapshotQueue, &snapshot);
+}
+
+bool latestSnapshot(SensorSnapshot& snapshot) {
+  return xQueuePeek(snapshotQueue, &snapshot, 0) == pdTRUE;
+}
+
+// Never blocks: a full queue drops the event and counts it
+bool postUIEvent(UIEvent::Type type, const char* text, uint8_t value, uint16_t duration) {
+  UIEvent event;
+  event.type = type;
+  event.value = value;
+  event.duration = duration;
+  strncpy(event.text, text, sizeof(event.text) - 1);
+  event.text[sizeof(event.text) - 1] = '\0';
+  if (xQueueSend(uiEventQueue, &event, 0) != pdTRUE) {
+    uiEventDrops++;
+    return false;
   }
+  return true;
+}
 
-  // API update at fixed interval
-  if (currentTime - lastAPIUpdateTime >= API_UPDATE_INTERVAL) {
-    lastAPIUpdateTime = currentTime;
-    updateAPI();
+bool postSystemAlert(const String& message) {
+  AlertRequest alert;
+  memset(&alert, 0, sizeof(alert));
+  alert.threshold = false;
+  message.toCharArray(alert.text, sizeof(alert.text));
+  if (xQueueSend(alertQueue, &alert, 0) != pdTRUE) {
+    alertDrops++;
+    return false;
   }
+  return true;
+}
 
-  // Update alert handler (for blinking LEDs, etc.)
-  alertHandler.update();
+bool postThresholdAlert(const char* tenant, const char* metric, float value, float limit) {
+  AlertRequest alert;
+  memset(&alert, 0, sizeof(alert));
+  alert.threshold = true;
+  strncpy(alert.tenant, tenant, sizeof(alert.tenant) - 1);
+  strncpy(alert.metric, metric, sizeof(alert.metric) - 1);
+  alert.value = value;
+  alert.limit = limit;
+  if (xQueueSend(alertQueue, &alert, 0) != pdTRUE) {
+    alertDrops++;
+    return false;
+  }
+  return true;
+}
 
-  // Check Screen Mode.
-  lcdInterface.backLightMode();
+void sendAlert(const AlertRequest& alert) {
+  if (alert.threshold) {
+    gsmModule.sendThresholdAlert(alert.tenant, alert.metric, alert.value, alert.limit);
+  } else {
+    gsmModule.sendSystemAlert(alert.text);
+  }
+}
 
-  // Small delay to prevent watchdog 
-  delay(10);
+void printTaskStats() {
+  Serial.println("TASKS:");
+  uint64_t uptime = monoMicros();
+  TaskInfo* tasks[] = {&sensorTaskInfo, &gsmTaskInfo, &uiTaskInfo};
+  for (TaskInfo* info : tasks) {
+    // High-water mark: the least stack that was ever free, in bytes on the ESP32
+    uint32_t freeStack = info->handle != nullptr ? uxTaskGetStackHighWaterMark(info->handle) : 0;
+    portENTER_CRITICAL(&taskStatsLock);
+    uint64_t busyMicros = info->busyMicros;
+    uint32_t passes = info->passes;
+    uint32_t maxPassMicros = info->maxPassMicros;
+    portEXIT_CRITICAL(&taskStatsLock);
+    float busy = uptime > 0 ? 100.0f * (float)busyMicros / (float)uptime : 0.0f;
+    Serial.println("  " + String(info->name) + ": core " + String((int)info->core) + ", priority " +
+                   String((int)info->priority) + ", stack " + String(info->stackSize - freeStack) + "/" +
+                   String(info->stackSize) + " bytes used at most, CPU " + String(busy, 2) + "%, " +
+                   String(passes) + " passes, longest " + String(maxPassMicros / 1000) + " ms");
+  }
+  Serial.println("  Queues: telemetry " + String(telemetryRing.size()) + "/" +
+                 String(TELEMETRY_RING_SIZE) + " (" + String(telemetryRing.dropped()) + " dropped), alerts " +
+                 String(uxQueueMessagesWaiting(alertQueue)) + "/" + String(ALERT_QUEUE_LENGTH) + " (" +
+                 String(alertDrops) + " dropped), UI " + String(uxQueueMessagesWaiting(uiEventQueue)) + "/" +
+                 String(UI_EVENT_QUEUE_LENGTH) + " (" + String(uiEventDrops) + " dropped)");
 }
 
 ////////////  FUNCTIONS PROTOTYPES ////////////////////
@@ -201,15 +449,19 @@ void handleSerialCommands() {
   // Basic diagnostic commands
   if (command == "test" || command == "diag") {
     Serial.println("Running basic diagnostics...");
+    xSemaphoreTake(sensorLock, portMAX_DELAY);
     sensorHandler.runDiagnostics();
+    xSemaphoreGive(sensorLock);
   }
   else if (command == "help") {
     printDiagnosticsMenu();
   }
   else if (command == "discover") {
     Serial.println("Discovering PZEM devices...");
+    xSemaphoreTake(sensorLock, portMAX_DELAY);
     uint8_t foundA = sensorHandler.discoverAddresses(1);
     uint8_t foundB = sensorHandler.discoverAddresses(2);
+    xSemaphoreGive(sensorLock);
     Serial.print("Total devices found: ");
     Serial.println(foundA + foundB);
   }
@@ -238,23 +490,23 @@ void handleSerialCommands() {
     if (firstSpace != -1) {
       String number = command.substring(9, firstSpace);
       String message = command.substring(firstSpace + 1);
-      Serial.println("📱 Sending test SMS...");
+      Serial.println("📱 Queueing test SMS...");
       if (gsmModule.sendSMS(number, message)) {
-        Serial.println("✓ SMS sent successfully");
+        Serial.println("✓ SMS queued");
       } else {
-        Serial.println("✗ SMS failed");
+        Serial.println("✗ SMS could not be queued");
       }
     } else {
       Serial.println("Usage: sms_send <number> <message>");
     }
   }
   else if (command == "sms_test_all") {
-    Serial.println("📱 Sending test SMS to all recipients...");
+    Serial.println("📱 Queueing test SMS to all recipients...");
     String testMsg = "Test SMS from diagnostics - " + gsmModule.getTimestamp();
     if (gsmModule.sendSMSToRecipients(testMsg)) {
-      Serial.println("✓ Test SMS sent to all recipients");
+      Serial.println("✓ Test SMS queued for all recipients");
     } else {
-      Serial.println("✗ Failed to send test SMS");
+      Serial.println("✗ Failed to queue test SMS");
     }
   }
   else if (command.startsWith("sms_simulate ")) {
@@ -287,7 +539,17 @@ void handleSerialCommands() {
   }
   else if (command == "cloud_test") {
     Serial.println("Testing cloud upload...");
-    logDataToCloud();
+    SensorSnapshot snapshot;
+    if (latestSnapshot(snapshot)) {
+      // Straight into the upload queue: the sensor task is the ring's only producer
+      drainTelemetry();
+      gsmModule.bufferRecord(makeTelemetryRecord(snapshot.readings));
+    }
+    if (gsmModule.sendBufferedData()) {
+      Serial.println("✓ Cloud update successful");
+    } else {
+      Serial.println("✗ Cloud update failed - " + String(gsmModule.getBufferedCount()) + " readings buffered");
+    }
   }
   else if (command.startsWith("http_test ")) {
     String url = command.substring(10);
@@ -301,7 +563,7 @@ void handleSerialCommands() {
   else if (command == "thingspeak_test") {
     Serial.println("Testing ThingSpeak upload...");
     // Generate test data
-    String url = "https://api.thingspeak.com/update?api_key" + String(THINGSPEAK_API_KEY);
+    String url = THINGSPEAK_UPDATE_URL "?api_key=" THINGSPEAK_API_KEY;
     url += "&field1=230.5&field2=1.2&field3=276.6&field4=1.5";
     url += "&field5=231.2&field6=0.8&field7=184.9&field8=1.2";
     
@@ -330,9 +592,9 @@ void handleSerialCommands() {
   else if (command == "emergency_alert") {
     Serial.println("Sending emergency alert...");
     if (gsmModule.sendSystemAlert("EMERGENCY TEST - System functioning normally")) {
-      Serial.println("✓ Emergency alert sent");
+      Serial.println("✓ Emergency alert queued");
     } else {
-      Serial.println("✗ Emergency alert failed");
+      Serial.println("✗ Emergency alert could not be queued");
     }
   }
   
@@ -342,13 +604,17 @@ void handleSerialCommands() {
   }
   else if (command == "sensor_test") {
     Serial.println("Testing PZEM sensors...");
+    xSemaphoreTake(sensorLock, portMAX_DELAY);
     sensorHandler.runDiagnostics();
+    xSemaphoreGive(sensorLock);
   }
   else if (command == "threshold_test") {
     Serial.println("Simulating threshold alerts...");
+    xSemaphoreTake(sensorLock, portMAX_DELAY);
     PZEMResult testData = sensorHandler.readAll();
     testData.tenant_a.daily_energy_kwh = DAILY_ENERGY_THRESHOLD + 1.0;
     checkEnergyThresholds(testData);
+    xSemaphoreGive(sensorLock);
   }
   else if (command == "memory_info") {
     Serial.println("  Memory Information:");
@@ -357,9 +623,12 @@ void handleSerialCommands() {
     Serial.println("  Free PSRAM: " + String(ESP.getFreePsram()) + " bytes");
   }
   else if (command == "uptime") {
-    unsigned long uptime = millis();
-    Serial.println("System Uptime: " + String(uptime / 1000) + " seconds");
-    Serial.println("   (" + String(uptime / 60000) + " minutes)");
+    unsigned long uptime = (unsigned long)(monoMillis() / 1000);
+    Serial.println("System Uptime: " + String(uptime) + " seconds");
+    Serial.println("   (" + String(uptime / 60) + " minutes)");
+  }
+  else if (command == "tasks") {
+    printTaskStats();
   }
   else if (command == "full_diag") {
     runComprehensiveDiagnostics();
@@ -382,7 +651,7 @@ void runComprehensiveDiagnostics() {
   
   // System Information
   Serial.println("SYSTEM INFORMATION:");
-  Serial.println("  Uptime: " + String(millis() / 1000) + " seconds");
+  Serial.println("  Uptime: " + String((unsigned long)(monoMillis() / 1000)) + " seconds");
   Serial.println("  Free Memory: " + String(ESP.getFreeHeap()) + " bytes");
   Serial.println("  ESP32 Chip: " + String(ESP.getChipModel()));
   
@@ -393,7 +662,9 @@ void runComprehensiveDiagnostics() {
   // Sensor Diagnostics
   Serial.println("\nSENSOR DIAGNOSTICS:");
   Serial.println("Running PZEM sensor tests...");
+  xSemaphoreTake(sensorLock, portMAX_DELAY);
   sensorHandler.runDiagnostics();
+  xSemaphoreGive(sensorLock);
   
   // Test SMS Functionality
   Serial.println("\nSMS FUNCTIONALITY TEST:");
@@ -461,25 +732,30 @@ void sendStatusToUsers() {
   Serial.println("Sending status report to users...");
   String statusMsg = gsmModule.generateStatusResponse();
   
-  if (gsmModule.sendSMSToRecipients(statusMsg)) {
-    Serial.println("✓ Status report sent to all users");
+  if (gsmModule.sendSMSToRecipients(statusMsg, GSMModule::SMS_PRIORITY_REPORT, "status-report")) {
+    Serial.println("✓ Status report queued for all users");
   } else {
-    Serial.println("✗ Failed to send status report");
+    Serial.println("✗ Failed to queue status report");
   }
 }
 
 void sendDailyReportToUsers() {
   Serial.println("Sending daily report to users...");
-  PZEMResult energyData = sensorHandler.readAll();
+  SensorSnapshot snapshot;
+  if (!latestSnapshot(snapshot)) {
+    Serial.println("✗ No readings yet");
+    return;
+  }
+  const PZEMResult& energyData = snapshot.readings;
   
   if (gsmModule.sendDailyReport(
       energyData.tenant_a.daily_energy_kwh, 
       energyData.tenant_a.daily_energy_kwh * ENERGY_COST_PER_KWH,
       energyData.tenant_b.daily_energy_kwh, 
       energyData.tenant_b.daily_energy_kwh * ENERGY_COST_PER_KWH)) {
-    Serial.println("✓ Daily report sent to all users");
+    Serial.println("✓ Daily report queued for all users");
   } else {
-    Serial.println("✗ Failed to send daily report");
+    Serial.println("✗ Failed to queue daily report");
   }
 }
 
@@ -500,14 +776,18 @@ void showSystemStatus() {
   Serial.println("  SMS Failed: " + String(gsmStatus.smsFailedCount));
   Serial.println("  SMS Received: " + String(gsmStatus.smsReceivedCount));
   
-  // Sensor Status
-  StatusResult sensorStatus = sensorHandler.getStatus();
-  PZEMResult energyData = sensorHandler.readAll();
+  // Sensor Status, as of the sensor task's last reading
+  SensorSnapshot snapshot;
+  if (!latestSnapshot(snapshot)) {
+    Serial.println("\n🔌 SENSOR STATUS: no readings yet");
+    return;
+  }
+  const PZEMResult& energyData = snapshot.readings;
   Serial.println("\n🔌 SENSOR STATUS:");
-  Serial.println("  Tenant A: " + String(sensorStatus.tenant_a_ok ? "OK" : "ERROR"));
-  Serial.println("  Tenant B: " + String(sensorStatus.tenant_b_ok ? "OK" : "ERROR"));
-  if (!sensorStatus.tenant_a_ok || !sensorStatus.tenant_b_ok) {
-    Serial.println("  Last Error: " + sensorStatus.last_error);
+  Serial.println("  Tenant A: " + String(snapshot.tenantAOk ? "OK" : "ERROR"));
+  Serial.println("  Tenant B: " + String(snapshot.tenantBOk ? "OK" : "ERROR"));
+  if (!snapshot.tenantAOk || !snapshot.tenantBOk) {
+    Serial.println("  Last Error: " + String(snapshot.lastError));
   }
   
   // Energy Data
@@ -526,7 +806,7 @@ void showSystemStatus() {
   
   // System Health
   Serial.println("\n SYSTEM HEALTH:");
-  Serial.println("  Uptime: " + String(millis() / 60000) + " minutes");
+  Serial.println("  Uptime: " + String((unsigned long)(monoMillis() / 60000)) + " minutes");
   Serial.println("  Free Memory: " + String(ESP.getFreeHeap()) + " bytes");
   Serial.println("  Alert Status:");
   Serial.println("    Energy Alert: " + String(energyAlertSent ? "ACTIVE" : "CLEAR"));
@@ -572,6 +852,7 @@ void printDiagnosticsMenu() {
     Serial.println("  threshold_test - Simulate threshold alerts");
     Serial.println("  memory_info   - Show memory usage");
     Serial.println("  uptime        - Show system uptime");
+    Serial.println("  tasks         - Show task stack, CPU and queue use");
     Serial.println("  full_diag     - Run complete diagnostics");
     Serial.println("  reset_counters - Reset all statistics");
     
@@ -588,42 +869,42 @@ void printDiagnosticsMenu() {
 void checkEnergyThresholds(const PZEMResult& energyData) {
   // Check Tenant A thresholds
   if (energyData.tenant_a.daily_energy_kwh > DAILY_ENERGY_THRESHOLD) {
-    alertHandler.triggerEnergyAlert(1);
-    lcdInterface.showAlert("Tenant A: Energy Limit!");
+    postUIEvent(UIEvent::ENERGY_ALERT, "", 1);
+    postUIEvent(UIEvent::ALERT, "Tenant A: Energy Limit!");
     
-    if (!energyAlertSent && gsmModule.getStatus().smsReady) {
-      if (gsmModule.sendThresholdAlert("A", "energy", 
+    if (!energyAlertSent && gsmSMSReady) {
+      if (postThresholdAlert("A", "energy", 
           energyData.tenant_a.daily_energy_kwh, DAILY_ENERGY_THRESHOLD)) {
         energyAlertSent = true;
-        if (DEBUG_MODE) Serial.println("✓ Energy alert sent for Tenant A");
+        if (DEBUG_MODE) Serial.println("✓ Energy alert queued for Tenant A");
       }
     }
   }
 
   // Check Tenant B thresholds
   if (energyData.tenant_b.daily_energy_kwh > DAILY_ENERGY_THRESHOLD) {
-    alertHandler.triggerEnergyAlert(2);
-    lcdInterface.showAlert("Tenant B: Energy Limit!");
+    postUIEvent(UIEvent::ENERGY_ALERT, "", 2);
+    postUIEvent(UIEvent::ALERT, "Tenant B: Energy Limit!");
     
-    if (!energyAlertSent && gsmModule.getStatus().smsReady) {
-      if (gsmModule.sendThresholdAlert("B", "energy", 
+    if (!energyAlertSent && gsmSMSReady) {
+      if (postThresholdAlert("B", "energy", 
           energyData.tenant_b.daily_energy_kwh, DAILY_ENERGY_THRESHOLD)) {
         energyAlertSent = true;
-        if (DEBUG_MODE) Serial.println("✓ Energy alert sent for Tenant B");
+        if (DEBUG_MODE) Serial.println("✓ Energy alert queued for Tenant B");
       }
     }
   }
 
   // Check cost thresholds
   if (energyData.summary.total_daily_cost > DAILY_COST_THRESHOLD) {
-    alertHandler.triggerEnergyAlert(3); // Both tenants
-    lcdInterface.showAlert("Total Cost Limit!");
+    postUIEvent(UIEvent::ENERGY_ALERT, "", 3); // Both tenants
+    postUIEvent(UIEvent::ALERT, "Total Cost Limit!");
     
-    if (!costAlertSent && gsmModule.getStatus().smsReady) {
-      if (gsmModule.sendThresholdAlert("Both", "cost", 
+    if (!costAlertSent && gsmSMSReady) {
+      if (postThresholdAlert("Both", "cost", 
           energyData.summary.total_daily_cost, DAILY_COST_THRESHOLD)) {
         costAlertSent = true;
-        if (DEBUG_MODE) Serial.println("✓ Cost alert sent");
+        if (DEBUG_MODE) Serial.println("✓ Cost alert queued");
       }
     }
   }
@@ -631,7 +912,7 @@ void checkEnergyThresholds(const PZEMResult& energyData) {
   // Clear alerts if below thresholds (with 10% hysteresis)
   if (energyData.tenant_a.daily_energy_kwh <= DAILY_ENERGY_THRESHOLD * 0.9 && 
       energyData.tenant_b.daily_energy_kwh <= DAILY_ENERGY_THRESHOLD * 0.9) {
-    alertHandler.clearEnergyAlert();
+    postUIEvent(UIEvent::CLEAR_ENERGY_ALERT);
     if (energyAlertSent) {
       energyAlertSent = false;
       if (DEBUG_MODE) Serial.println("✓ Energy alerts cleared");
@@ -646,76 +927,114 @@ void checkEnergyThresholds(const PZEMResult& energyData) {
   }
 }
 
-void logDataToCloud() {
-  if (DEBUG_MODE) Serial.println("Attempting cloud data log...");
-  
-  PZEMResult energyData = sensorHandler.readAll();
-  GSMModule::ModuleStatus gsmStatus = gsmModule.getStatus();
-  
-  if (gsmStatus.gprsConnected || gsmModule.setupGPRS()) {
-    String url = "https://api.thingspeak.com/update?api_key=";
-    url += THINGSPEAK_API_KEY;
-    url += "&field1=" + String(energyData.tenant_a.voltage, 1);
-    url += "&field2=" + String(energyData.tenant_a.current, 2);
-    url += "&field3=" + String(energyData.tenant_a.power, 1);
-    url += "&field4=" + String(energyData.tenant_a.daily_energy_kwh, 3);
-    url += "&field5=" + String(energyData.tenant_b.voltage, 1);
-    url += "&field6=" + String(energyData.tenant_b.current, 2);
-    url += "&field7=" + String(energyData.tenant_b.power, 1);
-    url += "&field8=" + String(energyData.tenant_b.daily_energy_kwh, 3);
-    
-    alertHandler.setCommunicationStatus(true);
-    
-    // Use retry mechanism for better reliability
-    bool success = gsmModule.sendDataWithRetry(url, "", 2);
-    
-    alertHandler.setCommunicationStatus(false);
+void checkSensorStatus(const StatusResult& sensorStatus) {
+  if (!sensorStatus.tenant_a_ok || !sensorStatus.tenant_b_ok) {
+    // Determine which sensor failed
+    String sensorName = !sensorStatus.tenant_a_ok ? "A" : "B";
     
-    if (success && DEBUG_MODE) {
-      Serial.println("✓ Cloud update successful");
-    } else if (DEBUG_MODE) {
-      Serial.println("Cloud update failed - data buffered");
+    // For serial debugging - show raw code
+    if (DEBUG_MODE) {
+      Serial.print("Sensor ");
+      Serial.print(sensorName);
+      Serial.print(" error: ");
+      Serial.println(sensorStatus.last_error);
     }
     
-    // Try to send any buffered data
-    gsmModule.sendBufferedData();
-    
-  } else if (DEBUG_MODE) {
-    Serial.println("GPRS not available - buffering data");
-    // Buffer the data for later transmission
-    String dataToBuffer = "field1=" + String(energyData.tenant_a.voltage, 1);
-    dataToBuffer += "&field2=" + String(energyData.tenant_a.current, 2);
-    dataToBuffer += "&field3=" + String(energyData.tenant_a.power, 1);
-    dataToBuffer += "&field4=" + String(energyData.tenant_a.daily_energy_kwh, 3);
-    dataToBuffer += "&field5=" + String(energyData.tenant_b.voltage, 1);
-    dataToBuffer += "&field6=" + String(energyData.tenant_b.current, 2);
-    dataToBuffer += "&field7=" + String(energyData.tenant_b.power, 1);
-    dataToBuffer += "&field8=" + String(energyData.tenant_b.daily_energy_kwh, 3);
+    // Trigger visual/audio alerts
+    postUIEvent(UIEvent::SYSTEM_ALERT);
+    postUIEvent(UIEvent::ALERT, sensorStatus.last_error.c_str()); // Pass raw code to LCD
     
-    gsmModule.bufferDataForLater(dataToBuffer);
+    // Send detailed SMS if ready
+    if (!systemAlertSent && gsmSMSReady) {
+      String smsMsg = "UNIT " + sensorName + " error: ";
+      
+      // Add description for SMS
+      if (sensorStatus.last_error == "E1") {
+        smsMsg += "UNIT A communication failure";
+      } 
+      else if (sensorStatus.last_error == "E2") {
+        smsMsg += "UNIT B communication failure";
+      }
+      else {
+        smsMsg += sensorStatus.last_error; // fallback
+      }
+      
+      if (postSystemAlert(smsMsg)) {
+        systemAlertSent = true;
+      }
+    }
+  } else {
+    postUIEvent(UIEvent::CLEAR_SYSTEM_ALERT);
+    systemAlertSent = false;
   }
 }
 
-void checkForIncomingSMS() {
-  if (DEBUG_MODE && false) { // Set to true for verbose SMS checking
-    Serial.println("Checking for incoming SMS...");
+void logDataToCloud(const PZEMResult& energyData) {
+  if (DEBUG_MODE) Serial.println("Attempting cloud data log...");
+  
+  // Every reading is queued first and goes out with the backlog in one bulk
+  // update. The GSM task buffers it with the modem; push() never waits.
+  telemetryRing.push(makeTelemetryRecord(energyData));
+}
+
+TelemetryRecord makeTelemetryRecord(const PZEMResult& energyData) {
+  TelemetryRecord record;
+  record.capturedAt = millis();
+  record.createdAt = 0;
+  record.fields[FIELD_VOLTAGE_A] = energyData.tenant_a.voltage;
+  record.fields[FIELD_CURRENT_A] = energyData.tenant_a.current;
+  record.fields[FIELD_POWER_A] = energyData.tenant_a.power;
+  record.fields[FIELD_ENERGY_A] = energyData.tenant_a.daily_energy_kwh;
+  record.fields[FIELD_VOLTAGE_B] = energyData.tenant_b.voltage;
+  record.fields[FIELD_CURRENT_B] = energyData.tenant_b.current;
+  record.fields[FIELD_POWER_B] = energyData.tenant_b.power;
+  record.fields[FIELD_ENERGY_B] = energyData.tenant_b.daily_energy_kwh;
+  return record;
+}
+
+void serviceCloudUploads() {
+  // Returns at once outside the upload window or while the GPRS link is backing off
+  if (gsmModule.getNextUploadIn() > 0) {
+    return;
   }
   
-  String result = gsmModule.parseIncomingSMS();
+  postUIEvent(UIEvent::COMMUNICATION, "", 1);
+  bool success = gsmModule.serviceUploads();
+  postUIEvent(UIEvent::COMMUNICATION, "", 0);
   
-  if (result.length() > 0 && DEBUG_MODE) {
-    Serial.println("SMS Processing Result: " + result);
+  if (success && DEBUG_MODE) {
+    Serial.println("✓ Cloud update successful");
+  } else if (DEBUG_MODE) {
+    Serial.print("Cloud update incomplete - ");
+    Serial.print(gsmModule.getBufferedCount());
+    Serial.println(" readings buffered");
   }
 }
 
-void updateAPI() {
-  // Try to send any buffered data when doing API updates
-  if (gsmModule.getStatus().gprsConnected) {
-    gsmModule.sendBufferedData();
+void serviceGSMBringUp() {
+  GSMModule::BringUpState before = gsmModule.getBringUpState();
+  
+  if (gsmModule.serviceBringUp()) {
+    if (DEBUG_MODE) {
+      Serial.println("GSM initialized successfully");
+    }
+    postUIEvent(UIEvent::MESSAGE, "GSM Ready", 0, 1500);
+    
+    // Pick up anything stored on the SIM while we were off; later SMS are pushed
+    gsmModule.parseIncomingSMS();
+  } else if (before != GSMModule::BRINGUP_FAILED && gsmModule.getBringUpState() == GSMModule::BRINGUP_FAILED) {
+    postUIEvent(UIEvent::MESSAGE, "GSM Init Failed", 0, 1500);
   }
+}
+
+void checkForIncomingSMS() {
+  // Dispatch URCs the modem pushed since the last exchange (no UART traffic)
+  gsmModule.poll();
+  
+  String result = gsmModule.processIncomingSMS();
   
-  if (DEBUG_MODE && false) { // Set to true for verbose API updates
-    Serial.println("Performing API updates...");
+  if (result.length() > 0 && DEBUG_MODE) {
+    Serial.println("SMS Processing Result: " + result);
   }
 }
 
@@ -0,0 +1,119 @@
+#include <unity.h>
+#include <stdio.h>
+#include <string.h>
+#include "ATCommandStats.h"
+
+void setUp() {}
+void tearDown() {}
+
+static void assertClass(const char* expected, const char* command) {
+    char name[ATCommandStats::NAME_LENGTH];
+    ATCommandStats::className(command, name, sizeof(name));
+    TEST_ASSERT_EQUAL_STRING(expected, name);
+}
+
+void test_commands_are_grouped_by_class() {
+    assertClass("CSQ", "AT+CSQ");
+    assertClass("CMGS", "AT+CMGS=\"+233241234567\"");
+    assertClass("HTTPPARA", "AT+HTTPPARA=\"URL\",\"https://api.thingspeak.com/update\"");
+    assertClass("CREG", "AT+CREG?");
+    assertClass("E", "ATE0");
+    assertClass("&W", "AT&W");
+    assertClass("AT", "AT");
+    assertClass("CMGS body", "CMGS body");
+}
+
+void test_outcomes_are_counted_per_class() {
+    ATCommandStats stats;
+    stats.record("AT+CSQ", ATCommandStats::OUTCOME_OK, 40);
+    stats.record("AT+CSQ", ATCommandStats::OUTCOME_OK, 60);
+    stats.record("AT+CSQ", ATCommandStats::OUTCOME_TIMEOUT, 5000);
+    stats.record("AT+SAPBR=1,1", ATCommandStats::OUTCOME_ERROR, 850);
+    stats.record("AT+SAPBR=2,1", ATCommandStats::OUTCOME_OK, 120);
+
+    TEST_ASSERT_EQUAL(2, stats.count());
+    const ATCommandStats::Entry* csq = stats.find("CSQ");
+    TEST_ASSERT_NOT_NULL(csq);
+    TEST_ASSERT_EQUAL_UINT32(2, csq->outcomes[ATCommandStats::OUTCOME_OK]);
+    TEST_ASSERT_EQUAL_UINT32(0, csq->outcomes[ATCommandStats::OUTCOME_ERROR]);
+    TEST_ASSERT_EQUAL_UINT32(1, csq->outcomes[ATCommandStats::OUTCOME_TIMEOUT]);
+    TEST_ASSERT_EQUAL_UINT32(5000, csq->maxLatency);
+    TEST_ASSERT_EQUAL_UINT32(5100, csq->totalLatency);
+
+    const ATCommandStats::Entry* sapbr = stats.find("SAPBR");
+    TEST_ASSERT_NOT_NULL(sapbr);
+    TEST_ASSERT_EQUAL_UINT32(1, sapbr->outcomes[ATCommandStats::OUTCOME_OK]);
+    TEST_ASSERT_EQUAL_UINT32(1, sapbr->outcomes[ATCommandStats::OUTCOME_ERROR]);
+    TEST_ASSERT_EQUAL_UINT32(2, ATCommandStats::calls(*sapbr));
+    TEST_ASSERT_NULL(stats.find("CREG"));
+}
+
+void test_percentiles_come_from_the_histogram() {
+    ATCommandStats stats;
+    // 90 fast answers and 10 slow ones
+    for (int i = 0; i < 90; i++) {
+        stats.record("AT+HTTPACTION=1", ATCommandStats::OUTCOME_OK, 1500);
+    }
+    for (int i = 0; i < 10; i++) {
+        stats.record("AT+HTTPACTION=1", ATCommandStats::OUTCOME_OK, 8000);
+    }
+
+    const ATCommandStats::Entry* action = stats.find("HTTPACTION");
+    TEST_ASSERT_EQUAL_UINT32(2000, ATCommandStats::percentile(*action, 50));
+    TEST_ASSERT_EQUAL_UINT32(2000, ATCommandStats::percentile(*action, 90));
+    TEST_ASSERT_EQUAL_UINT32(10000, ATCommandStats::percentile(*action, 95));
+
+    // Bucket bounds are inclusive; past the last one there is no bound
+    stats.record("AT+CMGS=\"+1\"", ATCommandStats::OUTCOME_OK, 50);
+    TEST_ASSERT_EQUAL_UINT32(50, ATCommandStats::percentile(*stats.find("CMGS"), 100));
+    stats.record("AT+COPS=0", ATCommandStats::OUTCOME_TIMEOUT, 45000);
+    TEST_ASSERT_EQUAL_UINT32(UINT32_MAX, ATCommandStats::percentile(*stats.find("COPS"), 50));
+}
+
+void test_classes_past_the_table_share_other() {
+    ATCommandStats stats;
+    char command[24];
+    for (size_t i = 0; i < ATCommandStats::MAX_CLASSES + 5; i++) {
+        snprintf(command, sizeof(command), "AT+X%c%c", (char)('A' + i / 26), (char)('A' + i % 26));
+        stats.record(command, ATCommandStats::OUTCOME_OK, 10);
+    }
+
+    TEST_ASSERT_EQUAL(ATCommandStats::MAX_CLASSES, stats.count());
+    const ATCommandStats::Entry* other = stats.find("OTHER");
+    TEST_ASSERT_NOT_NULL(other);
+    TEST_ASSERT_EQUAL_UINT32(6, ATCommandStats::calls(*other));
+
+    // Classes that already have a slot keep it
+    stats.record("AT+XAA", ATCommandStats::OUTCOME_OK, 10);
+    TEST_ASSERT_EQUAL_UINT32(2, ATCommandStats::calls(*stats.find("XAA")));
+}
+
+void test_table_serializes_to_json() {
+    ATCommandStats stats;
+    stats.record("AT+CSQ", ATCommandStats::OUTCOME_OK, 30);
+    stats.record("AT+CSQ", ATCommandStats::OUTCOME_TIMEOUT, 5000);
+    stats.record("CMGS body", ATCommandStats::OUTCOME_ERROR, 4200);
+
+    char json[256];
+    size_t length = stats.toJSON(json, sizeof(json));
+    TEST_ASSERT_EQUAL_STRING("{\"CSQ\":[1,0,1,5000,[1,0,0,0,0,0,1,0,0,0]],"
+                             "\"CMGS body\":[0,1,0,4200,[0,0,0,0,0,0,1,0,0,0]]}", json);
+    TEST_ASSERT_EQUAL(strlen(json), length);
+
+    // Too small a buffer gives nothing rather than half an object
+    TEST_ASSERT_EQUAL(0, stats.toJSON(json, 40));
+
+    stats.reset();
+    TEST_ASSERT_EQUAL(2, stats.toJSON(json, sizeof(json)));
+    TEST_ASSERT_EQUAL_STRING("{}", json);
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_commands_are_grouped_by_class);
+    RUN_TEST(test_outcomes_are_counted_per_class);
+    RUN_TEST(test_percentiles_come_from_the_histogram);
+    RUN_TEST(test_classes_past_the_table_share_other);
+    RUN_TEST(test_table_serializes_to_json);
+    return UNITY_END();
+}
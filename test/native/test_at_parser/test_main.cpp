@@ -0,0 +1,282 @@
+#include <unity.h>
+#include <chrono>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include "ATResponseParser.h"
+
+// Transcripts recorded from a SIM800L on the bench (ATE0, CMEE=2)
+static const char TRANSCRIPT_INIT[] =
+    "AT\r\r\nOK\r\n"
+    "\r\nOK\r\n"
+    "\r\n+CREG: 0,1\r\n\r\nOK\r\n"
+    "\r\n+CSQ: 17,0\r\n\r\nOK\r\n"
+    "\r\n+COPS: 0,0,\"MTN GH\"\r\n\r\nOK\r\n"
+    "\r\nOK\r\n";
+
+static const char TRANSCRIPT_SMS[] =
+    "\r\n> "
+    "\r\n+CMGS: 47\r\n\r\nOK\r\n";
+
+static const char TRANSCRIPT_CMGL[] =
+    "\r\n+CMGL: 1,\"REC UNREAD\",\"+233205324322\",\"\",\"24/05/11,10:21:07+00\"\r\n"
+    "STATUS\r\n"
+    "\r\n+CMGL: 2,\"REC UNREAD\",\"+233245829456\",\"\",\"24/05/11,10:21:44+00\"\r\n"
+    "Looks OK to me, send REPORT\r\n"
+    "\r\nOK\r\n";
+
+static const char TRANSCRIPT_HTTP[] =
+    "\r\nOK\r\n"
+    "\r\nOK\r\n"
+    "\r\nOK\r\n"
+    "\r\nOK\r\n"
+    "\r\n+HTTPACTION: 0,200,2\r\n"
+    "\r\nOK\r\n";
+
+static const char TRANSCRIPT_ERRORS[] =
+    "\r\n+CME ERROR: operation not allowed\r\n"
+    "\r\n+CMS ERROR: 500\r\n"
+    "\r\nERROR\r\n";
+
+static ATResponseParser parser;
+
+void setUp() {
+    parser.reset();
+    parser.setExpected(nullptr);
+    parser.setLineHandler(nullptr, nullptr);
+}
+
+void tearDown() {}
+
+static ATResponseParser::Token feedAll(const char* text, int* tokenCount = nullptr) {
+    ATResponseParser::Token last = ATResponseParser::TOKEN_NONE;
+    int count = 0;
+    for (const char* p = text; *p; p++) {
+        ATResponseParser::Token t = parser.feed(*p);
+        if (t != ATResponseParser::TOKEN_NONE) {
+            last = t;
+            count++;
+        }
+    }
+    if (tokenCount) *tokenCount = count;
+    return last;
+}
+
+void test_ok_and_error_are_exact_line_matches() {
+    TEST_ASSERT_EQUAL(ATResponseParser::TOKEN_OK, feedAll("\r\nOK\r\n"));
+    TEST_ASSERT_EQUAL(ATResponseParser::TOKEN_NONE, feedAll("OKAY\r\n"));
+    TEST_ASSERT_EQUAL(ATResponseParser::TOKEN_ERROR, feedAll("ERROR\r\n"));
+    TEST_ASSERT_EQUAL(ATResponseParser::TOKEN_NONE, feedAll("NO ERROR HERE\r\n"));
+}
+
+void test_tokens_are_anchored_at_line_start() {
+    parser.setExpected("OK");
+    int okCount = 0;
+    for (const char* p = TRANSCRIPT_CMGL; *p; p++) {
+        if (parser.isExpected(parser.feed(*p))) okCount++;
+    }
+    // Only the final OK counts; "OK" inside the SMS body must not
+    TEST_ASSERT_EQUAL(1, okCount);
+}
+
+void test_sms_text_is_payload_not_token() {
+    TEST_ASSERT_EQUAL(ATResponseParser::TOKEN_CMT, feedAll("\r\n+CMT: \"+233205324322\",\"\",\"24/05/11,10:21:07+00\"\r\n"));
+    TEST_ASSERT_EQUAL(ATResponseParser::TOKEN_PAYLOAD, feedAll("OK\r\n"));
+    TEST_ASSERT_EQUAL(ATResponseParser::TOKEN_CMGR, feedAll("+CMGR: \"REC READ\",\"+233205324322\",\"\",\"24/05/11\"\r\n"));
+    TEST_ASSERT_EQUAL(ATResponseParser::TOKEN_PAYLOAD, feedAll("> RING\r\n"));
+    TEST_ASSERT_EQUAL(ATResponseParser::TOKEN_OK, feedAll("\r\nOK\r\n"));
+}
+
+void test_empty_sms_body_is_still_payload() {
+    TEST_ASSERT_EQUAL(ATResponseParser::TOKEN_CMT, feedAll("\r\n+CMT: \"+233205324322\",\"\",\"24/05/11,10:21:07+00\"\r\n"));
+    TEST_ASSERT_EQUAL(ATResponseParser::TOKEN_PAYLOAD, feedAll("\r\n"));
+    TEST_ASSERT_EQUAL_STRING("", parser.line());
+    TEST_ASSERT_EQUAL(ATResponseParser::TOKEN_OK, feedAll("\r\nOK\r\n"));
+
+    // Every header of a listing is still seen when one body is empty
+    const char* listing =
+        "\r\n+CMGL: 1,\"REC UNREAD\",\"+233205324322\",\"\",\"24/05/11,10:21:07+00\"\r\n"
+        "\r\n"
+        "\r\n+CMGL: 2,\"REC UNREAD\",\"+233245829456\",\"\",\"24/05/11,10:21:44+00\"\r\n"
+        "STATUS\r\n"
+        "\r\nOK\r\n";
+    const ATResponseParser::Token expected[] = {
+        ATResponseParser::TOKEN_CMGL, ATResponseParser::TOKEN_PAYLOAD,
+        ATResponseParser::TOKEN_CMGL, ATResponseParser::TOKEN_PAYLOAD, ATResponseParser::TOKEN_OK};
+    size_t seen = 0;
+    for (const char* p = listing; *p; p++) {
+        ATResponseParser::Token t = parser.feed(*p);
+        if (t == ATResponseParser::TOKEN_NONE) continue;
+        TEST_ASSERT_TRUE(seen < 5);
+        TEST_ASSERT_EQUAL(expected[seen], t);
+        seen++;
+    }
+    TEST_ASSERT_EQUAL(5, seen);
+}
+
+void test_unsolicited_codes() {
+    TEST_ASSERT_EQUAL(ATResponseParser::TOKEN_CMTI, feedAll("+CMTI: \"SM\",3\r\n"));
+    TEST_ASSERT_EQUAL(ATResponseParser::TOKEN_CDS, feedAll("+CDS: 6,46,\"+233241234567\",145,\"24/06/01,12:00:00+00\",\"24/06/01,12:00:05+00\",0\r\n"));
+    TEST_ASSERT_EQUAL(ATResponseParser::TOKEN_RING, feedAll("RING\r\n"));
+    TEST_ASSERT_EQUAL(ATResponseParser::TOKEN_SAPBR_URC, feedAll("+SAPBR 1: DEACT\r\n"));
+    TEST_ASSERT_EQUAL(ATResponseParser::TOKEN_UNDER_VOLTAGE, feedAll("UNDER-VOLTAGE WARNNING\r\n"));
+    TEST_ASSERT_TRUE(ATResponseParser::isURC(ATResponseParser::TOKEN_RING));
+    TEST_ASSERT_FALSE(ATResponseParser::isURC(ATResponseParser::TOKEN_OK));
+    // The bearer query response is not the deactivation URC
+    TEST_ASSERT_EQUAL(ATResponseParser::TOKEN_NONE, feedAll("+SAPBR: 1,1,\"10.0.0.1\"\r\n"));
+    // TCP socket events; "CLOSE OK" answering AT+CIPCLOSE is not a drop
+    TEST_ASSERT_EQUAL(ATResponseParser::TOKEN_CIPRXGET, feedAll("+CIPRXGET: 1\r\n"));
+    TEST_ASSERT_EQUAL(ATResponseParser::TOKEN_TCP_CLOSED, feedAll("CLOSED\r\n"));
+    TEST_ASSERT_EQUAL(ATResponseParser::TOKEN_PDP_DEACT, feedAll("+PDP: DEACT\r\n"));
+    TEST_ASSERT_EQUAL(ATResponseParser::TOKEN_NONE, feedAll("CLOSE OK\r\n"));
+}
+
+void test_prefix_tokens() {
+    TEST_ASSERT_EQUAL(ATResponseParser::TOKEN_CME_ERROR, feedAll("+CME ERROR: SIM busy\r\n"));
+    TEST_ASSERT_EQUAL(ATResponseParser::TOKEN_CMS_ERROR, feedAll("+CMS ERROR: 304\r\n"));
+    TEST_ASSERT_EQUAL(ATResponseParser::TOKEN_CMGS, feedAll("+CMGS: 12\r\n"));
+    TEST_ASSERT_EQUAL(ATResponseParser::TOKEN_HTTPACTION, feedAll("+HTTPACTION: 0,603,0\r\n"));
+    TEST_ASSERT_EQUAL(ATResponseParser::TOKEN_DOWNLOAD, feedAll("DOWNLOAD\r\n"));
+}
+
+void test_prompt_fires_without_line_break() {
+    TEST_ASSERT_EQUAL(ATResponseParser::TOKEN_NONE, parser.feed('\r'));
+    TEST_ASSERT_EQUAL(ATResponseParser::TOKEN_NONE, parser.feed('\n'));
+    TEST_ASSERT_EQUAL(ATResponseParser::TOKEN_PROMPT, parser.feed('>'));
+    TEST_ASSERT_EQUAL(ATResponseParser::TOKEN_NONE, parser.feed(' '));
+    TEST_ASSERT_EQUAL(ATResponseParser::TOKEN_CMGS, feedAll("\r\n+CMGS: 47\r\n"));
+}
+
+void test_custom_expected_pattern() {
+    TEST_ASSERT_TRUE(parser.setExpected("+HTTPACTION: 0,200"));
+    TEST_ASSERT_EQUAL(ATResponseParser::TOKEN_EXPECTED, parser.expectedToken());
+
+    ATResponseParser::Token t = feedAll("+HTTPACTION: 0,200,2\r\n");
+    TEST_ASSERT_TRUE(parser.isExpected(t));
+
+    // A different status still resolves to the built-in token
+    t = feedAll("+HTTPACTION: 0,601,0\r\n");
+    TEST_ASSERT_EQUAL(ATResponseParser::TOKEN_HTTPACTION, t);
+    TEST_ASSERT_FALSE(parser.isExpected(t));
+}
+
+void test_expected_builtin_reuses_token() {
+    TEST_ASSERT_TRUE(parser.setExpected(">"));
+    TEST_ASSERT_EQUAL(ATResponseParser::TOKEN_PROMPT, parser.expectedToken());
+    TEST_ASSERT_TRUE(parser.setExpected("OK"));
+    TEST_ASSERT_EQUAL(ATResponseParser::TOKEN_OK, parser.expectedToken());
+}
+
+void test_expected_ignores_echo() {
+    parser.setExpected("+CSQ:");
+    int count = 0;
+    ATResponseParser::Token t = feedAll("AT+CSQ\r\r\n+CSQ: 17,0\r\n", &count);
+    TEST_ASSERT_EQUAL(1, count);
+    TEST_ASSERT_TRUE(parser.isExpected(t));
+    TEST_ASSERT_EQUAL_STRING("+CSQ: 17,0", parser.line());
+}
+
+void test_overlong_expected_rejected() {
+    TEST_ASSERT_FALSE(parser.setExpected("+THIS PATTERN IS LONGER THAN THIRTY TWO CHARS"));
+}
+
+struct LineLog {
+    int lines;
+    int tokens;
+    std::string last;
+};
+
+static void collectLine(const char* line, size_t length, ATResponseParser::Token token, void* context) {
+    LineLog* log = static_cast<LineLog*>(context);
+    log->lines++;
+    if (token != ATResponseParser::TOKEN_NONE) log->tokens++;
+    log->last.assign(line, length);
+}
+
+void test_line_handler_sees_every_line() {
+    LineLog log = {0, 0, ""};
+    parser.setLineHandler(collectLine, &log);
+    feedAll(TRANSCRIPT_CMGL);
+    TEST_ASSERT_EQUAL(5, log.lines);
+    TEST_ASSERT_EQUAL(5, log.tokens);
+    TEST_ASSERT_EQUAL_STRING("OK", log.last.c_str());
+}
+
+void test_long_lines_are_truncated_not_overrun() {
+    std::string longLine(ATResponseParser::LINE_BUFFER_SIZE * 2, 'x');
+    feedAll(longLine.c_str());
+    parser.feed('\n');
+    TEST_ASSERT_TRUE(parser.lineTruncated());
+    TEST_ASSERT_EQUAL(ATResponseParser::LINE_BUFFER_SIZE - 1, parser.lineLength());
+    TEST_ASSERT_EQUAL(ATResponseParser::TOKEN_OK, feedAll("OK\r\n"));
+}
+
+// Reference implementation of the old loop: grow a string per byte and rescan
+static int naiveScan(const char* text, const char* expected) {
+    std::string response;
+    int hits = 0;
+    for (const char* p = text; *p; p++) {
+        response += *p;
+        if (response.find(expected) != std::string::npos) { hits++; response.clear(); continue; }
+        if (response.find("ERROR") != std::string::npos || response.find("FAIL") != std::string::npos) {
+            hits++;
+            response.clear();
+        }
+    }
+    return hits;
+}
+
+void test_benchmark_recorded_transcripts() {
+    const char* transcripts[] = {TRANSCRIPT_INIT, TRANSCRIPT_SMS, TRANSCRIPT_CMGL, TRANSCRIPT_HTTP, TRANSCRIPT_ERRORS};
+    const char* expected[] = {"OK", "+CMGS:", "OK", "+HTTPACTION: 0,200", "OK"};
+    const int ITERATIONS = 20000;
+
+    size_t bytes = 0;
+    for (const char* t : transcripts) bytes += strlen(t);
+
+    volatile int sink = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < ITERATIONS; i++) {
+        for (int j = 0; j < 5; j++) {
+            parser.reset();
+            parser.setExpected(expected[j]);
+            int count = 0;
+            feedAll(transcripts[j], &count);
+            sink += count;
+        }
+    }
+    double streamNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < ITERATIONS; i++) {
+        for (int j = 0; j < 5; j++) {
+            sink += naiveScan(transcripts[j], expected[j]);
+        }
+    }
+    double naiveNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+    char message[160];
+    snprintf(message, sizeof(message), "streaming: %.1f ns/byte, String+indexOf: %.1f ns/byte (%zu bytes x %d)",
+             streamNs / (bytes * (double)ITERATIONS), naiveNs / (bytes * (double)ITERATIONS), bytes, ITERATIONS);
+    TEST_MESSAGE(message);
+    TEST_ASSERT_TRUE(sink > 0);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_ok_and_error_are_exact_line_matches);
+    RUN_TEST(test_tokens_are_anchored_at_line_start);
+    RUN_TEST(test_sms_text_is_payload_not_token);
+    RUN_TEST(test_empty_sms_body_is_still_payload);
+    RUN_TEST(test_unsolicited_codes);
+    RUN_TEST(test_prefix_tokens);
+    RUN_TEST(test_prompt_fires_without_line_break);
+    RUN_TEST(test_custom_expected_pattern);
+    RUN_TEST(test_expected_builtin_reuses_token);
+    RUN_TEST(test_expected_ignores_echo);
+    RUN_TEST(test_overlong_expected_rejected);
+    RUN_TEST(test_line_handler_sees_every_line);
+    RUN_TEST(test_long_lines_are_truncated_not_overrun);
+    RUN_TEST(test_benchmark_recorded_transcripts);
+    return UNITY_END();
+}
@@ -0,0 +1,777 @@
+#include <unity.h>
+#include <stdio.h>
+#include <string.h>
+#include "GSMModule.h"
+#include "SIM800Simulator.h"
+
+// GSMModule against the simulated modem, end to end on the virtual clock
+
+static const uint32_t NETWORK_EPOCH = 1717243200UL;    // 2024-06-01 12:00:00 UTC
+
+static SIM800Simulator* modem;
+static GSMModule* gsm;
+
+void setUp() {
+    hostResetClock();
+    hostAdvanceMillis(1000);
+    modem = new SIM800Simulator();
+    modem->setNetworkTime(NETWORK_EPOCH);
+    gsm = new GSMModule(*modem);
+}
+
+void tearDown() {
+    delete gsm;
+    delete modem;
+}
+
+// The module as built for the board: it can re-time its end of the UART
+static void useBaudNegotiation() {
+    delete gsm;
+    gsm = new GSMModule(*modem, &SIM800Simulator::hostBaudRateSetter, modem);
+}
+
+static TelemetryRecord makeRecord() {
+    TelemetryRecord record;
+    memset(&record, 0, sizeof(record));
+    record.capturedAt = millis();
+    record.fields[FIELD_VOLTAGE_A] = 231.4f;
+    record.fields[FIELD_CURRENT_A] = 2.25f;
+    record.fields[FIELD_VOLTAGE_B] = 229.8f;
+    record.fields[FIELD_CURRENT_B] = 0.75f;
+    return record;
+}
+
+static void bufferReadings(int count) {
+    for (int i = 0; i < count; i++) {
+        TEST_ASSERT_TRUE(gsm->bufferRecord(makeRecord()));
+        hostAdvanceMillis(DATA_LOG_INTERVAL);
+    }
+}
+
+// Sends everything queued, waiting out the SMS rate limit in between
+static void drainOutbox() {
+    for (int i = 0; i < 20 && gsm->getQueuedSMSCount() > 0; i++) {
+        gsm->processOutgoingSMS();
+        hostAdvanceMillis(SMS_MIN_INTERVAL);
+    }
+}
+
+void test_initialize_reads_network_state() {
+    TEST_ASSERT_TRUE(gsm->initialize());
+
+    GSMModule::ModuleStatus status = gsm->getStatus();
+    TEST_ASSERT_TRUE(status.networkRegistered);
+    TEST_ASSERT_TRUE(status.smsReady);
+    TEST_ASSERT_EQUAL_INT(4, status.signalStrength);
+    TEST_ASSERT_EQUAL_STRING("SIM-NET", status.operatorName.c_str());
+    TEST_ASSERT_EQUAL_INT(1, modem->commandCount("ATE0"));
+}
+
+void test_initialize_fails_without_registration() {
+    modem->setNetworkAvailable(false);
+    TEST_ASSERT_FALSE(gsm->initialize());
+    TEST_ASSERT_FALSE(gsm->getStatus().networkRegistered);
+}
+
+void test_bring_up_runs_in_short_steps() {
+    modem->powerCycle(3000);
+    unsigned long start = millis();
+    gsm->beginBringUp();
+    TEST_ASSERT_EQUAL_UINT32(start, millis());
+    
+    int becameReady = 0;
+    unsigned long longestStep = 0;
+    for (int i = 0; i < 2000 && gsm->getBringUpState() != GSMModule::BRINGUP_READY; i++) {
+        unsigned long before = millis();
+        if (gsm->serviceBringUp()) {
+            becameReady++;
+        }
+        if (millis() - before > longestStep) {
+            longestStep = millis() - before;
+        }
+        hostAdvanceMillis(10);
+    }
+    
+    TEST_ASSERT_EQUAL_INT(1, becameReady);
+    TEST_ASSERT_TRUE(gsm->getStatus().smsReady);
+    TEST_ASSERT_TRUE(longestStep < 500);
+    TEST_ASSERT_FALSE(gsm->serviceBringUp());
+}
+
+void test_warm_restart_skips_saved_settings() {
+    TEST_ASSERT_TRUE(gsm->initialize());
+    TEST_ASSERT_EQUAL_INT(1, modem->commandCount("AT&W"));
+    
+    // Reboot both ends; the modem comes back with its saved profile
+    delete gsm;
+    gsm = new GSMModule(*modem);
+    modem->powerCycle();
+    modem->clearLogs();
+    
+    unsigned long start = millis();
+    TEST_ASSERT_TRUE(gsm->initialize());
+    TEST_ASSERT_TRUE(millis() - start < 6000);
+    TEST_ASSERT_EQUAL_INT(0, modem->commandCount("ATE0"));
+    TEST_ASSERT_EQUAL_INT(0, modem->commandCount("AT+CNMI="));
+    TEST_ASSERT_EQUAL_INT(0, modem->commandCount("AT&W"));
+    TEST_ASSERT_EQUAL_INT(1, modem->commandCount("AT+CSQ"));
+    
+    // Settings the modem lost are sent again
+    delete gsm;
+    gsm = new GSMModule(*modem);
+    modem->injectFault("AT+CMGF?", SIM800Simulator::FAULT_ERROR);
+    modem->clearLogs();
+    TEST_ASSERT_TRUE(gsm->initialize());
+    TEST_ASSERT_EQUAL_INT(1, modem->commandCount("AT+CMGF=1"));
+    TEST_ASSERT_EQUAL_INT(1, modem->commandCount("AT&W"));
+}
+
+void test_link_moves_to_fast_baud_and_keeps_it() {
+    useBaudNegotiation();
+    TEST_ASSERT_TRUE(gsm->initialize());
+    TEST_ASSERT_EQUAL_UINT32(GSM_UART_FAST_BAUDRATE, modem->lineBaudRate());
+    TEST_ASSERT_EQUAL_UINT32(GSM_UART_FAST_BAUDRATE, gsm->getStatus().uartBaud);
+    TEST_ASSERT_EQUAL_INT(1, modem->commandCount("AT+IPR="));
+    TEST_ASSERT_EQUAL_INT(1, modem->commandCount("AT&W"));
+    
+    // After a reboot of both ends the saved rate is found by the probes
+    useBaudNegotiation();
+    modem->powerCycle();
+    modem->clearLogs();
+    TEST_ASSERT_TRUE(gsm->initialize());
+    TEST_ASSERT_EQUAL_UINT32(GSM_UART_FAST_BAUDRATE, gsm->getStatus().uartBaud);
+    TEST_ASSERT_EQUAL_INT(0, modem->commandCount("AT+IPR="));
+    TEST_ASSERT_EQUAL_INT(0, modem->commandCount("AT&W"));
+}
+
+void test_refused_fast_baud_stays_at_probe_rate() {
+    useBaudNegotiation();
+    modem->injectFault("AT+IPR=", SIM800Simulator::FAULT_ERROR);
+    TEST_ASSERT_TRUE(gsm->initialize());
+    TEST_ASSERT_EQUAL_UINT32(GSM_UART_BAUDRATE, modem->lineBaudRate());
+    TEST_ASSERT_EQUAL_UINT32(GSM_UART_BAUDRATE, gsm->getStatus().uartBaud);
+}
+
+void test_silent_modem_is_probed_at_both_rates_again() {
+    useBaudNegotiation();
+    TEST_ASSERT_TRUE(gsm->initialize());
+    
+    // Someone fixed the modem back to 9600; nothing we send gets through
+    modem->setBaudRate(GSM_UART_BAUDRATE);
+    uint32_t epoch = 0;
+    for (int i = 0; i < MODEM_SILENT_LIMIT; i++) {
+        TEST_ASSERT_FALSE(gsm->readNetworkTime(epoch));
+    }
+    TEST_ASSERT_EQUAL_INT(GSMModule::BRINGUP_BOOTING, gsm->getBringUpState());
+    TEST_ASSERT_FALSE(gsm->getStatus().moduleReady);
+    
+    for (int i = 0; i < 2000 && gsm->getBringUpState() != GSMModule::BRINGUP_READY; i++) {
+        gsm->serviceBringUp();
+        hostAdvanceMillis(10);
+    }
+    TEST_ASSERT_EQUAL_INT(GSMModule::BRINGUP_READY, gsm->getBringUpState());
+    TEST_ASSERT_EQUAL_UINT32(GSM_UART_FAST_BAUDRATE, modem->lineBaudRate());
+    TEST_ASSERT_TRUE(gsm->readNetworkTime(epoch));
+}
+
+void test_short_sms_goes_out_in_text_mode() {
+    TEST_ASSERT_TRUE(gsm->initialize());
+    TEST_ASSERT_TRUE(gsm->sendSMS("+233200000001", "Meter online"));
+    drainOutbox();
+
+    TEST_ASSERT_EQUAL_UINT32(1, modem->sentSMS().size());
+    const SIM800Simulator::SentSMS& sms = modem->sentSMS()[0];
+    TEST_ASSERT_FALSE(sms.pdu);
+    TEST_ASSERT_EQUAL_STRING("+233200000001", sms.number.c_str());
+    TEST_ASSERT_EQUAL_STRING("Meter online", sms.text.c_str());
+    TEST_ASSERT_EQUAL_INT(1, gsm->getStatus().smsSentCount);
+}
+
+void test_long_sms_goes_out_as_concatenated_pdus() {
+    TEST_ASSERT_TRUE(gsm->initialize());
+    String message;
+    for (int i = 0; i < 20; i++) {
+        message += "Reading " + String(i) + " ok. ";
+    }
+    TEST_ASSERT_TRUE(gsm->sendSMS("+233200000001", message));
+    drainOutbox();
+
+    TEST_ASSERT_EQUAL_UINT32(2, modem->sentSMS().size());
+    String rebuilt;
+    for (int i = 0; i < 2; i++) {
+        const SIM800Simulator::SentSMS& part = modem->sentSMS()[i];
+        TEST_ASSERT_TRUE(part.pdu);
+        TEST_ASSERT_EQUAL_STRING("+233200000001", part.number.c_str());
+        TEST_ASSERT_EQUAL_INT(2, part.parts);
+        TEST_ASSERT_EQUAL_INT(i + 1, part.part);
+        rebuilt += part.text;
+    }
+    TEST_ASSERT_EQUAL_STRING(message.c_str(), rebuilt.c_str());
+
+    // Text mode and direct delivery are restored afterwards
+    const std::vector<String>& log = modem->commandLog();
+    TEST_ASSERT_EQUAL_STRING("AT+CNMI=1,2,0,1,0", log.back().c_str());
+    TEST_ASSERT_EQUAL_STRING("AT+CMGF=1", log[log.size() - 2].c_str());
+}
+
+// Runs the main loop's SMS work until the queue is empty and every report is in
+static void waitForDeliveries(unsigned long limit) {
+    unsigned long start = millis();
+    while (millis() - start < limit &&
+           (gsm->getQueuedSMSCount() > 0 || gsm->getDeliveryTracker().pendingCount() > 0)) {
+        gsm->poll();
+        gsm->processOutgoingSMS();
+        hostAdvanceMillis(1000);
+    }
+    gsm->processOutgoingSMS();
+}
+
+static int sentTo(const char* number) {
+    int count = 0;
+    for (size_t i = 0; i < modem->sentSMS().size(); i++) {
+        if (modem->sentSMS()[i].number == number) {
+            count++;
+        }
+    }
+    return count;
+}
+
+void test_undelivered_alert_is_sent_again_to_that_recipient_only() {
+    TEST_ASSERT_TRUE(gsm->initialize());
+    modem->setDeliveryReport(SMS_RECIPIENTS[0], 0, 4000);
+    modem->setDeliveryReport(SMS_RECIPIENTS[1], 0x62, 30000);   // Phone off, centre gave up
+    modem->setDeliveryReport(SMS_RECIPIENTS[2], 0x41);          // Number not in use
+    TEST_ASSERT_TRUE(gsm->sendSystemAlert("Sensor A offline"));
+    waitForDeliveries(120000);
+
+    for (size_t i = 0; i < modem->sentSMS().size(); i++) {
+        TEST_ASSERT_TRUE(modem->sentSMS()[i].reportRequested);
+    }
+    TEST_ASSERT_EQUAL_INT(1, sentTo(SMS_RECIPIENTS[0]));
+    TEST_ASSERT_EQUAL_INT(1 + SMS_REDELIVERY_COUNT, sentTo(SMS_RECIPIENTS[1]));
+    TEST_ASSERT_EQUAL_INT(1, sentTo(SMS_RECIPIENTS[2]));
+    TEST_ASSERT_EQUAL_INT(0, gsm->getQueuedSMSCount());
+
+    const DeliveryTracker& tracker = gsm->getDeliveryTracker();
+    const DeliveryTracker::Recipient* delivered = tracker.findRecipient(SMS_RECIPIENTS[0]);
+    TEST_ASSERT_EQUAL_UINT32(1, delivered->delivered);
+    TEST_ASSERT_TRUE(delivered->lastLatency >= 4000 && delivered->lastLatency < 10000);
+    TEST_ASSERT_EQUAL_UINT32(1 + SMS_REDELIVERY_COUNT, tracker.findRecipient(SMS_RECIPIENTS[1])->failed);
+    TEST_ASSERT_EQUAL_UINT32(1, tracker.findRecipient(SMS_RECIPIENTS[2])->failed);
+}
+
+void test_alert_without_any_report_is_sent_once() {
+    TEST_ASSERT_TRUE(gsm->initialize());
+    // An SMS centre that never returns +CDS
+    for (size_t i = 0; i < SMS_RECIPIENT_COUNT; i++) {
+        modem->setDeliveryReport(SMS_RECIPIENTS[i], -1);
+    }
+    TEST_ASSERT_TRUE(gsm->sendSystemAlert("Sensor B offline"));
+    waitForDeliveries(3 * SMS_DELIVERY_TIMEOUT);
+
+    const DeliveryTracker& tracker = gsm->getDeliveryTracker();
+    for (size_t i = 0; i < SMS_RECIPIENT_COUNT; i++) {
+        TEST_ASSERT_EQUAL_INT(1, sentTo(SMS_RECIPIENTS[i]));
+        TEST_ASSERT_EQUAL_UINT32(1, tracker.findRecipient(SMS_RECIPIENTS[i])->expired);
+    }
+    TEST_ASSERT_EQUAL_INT(0, gsm->getQueuedSMSCount());
+}
+
+void test_reports_are_read_in_pdu_mode_and_routine_sms_are_not_retried() {
+    TEST_ASSERT_TRUE(gsm->initialize());
+    String message;
+    for (int i = 0; i < 20; i++) {
+        message += "Reading " + String(i) + " ok. ";
+    }
+    // The first part's report comes in while the second is still being sent
+    modem->setDeliveryReport("+233200000001", 0, 500);
+    modem->setDeliveryReport("+233200000002", -1);
+    TEST_ASSERT_TRUE(gsm->sendSMS("+233200000001", message));
+    TEST_ASSERT_TRUE(gsm->sendDailyReport(12.5f, 10.0f, 8.25f, 6.6f));
+    waitForDeliveries(SMS_DELIVERY_TIMEOUT + 60000);
+
+    const DeliveryTracker& tracker = gsm->getDeliveryTracker();
+    TEST_ASSERT_EQUAL_UINT32(1, tracker.findRecipient("+233200000001")->delivered);
+    // The daily report is never confirmed, but it is not an alert
+    TEST_ASSERT_EQUAL_INT(1, sentTo(SMS_RECIPIENTS[0]));
+    TEST_ASSERT_EQUAL_UINT32(0, tracker.pendingCount());
+}
+
+void test_status_command_by_sms_gets_a_reply() {
+    TEST_ASSERT_TRUE(gsm->initialize());
+    modem->receiveSMS(SMS_RECIPIENTS[0], "status");
+    hostAdvanceMillis(100);
+
+    gsm->poll();
+    String result = gsm->processIncomingSMS();
+    TEST_ASSERT_EQUAL_STRING("Command processed: STATUS", result.c_str());
+    drainOutbox();
+
+    String reply;
+    for (size_t i = 0; i < modem->sentSMS().size(); i++) {
+        TEST_ASSERT_EQUAL_STRING(SMS_RECIPIENTS[0], modem->sentSMS()[i].number.c_str());
+        reply += modem->sentSMS()[i].text;
+    }
+    TEST_ASSERT_EQUAL_INT(0, reply.indexOf("SYSTEM STATUS"));
+}
+
+void test_stored_sms_are_handled_and_deleted_in_one_command() {
+    TEST_ASSERT_TRUE(gsm->initialize());
+    modem->storeSMS(SMS_RECIPIENTS[1], "HELP");
+    modem->storeSMS("+10000000000", "STATUS");
+    modem->storeSMS(SMS_RECIPIENTS[2], "SIGNAL");
+
+    gsm->parseIncomingSMS();
+
+    TEST_ASSERT_EQUAL_INT(0, modem->storedSMSCount());
+    TEST_ASSERT_EQUAL_INT(1, modem->commandCount("AT+CMGD=1;+CMGD=2;+CMGD=3"));
+    TEST_ASSERT_EQUAL_INT(2, gsm->getQueuedSMSCount());
+}
+
+void test_bulk_upload_is_one_stamped_post() {
+    TEST_ASSERT_TRUE(gsm->initialize());
+    bufferReadings(5);
+    modem->clearLogs();
+
+    TEST_ASSERT_TRUE(gsm->sendBufferedData());
+
+    // One post per backend
+    TEST_ASSERT_EQUAL_UINT32(2, modem->httpRequests().size());
+    const SIM800Simulator::HTTPRequest& request = modem->httpRequests()[0];
+    TEST_ASSERT_EQUAL_INT(1, request.method);
+    TEST_ASSERT_EQUAL_STRING(THINGSPEAK_BULK_URL, request.url.c_str());
+    TEST_ASSERT_EQUAL_STRING("application/json", request.contentType.c_str());
+    TEST_ASSERT_TRUE(request.body.indexOf("\"created_at\":\"2024-06-01 ") > 0);
+    TEST_ASSERT_TRUE(request.body.indexOf("\"status\":\"seq:4\"") > 0);
+    TEST_ASSERT_EQUAL_STRING(BILLING_UPLOAD_URL, modem->httpRequests()[1].url.c_str());
+    TEST_ASSERT_TRUE(modem->httpRequests()[1].body.indexOf("\"status\":\"seq:4\"") > 0);
+    TEST_ASSERT_EQUAL_INT(0, gsm->getBufferedCount());
+    TEST_ASSERT_TRUE(modem->bearerOpen());
+}
+
+void test_full_queue_streams_as_one_post() {
+    TEST_ASSERT_TRUE(gsm->initialize());
+    bufferReadings(45);
+    modem->clearLogs();
+
+    TEST_ASSERT_TRUE(gsm->sendBufferedData());
+
+    // Bigger than any buffer the module keeps, declared up front and sent whole
+    TEST_ASSERT_EQUAL_UINT32(2, modem->httpRequests().size());
+    const String& body = modem->httpRequests()[0].body;
+    TEST_ASSERT_TRUE(body.length() > 4 * UPLOAD_STREAM_WINDOW);
+    TEST_ASSERT_EQUAL_INT(1, modem->commandCount(("AT+HTTPDATA=" + String(body.length()) + ",").c_str()));
+    TEST_ASSERT_EQUAL_INT(0, body.indexOf("{\"write_api_key\":"));
+    TEST_ASSERT_TRUE(body.endsWith("}]}"));
+    TEST_ASSERT_TRUE(body.indexOf("\"status\":\"seq:0\"") > 0);
+    TEST_ASSERT_TRUE(body.indexOf("\"status\":\"seq:44\"") > 0);
+    TEST_ASSERT_EQUAL_INT(0, gsm->getBufferedCount());
+}
+
+void test_outage_backs_off_without_at_traffic() {
+    TEST_ASSERT_TRUE(gsm->initialize());
+    bufferReadings(1);
+    TEST_ASSERT_TRUE(gsm->sendBufferedData());
+
+    // The network drops the bearer; the module hears it between uploads
+    modem->scheduleNetworkOutage(millis() + 1000, 600000);
+    hostAdvanceMillis(2000);
+    gsm->poll();
+    TEST_ASSERT_FALSE(modem->bearerOpen());
+
+    // One reconnect attempt, which fails and starts the backoff
+    bufferReadings(1);
+    TEST_ASSERT_FALSE(gsm->sendBufferedData());
+    TEST_ASSERT_EQUAL_INT(1, gsm->getBufferedCount());
+
+    modem->clearLogs();
+    TEST_ASSERT_FALSE(gsm->sendBufferedData());
+    TEST_ASSERT_EQUAL_UINT32(0, modem->commandLog().size());
+
+    // Once the outage and the backoff are over the reading goes out
+    for (int i = 0; i < 40 && gsm->getBufferedCount() > 0; i++) {
+        hostAdvanceMillis(60000);
+        gsm->sendBufferedData();
+    }
+    TEST_ASSERT_EQUAL_INT(0, gsm->getBufferedCount());
+    TEST_ASSERT_TRUE(modem->commandCount("AT+SAPBR=1,1") < 10);
+}
+
+void test_injected_error_leaves_readings_queued() {
+    TEST_ASSERT_TRUE(gsm->initialize());
+    bufferReadings(3);
+
+    modem->injectFault("AT+HTTPACTION", SIM800Simulator::FAULT_ERROR);
+    TEST_ASSERT_FALSE(gsm->sendBufferedData());
+    TEST_ASSERT_EQUAL_INT(3, gsm->getBufferedCount());
+
+    // The session was torn down and is rebuilt on the next upload, once the
+    // backend that failed has waited out its backoff
+    hostAdvanceMillis(UPLOAD_RETRY_BASE_DELAY);
+    TEST_ASSERT_TRUE(gsm->sendBufferedData());
+    TEST_ASSERT_EQUAL_INT(0, gsm->getBufferedCount());
+    TEST_ASSERT_EQUAL_INT(2, modem->commandCount("AT+HTTPINIT"));
+}
+
+void test_lost_final_line_times_out_and_recovers() {
+    TEST_ASSERT_TRUE(gsm->initialize());
+    bufferReadings(2);
+
+    modem->injectFault("AT+HTTPPARA=\"URL\"", SIM800Simulator::FAULT_DROP_FINAL_LINE);
+    unsigned long start = millis();
+    TEST_ASSERT_FALSE(gsm->sendBufferedData());
+    TEST_ASSERT_TRUE(millis() - start >= 10000);
+
+    hostAdvanceMillis(UPLOAD_RETRY_BASE_DELAY);
+    TEST_ASSERT_TRUE(gsm->sendBufferedData());
+    TEST_ASSERT_EQUAL_INT(0, gsm->getBufferedCount());
+}
+
+void test_dead_backend_fails_over_without_holding_back_others() {
+    TEST_ASSERT_TRUE(gsm->initialize());
+    TEST_ASSERT_EQUAL_INT(2, gsm->getUploadBackendCount());
+    modem->setHTTPStatus(BILLING_UPLOAD_URL, 503);
+    bufferReadings(3);
+
+    TEST_ASSERT_FALSE(gsm->sendBufferedData());
+    TEST_ASSERT_EQUAL_INT(0, gsm->getUploadBackendStatus(0).pending);
+    TEST_ASSERT_EQUAL_INT(3, gsm->getUploadBackendStatus(1).pending);
+    TEST_ASSERT_EQUAL_INT(LinkSupervisor::LINK_BACKOFF, gsm->getUploadBackendStatus(1).health);
+
+    // While billing backs off ThingSpeak keeps going and billing costs nothing
+    TEST_ASSERT_TRUE(gsm->bufferRecord(makeRecord()));
+    modem->clearLogs();
+    TEST_ASSERT_FALSE(gsm->sendBufferedData());
+    TEST_ASSERT_EQUAL_UINT32(1, modem->httpRequests().size());
+    TEST_ASSERT_EQUAL_STRING(THINGSPEAK_BULK_URL, modem->httpRequests()[0].url.c_str());
+    TEST_ASSERT_EQUAL_INT(4, gsm->getBufferedCount());
+
+    // The second failure in a row moves billing to its failover URL
+    hostAdvanceMillis(UPLOAD_RETRY_BASE_DELAY);
+    TEST_ASSERT_FALSE(gsm->sendBufferedData());
+    TEST_ASSERT_EQUAL_STRING(BILLING_FAILOVER_URL, gsm->getUploadBackendStatus(1).url);
+
+    hostAdvanceMillis(2 * UPLOAD_RETRY_BASE_DELAY);
+    modem->clearLogs();
+    TEST_ASSERT_TRUE(gsm->sendBufferedData());
+    TEST_ASSERT_EQUAL_UINT32(1, modem->httpRequests().size());
+    TEST_ASSERT_EQUAL_STRING(BILLING_FAILOVER_URL, modem->httpRequests()[0].url.c_str());
+    TEST_ASSERT_TRUE(modem->httpRequests()[0].body.indexOf("\"status\":\"seq:3\"") > 0);
+    TEST_ASSERT_EQUAL_INT(0, gsm->getBufferedCount());
+    TEST_ASSERT_EQUAL_UINT32(2, gsm->getUploadBackendStatus(1).failedCount);
+}
+
+void test_uploads_wait_for_the_device_window() {
+    TEST_ASSERT_TRUE(gsm->initialize());
+    bufferReadings(2);
+    modem->clearLogs();
+
+    // The first window is this device's phase after bring-up began
+    unsigned long wait = gsm->getNextUploadIn();
+    if (wait > 0) {
+        TEST_ASSERT_FALSE(gsm->serviceUploads());
+        TEST_ASSERT_EQUAL_UINT32(0, modem->commandLog().size());
+        hostAdvanceMillis(wait);
+    }
+    // The next window counts from the one just used, not from the end of the upload
+    unsigned long windowAt = millis();
+    TEST_ASSERT_TRUE(gsm->serviceUploads());
+    TEST_ASSERT_EQUAL_INT(0, gsm->getBufferedCount());
+    TEST_ASSERT_TRUE(gsm->getNextUploadIn() + (millis() - windowAt) >= UPLOAD_INTERVAL - UPLOAD_JITTER / 2);
+}
+
+void test_server_directives_change_the_schedule() {
+    TEST_ASSERT_TRUE(gsm->initialize());
+    bufferReadings(1);
+
+    modem->setHTTPResponse("{\"success\":true,\"upload_interval\":1800}");
+    TEST_ASSERT_TRUE(gsm->sendBufferedData());
+    TEST_ASSERT_EQUAL_UINT32(1800000, gsm->getUploadInterval());
+    TEST_ASSERT_EQUAL_INT(2, modem->commandCount("AT+HTTPREAD"));
+
+    // Told to hold off, neither backend posts until the pause is over
+    modem->setHTTPResponse("{\"retry_after\":3600}");
+    bufferReadings(1);
+    TEST_ASSERT_TRUE(gsm->sendBufferedData());
+    TEST_ASSERT_TRUE(gsm->getUploadBackendStatus(1).heldFor > 3500000);
+
+    bufferReadings(1);
+    modem->clearLogs();
+    TEST_ASSERT_FALSE(gsm->sendBufferedData());
+    TEST_ASSERT_EQUAL_UINT32(0, modem->httpRequests().size());
+
+    modem->setHTTPResponse("");
+    hostAdvanceMillis(3600000 + UPLOAD_JITTER);
+    TEST_ASSERT_TRUE(gsm->sendBufferedData());
+    TEST_ASSERT_EQUAL_INT(0, gsm->getBufferedCount());
+}
+
+// Opens the next upload window without sending anything else first
+static void reachUploadWindow() {
+    hostAdvanceMillis(gsm->getNextUploadIn());
+}
+
+void test_poor_signal_puts_uploads_off_until_they_go_stale() {
+    TEST_ASSERT_TRUE(gsm->initialize());
+    modem->setSignalQuality(6);     // Bucket 2
+    unsigned long capturedAt = millis();
+    TEST_ASSERT_TRUE(gsm->bufferRecord(makeRecord()));
+    modem->clearLogs();
+
+    reachUploadWindow();
+    TEST_ASSERT_FALSE(gsm->serviceUploads());
+    TEST_ASSERT_EQUAL_UINT32(0, modem->httpRequests().size());
+    TEST_ASSERT_EQUAL_INT(1, modem->commandCount("AT+CSQ"));
+    TEST_ASSERT_EQUAL_UINT32(1, gsm->getSignalStats().deferred[2]);
+    TEST_ASSERT_TRUE(gsm->getNextUploadIn() > UPLOAD_DEFER_RETRY - 5000);
+    TEST_ASSERT_TRUE(gsm->getNextUploadIn() <= UPLOAD_DEFER_RETRY);
+
+    // Past the staleness budget it goes anyway, in a small batch
+    for (int i = 0; i < 40 && gsm->getBufferedCount() > 0; i++) {
+        reachUploadWindow();
+        gsm->serviceUploads();
+    }
+    TEST_ASSERT_EQUAL_INT(0, gsm->getBufferedCount());
+    TEST_ASSERT_EQUAL_UINT32(1, gsm->getSignalStats().sent[2]);
+    TEST_ASSERT_TRUE(modem->httpRequests()[0].at - capturedAt >= UPLOAD_MAX_STALENESS);
+}
+
+void test_batch_size_follows_the_signal() {
+    TEST_ASSERT_TRUE(gsm->initialize());
+    bufferReadings(45);
+
+    // Weak but urgent: the queue is old, so it goes a few readings at a time
+    modem->setSignalQuality(3);
+    modem->clearLogs();
+    reachUploadWindow();
+    gsm->serviceUploads();
+    size_t weakBody = modem->httpRequests()[0].body.length();
+    TEST_ASSERT_TRUE(weakBody <= UPLOAD_MAX_BODY / 16);
+    TEST_ASSERT_TRUE(gsm->getBufferedCount() > 0);
+
+    modem->setSignalQuality(25);
+    modem->clearLogs();
+    reachUploadWindow();
+    TEST_ASSERT_TRUE(gsm->serviceUploads());
+    TEST_ASSERT_TRUE(modem->httpRequests()[0].body.length() > 2 * weakBody);
+    TEST_ASSERT_EQUAL_INT(0, gsm->getBufferedCount());
+    TEST_ASSERT_EQUAL_UINT32(1, gsm->getSignalStats().sent[5]);
+}
+
+void test_command_outcomes_and_latency_are_recorded() {
+    TEST_ASSERT_TRUE(gsm->initialize());
+    const ATCommandStats::Entry* csq = gsm->getCommandStats().find("CSQ");
+    TEST_ASSERT_NOT_NULL(csq);
+    TEST_ASSERT_TRUE(csq->outcomes[ATCommandStats::OUTCOME_OK] > 0);
+
+    // The window's signal check goes unanswered; the upload goes ahead
+    bufferReadings(1);
+    modem->injectFault("AT+CSQ", SIM800Simulator::FAULT_NO_RESPONSE);
+    modem->setCommandDelay("AT+HTTPACTION", 3000);
+    modem->clearLogs();
+    reachUploadWindow();
+    TEST_ASSERT_TRUE(gsm->serviceUploads());
+
+    csq = gsm->getCommandStats().find("CSQ");
+    TEST_ASSERT_EQUAL_UINT32(1, csq->outcomes[ATCommandStats::OUTCOME_TIMEOUT]);
+    TEST_ASSERT_TRUE(csq->maxLatency >= 5000);
+    const ATCommandStats::Entry* action = gsm->getCommandStats().find("HTTPACTION");
+    TEST_ASSERT_EQUAL_UINT32(5000, ATCommandStats::percentile(*action, 50));
+    TEST_ASSERT_TRUE(gsm->getCommandStats().find("HTTPDATA body")->outcomes[ATCommandStats::OUTCOME_OK] >= 2);
+
+    // The first window that gets through also sends the table to the billing backend
+    TEST_ASSERT_EQUAL_UINT32(3, modem->httpRequests().size());
+    const SIM800Simulator::HTTPRequest& report = modem->httpRequests()[2];
+    TEST_ASSERT_EQUAL_STRING(MODEM_STATS_URL, report.url.c_str());
+    TEST_ASSERT_TRUE(report.body.indexOf("\"device\":\"" DEVICE_ID "\"") >= 0);
+    TEST_ASSERT_TRUE(report.body.indexOf("\"HTTPACTION\":[2,0,0,") >= 0);
+    TEST_ASSERT_EQUAL_UINT32(3, action->outcomes[ATCommandStats::OUTCOME_OK]);
+
+    // and not again until MODEM_STATS_INTERVAL has passed
+    bufferReadings(1);
+    modem->clearLogs();
+    reachUploadWindow();
+    TEST_ASSERT_TRUE(gsm->serviceUploads());
+    TEST_ASSERT_EQUAL_UINT32(2, modem->httpRequests().size());
+}
+
+void test_wall_clock_follows_network_time() {
+    TEST_ASSERT_EQUAL_STRING("NONE", WallClock::sourceName(gsm->getWallClock().source()));
+    TEST_ASSERT_TRUE(gsm->initialize());
+    modem->clearLogs();
+
+    gsm->serviceClock();
+    TEST_ASSERT_EQUAL_INT(1, modem->commandCount("AT+CCLK?"));
+    TEST_ASSERT_EQUAL(WallClock::SOURCE_NETWORK, gsm->getWallClock().source());
+    TEST_ASSERT_TRUE(gsm->getTimestamp().startsWith("01/06/2024 12:0"));
+
+    // Read once an hour, and the time keeps running in between
+    hostAdvanceMillis(CLOCK_SYNC_INTERVAL / 2);
+    gsm->serviceClock();
+    TEST_ASSERT_EQUAL_INT(1, modem->commandCount("AT+CCLK?"));
+    TEST_ASSERT_TRUE(gsm->getTimestamp().startsWith("01/06/2024 12:3"));
+    hostAdvanceMillis(CLOCK_SYNC_INTERVAL / 2);
+    gsm->serviceClock();
+    TEST_ASSERT_EQUAL_INT(2, modem->commandCount("AT+CCLK?"));
+    TEST_ASSERT_EQUAL_UINT32(2, gsm->getWallClock().drift().syncs);
+    TEST_ASSERT_TRUE(abs(gsm->getWallClock().drift().lastOffset) < 1000);
+
+    // The network jumps (operator fixed its clock): the estimate steps
+    hostAdvanceMillis(CLOCK_SYNC_INTERVAL);
+    modem->setNetworkTime(NETWORK_EPOCH + 7200 + 120);
+    gsm->serviceClock();
+    TEST_ASSERT_EQUAL_UINT32(2, gsm->getWallClock().drift().steps);
+    TEST_ASSERT_TRUE(gsm->getTimestamp().startsWith("01/06/2024 14:02"));
+    TEST_ASSERT_EQUAL_UINT32(NETWORK_EPOCH + 7200 + 120, gsm->getWallClock().epoch(monoMillis()));
+
+    // The modem loses network time (back at its 2004 default): retried at
+    // CLOCK_SYNC_RETRY, not on every pass
+    hostAdvanceMillis(CLOCK_SYNC_INTERVAL);
+    modem->setNetworkTime(1072915200UL);
+    modem->clearLogs();
+    gsm->serviceClock();
+    TEST_ASSERT_EQUAL_INT(1, modem->commandCount("AT+CCLK?"));
+    for (int i = 0; i < 5; i++) {
+        hostAdvanceMillis(10);
+        gsm->serviceClock();
+    }
+    TEST_ASSERT_EQUAL_INT(1, modem->commandCount("AT+CCLK?"));
+    hostAdvanceMillis(CLOCK_SYNC_RETRY);
+    gsm->serviceClock();
+    TEST_ASSERT_EQUAL_INT(2, modem->commandCount("AT+CCLK?"));
+    TEST_ASSERT_EQUAL(WallClock::SOURCE_NETWORK, gsm->getWallClock().source());
+}
+
+void test_http_601_drops_the_bearer_state() {
+    TEST_ASSERT_TRUE(gsm->initialize());
+    bufferReadings(1);
+
+    modem->setHTTPStatus(601);
+    TEST_ASSERT_FALSE(gsm->sendBufferedData());
+    TEST_ASSERT_EQUAL_INT(601, gsm->getLastHTTPStatus());
+
+    // The next upload checks the bearer again before using it
+    modem->setHTTPStatus(200);
+    modem->clearLogs();
+    TEST_ASSERT_TRUE(gsm->sendBufferedData());
+    TEST_ASSERT_EQUAL_INT(1, modem->commandCount("AT+SAPBR=2,1"));
+}
+
+void test_late_http_status_does_not_end_other_commands() {
+    TEST_ASSERT_TRUE(gsm->initialize());
+
+    // The status of a request we gave up on arrives while the next command waits
+    modem->setCommandDelay("AT+HTTPACTION", HTTP_TIMEOUT + 500);
+    modem->setCommandDelay("AT+CMGD", 2000);
+    TEST_ASSERT_FALSE(gsm->sendHTTPRequest(THINGSPEAK_UPDATE_URL));
+    TEST_ASSERT_TRUE(gsm->deleteSMS(1));
+}
+
+void test_noisy_line_still_delivers() {
+    TEST_ASSERT_TRUE(gsm->initialize());
+    modem->setLineDropRate(50, 7);
+
+    bufferReadings(4);
+    for (int i = 0; i < 20 && gsm->getBufferedCount() > 0; i++) {
+        gsm->sendBufferedData();
+        hostAdvanceMillis(60000);
+    }
+    TEST_ASSERT_EQUAL_INT(0, gsm->getBufferedCount());
+}
+
+// Virtual time and AT traffic per operation at 9600 baud with the default
+// latencies; run with -v to see the figures
+void test_benchmark_upload_and_sms() {
+    TEST_ASSERT_TRUE(gsm->initialize());
+    bufferReadings(10);
+
+    modem->clearLogs();
+    unsigned long start = millis();
+    TEST_ASSERT_TRUE(gsm->sendBufferedData());
+    unsigned long firstUpload = millis() - start;
+    size_t firstCommands = modem->commandLog().size();
+
+    bufferReadings(10);
+    modem->clearLogs();
+    start = millis();
+    TEST_ASSERT_TRUE(gsm->sendBufferedData());
+    unsigned long warmUpload = millis() - start;
+    size_t warmCommands = modem->commandLog().size();
+    unsigned long warmBytes = modem->bytesFromHost() + modem->bytesToHost();
+
+    gsm->sendSMS("+233200000001", "Daily usage A 4.2 kWh, B 3.1 kWh");
+    modem->clearLogs();
+    start = millis();
+    gsm->processOutgoingSMS();
+    unsigned long smsTime = millis() - start;
+    size_t smsCommands = modem->commandLog().size();
+
+    printf("upload (bearer setup): %lu ms, %u AT commands\n", firstUpload, (unsigned)firstCommands);
+    printf("upload (warm session): %lu ms, %u AT commands, %lu UART bytes\n", warmUpload, (unsigned)warmCommands, warmBytes);
+    printf("sms (text mode):       %lu ms, %u AT commands\n", smsTime, (unsigned)smsCommands);
+
+    TEST_ASSERT_TRUE(warmCommands < firstCommands);
+    TEST_ASSERT_TRUE(warmUpload < firstUpload);
+}
+
+static unsigned long timeInboxListing() {
+    TEST_ASSERT_TRUE(gsm->initialize());
+    for (int i = 0; i < 8; i++) {
+        modem->storeSMS("+10000000000", "Promotional message number one of many, reply STOP to opt out");
+    }
+    unsigned long start = millis();
+    gsm->parseIncomingSMS();
+    TEST_ASSERT_EQUAL_INT(0, modem->storedSMSCount());
+    return millis() - start;
+}
+
+void test_benchmark_inbox_listing_at_both_rates() {
+    unsigned long slow = timeInboxListing();
+    
+    delete gsm;
+    delete modem;
+    modem = new SIM800Simulator();
+    modem->setNetworkTime(NETWORK_EPOCH);
+    gsm = new GSMModule(*modem, &SIM800Simulator::hostBaudRateSetter, modem);
+    unsigned long fast = timeInboxListing();
+    
+    printf("inbox of 8 (9600 baud):   %lu ms\n", slow);
+    printf("inbox of 8 (%lu baud): %lu ms\n", (unsigned long)GSM_UART_FAST_BAUDRATE, fast);
+    TEST_ASSERT_TRUE(fast < slow);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_initialize_reads_network_state);
+    RUN_TEST(test_initialize_fails_without_registration);
+    RUN_TEST(test_bring_up_runs_in_short_steps);
+    RUN_TEST(test_warm_restart_skips_saved_settings);
+    RUN_TEST(test_link_moves_to_fast_baud_and_keeps_it);
+    RUN_TEST(test_refused_fast_baud_stays_at_probe_rate);
+    RUN_TEST(test_silent_modem_is_probed_at_both_rates_again);
+    RUN_TEST(test_short_sms_goes_out_in_text_mode);
+    RUN_TEST(test_long_sms_goes_out_as_concatenated_pdus);
+    RUN_TEST(test_undelivered_alert_is_sent_again_to_that_recipient_only);
+    RUN_TEST(test_alert_without_any_report_is_sent_once);
+    RUN_TEST(test_reports_are_read_in_pdu_mode_and_routine_sms_are_not_retried);
+    RUN_TEST(test_status_command_by_sms_gets_a_reply);
+    RUN_TEST(test_stored_sms_are_handled_and_deleted_in_one_command);
+    RUN_TEST(test_bulk_upload_is_one_stamped_post);
+    RUN_TEST(test_full_queue_streams_as_one_post);
+    RUN_TEST(test_outage_backs_off_without_at_traffic);
+    RUN_TEST(test_injected_error_leaves_readings_queued);
+    RUN_TEST(test_lost_final_line_times_out_and_recovers);
+    RUN_TEST(test_dead_backend_fails_over_without_holding_back_others);
+    RUN_TEST(test_uploads_wait_for_the_device_window);
+    RUN_TEST(test_server_directives_change_the_schedule);
+    RUN_TEST(test_poor_signal_puts_uploads_off_until_they_go_stale);
+    RUN_TEST(test_batch_size_follows_the_signal);
+    RUN_TEST(test_command_outcomes_and_latency_are_recorded);
+    RUN_TEST(test_wall_clock_follows_network_time);
+    RUN_TEST(test_http_601_drops_the_bearer_state);
+    RUN_TEST(test_late_http_status_does_not_end_other_commands);
+    RUN_TEST(test_noisy_line_still_delivers);
+    RUN_TEST(test_benchmark_upload_and_sms);
+    RUN_TEST(test_benchmark_inbox_listing_at_both_rates);
+    return UNITY_END();
+}
@@ -0,0 +1,103 @@
+#include <unity.h>
+#include "LinkSupervisor.h"
+
+void setUp() {}
+void tearDown() {}
+
+static const uint32_t BASE = 5000;
+static const uint32_t MAX = 60000;
+static const uint8_t THRESHOLD = 4;
+static const uint32_t OPEN_TIME = 600000;
+
+void test_first_attempt_is_allowed_at_once() {
+    LinkSupervisor link(BASE, MAX, THRESHOLD, OPEN_TIME);
+    TEST_ASSERT_TRUE(link.shouldAttempt(0));
+    TEST_ASSERT_EQUAL(LinkSupervisor::LINK_DOWN, link.state(0));
+
+    link.attemptSucceeded(0);
+    TEST_ASSERT_TRUE(link.isUp());
+    TEST_ASSERT_FALSE(link.shouldAttempt(1000));
+}
+
+void test_backoff_doubles_within_jitter_bounds() {
+    LinkSupervisor link(BASE, MAX, 10, OPEN_TIME);
+    link.seed(12345);
+
+    uint32_t now = 1000;
+    uint32_t expected = BASE;
+    for (int i = 0; i < 6; i++) {
+        link.attemptFailed(now);
+        TEST_ASSERT_EQUAL(LinkSupervisor::LINK_BACKOFF, link.state(now));
+
+        uint32_t wait = link.retryIn(now);
+        TEST_ASSERT_TRUE(wait >= expected / 2);
+        TEST_ASSERT_TRUE(wait <= expected);
+        TEST_ASSERT_FALSE(link.shouldAttempt(now + wait - 1));
+        TEST_ASSERT_TRUE(link.shouldAttempt(now + wait));
+
+        now += wait;
+        expected = expected * 2 > MAX ? MAX : expected * 2;
+    }
+}
+
+void test_breaker_opens_and_probe_reopens_it() {
+    LinkSupervisor link(BASE, MAX, THRESHOLD, OPEN_TIME);
+    uint32_t now = 0;
+    for (uint8_t i = 0; i < THRESHOLD; i++) {
+        now += link.retryIn(now);
+        TEST_ASSERT_TRUE(link.shouldAttempt(now));
+        link.attemptFailed(now);
+    }
+    TEST_ASSERT_EQUAL(LinkSupervisor::LINK_CIRCUIT_OPEN, link.state(now));
+    TEST_ASSERT_EQUAL_UINT32(1, link.circuitTrips());
+    TEST_ASSERT_TRUE(link.retryIn(now) >= OPEN_TIME);
+    TEST_ASSERT_FALSE(link.shouldAttempt(now + OPEN_TIME - 1));
+
+    // One failed probe is enough to open it again
+    now += link.retryIn(now);
+    TEST_ASSERT_TRUE(link.shouldAttempt(now));
+    link.attemptFailed(now);
+    TEST_ASSERT_EQUAL(LinkSupervisor::LINK_CIRCUIT_OPEN, link.state(now));
+    TEST_ASSERT_EQUAL_UINT32(2, link.circuitTrips());
+
+    // A successful probe closes it and clears the failure run
+    now += link.retryIn(now);
+    link.attemptSucceeded(now);
+    TEST_ASSERT_TRUE(link.isUp());
+    TEST_ASSERT_EQUAL_UINT8(0, link.consecutiveFailures());
+}
+
+void test_lost_link_reconnects_without_delay() {
+    LinkSupervisor link(BASE, MAX, THRESHOLD, OPEN_TIME);
+    link.attemptFailed(0);
+    link.attemptSucceeded(link.retryIn(0));
+    link.linkLost(20000);
+    TEST_ASSERT_TRUE(link.shouldAttempt(20000));
+    TEST_ASSERT_EQUAL_UINT8(0, link.consecutiveFailures());
+
+    // Losing a link that was never up changes nothing
+    link.attemptFailed(20000);
+    uint32_t wait = link.retryIn(20000);
+    link.linkLost(20000);
+    TEST_ASSERT_EQUAL_UINT32(wait, link.retryIn(20000));
+}
+
+void test_timer_wraparound() {
+    LinkSupervisor link(BASE, MAX, THRESHOLD, OPEN_TIME);
+    uint32_t now = 0xFFFFFFFFUL - 1000;
+    link.attemptFailed(now);
+    uint32_t wait = link.retryIn(now);
+    TEST_ASSERT_TRUE(wait >= BASE / 2);
+    TEST_ASSERT_FALSE(link.shouldAttempt(now + 1500));
+    TEST_ASSERT_TRUE(link.shouldAttempt(now + wait));
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_first_attempt_is_allowed_at_once);
+    RUN_TEST(test_backoff_doubles_within_jitter_bounds);
+    RUN_TEST(test_breaker_opens_and_probe_reopens_it);
+    RUN_TEST(test_lost_link_reconnects_without_delay);
+    RUN_TEST(test_timer_wraparound);
+    return UNITY_END();
+}
@@ -0,0 +1,154 @@
+#include <unity.h>
+#include <string.h>
+#include "MonoClock.h"
+#include "LCDInterface.h"
+#include "SensorHandler.h"
+
+// The 64-bit time base against the host's fake clock, across the points
+// where the ESP32's 32-bit millis() and micros() wrap, and the modules that
+// time themselves with it
+
+static const uint64_t MILLIS_WRAP = 0x100000000ULL;     // 49.7 days
+
+void setUp() {
+    hostResetClock();
+}
+
+void tearDown() {}
+
+void test_counts_from_boot() {
+    TEST_ASSERT_EQUAL_UINT64(0, monoMicros());
+    hostAdvanceMillis(1500);
+    delayMicroseconds(250);
+    TEST_ASSERT_EQUAL_UINT64(1500250, monoMicros());
+    TEST_ASSERT_EQUAL_UINT64(1500, monoMillis());
+    TEST_ASSERT_EQUAL_UINT32(1500, millis());
+}
+
+void test_keeps_counting_where_millis_wraps() {
+    hostSetMicros((MILLIS_WRAP - 10) * 1000);
+    TEST_ASSERT_EQUAL_UINT32(MILLIS_WRAP - 10, millis());
+    uint64_t before = monoMillis();
+
+    hostAdvanceMillis(20);
+    TEST_ASSERT_EQUAL_UINT32(10, millis());
+    TEST_ASSERT_EQUAL_UINT64(MILLIS_WRAP + 10, monoMillis());
+    TEST_ASSERT_TRUE(monoMillis() > before);
+    TEST_ASSERT_EQUAL_UINT64(20, monoMillis() - before);
+}
+
+void test_keeps_counting_where_micros_wraps() {
+    // micros() goes round every 71.6 minutes
+    hostSetMicros(MILLIS_WRAP - 1);
+    hostAdvanceMillis(1);
+    TEST_ASSERT_EQUAL_UINT32(999, micros());
+    TEST_ASSERT_EQUAL_UINT64(MILLIS_WRAP + 999, monoMicros());
+}
+
+void test_deadline_set_before_the_wrap_holds() {
+    // A message shown for two seconds, starting one second before the wrap
+    hostSetMicros((MILLIS_WRAP - 1000) * 1000);
+    uint64_t endTime = monoMillis() + 2000;
+
+    hostAdvanceMillis(1500);
+    TEST_ASSERT_FALSE(monoMillis() >= endTime);
+    hostAdvanceMillis(500);
+    TEST_ASSERT_TRUE(monoMillis() >= endTime);
+}
+
+// A PZEM-004T drawing a steady 1 kW at either address
+static void steadyKilowatt(SoftwareSerial& serial, const uint8_t* frame, size_t length) {
+    if (length != 8 || frame[1] != 0x04) {
+        return;
+    }
+    uint8_t reply[25] = {frame[0], 0x04, 20,
+                         0x08, 0xFC,                // 230.0 V
+                         0x10, 0xFC, 0x00, 0x00,    // 4.348 A
+                         0x27, 0x10, 0x00, 0x00,    // 1000.0 W
+                         0x00, 0x00, 0x00, 0x00,    // 0 Wh
+                         0x01, 0xF4,                // 50.0 Hz
+                         0x00, 0x64,                // PF 1.00
+                         0x00, 0x00};
+    uint16_t crc = 0xFFFF;
+    for (int i = 0; i < 23; i++) {
+        crc ^= reply[i];
+        for (int bit = 0; bit < 8; bit++) {
+            crc = crc & 1 ? (crc >> 1) ^ 0xA001 : crc >> 1;
+        }
+    }
+    reply[23] = crc & 0xFF;
+    reply[24] = crc >> 8;
+    serial.hostQueue(reply, sizeof(reply));
+}
+
+void test_lcd_message_outlasts_the_wrap() {
+    hostSetMicros((MILLIS_WRAP - 1000) * 1000);
+    LCDInterface display;
+    display.begin();
+    PZEMResult data;
+    memset(&data, 0, sizeof(data));
+    StatusResult status;
+    status.tenant_a_ok = true;
+    status.tenant_b_ok = true;
+
+    // Two seconds from one second before millis() wraps
+    display.showSystemMessage("GSM Ready", 2000);
+    hostAdvanceMillis(500);
+    display.updateDisplay(data, status);
+    TEST_ASSERT_TRUE(strstr(LiquidCrystal_I2C::hostActive()->hostRow(1), "GSM Ready") != nullptr);
+    hostAdvanceMillis(1000);
+    display.updateDisplay(data, status);
+    TEST_ASSERT_TRUE(strstr(LiquidCrystal_I2C::hostActive()->hostRow(1), "GSM Ready") != nullptr);
+
+    // Gone once the two seconds are up, and the pages come back
+    hostAdvanceMillis(600);
+    display.updateDisplay(data, status);
+    TEST_ASSERT_TRUE(strstr(LiquidCrystal_I2C::hostActive()->hostRow(0), "TENANT A") != nullptr);
+}
+
+void test_energy_accumulates_across_the_wrap() {
+    SoftwareSerial::hostSetResponder(steadyKilowatt);
+    SensorHandler sensors;
+    sensors.init();
+
+    hostSetMicros((MILLIS_WRAP - 30000) * 1000);
+    uint64_t first = monoMillis();
+    PZEMResult reading = sensors.readAll();
+    TEST_ASSERT_TRUE(reading.tenant_a.ok);
+    TEST_ASSERT_FLOAT_WITHIN(1e-6, 0.0, reading.tenant_a.daily_energy_kwh);
+
+    // A minute later, on the far side of the wrap
+    hostAdvanceMillis(60000);
+    uint64_t second = monoMillis();
+    reading = sensors.readAll();
+    TEST_ASSERT_TRUE(millis() < 60000);
+    double expected = 1000.0 * (double)(second - first) / 3600000.0 / 1000.0;
+    TEST_ASSERT_FLOAT_WITHIN(1e-5, expected, reading.tenant_a.daily_energy_kwh);
+    TEST_ASSERT_FLOAT_WITHIN(1e-5, expected, reading.tenant_b.daily_energy_kwh);
+    TEST_ASSERT_EQUAL_UINT64(reading.tenant_b.timestamp, reading.summary.timestamp);
+    TEST_ASSERT_TRUE(reading.summary.timestamp > MILLIS_WRAP);
+
+    SoftwareSerial::hostSetResponder(nullptr);
+}
+
+void test_years_of_uptime() {
+    // Ten years: still exact to the microsecond
+    const uint64_t tenYears = 10ULL * 365 * 86400 * 1000000;
+    hostSetMicros(tenYears);
+    uint64_t last = monoMillis();
+    hostAdvanceMillis(2000);
+    TEST_ASSERT_EQUAL_UINT64(tenYears + 2000000, monoMicros());
+    TEST_ASSERT_EQUAL_UINT64(2000, monoMillis() - last);
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_counts_from_boot);
+    RUN_TEST(test_keeps_counting_where_millis_wraps);
+    RUN_TEST(test_keeps_counting_where_micros_wraps);
+    RUN_TEST(test_deadline_set_before_the_wrap_holds);
+    RUN_TEST(test_lcd_message_outlasts_the_wrap);
+    RUN_TEST(test_energy_accumulates_across_the_wrap);
+    RUN_TEST(test_years_of_uptime);
+    return UNITY_END();
+}
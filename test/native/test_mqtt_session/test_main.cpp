@@ -0,0 +1,283 @@
+#include <unity.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "MQTTSession.h"
+
+// Minimal broker stand-in: decodes what the client writes, answers the way
+// Mosquitto does, and holds its replies until the test delivers them
+struct Packet {
+    uint8_t type;
+    uint8_t flags;
+    std::vector<uint8_t> body;
+};
+
+struct FakeBroker {
+    std::vector<uint8_t> fromClient;
+    std::vector<Packet> received;
+    std::vector<uint8_t> toClient;
+    uint8_t connackCode;
+    bool autoPuback;
+    bool autoPingresp;
+
+    FakeBroker() : connackCode(0), autoPuback(true), autoPingresp(true) {}
+
+    static bool write(const uint8_t* head, size_t headLength, const uint8_t* body, size_t bodyLength, void* context) {
+        FakeBroker* self = static_cast<FakeBroker*>(context);
+        self->fromClient.insert(self->fromClient.end(), head, head + headLength);
+        if (body != nullptr) {
+            self->fromClient.insert(self->fromClient.end(), body, body + bodyLength);
+        }
+        self->parse();
+        return true;
+    }
+
+    void parse() {
+        while (fromClient.size() >= 2) {
+            size_t remaining = 0, multiplier = 1, n = 1;
+            uint8_t digit;
+            do {
+                if (n >= fromClient.size()) return;
+                digit = fromClient[n++];
+                remaining += (digit & 0x7F) * multiplier;
+                multiplier *= 128;
+            } while (digit & 0x80);
+            if (fromClient.size() < n + remaining) return;
+
+            Packet packet;
+            packet.type = fromClient[0] >> 4;
+            packet.flags = fromClient[0] & 0x0F;
+            packet.body.assign(fromClient.begin() + n, fromClient.begin() + n + remaining);
+            fromClient.erase(fromClient.begin(), fromClient.begin() + n + remaining);
+            received.push_back(packet);
+            respond(packet);
+        }
+    }
+
+    void respond(const Packet& packet) {
+        switch (packet.type) {
+            case 1: queue(0x20, {0, connackCode}); break;
+            case 3:
+                if (((packet.flags >> 1) & 3) == 1 && autoPuback) {
+                    size_t topicLength = (packet.body[0] << 8) | packet.body[1];
+                    queue(0x40, {packet.body[2 + topicLength], packet.body[3 + topicLength]});
+                }
+                break;
+            case 8: queue(0x90, {packet.body[0], packet.body[1], 1}); break;
+            case 12: if (autoPingresp) queue(0xD0, {}); break;
+            default: break;
+        }
+    }
+
+    void queue(uint8_t header, const std::vector<uint8_t>& body) {
+        toClient.push_back(header);
+        size_t length = body.size();
+        do {
+            uint8_t digit = length % 128;
+            length /= 128;
+            toClient.push_back(length > 0 ? (digit | 0x80) : digit);
+        } while (length > 0);
+        toClient.insert(toClient.end(), body.begin(), body.end());
+    }
+
+    void queuePublish(const std::string& topic, const std::string& payload, uint8_t qos, uint16_t id) {
+        std::vector<uint8_t> body;
+        body.push_back(topic.size() >> 8);
+        body.push_back(topic.size() & 0xFF);
+        body.insert(body.end(), topic.begin(), topic.end());
+        if (qos > 0) {
+            body.push_back(id >> 8);
+            body.push_back(id & 0xFF);
+        }
+        body.insert(body.end(), payload.begin(), payload.end());
+        queue(0x30 | (qos << 1), body);
+    }
+
+    void deliver(MQTTSession& session, uint32_t now, size_t chunk = 0) {
+        std::vector<uint8_t> pending;
+        pending.swap(toClient);
+        size_t step = chunk == 0 ? pending.size() : chunk;
+        for (size_t i = 0; i < pending.size(); i += step) {
+            size_t n = pending.size() - i < step ? pending.size() - i : step;
+            session.feed(pending.data() + i, n, now);
+        }
+    }
+};
+
+struct Downlink {
+    std::string topic;
+    std::string payload;
+    int count;
+};
+
+static void onMessage(const char* topic, size_t topicLength, const uint8_t* payload, size_t payloadLength, void* context) {
+    Downlink* downlink = static_cast<Downlink*>(context);
+    downlink->topic.assign(topic, topicLength);
+    downlink->payload.assign(reinterpret_cast<const char*>(payload), payloadLength);
+    downlink->count++;
+}
+
+static FakeBroker* broker;
+static MQTTSession* session;
+
+void setUp() {
+    broker = new FakeBroker();
+    session = new MQTTSession();
+    session->setWriteHandler(&FakeBroker::write, broker);
+}
+
+void tearDown() {
+    delete session;
+    delete broker;
+}
+
+static void connectSession(uint16_t keepAlive = 60) {
+    TEST_ASSERT_TRUE(session->connect("ESM_001", keepAlive, nullptr, nullptr, 0));
+    broker->deliver(*session, 0);
+    TEST_ASSERT_TRUE(session->connected());
+}
+
+void test_connect_handshake() {
+    TEST_ASSERT_TRUE(session->connect("ESM_001", 300, "meter", "secret", 0));
+    TEST_ASSERT_EQUAL(MQTTSession::MQTT_CONNECTING, session->state());
+
+    TEST_ASSERT_EQUAL(1, broker->received.size());
+    const std::vector<uint8_t>& body = broker->received[0].body;
+    const uint8_t expected[] = {0, 4, 'M', 'Q', 'T', 'T', 4, 0xC2, 0x01, 0x2C, 0, 7, 'E', 'S', 'M', '_', '0', '0', '1'};
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(expected, body.data(), sizeof(expected));
+    TEST_ASSERT_EQUAL(sizeof(expected) + 2 + 5 + 2 + 6, body.size());
+
+    broker->deliver(*session, 100);
+    TEST_ASSERT_TRUE(session->connected());
+}
+
+void test_connect_refused() {
+    broker->connackCode = 5;
+    TEST_ASSERT_TRUE(session->connect("ESM_001", 60, nullptr, nullptr, 0));
+    broker->deliver(*session, 100);
+    TEST_ASSERT_EQUAL(MQTTSession::MQTT_DISCONNECTED, session->state());
+    TEST_ASSERT_EQUAL_UINT8(5, session->connectReturnCode());
+
+    // No CONNACK at all times out
+    broker->autoPuback = false;
+    TEST_ASSERT_TRUE(session->connect("ESM_001", 60, nullptr, nullptr, 1000));
+    broker->toClient.clear();
+    session->loop(1000 + MQTTSession::CONNECT_TIMEOUT);
+    TEST_ASSERT_EQUAL(MQTTSession::MQTT_DISCONNECTED, session->state());
+}
+
+void test_qos1_publish_is_tracked_until_puback() {
+    connectSession();
+    std::vector<uint8_t> payload(300);
+    for (size_t i = 0; i < payload.size(); i++) payload[i] = (uint8_t)i;
+
+    uint32_t sentBefore = session->bytesSent();
+    uint16_t id = 0;
+    TEST_ASSERT_TRUE(session->publish("em/ESM_001/telemetry", payload.data(), payload.size(), 1, &id));
+    TEST_ASSERT_NOT_EQUAL(0, id);
+    TEST_ASSERT_TRUE(session->isPending(id));
+
+    // Fixed header (1 + 2 length bytes), topic (2 + 20), packet id (2)
+    TEST_ASSERT_EQUAL_UINT32(payload.size() + 3 + 22 + 2, session->bytesSent() - sentBefore);
+
+    const Packet& packet = broker->received.back();
+    TEST_ASSERT_EQUAL_UINT8(3, packet.type);
+    TEST_ASSERT_EQUAL_UINT8(0x02, packet.flags);
+    TEST_ASSERT_EQUAL(2 + 20 + 2 + payload.size(), packet.body.size());
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(payload.data(), packet.body.data() + 24, payload.size());
+
+    broker->deliver(*session, 200);
+    TEST_ASSERT_FALSE(session->isPending(id));
+    TEST_ASSERT_EQUAL_UINT32(1, session->acknowledgedCount());
+}
+
+void test_downlink_command_is_delivered_and_acknowledged() {
+    Downlink downlink = {"", "", 0};
+    session->setMessageHandler(&onMessage, &downlink);
+    connectSession();
+
+    TEST_ASSERT_TRUE(session->subscribe("em/ESM_001/cmd", 1));
+    const Packet& subscribe = broker->received.back();
+    TEST_ASSERT_EQUAL_UINT8(8, subscribe.type);
+    TEST_ASSERT_EQUAL_UINT8(0x02, subscribe.flags);
+    TEST_ASSERT_EQUAL_UINT8(1, subscribe.body.back());
+
+    broker->queuePublish("em/ESM_001/cmd", "STATUS", 1, 0x1234);
+    broker->deliver(*session, 300, 1);   // One byte at a time, as the modem hands it over
+
+    TEST_ASSERT_FALSE(session->subscriptionRejected());
+    TEST_ASSERT_EQUAL(1, downlink.count);
+    TEST_ASSERT_EQUAL_STRING("em/ESM_001/cmd", downlink.topic.c_str());
+    TEST_ASSERT_EQUAL_STRING("STATUS", downlink.payload.c_str());
+
+    const Packet& puback = broker->received.back();
+    TEST_ASSERT_EQUAL_UINT8(4, puback.type);
+    TEST_ASSERT_EQUAL_UINT8(0x12, puback.body[0]);
+    TEST_ASSERT_EQUAL_UINT8(0x34, puback.body[1]);
+}
+
+void test_keepalive_ping_and_dead_broker() {
+    connectSession(10);
+    size_t before = broker->received.size();
+
+    session->loop(9999);
+    TEST_ASSERT_EQUAL(before, broker->received.size());
+    session->loop(10000);
+    TEST_ASSERT_EQUAL_UINT8(12, broker->received.back().type);
+    broker->deliver(*session, 10100);
+
+    // Traffic resets the quiet period
+    session->publish("t", reinterpret_cast<const uint8_t*>("x"), 1, 0);
+    session->loop(19000);
+    TEST_ASSERT_EQUAL_UINT8(3, broker->received.back().type);
+
+    // The publish went out at 10100, so the next ping is due at 20100
+    broker->autoPingresp = false;
+    session->loop(20099);
+    TEST_ASSERT_EQUAL_UINT8(3, broker->received.back().type);
+    session->loop(20100);
+    TEST_ASSERT_EQUAL_UINT8(12, broker->received.back().type);
+    session->loop(25099);
+    TEST_ASSERT_TRUE(session->connected());
+    session->loop(25100);
+    TEST_ASSERT_FALSE(session->connected());
+}
+
+void test_oversized_packet_is_skipped() {
+    Downlink downlink = {"", "", 0};
+    session->setMessageHandler(&onMessage, &downlink);
+    connectSession();
+
+    broker->queuePublish("em/ESM_001/cmd", std::string(1000, 'A'), 0, 0);
+    broker->queuePublish("em/ESM_001/cmd", "HELP", 0, 0);
+    broker->deliver(*session, 400, 7);
+
+    TEST_ASSERT_TRUE(session->connected());
+    TEST_ASSERT_EQUAL(1, downlink.count);
+    TEST_ASSERT_EQUAL_STRING("HELP", downlink.payload.c_str());
+}
+
+void test_inflight_table_evicts_oldest() {
+    connectSession();
+    broker->autoPuback = false;
+    uint16_t ids[MQTTSession::MAX_INFLIGHT + 1];
+    for (size_t i = 0; i <= MQTTSession::MAX_INFLIGHT; i++) {
+        TEST_ASSERT_TRUE(session->publish("t", reinterpret_cast<const uint8_t*>("x"), 1, 1, &ids[i]));
+    }
+    TEST_ASSERT_FALSE(session->isPending(ids[0]));
+    for (size_t i = 1; i <= MQTTSession::MAX_INFLIGHT; i++) {
+        TEST_ASSERT_TRUE(session->isPending(ids[i]));
+    }
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_connect_handshake);
+    RUN_TEST(test_connect_refused);
+    RUN_TEST(test_qos1_publish_is_tracked_until_puback);
+    RUN_TEST(test_downlink_command_is_delivered_and_acknowledged);
+    RUN_TEST(test_keepalive_ping_and_dead_broker);
+    RUN_TEST(test_oversized_packet_is_skipped);
+    RUN_TEST(test_inflight_table_evicts_oldest);
+    return UNITY_END();
+}
@@ -0,0 +1,228 @@
+#include <unity.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <stdio.h>
+#include <thread>
+#include "SampleRing.h"
+#include "TelemetryRecord.h"
+
+void setUp() {}
+void tearDown() {}
+
+// Every field derives from the sequence number, so a torn copy shows
+static TelemetryRecord sample(uint32_t sequence) {
+    TelemetryRecord record;
+    record.capturedAt = sequence;
+    record.createdAt = sequence * 7 + 1;
+    for (int i = 0; i < TELEMETRY_FIELD_COUNT; i++) {
+        record.fields[i] = (float)(sequence % 100000) + i;
+    }
+    return record;
+}
+
+static bool intact(const TelemetryRecord& record) {
+    if (record.createdAt != record.capturedAt * 7 + 1) {
+        return false;
+    }
+    for (int i = 0; i < TELEMETRY_FIELD_COUNT; i++) {
+        if (record.fields[i] != (float)(record.capturedAt % 100000) + i) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void test_records_come_out_in_order() {
+    SampleRing<TelemetryRecord, 8> ring;
+    TelemetryRecord out[8];
+    TEST_ASSERT_EQUAL(0, ring.popBatch(out, 8));
+
+    for (uint32_t i = 0; i < 5; i++) ring.push(sample(i));
+    TEST_ASSERT_EQUAL_UINT32(5, ring.size());
+    TEST_ASSERT_EQUAL(3, ring.popBatch(out, 3));
+    TEST_ASSERT_EQUAL_UINT32(0, out[0].capturedAt);
+    TEST_ASSERT_EQUAL_UINT32(2, out[2].capturedAt);
+
+    TelemetryRecord one = TelemetryRecord();
+    TEST_ASSERT_TRUE(ring.pop(one));
+    TEST_ASSERT_EQUAL_UINT32(3, one.capturedAt);
+    TEST_ASSERT_EQUAL(1, ring.popBatch(out, 8));
+    TEST_ASSERT_EQUAL_UINT32(4, out[0].capturedAt);
+    TEST_ASSERT_FALSE(ring.pop(one));
+    TEST_ASSERT_EQUAL_UINT32(0, ring.dropped());
+}
+
+void test_full_ring_drops_the_oldest() {
+    SampleRing<TelemetryRecord, 8> ring;
+    for (uint32_t i = 0; i < 11; i++) ring.push(sample(i));
+    TEST_ASSERT_EQUAL_UINT32(8, ring.size());
+    TEST_ASSERT_EQUAL_UINT32(3, ring.dropped());
+    TEST_ASSERT_EQUAL_UINT32(11, ring.pushed());
+
+    TelemetryRecord out[16];
+    TEST_ASSERT_EQUAL(8, ring.popBatch(out, 16));
+    for (uint32_t i = 0; i < 8; i++) {
+        TEST_ASSERT_EQUAL_UINT32(3 + i, out[i].capturedAt);
+        TEST_ASSERT_TRUE(intact(out[i]));
+    }
+
+    // Space freed by the consumer is used before anything else is dropped
+    for (uint32_t i = 11; i < 19; i++) ring.push(sample(i));
+    TEST_ASSERT_EQUAL_UINT32(3, ring.dropped());
+}
+
+void test_indices_are_padded_apart() {
+    SampleRing<TelemetryRecord, 8> ring;
+    TEST_ASSERT_EQUAL(0, (uintptr_t)&ring % SAMPLE_RING_CACHE_LINE);
+    TEST_ASSERT_TRUE(sizeof(ring) >= 2 * SAMPLE_RING_CACHE_LINE + 8 * sizeof(TelemetryRecord));
+}
+
+// One producer that never waits, one consumer that sometimes falls behind:
+// every record is either received intact and in order or counted as dropped
+void test_stress_two_threads() {
+    const uint32_t TOTAL = 1000000;
+    static SampleRing<TelemetryRecord, 16> ring;
+    std::atomic<bool> done(false);
+
+    std::thread producer([&]() {
+        for (uint32_t i = 0; i < TOTAL; i++) {
+            ring.push(sample(i));
+            // Hands the core over now and then, so both sides interleave on a single-core host too
+            if ((i & 63) == 0) std::this_thread::yield();
+        }
+        done.store(true, std::memory_order_release);
+    });
+
+    uint32_t received = 0;
+    uint32_t gaps = 0;
+    uint32_t torn = 0;
+    int64_t last = -1;
+    TelemetryRecord out[8];
+    for (;;) {
+        bool finished = done.load(std::memory_order_acquire);
+        size_t count = ring.popBatch(out, (received & 7) + 1);
+        for (size_t i = 0; i < count; i++) {
+            if (!intact(out[i])) torn++;
+            int64_t sequence = out[i].capturedAt;
+            if (sequence <= last) torn++;
+            gaps += (uint32_t)(sequence - last - 1);
+            last = sequence;
+        }
+        received += count;
+        if (count == 0 && finished) break;
+        if ((received & 0xFFF) == 0) std::this_thread::yield();
+    }
+    producer.join();
+
+    char message[128];
+    snprintf(message, sizeof(message), "received %u, dropped %u", received, ring.dropped());
+    TEST_MESSAGE(message);
+    TEST_ASSERT_EQUAL_UINT32(0, torn);
+    TEST_ASSERT_EQUAL_UINT32(TOTAL - 1, (uint32_t)last);
+    TEST_ASSERT_EQUAL_UINT32(TOTAL, received + ring.dropped());
+    TEST_ASSERT_EQUAL_UINT32(ring.dropped(), gaps);
+}
+
+// The same ring behind a mutex, as with a locked copy of the struct
+class LockedRing {
+public:
+    LockedRing() : head(0), tail(0), dropCount(0) {}
+    void push(const TelemetryRecord& record) {
+        std::lock_guard<std::mutex> guard(lock);
+        if (head - tail == 16) {
+            tail++;
+            dropCount++;
+        }
+        slots[head++ & 15] = record;
+    }
+    size_t popBatch(TelemetryRecord* out, size_t max) {
+        std::lock_guard<std::mutex> guard(lock);
+        size_t count = std::min<size_t>(max, head - tail);
+        for (size_t i = 0; i < count; i++) out[i] = slots[tail++ & 15];
+        return count;
+    }
+private:
+    std::mutex lock;
+    TelemetryRecord slots[16];
+    uint32_t head;
+    uint32_t tail;
+    uint32_t dropCount;
+};
+
+struct PushTiming {
+    double meanNs;
+    double p999Ns;         // Single pushes, timing overhead included
+    double maxNs;
+    uint32_t received;
+};
+
+template <typename Ring>
+static PushTiming timePushes(Ring& ring, uint32_t total) {
+    static double samples[200000];
+    std::atomic<bool> done(false);
+    uint32_t received = 0;
+
+    std::thread consumer([&]() {
+        TelemetryRecord out[8];
+        for (;;) {
+            bool finished = done.load(std::memory_order_acquire);
+            size_t count = ring.popBatch(out, 8);
+            received += count;
+            if (count == 0 && finished) break;
+        }
+    });
+
+    // Throughput untimed, then each push on its own for the tail
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < total; i++) {
+        ring.push(sample(i));
+    }
+    double elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    for (uint32_t i = 0; i < 200000; i++) {
+        TelemetryRecord record = sample(total + i);
+        auto before = std::chrono::steady_clock::now();
+        ring.push(record);
+        samples[i] = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - before).count();
+    }
+    done.store(true, std::memory_order_release);
+    consumer.join();
+
+    size_t kept = 200000;
+    std::sort(samples, samples + kept);
+    PushTiming timing;
+    timing.meanNs = elapsed / total;
+    timing.p999Ns = samples[kept * 999 / 1000];
+    timing.maxNs = samples[kept - 1];
+    timing.received = received;
+    return timing;
+}
+
+void test_benchmark_two_threads() {
+    const uint32_t TOTAL = 1000000;
+    static SampleRing<TelemetryRecord, 16> ring;
+    static LockedRing locked;
+
+    PushTiming lockFree = timePushes(ring, TOTAL);
+    PushTiming mutex = timePushes(locked, TOTAL);
+
+    char message[256];
+    snprintf(message, sizeof(message),
+             "push, consumer on another thread: lock-free %.0f ns/record (p99.9 %.0f ns, max %.0f ns); "
+             "mutex %.0f ns/record (p99.9 %.0f ns, max %.0f ns)",
+             lockFree.meanNs, lockFree.p999Ns, lockFree.maxNs, mutex.meanNs, mutex.p999Ns, mutex.maxNs);
+    TEST_MESSAGE(message);
+
+    TEST_ASSERT_EQUAL_UINT32(TOTAL + 200000, lockFree.received + ring.dropped());
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_records_come_out_in_order);
+    RUN_TEST(test_full_ring_drops_the_oldest);
+    RUN_TEST(test_indices_are_padded_apart);
+    RUN_TEST(test_stress_two_threads);
+    RUN_TEST(test_benchmark_two_threads);
+    return UNITY_END();
+}
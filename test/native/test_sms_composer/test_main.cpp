@@ -0,0 +1,137 @@
+#include <unity.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include "SMSComposer.h"
+
+void setUp() {}
+void tearDown() {}
+
+static uint8_t hexByte(const char* hex) {
+    unsigned value = 0;
+    sscanf(hex, "%2x", &value);
+    return (uint8_t)value;
+}
+
+// Unpacks the user data of a hex PDU built without an SMSC address
+static std::string unpackUserData(const char* hex, bool concatenated) {
+    size_t daDigits = hexByte(hex + 2 + 4);
+    size_t offset = 2 + 2 * (4 + (daDigits + 1) / 2 + 2);
+    size_t udl = hexByte(hex + offset);
+    offset += 2;
+
+    size_t octets = strlen(hex + offset) / 2;
+    uint8_t data[160];
+    for (size_t i = 0; i < octets; i++) data[i] = hexByte(hex + offset + 2 * i);
+
+    std::string text;
+    for (size_t s = concatenated ? 7 : 0; s < udl; s++) {
+        size_t bit = s * 7;
+        uint16_t pair = data[bit / 8] | (bit / 8 + 1 < octets ? data[bit / 8 + 1] << 8 : 0);
+        text += (char)((pair >> (bit % 8)) & 0x7F);
+    }
+    return text;
+}
+
+void test_plain_ascii_stays_in_text_mode() {
+    SMSComposer composer;
+    composer.compose("Signal: Good (4/5)");
+    TEST_ASSERT_EQUAL(1, composer.segmentCount());
+    TEST_ASSERT_FALSE(composer.needsPDU());
+    TEST_ASSERT_EQUAL_STRING("Signal: Good (4/5)", composer.text());
+    TEST_ASSERT_EQUAL(0, composer.substitutionCount());
+}
+
+void test_cedi_is_transliterated() {
+    SMSComposer composer;
+    composer.compose("Cost: \xE2\x82\xB5" "12.50");
+    TEST_ASSERT_EQUAL_STRING("Cost: GHS12.50", composer.text());
+    TEST_ASSERT_EQUAL(1, composer.substitutionCount());
+    TEST_ASSERT_EQUAL(14, composer.septetCount());
+}
+
+void test_extension_and_remapped_characters_need_pdu() {
+    SMSComposer composer;
+    composer.compose("a{b}");
+    TEST_ASSERT_EQUAL(6, composer.septetCount());
+    TEST_ASSERT_TRUE(composer.needsPDU());
+
+    composer.compose("user@example");
+    TEST_ASSERT_EQUAL(12, composer.septetCount());
+    TEST_ASSERT_TRUE(composer.needsPDU());
+}
+
+void test_segment_boundaries() {
+    std::string text(160, 'a');
+    SMSComposer composer;
+    composer.compose(text.c_str());
+    TEST_ASSERT_EQUAL(1, composer.segmentCount());
+
+    text += 'a';
+    composer.compose(text.c_str());
+    TEST_ASSERT_EQUAL(2, composer.segmentCount());
+    TEST_ASSERT_TRUE(composer.needsPDU());
+
+    // An escape pair straddling septet 153 moves whole into the next segment
+    std::string straddle(152, 'a');
+    straddle += "[";
+    straddle += std::string(20, 'b');
+    composer.compose(straddle.c_str());
+    TEST_ASSERT_EQUAL(2, composer.segmentCount());
+
+    char hex[SMSComposer::MAX_PDU_HEX];
+    TEST_ASSERT_TRUE(composer.buildPDU(0, "+233241234567", 9, hex, sizeof(hex)) > 0);
+    TEST_ASSERT_EQUAL(152, unpackUserData(hex, true).size());
+}
+
+void test_overlong_text_is_truncated() {
+    std::string text(SMSComposer::MAX_SEPTETS + 10, 'x');
+    SMSComposer composer;
+    TEST_ASSERT_FALSE(composer.compose(text.c_str()));
+    TEST_ASSERT_TRUE(composer.wasTruncated());
+    TEST_ASSERT_EQUAL(SMSComposer::MAX_SEGMENTS, composer.segmentCount());
+}
+
+void test_single_pdu_matches_reference_packing() {
+    SMSComposer composer;
+    composer.compose("hellohello");
+    char hex[SMSComposer::MAX_PDU_HEX];
+    size_t length = composer.buildPDU(0, "+233241234567", 0, hex, sizeof(hex));
+
+    // 00 SMSC | 01 submit | 00 MR | 0C 91 322314325476 | 00 00 | 0A | packed text
+    TEST_ASSERT_EQUAL_STRING("0001000C9132231432547600000AE8329BFD4697D9EC37", hex);
+    TEST_ASSERT_EQUAL((strlen(hex) - 2) / 2, length);
+}
+
+void test_concatenated_pdus_carry_udh() {
+    std::string text;
+    for (int i = 0; i < 20; i++) text += "Segment text. ";
+    SMSComposer composer;
+    composer.compose(text.c_str());
+    TEST_ASSERT_EQUAL(2, composer.segmentCount());
+
+    char hex[SMSComposer::MAX_PDU_HEX];
+    std::string joined;
+    for (size_t part = 0; part < composer.segmentCount(); part++) {
+        TEST_ASSERT_TRUE(composer.buildPDU(part, "0241234567", 0x42, hex, sizeof(hex), true) > 0);
+        // Submit with UDHI and status report request, national number
+        TEST_ASSERT_EQUAL_STRING_LEN("0061000A81", hex, 10);
+        char udh[13];
+        snprintf(udh, sizeof(udh), "05000342%02X%02X", (unsigned)composer.segmentCount(), (unsigned)(part + 1));
+        TEST_ASSERT_NOT_NULL(strstr(hex, udh));
+        joined += unpackUserData(hex, true);
+    }
+    TEST_ASSERT_EQUAL_STRING(text.c_str(), joined.c_str());
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_plain_ascii_stays_in_text_mode);
+    RUN_TEST(test_cedi_is_transliterated);
+    RUN_TEST(test_extension_and_remapped_characters_need_pdu);
+    RUN_TEST(test_segment_boundaries);
+    RUN_TEST(test_overlong_text_is_truncated);
+    RUN_TEST(test_single_pdu_matches_reference_packing);
+    RUN_TEST(test_concatenated_pdus_carry_udh);
+    return UNITY_END();
+}
@@ -0,0 +1,156 @@
+#include <unity.h>
+#include <stdio.h>
+#include "DeliveryTracker.h"
+
+void setUp() {}
+void tearDown() {}
+
+static const uint32_t TIMEOUT = 600000;
+
+void test_text_reports_are_parsed() {
+    uint8_t reference = 0;
+    uint8_t status = 0xFF;
+    TEST_ASSERT_TRUE(DeliveryTracker::parseTextReport(
+        "+CDS: 6,46,\"+233241234567\",145,\"24/06/01,12:00:00+00\",\"24/06/01,12:00:05+00\",0", reference, status));
+    TEST_ASSERT_EQUAL_UINT8(46, reference);
+    TEST_ASSERT_EQUAL_UINT8(0, status);
+
+    // Recipient address left out
+    TEST_ASSERT_TRUE(DeliveryTracker::parseTextReport(
+        "+CDS: 6,7,,,\"24/06/01,12:00:00+00\",\"24/06/01,12:10:00+00\",70", reference, status));
+    TEST_ASSERT_EQUAL_UINT8(7, reference);
+    TEST_ASSERT_EQUAL_UINT8(70, status);
+
+    TEST_ASSERT_FALSE(DeliveryTracker::parseTextReport("+CDS: 25", reference, status));
+}
+
+void test_pdu_reports_are_parsed() {
+    uint8_t reference = 0;
+    uint8_t status = 0xFF;
+    // SMSC +233244000000, report for reference 0x2A to +233241234567, status 0x62
+    TEST_ASSERT_TRUE(DeliveryTracker::parsePDUReport(
+        "07913322440000F0" "06" "2A" "0C91" "332214325476" "42106021000000" "42106021500000" "62",
+        reference, status));
+    TEST_ASSERT_EQUAL_UINT8(0x2A, reference);
+    TEST_ASSERT_EQUAL_UINT8(0x62, status);
+
+    // No SMSC address, odd number of digits
+    TEST_ASSERT_TRUE(DeliveryTracker::parsePDUReport(
+        "00" "06" "05" "0B91" "3322143254F6" "42106021000000" "42106021500000" "00", reference, status));
+    TEST_ASSERT_EQUAL_UINT8(5, reference);
+    TEST_ASSERT_EQUAL_UINT8(0, status);
+
+    // An SMS-DELIVER is not a status report; a cut-off one is nothing
+    TEST_ASSERT_FALSE(DeliveryTracker::parsePDUReport("00" "04" "05" "0B91", reference, status));
+    TEST_ASSERT_FALSE(DeliveryTracker::parsePDUReport("00" "06" "05" "0B91" "3322", reference, status));
+}
+
+void test_delivery_settles_with_latency() {
+    DeliveryTracker tracker(TIMEOUT);
+    int id = tracker.begin("+233205324322", 1000);
+    tracker.addPart(id, 12);
+    TEST_ASSERT_EQUAL(-1, tracker.nextSettled(2000));
+
+    // Another reference is someone else's report
+    TEST_ASSERT_EQUAL(-1, tracker.report(13, 0, 3000));
+    TEST_ASSERT_EQUAL(id, tracker.report(12, 0, 5000));
+    TEST_ASSERT_EQUAL(DeliveryTracker::STATE_DELIVERED, tracker.state(id));
+    TEST_ASSERT_EQUAL_UINT32(4000, tracker.latency(id));
+    TEST_ASSERT_EQUAL(id, tracker.nextSettled(5000));
+
+    const DeliveryTracker::Recipient* recipient = tracker.findRecipient("+233205324322");
+    TEST_ASSERT_NOT_NULL(recipient);
+    TEST_ASSERT_EQUAL_UINT32(1, recipient->delivered);
+    TEST_ASSERT_EQUAL_UINT32(4000, recipient->maxLatency);
+
+    tracker.release(id);
+    TEST_ASSERT_EQUAL(-1, tracker.nextSettled(5000));
+}
+
+void test_concatenated_message_waits_for_every_part() {
+    DeliveryTracker tracker(TIMEOUT);
+    int id = tracker.begin("+233245829456", 0);
+    tracker.addPart(id, 200);
+    tracker.addPart(id, 201);
+    tracker.addPart(id, 202);
+
+    TEST_ASSERT_EQUAL(-1, tracker.report(201, 0, 4000));
+    TEST_ASSERT_EQUAL(-1, tracker.report(200, 0, 5000));
+    // The same part reported twice does not count as the third
+    TEST_ASSERT_EQUAL(-1, tracker.report(201, 0, 5500));
+    TEST_ASSERT_EQUAL(DeliveryTracker::STATE_PENDING, tracker.state(id));
+    TEST_ASSERT_EQUAL(id, tracker.report(202, 0, 9000));
+    TEST_ASSERT_EQUAL_UINT32(9000, tracker.latency(id));
+}
+
+void test_failures_are_told_apart() {
+    DeliveryTracker tracker(TIMEOUT);
+    int retrying = tracker.begin("+233205324322", 0);
+    tracker.addPart(retrying, 1);
+    int unknown = tracker.begin("+233524919044", 0);
+    tracker.addPart(unknown, 2);
+    int silent = tracker.begin("+233245829456", 0);
+    tracker.addPart(silent, 3);
+
+    // Still trying, then given up for now
+    TEST_ASSERT_EQUAL(-1, tracker.report(1, 0x30, 60000));
+    TEST_ASSERT_EQUAL(retrying, tracker.report(1, 0x62, 120000));
+    TEST_ASSERT_EQUAL(DeliveryTracker::STATE_FAILED, tracker.state(retrying));
+    TEST_ASSERT_FALSE(DeliveryTracker::isPermanent(tracker.status(retrying)));
+
+    TEST_ASSERT_EQUAL(unknown, tracker.report(2, 0x41, 3000));
+    TEST_ASSERT_TRUE(DeliveryTracker::isPermanent(tracker.status(unknown)));
+
+    tracker.release(retrying);
+    tracker.release(unknown);
+    TEST_ASSERT_EQUAL(-1, tracker.nextSettled(TIMEOUT - 1));
+    TEST_ASSERT_EQUAL(silent, tracker.nextSettled(TIMEOUT));
+    TEST_ASSERT_EQUAL(DeliveryTracker::STATE_EXPIRED, tracker.state(silent));
+    TEST_ASSERT_EQUAL_UINT32(1, tracker.findRecipient("+233245829456")->expired);
+    TEST_ASSERT_EQUAL_UINT32(1, tracker.findRecipient("+233205324322")->failed);
+}
+
+void test_reused_reference_goes_to_the_newest_message() {
+    DeliveryTracker tracker(TIMEOUT);
+    // 256 messages later the modem hands out reference 9 again
+    int old = tracker.begin("+233205324322", 0);
+    tracker.addPart(old, 9);
+    int fresh = tracker.begin("+233205324322", 300000);
+    tracker.addPart(fresh, 9);
+
+    TEST_ASSERT_EQUAL(fresh, tracker.report(9, 0, 305000));
+    TEST_ASSERT_EQUAL(DeliveryTracker::STATE_PENDING, tracker.state(old));
+}
+
+void test_full_table_declines_and_recipients_overflow() {
+    DeliveryTracker tracker(TIMEOUT);
+    char number[DeliveryTracker::NUMBER_LENGTH];
+    for (size_t i = 0; i < DeliveryTracker::MAX_MESSAGES; i++) {
+        snprintf(number, sizeof(number), "+2332000000%02u", (unsigned)i);
+        int id = tracker.begin(number, 0);
+        TEST_ASSERT_TRUE(id >= 0);
+        tracker.addPart(id, (uint8_t)i);
+    }
+    TEST_ASSERT_EQUAL(-1, tracker.begin("+233200000099", 0));
+    TEST_ASSERT_EQUAL(DeliveryTracker::MAX_MESSAGES, tracker.pendingCount());
+
+    for (size_t i = 0; i < DeliveryTracker::MAX_MESSAGES; i++) {
+        tracker.report((uint8_t)i, 0, 1000);
+    }
+    TEST_ASSERT_EQUAL(DeliveryTracker::MAX_RECIPIENTS, tracker.recipientCount());
+    const DeliveryTracker::Recipient* other = tracker.findRecipient("OTHER");
+    TEST_ASSERT_NOT_NULL(other);
+    TEST_ASSERT_EQUAL_UINT32(DeliveryTracker::MAX_MESSAGES - (DeliveryTracker::MAX_RECIPIENTS - 1), other->delivered);
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_text_reports_are_parsed);
+    RUN_TEST(test_pdu_reports_are_parsed);
+    RUN_TEST(test_delivery_settles_with_latency);
+    RUN_TEST(test_concatenated_message_waits_for_every_part);
+    RUN_TEST(test_failures_are_told_apart);
+    RUN_TEST(test_reused_reference_goes_to_the_newest_message);
+    RUN_TEST(test_full_table_declines_and_recipients_overflow);
+    return UNITY_END();
+}
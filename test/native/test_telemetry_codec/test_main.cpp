@@ -0,0 +1,221 @@
+#include <unity.h>
+#include <chrono>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include "TelemetryCodec.h"
+#include "ThingSpeakBatch.h"
+
+void setUp() {}
+void tearDown() {}
+
+static const uint32_t START_EPOCH = 1715422800UL;
+static const uint32_t INTERVAL_SECONDS = 300;
+
+// A day of 5-minute readings with realistic drift and noise
+static TelemetryRecord syntheticRecord(uint32_t index) {
+    TelemetryRecord record;
+    record.capturedAt = index * INTERVAL_SECONDS * 1000;
+    record.createdAt = START_EPOCH + index * INTERVAL_SECONDS;
+    float wobble = sinf(index * 0.37f);
+    record.fields[FIELD_VOLTAGE_A] = 230.0f + 3.0f * wobble;
+    record.fields[FIELD_CURRENT_A] = 1.2f + 0.4f * sinf(index * 0.11f);
+    record.fields[FIELD_POWER_A] = record.fields[FIELD_VOLTAGE_A] * record.fields[FIELD_CURRENT_A];
+    record.fields[FIELD_ENERGY_A] = index * 0.023f;
+    record.fields[FIELD_VOLTAGE_B] = 229.0f - 2.0f * wobble;
+    record.fields[FIELD_CURRENT_B] = 0.8f + 0.3f * cosf(index * 0.07f);
+    record.fields[FIELD_POWER_B] = record.fields[FIELD_VOLTAGE_B] * record.fields[FIELD_CURRENT_B];
+    record.fields[FIELD_ENERGY_B] = index * 0.015f;
+    return record;
+}
+
+static void assertSameReading(const TelemetryRecord& expected, const TelemetryRecord& actual) {
+    for (int i = 0; i < TELEMETRY_FIELD_COUNT; i++) {
+        if (isnan(expected.fields[i])) {
+            TEST_ASSERT_TRUE(isnan(actual.fields[i]));
+            continue;
+        }
+        // Lossless at the precision the fields are published with
+        float tolerance = 0.51f * powf(10.0f, -TELEMETRY_FIELD_DECIMALS[i]);
+        TEST_ASSERT_FLOAT_WITHIN(tolerance, expected.fields[i], actual.fields[i]);
+    }
+}
+
+void test_round_trip_day_of_readings() {
+    static uint8_t buffer[8192];
+    TelemetryEncoder encoder(buffer, sizeof(buffer));
+    for (uint32_t i = 0; i < 288; i++) {
+        TelemetryRecord record = syntheticRecord(i);
+        TEST_ASSERT_TRUE(encoder.add(record, record.createdAt, 1000 + i));
+    }
+
+    TelemetryDecoder decoder(encoder.data(), encoder.length());
+    TEST_ASSERT_TRUE(decoder.isValid());
+    TEST_ASSERT_EQUAL(288, decoder.count());
+
+    TelemetryRecord decoded;
+    uint32_t createdAt, sequence;
+    for (uint32_t i = 0; i < 288; i++) {
+        TEST_ASSERT_TRUE(decoder.next(decoded, createdAt, sequence));
+        TEST_ASSERT_EQUAL_UINT32(1000 + i, sequence);
+        TEST_ASSERT_EQUAL_UINT32(START_EPOCH + i * INTERVAL_SECONDS, createdAt);
+        assertSameReading(syntheticRecord(i), decoded);
+    }
+    TEST_ASSERT_FALSE(decoder.next(decoded, createdAt, sequence));
+}
+
+void test_gaps_jitter_and_missing_values() {
+    uint8_t buffer[512];
+    TelemetryEncoder encoder(buffer, sizeof(buffer));
+
+    TelemetryRecord records[4];
+    const uint32_t times[] = {START_EPOCH, START_EPOCH + 300, START_EPOCH + 601, START_EPOCH + 90000};
+    const uint32_t sequences[] = {5, 6, 9, 10};
+    for (int i = 0; i < 4; i++) {
+        records[i] = syntheticRecord(i);
+        if (i == 2) records[i].fields[FIELD_CURRENT_B] = NAN;
+        TEST_ASSERT_TRUE(encoder.add(records[i], times[i], sequences[i]));
+    }
+
+    TelemetryDecoder decoder(encoder.data(), encoder.length());
+    TelemetryRecord decoded;
+    uint32_t createdAt, sequence;
+    for (int i = 0; i < 4; i++) {
+        TEST_ASSERT_TRUE(decoder.next(decoded, createdAt, sequence));
+        TEST_ASSERT_EQUAL_UINT32(sequences[i], sequence);
+        TEST_ASSERT_EQUAL_UINT32(times[i], createdAt);
+        assertSameReading(records[i], decoded);
+    }
+}
+
+void test_full_buffer_rejects_without_corrupting() {
+    uint8_t buffer[64];
+    TelemetryEncoder encoder(buffer, sizeof(buffer));
+    uint32_t added = 0;
+    while (encoder.add(syntheticRecord(added), START_EPOCH + added * INTERVAL_SECONDS, added)) {
+        added++;
+    }
+    TEST_ASSERT_TRUE(added >= 2);
+    TEST_ASSERT_TRUE(encoder.length() <= sizeof(buffer));
+
+    TelemetryDecoder decoder(encoder.data(), encoder.length());
+    TEST_ASSERT_EQUAL(added, decoder.count());
+    TelemetryRecord decoded;
+    uint32_t createdAt, sequence;
+    for (uint32_t i = 0; i < added; i++) {
+        TEST_ASSERT_TRUE(decoder.next(decoded, createdAt, sequence));
+        assertSameReading(syntheticRecord(i), decoded);
+    }
+}
+
+void test_rejects_foreign_header() {
+    const uint8_t junk[] = {'{', '"', 'w', 'r', 'i', 't', 'e'};
+    TelemetryDecoder decoder(junk, sizeof(junk));
+    TEST_ASSERT_FALSE(decoder.isValid());
+}
+
+static bool appendTo(const uint8_t* data, size_t length, void* context) {
+    static_cast<std::string*>(context)->append(reinterpret_cast<const char*>(data), length);
+    return true;
+}
+
+void test_streamed_encoding_matches_buffered() {
+    static uint8_t buffer[8192];
+    TelemetryEncoder whole(buffer, sizeof(buffer));
+
+    std::string streamed;
+    uint8_t window[TelemetryEncoder::MAX_ENTRY_LENGTH + 8];
+    TelemetryEncoder stream(window, sizeof(window), 288, &appendTo, &streamed);
+
+    for (uint32_t i = 0; i < 288; i++) {
+        TelemetryRecord record = syntheticRecord(i);
+        if (i % 50 == 7) {
+            record.fields[FIELD_CURRENT_B] = NAN;
+        }
+        TEST_ASSERT_TRUE(whole.add(record, record.createdAt, 1000 + i));
+        TEST_ASSERT_TRUE(stream.add(record, record.createdAt, 1000 + i));
+        TEST_ASSERT_EQUAL(whole.length(), stream.length());
+    }
+    TEST_ASSERT_TRUE(stream.finish());
+    TEST_ASSERT_EQUAL(whole.length(), streamed.size());
+
+    // Trailing bits of the last byte are padding
+    TEST_ASSERT_EQUAL_MEMORY(whole.data(), streamed.data(), streamed.size() - 1);
+
+    TelemetryDecoder decoder(reinterpret_cast<const uint8_t*>(streamed.data()), streamed.size());
+    TEST_ASSERT_TRUE(decoder.isValid());
+    TEST_ASSERT_EQUAL(288, decoder.count());
+    TelemetryRecord decoded;
+    uint32_t createdAt, sequence;
+    for (uint32_t i = 0; i < 288; i++) {
+        TEST_ASSERT_TRUE(decoder.next(decoded, createdAt, sequence));
+        TEST_ASSERT_EQUAL_UINT32(1000 + i, sequence);
+    }
+}
+
+void test_benchmark_compression_ratio() {
+    const uint32_t RECORDS = 288;
+    const int ROUNDS = 200;
+    static uint8_t binary[8192];
+    static char json[96 * 1024];
+
+    TelemetryRecord records[RECORDS];
+    for (uint32_t i = 0; i < RECORDS; i++) records[i] = syntheticRecord(i);
+
+    size_t binaryLength = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int round = 0; round < ROUNDS; round++) {
+        TelemetryEncoder encoder(binary, sizeof(binary));
+        for (uint32_t i = 0; i < RECORDS; i++) {
+            encoder.add(records[i], records[i].createdAt, i);
+        }
+        binaryLength = encoder.length();
+    }
+    double encodeNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+    size_t jsonLength = 0;
+    start = std::chrono::steady_clock::now();
+    for (int round = 0; round < ROUNDS; round++) {
+        ThingSpeakBatch batch(json, sizeof(json), "XXXXXXXXXXXXXXXX");
+        for (uint32_t i = 0; i < RECORDS; i++) {
+            batch.add(records[i], records[i].createdAt, i);
+        }
+        jsonLength = batch.length();
+    }
+    double jsonNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+    // The per-reading GET query string used before batching
+    char query[256];
+    size_t queryLength = 0;
+    for (uint32_t i = 0; i < RECORDS; i++) {
+        queryLength += snprintf(query, sizeof(query),
+                                "https://api.thingspeak.com/update?api_key=XXXXXXXXXXXXXXXX"
+                                "&field1=%.1f&field2=%.2f&field3=%.1f&field4=%.3f"
+                                "&field5=%.1f&field6=%.2f&field7=%.1f&field8=%.3f",
+                                records[i].fields[0], records[i].fields[1], records[i].fields[2], records[i].fields[3],
+                                records[i].fields[4], records[i].fields[5], records[i].fields[6], records[i].fields[7]);
+    }
+
+    char message[256];
+    snprintf(message, sizeof(message),
+             "binary: %.1f B/record, %.0f ns/record; bulk JSON: %.1f B/record (%.1fx), %.0f ns/record; "
+             "query string: %.1f B/record (%.1fx)",
+             (double)binaryLength / RECORDS, encodeNs / (ROUNDS * RECORDS),
+             (double)jsonLength / RECORDS, (double)jsonLength / binaryLength, jsonNs / (ROUNDS * RECORDS),
+             (double)queryLength / RECORDS, (double)queryLength / binaryLength);
+    TEST_MESSAGE(message);
+
+    TEST_ASSERT_TRUE(binaryLength * 5 < jsonLength);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_round_trip_day_of_readings);
+    RUN_TEST(test_gaps_jitter_and_missing_values);
+    RUN_TEST(test_full_buffer_rejects_without_corrupting);
+    RUN_TEST(test_rejects_foreign_header);
+    RUN_TEST(test_streamed_encoding_matches_buffered);
+    RUN_TEST(test_benchmark_compression_ratio);
+    return UNITY_END();
+}
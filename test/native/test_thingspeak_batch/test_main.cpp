@@ -0,0 +1,116 @@
+#include <unity.h>
+#include <math.h>
+#include <string.h>
+#include <string>
+#include "CivilTime.h"
+#include "ThingSpeakBatch.h"
+
+void setUp() {}
+void tearDown() {}
+
+static TelemetryRecord sampleRecord() {
+    TelemetryRecord record;
+    record.capturedAt = 0;
+    record.createdAt = 0;
+    const float values[TELEMETRY_FIELD_COUNT] = {230.5f, 1.25f, 276.6f, 1.5f, 231.2f, 0.8f, 184.9f, 1.2f};
+    memcpy(record.fields, values, sizeof(values));
+    return record;
+}
+
+void test_epoch_round_trip() {
+    CivilTime time = {2024, 2, 29, 23, 59, 58};
+    uint32_t epoch = civilToEpoch(time);
+    TEST_ASSERT_EQUAL_UINT32(1709251198UL, epoch);
+
+    CivilTime back;
+    epochToCivil(epoch, back);
+    TEST_ASSERT_EQUAL(2024, back.year);
+    TEST_ASSERT_EQUAL(2, back.month);
+    TEST_ASSERT_EQUAL(29, back.day);
+    TEST_ASSERT_EQUAL(58, back.second);
+}
+
+void test_modem_clock_applies_zone() {
+    uint32_t epoch = 0;
+    TEST_ASSERT_TRUE(parseModemClock("24/05/11,10:21:07+00", epoch));
+    TEST_ASSERT_EQUAL_UINT32(1715422867UL, epoch);
+
+    // +04 quarter hours = UTC+1
+    TEST_ASSERT_TRUE(parseModemClock("24/05/11,11:21:07+04", epoch));
+    TEST_ASSERT_EQUAL_UINT32(1715422867UL, epoch);
+
+    TEST_ASSERT_FALSE(parseModemClock("garbage", epoch));
+}
+
+void test_batch_is_valid_json_envelope() {
+    char buffer[1024];
+    ThingSpeakBatch batch(buffer, sizeof(buffer), "KEY");
+    TEST_ASSERT_EQUAL_STRING("{\"write_api_key\":\"KEY\",\"updates\":[]}", batch.body());
+
+    TEST_ASSERT_TRUE(batch.add(sampleRecord(), 1715422867UL, 7));
+    TEST_ASSERT_EQUAL(1, batch.count());
+    TEST_ASSERT_EQUAL(strlen(batch.body()), batch.length());
+    TEST_ASSERT_NOT_NULL(strstr(batch.body(), "\"created_at\":\"2024-05-11 10:21:07 +0000\",\"status\":\"seq:7\""));
+    TEST_ASSERT_NOT_NULL(strstr(batch.body(), "\"field1\":230.5,"));
+    TEST_ASSERT_NOT_NULL(strstr(batch.body(), "\"field8\":1.200}]}"));
+}
+
+void test_batch_packs_until_full() {
+    char buffer[700];
+    ThingSpeakBatch batch(buffer, sizeof(buffer), "KEY");
+    size_t added = 0;
+    while (batch.add(sampleRecord(), 1715422867UL + added * 300, added)) {
+        added++;
+    }
+    TEST_ASSERT_TRUE(added >= 3);
+    TEST_ASSERT_EQUAL(added, batch.count());
+    TEST_ASSERT_TRUE(batch.length() < sizeof(buffer));
+    // Still a closed document after the rejected add
+    TEST_ASSERT_EQUAL_STRING("]}", batch.body() + batch.length() - 2);
+}
+
+void test_nan_fields_are_omitted() {
+    char buffer[512];
+    ThingSpeakBatch batch(buffer, sizeof(buffer), "KEY");
+    TelemetryRecord record = sampleRecord();
+    record.fields[FIELD_CURRENT_B] = NAN;
+    TEST_ASSERT_TRUE(batch.add(record, 1715422867UL, 8));
+    TEST_ASSERT_NULL(strstr(batch.body(), "field6"));
+    TEST_ASSERT_NOT_NULL(strstr(batch.body(), "field7"));
+}
+
+static bool appendTo(const uint8_t* data, size_t length, void* context) {
+    static_cast<std::string*>(context)->append(reinterpret_cast<const char*>(data), length);
+    return true;
+}
+
+void test_streamed_batch_matches_buffered() {
+    static char buffer[16384];
+    ThingSpeakBatch whole(buffer, sizeof(buffer), "KEY");
+
+    std::string streamed;
+    char window[300];
+    ThingSpeakBatch stream(window, sizeof(window), "KEY", &appendTo, &streamed);
+
+    for (uint32_t i = 0; i < 60; i++) {
+        TEST_ASSERT_TRUE(whole.add(sampleRecord(), 1715422867UL + i * 300, i));
+        TEST_ASSERT_TRUE(stream.add(sampleRecord(), 1715422867UL + i * 300, i));
+        TEST_ASSERT_EQUAL(whole.length(), stream.length());
+    }
+    TEST_ASSERT_TRUE(streamed.size() < whole.length());
+    TEST_ASSERT_TRUE(stream.finish());
+    TEST_ASSERT_EQUAL(whole.length(), streamed.size());
+    TEST_ASSERT_EQUAL_STRING(whole.body(), streamed.c_str());
+    TEST_ASSERT_FALSE(stream.add(sampleRecord(), 1715422867UL, 61));
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_epoch_round_trip);
+    RUN_TEST(test_modem_clock_applies_zone);
+    RUN_TEST(test_batch_is_valid_json_envelope);
+    RUN_TEST(test_batch_packs_until_full);
+    RUN_TEST(test_nan_fields_are_omitted);
+    RUN_TEST(test_streamed_batch_matches_buffered);
+    return UNITY_END();
+}
@@ -0,0 +1,210 @@
+#include <unity.h>
+#include <string.h>
+#include "RAMLogStorage.h"
+#include "UploadQueue.h"
+
+void setUp() {}
+void tearDown() {}
+
+static const uint32_t RECORDS_PER_SEGMENT = 4;
+static const uint32_t MAX_SEGMENTS = 3;
+
+static TelemetryRecord makeRecord(uint32_t capturedAt) {
+    TelemetryRecord record;
+    memset(&record, 0, sizeof(record));
+    record.capturedAt = capturedAt;
+    record.fields[FIELD_VOLTAGE_A] = 230.0f + capturedAt;
+    return record;
+}
+
+void test_records_drain_in_order() {
+    RAMLogStorage storage(RECORDS_PER_SEGMENT * sizeof(UploadQueue::Entry), MAX_SEGMENTS);
+    UploadQueue queue(storage, RECORDS_PER_SEGMENT, MAX_SEGMENTS);
+    TEST_ASSERT_TRUE(queue.begin());
+
+    for (uint32_t i = 0; i < 6; i++) {
+        TEST_ASSERT_TRUE(queue.push(makeRecord(i)));
+    }
+    TEST_ASSERT_EQUAL_UINT32(6, queue.pending());
+
+    UploadQueue::Entry entry;
+    for (uint32_t seq = queue.readCursor(); seq < queue.writeSequence(); seq++) {
+        TEST_ASSERT_TRUE(queue.read(seq, entry));
+        TEST_ASSERT_EQUAL_UINT32(seq, entry.sequence);
+        TEST_ASSERT_EQUAL_UINT32(seq, entry.record.capturedAt);
+    }
+
+    TEST_ASSERT_TRUE(queue.acknowledge(4));
+    TEST_ASSERT_EQUAL_UINT32(1, queue.pending());
+    TEST_ASSERT_FALSE(queue.read(4, entry));
+    TEST_ASSERT_TRUE(queue.read(5, entry));
+
+    // The first segment is fully delivered and removed
+    uint32_t first = 0, last = 0;
+    TEST_ASSERT_TRUE(storage.segmentRange(first, last));
+    TEST_ASSERT_EQUAL_UINT32(1, first);
+}
+
+void test_cursor_and_sequence_survive_restart() {
+    RAMLogStorage storage(RECORDS_PER_SEGMENT * sizeof(UploadQueue::Entry), MAX_SEGMENTS);
+    {
+        UploadQueue queue(storage, RECORDS_PER_SEGMENT, MAX_SEGMENTS);
+        TEST_ASSERT_TRUE(queue.begin());
+        for (uint32_t i = 0; i < 7; i++) queue.push(makeRecord(i));
+        queue.acknowledge(2);
+    }
+
+    UploadQueue queue(storage, RECORDS_PER_SEGMENT, MAX_SEGMENTS);
+    TEST_ASSERT_TRUE(queue.begin());
+    TEST_ASSERT_EQUAL_UINT32(3, queue.readCursor());
+    TEST_ASSERT_EQUAL_UINT32(7, queue.writeSequence());
+    TEST_ASSERT_EQUAL_UINT16(2, queue.currentBootId());
+
+    UploadQueue::Entry entry;
+    TEST_ASSERT_TRUE(queue.read(3, entry));
+    TEST_ASSERT_EQUAL_UINT16(1, entry.bootId);
+
+    TEST_ASSERT_TRUE(queue.push(makeRecord(100)));
+    TEST_ASSERT_TRUE(queue.read(7, entry));
+    TEST_ASSERT_EQUAL_UINT16(2, entry.bootId);
+}
+
+void test_sequence_continues_after_full_drain() {
+    RAMLogStorage storage(RECORDS_PER_SEGMENT * sizeof(UploadQueue::Entry), MAX_SEGMENTS);
+    {
+        UploadQueue queue(storage, RECORDS_PER_SEGMENT, MAX_SEGMENTS);
+        queue.begin();
+        for (uint32_t i = 0; i < 9; i++) queue.push(makeRecord(i));
+        queue.acknowledge(8);
+        TEST_ASSERT_EQUAL_UINT32(0, queue.pending());
+    }
+
+    UploadQueue queue(storage, RECORDS_PER_SEGMENT, MAX_SEGMENTS);
+    queue.begin();
+    TEST_ASSERT_EQUAL_UINT32(9, queue.writeSequence());
+    TEST_ASSERT_EQUAL_UINT32(0, queue.pending());
+}
+
+void test_full_log_drops_oldest_segment() {
+    RAMLogStorage storage(RECORDS_PER_SEGMENT * sizeof(UploadQueue::Entry), MAX_SEGMENTS);
+    UploadQueue queue(storage, RECORDS_PER_SEGMENT, MAX_SEGMENTS);
+    queue.begin();
+
+    for (uint32_t i = 0; i < queue.capacity() + 1; i++) {
+        TEST_ASSERT_TRUE(queue.push(makeRecord(i)));
+    }
+
+    TEST_ASSERT_EQUAL_UINT32(RECORDS_PER_SEGMENT, queue.droppedCount());
+    TEST_ASSERT_EQUAL_UINT32(RECORDS_PER_SEGMENT, queue.readCursor());
+    TEST_ASSERT_EQUAL_UINT32(queue.capacity() - RECORDS_PER_SEGMENT + 1, queue.pending());
+
+    UploadQueue::Entry entry;
+    TEST_ASSERT_TRUE(queue.read(queue.readCursor(), entry));
+    TEST_ASSERT_EQUAL_UINT32(RECORDS_PER_SEGMENT, entry.record.capturedAt);
+}
+
+void test_corrupt_record_is_rejected() {
+    RAMLogStorage storage(RECORDS_PER_SEGMENT * sizeof(UploadQueue::Entry), MAX_SEGMENTS);
+    UploadQueue queue(storage, RECORDS_PER_SEGMENT, MAX_SEGMENTS);
+    queue.begin();
+    for (uint32_t i = 0; i < 3; i++) queue.push(makeRecord(i));
+
+    // Flip one byte of record 1's payload
+    size_t offset = sizeof(UploadQueue::Entry) + offsetof(UploadQueue::Entry, record) + 8;
+    uint8_t byte;
+    storage.readSegment(0, offset, &byte, 1);
+    byte ^= 0x40;
+    storage.writeSegment(0, offset, &byte, 1);
+
+    UploadQueue::Entry entry;
+    TEST_ASSERT_TRUE(queue.read(0, entry));
+    TEST_ASSERT_FALSE(queue.read(1, entry));
+    TEST_ASSERT_TRUE(queue.read(2, entry));
+    TEST_ASSERT_EQUAL_UINT32(1, queue.corruptCount());
+}
+
+void test_torn_trailing_write_is_overwritten() {
+    RAMLogStorage storage(RECORDS_PER_SEGMENT * sizeof(UploadQueue::Entry), MAX_SEGMENTS);
+    {
+        UploadQueue queue(storage, RECORDS_PER_SEGMENT, MAX_SEGMENTS);
+        queue.begin();
+        queue.push(makeRecord(0));
+        queue.push(makeRecord(1));
+    }
+
+    // Half an entry made it to storage before power was lost
+    uint8_t partial[sizeof(UploadQueue::Entry) / 2];
+    memset(partial, 0xAB, sizeof(partial));
+    storage.writeSegment(0, 2 * sizeof(UploadQueue::Entry), partial, sizeof(partial));
+
+    UploadQueue queue(storage, RECORDS_PER_SEGMENT, MAX_SEGMENTS);
+    queue.begin();
+    TEST_ASSERT_EQUAL_UINT32(2, queue.writeSequence());
+    TEST_ASSERT_TRUE(queue.push(makeRecord(2)));
+
+    UploadQueue::Entry entry;
+    TEST_ASSERT_TRUE(queue.read(2, entry));
+    TEST_ASSERT_EQUAL_UINT32(2, entry.record.capturedAt);
+}
+
+void test_readers_drain_independently() {
+    RAMLogStorage storage(RECORDS_PER_SEGMENT * sizeof(UploadQueue::Entry), MAX_SEGMENTS);
+    {
+        UploadQueue queue(storage, RECORDS_PER_SEGMENT, MAX_SEGMENTS, 2);
+        TEST_ASSERT_TRUE(queue.begin());
+        for (uint32_t i = 0; i < 6; i++) queue.push(makeRecord(i));
+
+        TEST_ASSERT_TRUE(queue.acknowledge(5, 0));
+        TEST_ASSERT_EQUAL_UINT32(0, queue.pending(0));
+        TEST_ASSERT_EQUAL_UINT32(6, queue.pending(1));
+        TEST_ASSERT_EQUAL_UINT32(6, queue.pending());
+
+        // The slow reader still gets everything
+        UploadQueue::Entry entry;
+        TEST_ASSERT_TRUE(queue.read(0, entry));
+        uint32_t first = 0, last = 0;
+        TEST_ASSERT_TRUE(storage.segmentRange(first, last));
+        TEST_ASSERT_EQUAL_UINT32(0, first);
+
+        // Once both are past it the segment goes
+        TEST_ASSERT_TRUE(queue.acknowledge(4, 1));
+        TEST_ASSERT_TRUE(storage.segmentRange(first, last));
+        TEST_ASSERT_EQUAL_UINT32(1, first);
+        TEST_ASSERT_FALSE(queue.acknowledge(2, 1));
+    }
+
+    UploadQueue queue(storage, RECORDS_PER_SEGMENT, MAX_SEGMENTS, 2);
+    TEST_ASSERT_TRUE(queue.begin());
+    TEST_ASSERT_EQUAL_UINT32(6, queue.readCursor(0));
+    TEST_ASSERT_EQUAL_UINT32(5, queue.readCursor(1));
+    TEST_ASSERT_EQUAL_UINT32(1, queue.pending());
+}
+
+void test_rotation_moves_only_readers_behind_on() {
+    RAMLogStorage storage(RECORDS_PER_SEGMENT * sizeof(UploadQueue::Entry), MAX_SEGMENTS);
+    UploadQueue queue(storage, RECORDS_PER_SEGMENT, MAX_SEGMENTS, 2);
+    queue.begin();
+
+    for (uint32_t i = 0; i < queue.capacity(); i++) {
+        queue.push(makeRecord(i));
+    }
+    queue.acknowledge(queue.capacity() - 2, 0);
+    TEST_ASSERT_TRUE(queue.push(makeRecord(queue.capacity())));
+
+    TEST_ASSERT_EQUAL_UINT32(RECORDS_PER_SEGMENT, queue.droppedCount());
+    TEST_ASSERT_EQUAL_UINT32(queue.capacity() - 1, queue.readCursor(0));
+    TEST_ASSERT_EQUAL_UINT32(RECORDS_PER_SEGMENT, queue.readCursor(1));
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_records_drain_in_order);
+    RUN_TEST(test_cursor_and_sequence_survive_restart);
+    RUN_TEST(test_sequence_continues_after_full_drain);
+    RUN_TEST(test_full_log_drops_oldest_segment);
+    RUN_TEST(test_corrupt_record_is_rejected);
+    RUN_TEST(test_torn_trailing_write_is_overwritten);
+    RUN_TEST(test_readers_drain_independently);
+    RUN_TEST(test_rotation_moves_only_readers_behind_on);
+    return UNITY_END();
+}
@@ -0,0 +1,113 @@
+#include <unity.h>
+#include <stdio.h>
+#include "UploadScheduler.h"
+
+void setUp() {}
+void tearDown() {}
+
+static const uint32_t INTERVAL = 300000;
+static const uint32_t JITTER = 60000;
+static const uint32_t MIN_INTERVAL = 60000;
+static const uint32_t MAX_INTERVAL = 21600000;
+
+void test_first_window_opens_at_the_device_phase() {
+    UploadScheduler schedule(INTERVAL, JITTER, MIN_INTERVAL, MAX_INTERVAL);
+    schedule.begin(1000, "ESM_001");
+
+    uint32_t phase = UploadScheduler::hashId("ESM_001") % INTERVAL;
+    TEST_ASSERT_EQUAL_UINT32(phase, schedule.phase());
+    TEST_ASSERT_EQUAL_UINT32(phase, schedule.dueIn(1000));
+    TEST_ASSERT_FALSE(schedule.due(1000 + phase - 1));
+    TEST_ASSERT_TRUE(schedule.due(1000 + phase));
+}
+
+void test_fleet_booted_together_is_spread_out() {
+    // 100 devices powered up at the same instant
+    const int DEVICES = 100;
+    const int BUCKETS = 10;
+    int perBucket[BUCKETS] = {0};
+    char id[16];
+    for (int i = 0; i < DEVICES; i++) {
+        snprintf(id, sizeof(id), "ESM_%03d", i + 1);
+        UploadScheduler schedule(INTERVAL, JITTER, MIN_INTERVAL, MAX_INTERVAL);
+        schedule.begin(0, id);
+        perBucket[schedule.dueIn(0) / (INTERVAL / BUCKETS)]++;
+    }
+
+    // No 30-second slice gets more than a quarter of the fleet
+    for (int b = 0; b < BUCKETS; b++) {
+        TEST_ASSERT_TRUE(perBucket[b] < DEVICES / 4);
+    }
+}
+
+void test_windows_repeat_within_jitter_bounds() {
+    UploadScheduler schedule(INTERVAL, JITTER, MIN_INTERVAL, MAX_INTERVAL);
+    schedule.seed(42);
+    schedule.begin(0, "ESM_001");
+
+    uint32_t now = schedule.phase();
+    bool varied = false;
+    uint32_t previous = 0;
+    for (int i = 0; i < 20; i++) {
+        TEST_ASSERT_TRUE(schedule.due(now));
+        schedule.windowUsed(now);
+        uint32_t wait = schedule.dueIn(now);
+        TEST_ASSERT_TRUE(wait >= INTERVAL - JITTER / 2);
+        TEST_ASSERT_TRUE(wait <= INTERVAL + JITTER / 2);
+        varied = varied || (i > 0 && wait != previous);
+        previous = wait;
+        now += wait;
+    }
+    TEST_ASSERT_TRUE(varied);
+}
+
+void test_server_interval_is_clamped_and_applied() {
+    UploadScheduler schedule(INTERVAL, JITTER, MIN_INTERVAL, MAX_INTERVAL);
+    schedule.begin(0, "ESM_001");
+
+    schedule.setInterval(5000, 900000);
+    TEST_ASSERT_EQUAL_UINT32(900000, schedule.interval());
+    TEST_ASSERT_TRUE(schedule.dueIn(5000) >= 900000 - JITTER / 2);
+    TEST_ASSERT_TRUE(schedule.dueIn(5000) <= 900000 + JITTER / 2);
+    TEST_ASSERT_EQUAL_UINT32(UploadScheduler::hashId("ESM_001") % INTERVAL, schedule.phase());
+
+    schedule.setInterval(5000, 1000);
+    TEST_ASSERT_EQUAL_UINT32(MIN_INTERVAL, schedule.interval());
+    schedule.setInterval(5000, 0xFFFFFFFF);
+    TEST_ASSERT_EQUAL_UINT32(MAX_INTERVAL, schedule.interval());
+}
+
+void test_deferred_window_is_looked_at_again_soon() {
+    UploadScheduler schedule(INTERVAL, JITTER, MIN_INTERVAL, MAX_INTERVAL);
+    schedule.begin(0, "ESM_001");
+    uint32_t now = schedule.phase();
+
+    schedule.deferWindow(now, 120000);
+    TEST_ASSERT_EQUAL_UINT32(120000, schedule.dueIn(now));
+    TEST_ASSERT_EQUAL_UINT32(INTERVAL, schedule.interval());
+
+    // Never later than a normal window would have been
+    schedule.deferWindow(now, 10 * INTERVAL);
+    TEST_ASSERT_EQUAL_UINT32(INTERVAL, schedule.dueIn(now));
+}
+
+void test_schedule_survives_millis_wrap() {
+    UploadScheduler schedule(INTERVAL, 0, MIN_INTERVAL, MAX_INTERVAL);
+    uint32_t now = 0xFFFFFFFF - 1000;
+    schedule.begin(now, "ESM_001");
+    schedule.windowUsed(now);
+    TEST_ASSERT_FALSE(schedule.due(now + INTERVAL - 1));
+    TEST_ASSERT_TRUE(schedule.due(now + INTERVAL));
+    TEST_ASSERT_EQUAL_UINT32(INTERVAL, schedule.dueIn(now));
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_first_window_opens_at_the_device_phase);
+    RUN_TEST(test_fleet_booted_together_is_spread_out);
+    RUN_TEST(test_windows_repeat_within_jitter_bounds);
+    RUN_TEST(test_server_interval_is_clamped_and_applied);
+    RUN_TEST(test_deferred_window_is_looked_at_again_soon);
+    RUN_TEST(test_schedule_survives_millis_wrap);
+    return UNITY_END();
+}
@@ -0,0 +1,197 @@
+#include <unity.h>
+#include "WallClock.h"
+
+void setUp() {}
+void tearDown() {}
+
+static const uint32_t NETWORK_EPOCH = 1717243200UL;    // 2024-06-01 12:00:00 UTC
+static const uint32_t HOUR = 3600000UL;
+
+// A DS3231 as WallClock sees it: its time runs `ppm` fast until trimmed
+class FakeRTC : public RTCDevice {
+public:
+    bool running;
+    uint32_t setAt;         // Epoch written last
+    uint32_t setWhen;       // True time (s) of that write
+    int8_t trim;
+    int ppm;
+    uint32_t trueTime;      // Advanced by the test
+    int timeWrites;
+    int trimWrites;
+
+    FakeRTC() : running(false), setAt(0), setWhen(0), trim(0), ppm(0), trueTime(0), timeWrites(0), trimWrites(0) {}
+
+    bool readTime(uint32_t& epoch) {
+        if (!running) {
+            return false;
+        }
+        // 0.1 ppm per trim step
+        int64_t elapsed = (int64_t)(trueTime - setWhen);
+        epoch = setAt + (uint32_t)(elapsed + elapsed * (ppm * 10 - trim) / 10000000);
+        return true;
+    }
+    bool writeTime(uint32_t epoch) {
+        running = true;
+        setAt = epoch;
+        setWhen = trueTime;
+        timeWrites++;
+        return true;
+    }
+    bool readTrim(int8_t& value) { value = trim; return true; }
+    bool writeTrim(int8_t value) { trim = value; trimWrites++; return true; }
+    int trimStep() const { return 1; }
+};
+
+void test_unset_clock_reads_zero() {
+    WallClock clock;
+    TEST_ASSERT_FALSE(clock.begin(1000));
+    TEST_ASSERT_EQUAL(WallClock::SOURCE_NONE, clock.source());
+    TEST_ASSERT_EQUAL_UINT64(0, clock.epochMillis(5000));
+
+    // The modem's RTC before it has network time
+    clock.syncNetwork(1072915200UL, 6000);
+    TEST_ASSERT_FALSE(clock.valid());
+}
+
+void test_boot_time_comes_from_the_rtc() {
+    FakeRTC rtc;
+    rtc.trueTime = NETWORK_EPOCH;
+    rtc.writeTime(NETWORK_EPOCH);
+    rtc.trim = -7;
+
+    WallClock clock;
+    clock.attachRTC(&rtc);
+    TEST_ASSERT_TRUE(clock.begin(2000));
+    TEST_ASSERT_EQUAL(WallClock::SOURCE_RTC, clock.source());
+    TEST_ASSERT_EQUAL_UINT64((uint64_t)NETWORK_EPOCH * 1000 + 1500, clock.epochMillis(3500));
+    TEST_ASSERT_EQUAL_INT(-7, clock.drift().rtcTrim);
+
+    // A chip whose oscillator stopped is not believed
+    FakeRTC lost;
+    WallClock other;
+    other.attachRTC(&lost);
+    TEST_ASSERT_FALSE(other.begin(2000));
+}
+
+void test_small_offsets_keep_the_estimate() {
+    WallClock clock;
+    clock.syncNetwork(NETWORK_EPOCH, 10000);
+    TEST_ASSERT_EQUAL(WallClock::SOURCE_NETWORK, clock.source());
+    TEST_ASSERT_EQUAL_UINT32(1, clock.drift().steps);
+
+    // Network time is whole seconds: 600 ms behind it is not worth a step
+    clock.syncNetwork(NETWORK_EPOCH + 60, 10000 + 59400);
+    TEST_ASSERT_EQUAL_INT32(600, clock.drift().lastOffset);
+    TEST_ASSERT_EQUAL_UINT32(1, clock.drift().steps);
+    TEST_ASSERT_EQUAL_UINT64((uint64_t)NETWORK_EPOCH * 1000 + 59400, clock.epochMillis(69400));
+
+    // Readings taken before the sync still resolve against it
+    TEST_ASSERT_EQUAL_UINT32(NETWORK_EPOCH + 30, clock.epoch(40000));
+}
+
+void test_large_offset_steps_and_drift_is_measured() {
+    WallClock clock;
+    clock.syncNetwork(NETWORK_EPOCH, 0);
+
+    // The local counter runs 100 ppm slow: 720 ms short over two hours
+    clock.syncNetwork(NETWORK_EPOCH + 7200, 2 * HOUR - 720);
+    TEST_ASSERT_EQUAL_INT32(720, clock.drift().lastOffset);
+    TEST_ASSERT_EQUAL_INT32(100, clock.drift().ppm);
+
+    // Ten hours in the error is over a second: step to network time
+    clock.syncNetwork(NETWORK_EPOCH + 36000, 10 * HOUR - 3600);
+    TEST_ASSERT_EQUAL_UINT32(2, clock.drift().steps);
+    TEST_ASSERT_EQUAL_INT32(100, clock.drift().ppm);
+    TEST_ASSERT_EQUAL_UINT32(NETWORK_EPOCH + 36000, clock.epoch(10 * HOUR - 3600));
+    TEST_ASSERT_EQUAL_UINT32(3, clock.drift().syncs);
+}
+
+void test_counter_wrap_is_seamless() {
+    // Where millis() would wrap, 49.7 days in
+    WallClock clock;
+    uint64_t before = 0xFFFFFFFFULL - 5000;
+    clock.syncNetwork(NETWORK_EPOCH, before);
+    TEST_ASSERT_EQUAL_UINT32(NETWORK_EPOCH + 10, clock.epoch(before + 10000));
+}
+
+void test_rtc_only_clock_runs_for_months() {
+    FakeRTC rtc;
+    rtc.trueTime = NETWORK_EPOCH;
+    rtc.writeTime(NETWORK_EPOCH);
+    WallClock clock;
+    clock.attachRTC(&rtc);
+    TEST_ASSERT_TRUE(clock.begin(1000));
+
+    // No network time ever: the boot anchor has to hold past 2^31 and 2^32 ms
+    uint64_t later = 1000 + 0x80000000ULL + 60000;
+    TEST_ASSERT_EQUAL_UINT32(NETWORK_EPOCH + (uint32_t)((later - 1000) / 1000), clock.epoch(later));
+    later = 1000 + 100ULL * 86400000ULL;
+    TEST_ASSERT_EQUAL_UINT32(NETWORK_EPOCH + 100UL * 86400, clock.epoch(later));
+    TEST_ASSERT_EQUAL(WallClock::SOURCE_RTC, clock.source());
+}
+
+void test_rtc_is_set_then_trimmed() {
+    FakeRTC rtc;
+    rtc.ppm = 20;           // 1.7 s a day fast
+    rtc.trueTime = NETWORK_EPOCH;
+    WallClock clock(86400);
+    clock.attachRTC(&rtc);
+    TEST_ASSERT_FALSE(clock.begin(0));
+
+    // Lost its time: set straight away
+    clock.syncNetwork(NETWORK_EPOCH, 0);
+    TEST_ASSERT_EQUAL_INT(1, rtc.timeWrites);
+
+    // A second off within the day is left alone
+    rtc.trueTime = NETWORK_EPOCH + 43200;
+    clock.syncNetwork(rtc.trueTime, 43200000UL);
+    TEST_ASSERT_EQUAL_INT32(0, clock.drift().rtcOffset);
+    TEST_ASSERT_EQUAL_INT(1, rtc.timeWrites);
+
+    // After a day the rate error goes into the trim and the time is reset
+    rtc.trueTime = NETWORK_EPOCH + 86400;
+    clock.syncNetwork(rtc.trueTime, 86400000UL);
+    TEST_ASSERT_EQUAL_INT32(1, clock.drift().rtcOffset);
+    TEST_ASSERT_EQUAL_INT(1, rtc.trimWrites);
+    TEST_ASSERT_TRUE(rtc.trim > 0);
+    TEST_ASSERT_EQUAL_INT(rtc.trim, clock.drift().rtcTrim);
+    TEST_ASSERT_EQUAL_INT(2, rtc.timeWrites);
+    uint32_t epoch = 0;
+    TEST_ASSERT_TRUE(rtc.readTime(epoch));
+    TEST_ASSERT_EQUAL_UINT32(rtc.trueTime, epoch);
+}
+
+void test_rtc_far_off_is_reset() {
+    FakeRTC rtc;
+    rtc.trueTime = NETWORK_EPOCH;
+    rtc.writeTime(NETWORK_EPOCH - 300);     // Battery swapped, set by hand
+    rtc.timeWrites = 0;
+    WallClock clock;
+    clock.attachRTC(&rtc);
+    TEST_ASSERT_TRUE(clock.begin(0));
+
+    clock.syncNetwork(NETWORK_EPOCH, 0);
+    TEST_ASSERT_EQUAL_INT32(-300, clock.drift().rtcOffset);
+    TEST_ASSERT_EQUAL_INT(1, rtc.timeWrites);
+    TEST_ASSERT_EQUAL_INT(0, rtc.trimWrites);
+
+    // Stepped again within the span: reset, never trimmed on a short span
+    rtc.trueTime += 3600;
+    rtc.setAt -= 5;
+    clock.syncNetwork(rtc.trueTime, HOUR);
+    TEST_ASSERT_EQUAL_INT(2, rtc.timeWrites);
+    TEST_ASSERT_EQUAL_INT(0, rtc.trimWrites);
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_unset_clock_reads_zero);
+    RUN_TEST(test_boot_time_comes_from_the_rtc);
+    RUN_TEST(test_small_offsets_keep_the_estimate);
+    RUN_TEST(test_large_offset_steps_and_drift_is_measured);
+    RUN_TEST(test_counter_wrap_is_seamless);
+    RUN_TEST(test_rtc_only_clock_runs_for_months);
+    RUN_TEST(test_rtc_is_set_then_trimmed);
+    RUN_TEST(test_rtc_far_off_is_reset);
+    return UNITY_END();
+}